@@ -0,0 +1,98 @@
+//======================================================================
+#include "alloc_count.h"
+
+#if defined(ALLOCATION_CHECK)
+//======================================================================
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+//======================================================================
+static thread_local uint64_t count = 0;
+static thread_local bool excused = false;
+
+//======================================================================
+// The replacements of the global allocation functions, all of them, so
+// that every new is paired with the right delete.
+void *operator new( std::size_t size )
+{
+    count++;
+    if( void *p = std::malloc( size ? size : 1 ) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new( std::size_t size, std::align_val_t align )
+{
+    count++;
+    size_t a = size_t( align );
+    if( void *p = std::aligned_alloc( a, (size + a - 1) / a * a ) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[]( std::size_t size ) { return operator new( size ); }
+void *operator new[]( std::size_t size, std::align_val_t align ) { return operator new( size, align ); }
+
+void *operator new( std::size_t size, const std::nothrow_t & ) noexcept
+{
+    count++;
+    return std::malloc( size ? size : 1 );
+}
+void *operator new[]( std::size_t size, const std::nothrow_t &tag ) noexcept { return operator new( size, tag ); }
+
+void operator delete( void *p ) noexcept { std::free( p ); }
+void operator delete[]( void *p ) noexcept { std::free( p ); }
+void operator delete( void *p, std::size_t ) noexcept { std::free( p ); }
+void operator delete[]( void *p, std::size_t ) noexcept { std::free( p ); }
+void operator delete( void *p, std::align_val_t ) noexcept { std::free( p ); }
+void operator delete[]( void *p, std::align_val_t ) noexcept { std::free( p ); }
+void operator delete( void *p, std::size_t, std::align_val_t ) noexcept { std::free( p ); }
+void operator delete[]( void *p, std::size_t, std::align_val_t ) noexcept { std::free( p ); }
+void operator delete( void *p, const std::nothrow_t & ) noexcept { std::free( p ); }
+void operator delete[]( void *p, const std::nothrow_t & ) noexcept { std::free( p ); }
+
+//======================================================================
+namespace alloc_count {
+
+//======================================================================
+uint64_t allocations()
+{
+    return count;
+}
+
+//======================================================================
+void excuse_frame()
+{
+    excused = true;
+}
+
+//======================================================================
+FrameCheck::FrameCheck( const char *name, int warmup ) : m_Name( name ), m_Warmup( warmup )
+{
+    last = count;
+}
+
+//======================================================================
+void FrameCheck::end_frame()
+{
+    uint64_t made = count - last;
+    if( made && !excused && frames >= uint64_t( m_Warmup ) )
+    {
+        std::fprintf( stderr, "***ERROR: %s: frame %llu made %llu heap allocations.\n",
+                      m_Name, (unsigned long long)frames, (unsigned long long)made );
+        std::abort();
+    }
+    excused = false;
+    frames++;
+    last = count;
+}
+
+//======================================================================
+} // End of namespace alloc_count
+
+#endif // ALLOCATION_CHECK
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,59 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+//======================================================================
+#include <cstdint>
+
+//======================================================================
+// Counting of heap allocations (operator new), to check that the frames
+// of the steady state allocate nothing. Only in builds with the CMake
+// option ALLOCATION_CHECK: alloc_count.cpp then replaces the global
+// operator new and delete. The counts are per thread; the one that runs
+// the frames is the one that matters (not the metrics server's, not the
+// audio callback's). malloc() in C libraries (SDL, GL drivers) doesn't
+// count.
+//
+// Without ALLOCATION_CHECK, all of this compiles to nothing.
+namespace alloc_count {
+
+#if defined(ALLOCATION_CHECK)
+//======================================================================
+// Allocations of the calling thread so far.
+uint64_t allocations();
+// The current frame may allocate: the user loaded a program, a viewer
+// connected, ...
+void excuse_frame();
+
+//======================================================================
+// Call end_frame() once per frame. After "warmup" frames, a frame that
+// allocated (and wasn't excused) is reported on stderr with its number,
+// and the program aborts, so a debugger shows where.
+class FrameCheck
+{
+public:
+    explicit FrameCheck( const char *name, int warmup = 100 );
+    void end_frame();
+
+private:
+    const char *m_Name;
+    int m_Warmup;
+    uint64_t frames {0};
+    uint64_t last {0};
+};
+
+#else
+//======================================================================
+inline uint64_t allocations() { return 0; }
+inline void excuse_frame() {}
+
+class FrameCheck
+{
+public:
+    explicit FrameCheck( const char *, int = 100 ) {}
+    void end_frame() {}
+};
+#endif
+
+} // End of namespace alloc_count
+
+#endif // ALLOC_COUNT_H
+//======================================================================
@@ -0,0 +1,239 @@
+//======================================================================
+#include "glmurks64.h"
+//======================================================================
+#include "c64.h"
+#include "autostart.h"
+#include "palette.h"
+#include "render_kernels.h"
+//======================================================================
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//======================================================================
+struct glmurks64_session
+{
+    emu::C64 c64;
+    emu::Autostart autostart;
+    mutable std::unique_ptr<emu::C64::Snapshot> snap;   // For save and load.
+    std::vector<uint8_t> frame = std::vector<uint8_t>( size_t( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT ) );
+    bool frame_dirty {true};
+};
+
+//======================================================================
+namespace {
+    //------------------------------------------------------------------
+    // The state blob: MAGIC, the size of the snapshot, the snapshot.
+    constexpr uint32_t MAGIC = 0x34364D47;  // "GM64"
+    constexpr size_t HEADER = 8;
+    //------------------------------------------------------------------
+    thread_local std::string last_error;
+    //------------------------------------------------------------------
+    // No exception gets out to C: it becomes the last error.
+    template<typename F>
+    int guarded( F f )
+    {
+        last_error.clear();
+        try
+        {
+            f();
+            return GLMURKS64_OK;
+        }
+        catch( const std::exception &e )
+        {
+            last_error = e.what();
+        }
+        catch( int error )      // utils::Buffer::load()
+        {
+            last_error = std::string( "Can't read file: " ) + std::strerror( error );
+        }
+        catch( ... )
+        {
+            last_error = "Unknown error";
+        }
+        return GLMURKS64_ERROR;
+    }
+    //------------------------------------------------------------------
+    void snapshot( const glmurks64_session *session )
+    {
+        if( !session->snap )
+            session->snap = std::make_unique<emu::C64::Snapshot>();
+    }
+} // End of namespace
+
+//======================================================================
+int glmurks64_api_version( void )
+{
+    return GLMURKS64_API_VERSION;
+}
+
+//======================================================================
+const char *glmurks64_last_error( void )
+{
+    return last_error.c_str();
+}
+
+//======================================================================
+glmurks64_session *glmurks64_create( int sid_model )
+{
+    glmurks64_session *session = nullptr;
+    int result = guarded( [&] {
+        auto s = std::make_unique<glmurks64_session>();
+        s->c64.init( sid_model == GLMURKS64_SID_8580 ? sound::SIDModel::MOS8580 : sound::SIDModel::MOS6581 );
+        session = s.release();
+    } );
+    return result == GLMURKS64_OK ? session : nullptr;
+}
+
+//======================================================================
+void glmurks64_destroy( glmurks64_session *session )
+{
+    delete session;
+}
+
+//======================================================================
+int glmurks64_run_cycles( glmurks64_session *session, uint64_t cycles )
+{
+    return guarded( [&] {
+        session->c64.run_cycles( cycles );
+        session->frame_dirty = true;
+    } );
+}
+
+//======================================================================
+int glmurks64_run_frames( glmurks64_session *session, uint32_t frames )
+{
+    return guarded( [&] {
+        for( uint32_t i = 0; i < frames; i++ )
+            session->c64.run_frame();
+        session->frame_dirty = true;
+    } );
+}
+
+//======================================================================
+uint64_t glmurks64_cycles( const glmurks64_session *session )
+{
+    return session->c64.cycles_now();
+}
+
+//======================================================================
+const uint8_t *glmurks64_ram( const glmurks64_session *session )
+{
+    return session->c64.ram.data();
+}
+
+//======================================================================
+const uint8_t *glmurks64_color_ram( const glmurks64_session *session )
+{
+    return session->c64.color_ram.data();
+}
+
+//======================================================================
+uint8_t glmurks64_peek( const glmurks64_session *session, uint16_t address )
+{
+    return session->c64.peek( address );
+}
+
+//======================================================================
+const uint8_t *glmurks64_frame( glmurks64_session *session )
+{
+    if( session->frame_dirty )
+    {
+        emu::C64 &c64 = session->c64;
+        gfx::render_frame( { c64.ram.data(), c64.color_ram.data(), c64.vic.raster_lines(), c64.vic.display_lines() },
+                           c64.char_rom.data(), session->frame.data() );
+        session->frame_dirty = false;
+    }
+    return session->frame.data();
+}
+
+//======================================================================
+int glmurks64_palette( const char *name, uint8_t rgba[16 * 4] )
+{
+    return guarded( [&] {
+        gfx::Palette palette = name ? gfx::Palette::load( name ) : gfx::Palette();
+        for( int i = 0; i < gfx::Palette::COLORS; i++ )
+            std::memcpy( rgba + 4 * i, &palette.pixels()[ size_t(i) ], 4 );
+    } );
+}
+
+//======================================================================
+void glmurks64_key( glmurks64_session *session, int column, int row, int down )
+{
+    session->c64.key( column, row, down != 0 );
+}
+
+//======================================================================
+void glmurks64_restore( glmurks64_session *session, int down )
+{
+    session->c64.restore( down != 0 );
+}
+
+//======================================================================
+void glmurks64_joystick( glmurks64_session *session, int port, uint8_t bits )
+{
+    session->c64.joystick( port, bits );
+}
+
+//======================================================================
+int glmurks64_type( glmurks64_session *session, const char *text )
+{
+    uint8_t before = session->c64.ram[0xC6];
+    emu::type_keys( session->c64, text ? text : "" );
+    return session->c64.ram[0xC6] - before;
+}
+
+//======================================================================
+int glmurks64_autostart( glmurks64_session *session, const char *filename )
+{
+    return guarded( [&] {
+        if( !filename )
+            throw std::runtime_error( "No program file" );
+        session->autostart.start( session->c64, emu::load_program( filename ) );
+        session->frame_dirty = true;
+    } );
+}
+
+//======================================================================
+size_t glmurks64_state_size( void )
+{
+    return HEADER + sizeof(emu::C64::Snapshot);
+}
+
+//======================================================================
+int glmurks64_save_state( const glmurks64_session *session, void *buffer, size_t size )
+{
+    return guarded( [&] {
+        if( size < glmurks64_state_size() )
+            throw std::runtime_error( "State buffer too small: " + std::to_string( size ) + " bytes, " +
+                                      std::to_string( glmurks64_state_size() ) + " needed" );
+        snapshot( session );
+        session->c64.save_state( *session->snap );
+        uint32_t head[2] { MAGIC, uint32_t( sizeof(emu::C64::Snapshot) ) };
+        std::memcpy( buffer, head, HEADER );
+        std::memcpy( static_cast<uint8_t*>( buffer ) + HEADER, session->snap.get(), sizeof(emu::C64::Snapshot) );
+    } );
+}
+
+//======================================================================
+int glmurks64_load_state( glmurks64_session *session, const void *buffer, size_t size )
+{
+    return guarded( [&] {
+        uint32_t head[2] {};
+        if( size >= HEADER )
+            std::memcpy( head, buffer, HEADER );
+        if( size != glmurks64_state_size() || head[0] != MAGIC || head[1] != sizeof(emu::C64::Snapshot) )
+            throw std::runtime_error( "Not a state of this build of the library" );
+        snapshot( session );
+        std::memcpy( session->snap.get(), static_cast<const uint8_t*>( buffer ) + HEADER, sizeof(emu::C64::Snapshot) );
+        session->c64.load_state( *session->snap );
+        session->frame_dirty = true;
+    } );
+}
+
+//======================================================================
+// End of file.
+//======================================================================
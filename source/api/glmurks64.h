@@ -0,0 +1,111 @@
+#ifndef GLMURKS64_H
+#define GLMURKS64_H
+//======================================================================
+// libglmurks64: the emulation core for other programs, as a C API.
+//
+// A session is a C64 of its own. Sessions don't share anything, so
+// different threads can use different sessions at the same time; a
+// session is used by one thread at a time.
+//
+// Memory and frames are not copied: the pointers point into the session
+// and show what the machine did up to the last call. The ROMs come from
+// the "resource" folder next to (or above) the executable, or from the
+// folder in the environment variable GLMURKS64_RESOURCES.
+//
+// Functions that can fail return GLMURKS64_OK or GLMURKS64_ERROR (NULL
+// for glmurks64_create()), glmurks64_last_error() tells why.
+//======================================================================
+#include <stddef.h>
+#include <stdint.h>
+
+//======================================================================
+#if defined(_WIN32)
+    #define GLMURKS64_API __declspec(dllexport)
+#else
+    #define GLMURKS64_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//======================================================================
+// Changes when the API changes in a way that breaks callers.
+#define GLMURKS64_API_VERSION 1
+GLMURKS64_API int glmurks64_api_version( void );
+
+//======================================================================
+enum { GLMURKS64_OK = 0, GLMURKS64_ERROR = -1 };
+enum { GLMURKS64_SID_6581 = 0, GLMURKS64_SID_8580 = 1 };
+// PAL: cycles per frame, frame size of glmurks64_frame().
+enum
+{
+    GLMURKS64_CYCLES_PER_FRAME = 19656,
+    GLMURKS64_FRAME_WIDTH = 384,
+    GLMURKS64_FRAME_HEIGHT = 272
+};
+
+//======================================================================
+// The last error of a call on this thread ("" if none).
+GLMURKS64_API const char *glmurks64_last_error( void );
+
+//======================================================================
+typedef struct glmurks64_session glmurks64_session;
+
+// Power on a C64 with the given SID model. NULL if the ROMs are missing.
+GLMURKS64_API glmurks64_session *glmurks64_create( int sid_model );
+GLMURKS64_API void glmurks64_destroy( glmurks64_session *session );
+
+//======================================================================
+// Run the emulation. glmurks64_run_frames() runs up to the end of a
+// frame "frames" times: the first one only finishes the current frame.
+GLMURKS64_API int glmurks64_run_cycles( glmurks64_session *session, uint64_t cycles );
+GLMURKS64_API int glmurks64_run_frames( glmurks64_session *session, uint32_t frames );
+GLMURKS64_API uint64_t glmurks64_cycles( const glmurks64_session *session );
+
+//======================================================================
+// The 64K RAM and the 1K color RAM (low nibbles) of the session, valid
+// until it is destroyed.
+GLMURKS64_API const uint8_t *glmurks64_ram( const glmurks64_session *session );
+GLMURKS64_API const uint8_t *glmurks64_color_ram( const glmurks64_session *session );
+// Read a byte as the CPU sees it (ROMs, I/O registers), without side
+// effects.
+GLMURKS64_API uint8_t glmurks64_peek( const glmurks64_session *session, uint16_t address );
+
+//======================================================================
+// The picture of the last 312 raster lines, GLMURKS64_FRAME_WIDTH x
+// GLMURKS64_FRAME_HEIGHT palette indices (0-15): border and text screen,
+// no sprites. Rendered when it is asked for after the machine ran; the
+// pointer stays the same for the session, the contents are valid until
+// the next run.
+GLMURKS64_API const uint8_t *glmurks64_frame( glmurks64_session *session );
+// The colors of the palette "name" (NULL: the default), see --palette:
+// 16 times R, G, B, A (255) bytes.
+GLMURKS64_API int glmurks64_palette( const char *name, uint8_t rgba[16 * 4] );
+
+//======================================================================
+// Input. The keyboard matrix by column (CIA1 port A bit) and row (CIA1
+// port B bit); joystick bits 0 up, 1 down, 2 left, 3 right, 4 fire,
+// "port" 1 or 2. glmurks64_type() puts characters into the KERNAL
+// keyboard buffer ('\n' is RETURN) and returns how many fit (it holds 10).
+GLMURKS64_API void glmurks64_key( glmurks64_session *session, int column, int row, int down );
+GLMURKS64_API void glmurks64_restore( glmurks64_session *session, int down );
+GLMURKS64_API void glmurks64_joystick( glmurks64_session *session, int port, uint8_t bits );
+GLMURKS64_API int glmurks64_type( glmurks64_session *session, const char *text );
+// Boot (the first time), load a PRG or T64 file into memory and RUN it.
+GLMURKS64_API int glmurks64_autostart( glmurks64_session *session, const char *filename );
+
+//======================================================================
+// The complete state of the machine. Only valid for the same build of
+// the library. glmurks64_save_state() fails if "size" is less than
+// glmurks64_state_size().
+GLMURKS64_API size_t glmurks64_state_size( void );
+GLMURKS64_API int glmurks64_save_state( const glmurks64_session *session, void *buffer, size_t size );
+GLMURKS64_API int glmurks64_load_state( glmurks64_session *session, const void *buffer, size_t size );
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // GLMURKS64_H
+//======================================================================
@@ -0,0 +1,603 @@
+//======================================================================
+// glMurks64-bench: times the building blocks of startup and rendering.
+// The GL cases run on an offscreen EGL context (Mesa llvmpipe by
+// default), so the results don't depend on a window or a GPU.
+// Results can be written as JSON and compared to a stored baseline.
+//======================================================================
+#include "graphics.h"
+#include "text_screen.h"
+#include "border.h"
+#include "framebuffer.h"
+#include "gfx_utils.h"
+#include "gl_pool.h"
+#include "palette.h"
+#include "render_kernels.h"
+#include "metrics.h"
+#include "utils.h"
+//======================================================================
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+//======================================================================
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//======================================================================
+// Size of the offscreen "window".
+constexpr int SCREEN_WIDTH  = 384*2;
+constexpr int SCREEN_HEIGHT = 272*2;
+
+//======================================================================
+static void usage()
+{
+    std::cerr <<
+        "Usage: glMurks64-bench [options]\n"
+        "  --json <file>       Write the results as JSON.\n"
+        "  --compare <file>    Compare to a baseline written by --json. The\n"
+        "                      exit code is 1 if a case got slower.\n"
+        "  --threshold <pct>   Allowed slowdown of the median (default: 10).\n"
+        "  --time <seconds>    Measuring time per case (default: 0.5).\n"
+        "  --filter <text>     Only run cases whose name contains <text>.\n"
+        "  --no-gl             Skip the cases that need OpenGL.\n"
+        "The GL cases use EGL. Mesa's llvmpipe is selected unless GALLIUM_DRIVER\n"
+        "is set already.\n";
+}
+
+//======================================================================
+// The statistics of one case. All times in nanoseconds per operation.
+struct Result
+{
+    std::string name;
+    int iterations {0};
+    double min {0}, median {0}, mean {0}, p95 {0}, stddev {0};
+};
+
+//======================================================================
+class Bench
+{
+public:
+    double seconds {0.5};
+    std::string filter;
+    std::vector<Result> results;
+    //==================================================================
+    // Run "fn" for warmup, then until "seconds" have passed (at least
+    // 10 times). "batch" is the number of operations one call of fn does.
+    void run( const std::string &name, const std::function<void()> &fn, int batch = 1 )
+    {
+        if( !filter.empty() && name.find( filter ) == std::string::npos )
+            return;
+        using clock = std::chrono::steady_clock;
+        //--------------------------------------------------------------
+        // Warmup: a tenth of the measuring time, at least 3 calls.
+        auto warmup_end = clock::now() + std::chrono::duration<double>( seconds / 10 );
+        for( int i = 0; i < 3 || clock::now() < warmup_end; i++ )
+            fn();
+        //--------------------------------------------------------------
+        std::vector<double> samples;
+        auto end = clock::now() + std::chrono::duration<double>( seconds );
+        while( samples.size() < 10 || (clock::now() < end && samples.size() < 1000000) )
+        {
+            auto t0 = clock::now();
+            fn();
+            auto t1 = clock::now();
+            samples.push_back( std::chrono::duration<double, std::nano>( t1 - t0 ).count() / batch );
+        }
+        //--------------------------------------------------------------
+        std::sort( samples.begin(), samples.end() );
+        Result r;
+        r.name = name;
+        r.iterations = int( samples.size() );
+        r.min = samples.front();
+        r.median = samples[ samples.size() / 2 ];
+        r.p95 = samples[ (samples.size() - 1) * 95 / 100 ];
+        double sum = 0, sq = 0;
+        for( double s : samples ) sum += s;
+        r.mean = sum / samples.size();
+        for( double s : samples ) sq += (s - r.mean) * (s - r.mean);
+        r.stddev = std::sqrt( sq / samples.size() );
+        results.push_back( r );
+        std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(1)
+                  << " median " << std::setw(12) << r.median << " ns"
+                  << "  p95 " << std::setw(12) << r.p95 << " ns"
+                  << "  (" << r.iterations << " runs)\n";
+    }
+};
+
+//======================================================================
+static void write_json( const std::string &filename, const std::vector<Result> &results )
+{
+    std::ofstream out( filename );
+    out << "{\n  \"unit\": \"ns\",\n  \"benchmarks\": [\n";
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        const Result &r = results[i];
+        out << std::fixed << std::setprecision(1)
+            << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"min\": " << r.min << ", \"median\": " << r.median << ", \"mean\": " << r.mean
+            << ", \"p95\": " << r.p95 << ", \"stddev\": " << r.stddev << " }"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    if( !out )
+        std::cerr << "***ERROR: Can't write " << filename << "\n";
+}
+
+//======================================================================
+// Read the medians from a file written by write_json(). This is not a
+// JSON parser, it only understands what write_json() writes.
+static std::map<std::string, double> read_baseline( const std::string &filename )
+{
+    std::map<std::string, double> medians;
+    std::ifstream in( filename );
+    if( !in )
+    {
+        std::cerr << "***ERROR: Can't read baseline " << filename << "\n";
+        return medians;
+    }
+    std::string line;
+    while( std::getline( in, line ) )
+    {
+        auto name = line.find( "\"name\": \"" );
+        auto median = line.find( "\"median\": " );
+        if( name == std::string::npos || median == std::string::npos )
+            continue;
+        name += 9;
+        auto name_end = line.find( '"', name );
+        medians[ line.substr( name, name_end - name ) ] = std::atof( line.c_str() + median + 10 );
+    }
+    return medians;
+}
+
+//======================================================================
+// Returns the number of cases that got slower than allowed.
+static int compare( const std::vector<Result> &results, const std::string &filename, double threshold )
+{
+    auto baseline = read_baseline( filename );
+    int regressions = 0;
+    std::cout << "\nCompared to " << filename << " (threshold " << threshold << "%):\n";
+    for( const Result &r : results )
+    {
+        auto it = baseline.find( r.name );
+        std::cout << std::left << std::setw(34) << r.name << std::right;
+        if( it == baseline.end() || it->second <= 0 )
+        {
+            std::cout << "   new\n";
+            continue;
+        }
+        double change = (r.median / it->second - 1.0) * 100.0;
+        bool slower = change > threshold;
+        regressions += slower;
+        std::cout << std::showpos << std::setw(9) << std::setprecision(1) << change << "%" << std::noshowpos
+                  << (slower ? "   REGRESSION\n" : "\n");
+    }
+    return regressions;
+}
+
+//======================================================================
+// Create an offscreen OpenGL 4.6 core context with a pbuffer the size
+// of the window. The GLSL 4.60 shaders need the version override on
+// llvmpipe releases that report 4.5.
+static bool create_gl_context()
+{
+    setenv( "GALLIUM_DRIVER", "llvmpipe", 0 );
+    setenv( "MESA_GL_VERSION_OVERRIDE", "4.6", 0 );
+    setenv( "MESA_GLSL_VERSION_OVERRIDE", "460", 0 );
+    setenv( "MESA_SHADER_CACHE_DISABLE", "true", 0 ); // Time real compiles.
+    //------------------------------------------------------------------
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress( "eglGetPlatformDisplayEXT" ) );
+    if( get_platform_display )
+        display = get_platform_display( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+    if( display == EGL_NO_DISPLAY )
+        display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+    if( display == EGL_NO_DISPLAY || !eglInitialize( display, nullptr, nullptr ) )
+    {
+        std::cerr << "***ERROR: No EGL display.\n";
+        return false;
+    }
+    eglBindAPI( EGL_OPENGL_API );
+    //------------------------------------------------------------------
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    if( !eglChooseConfig( display, config_attribs, &config, 1, &configs ) || configs < 1 )
+    {
+        std::cerr << "***ERROR: No EGL config for a pbuffer.\n";
+        return false;
+    }
+    const EGLint surface_attribs[] = { EGL_WIDTH, SCREEN_WIDTH, EGL_HEIGHT, SCREEN_HEIGHT, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface( display, config, surface_attribs );
+    //------------------------------------------------------------------
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE };
+    EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, context_attribs );
+    if( surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent( display, surface, surface, context ) )
+    {
+        std::cerr << "***ERROR: Could not create an OpenGL 4.6 context: 0x" << std::hex << eglGetError() << std::dec << "\n";
+        return false;
+    }
+    gladLoadGLLoader( reinterpret_cast<GLADloadproc>( eglGetProcAddress ) );
+    std::cout << "Renderer: " << glGetString( GL_RENDERER ) << ", " << glGetString( GL_VERSION ) << "\n\n";
+    return true;
+}
+
+//======================================================================
+// The cases that don't need OpenGL.
+static void cpu_cases( Bench &bench )
+{
+    auto chargen { utils::RM.load( "roms/chargen" ) };
+    std::string chargen_file = (utils::RM.get_path() / "roms/chargen").string();
+    //------------------------------------------------------------------
+    static GLchar image[128][128];
+    bench.run( "prepare_charset", [&] {
+        gfx::prepare_charset( reinterpret_cast<uint8_t*>( chargen.data() ), image );
+    } );
+    //------------------------------------------------------------------
+    // Too fast to time one call: 1000 calls with varying aspects.
+    volatile float sink = 0;
+    bench.run( "adjust_aspect", [&] {
+        for( int i = 0; i < 1000; i++ )
+        {
+            gfx::Rect2D<float> r { 0.0f, 0.0f, 384.0f, 272.0f };
+            gfx::adjust_aspect( r, 0.5f + float(i) * 0.002f );
+            sink = sink + r.w;
+        }
+    }, 1000 );
+    //------------------------------------------------------------------
+    bench.run( "Buffer::load", [&] { utils::Buffer b( chargen_file ); } );
+    bench.run( "Resource::load", [&] { auto b { utils::RM.load( "roms/chargen" ) }; } );
+    //------------------------------------------------------------------
+    // A frame of color indices to 32 bit pixels.
+    std::vector<uint8_t> indices( 384 * 272 );
+    std::vector<uint32_t> pixels( indices.size() );
+    for( size_t i = 0; i < indices.size(); i++ )
+        indices[i] = uint8_t( (i * 7) >> 4 );
+    gfx::Palette palette = gfx::Palette::load( "pepto" );
+    bench.run( "Palette::to_pixels (384x272)", [&] {
+        palette.to_pixels( indices.data(), pixels.data(), indices.size() );
+    } );
+    bench.run( "Palette::load (built-in)", [&] { gfx::Palette p = gfx::Palette::load( "colodore" ); } );
+    //------------------------------------------------------------------
+    // The text area on the CPU, in all modes: each 8 lines another one.
+    std::mt19937 rng( 39 );
+    std::vector<uint8_t> ram( 0x10000 ), color_ram( 0x400 ), line_regs( gfx::RASTER_LINES * 64 );
+    std::vector<uint8_t> display( gfx::RASTER_LINES * gfx::DISPLAY_BYTES );
+    for( auto &b : ram ) b = uint8_t( rng() );
+    for( auto &b : color_ram ) b = uint8_t( rng() );
+    for( int line = 0; line < gfx::RASTER_LINES; line++ )
+    {
+        int y = line - 0x33;
+        line_regs[ line * 64 + 0x11 ] = uint8_t( 0x1B | ((line >> 3) & 3) << 5 );
+        line_regs[ line * 64 + 0x16 ] = uint8_t( 0xC8 | ((line >> 5) & 1) << 4 );
+        line_regs[ line * 64 + 0x18 ] = uint8_t( (line >> 6) & 1 ? 0x18 : 0x14 );
+        uint8_t *state = &display[ line * gfx::DISPLAY_BYTES ];
+        state[0] = uint8_t( std::max( y, 0 ) >> 3 );
+        state[1] = uint8_t( std::max( y, 0 ) & 7 );
+        state[3] = uint8_t( y >= 0 && y < 200 ? gfx::DISPLAY_ACTIVE | gfx::DISPLAY_40COLS : gfx::DISPLAY_BORDER );
+    }
+    gfx::VideoMemory vic { ram.data(), color_ram.data(), line_regs.data(), display.data() };
+    std::vector<uint8_t> text_area( 320 * 200 );
+    bench.run( "render_text_area (mode per 8 lines)", [&] {
+        gfx::render_text_area( vic, reinterpret_cast<const uint8_t*>( chargen.data() ),
+                               0x33, 25, 40, text_area.data(), 320 );
+    } );
+    //------------------------------------------------------------------
+    // The counter updates of one frame of the main loop, whether anyone
+    // reads them or not.
+    static metrics::Counters counters;
+    uint64_t frame = 0;
+    bench.run( "metrics (updates of one frame)", [&] {
+        for( int s = 0; s < metrics::STAGES; s++ )
+        {
+            metrics::set( counters.stage_ns[s], frame + uint64_t(s) );
+            metrics::add( counters.stage_ns_total[s], frame + uint64_t(s) );
+        }
+        metrics::set( counters.upload_bytes, 67744 );
+        metrics::add( counters.upload_bytes_total, 67744 );
+        metrics::add( counters.cycles, 19656 );
+        metrics::set( counters.frames_emulated, frame );
+        metrics::add( counters.frames_presented, 1 );
+        metrics::set( counters.frames_dropped, 0 );
+        metrics::set( counters.audio_fill, frame & 1023 );
+        metrics::set( counters.audio_capacity, 8192 );
+        frame++;
+    } );
+}
+
+//======================================================================
+// The GL cases. Each one ends with glFinish(), so the time includes
+// the work of the driver, not only queueing the commands.
+static void gl_cases( Bench &bench )
+{
+    auto chargen { utils::RM.load( "roms/chargen" ) };
+    //------------------------------------------------------------------
+    // Shaders: compile each stage, link the text screen program.
+    const GLenum stages[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+    const char *stage_names[3] = { "vertex", "geometry", "fragment" };
+    for( int s = 0; s < 3; s++ )
+    {
+        bench.run( std::string( "compile_shader (" ) + stage_names[s] + ")", [&] {
+            glDeleteShader( gfx::compile_shader( stages[s], gfx::text_screen::shader_code( stages[s] ) ) );
+        } );
+    }
+    GLuint shaders[3];
+    for( int s = 0; s < 3; s++ )
+        shaders[s] = gfx::compile_shader( stages[s], gfx::text_screen::shader_code( stages[s] ) );
+    bench.run( "link_program", [&] {
+        glDeleteProgram( gfx::link_program( shaders[0], shaders[2], shaders[1] ) );
+    } );
+    for( GLuint id : shaders )
+        glDeleteShader( id );
+    //------------------------------------------------------------------
+    // A text screen drawing into a framebuffer, like in Graphics.
+    gfx::Framebuffer frame;
+    frame.init( 384, 272 );
+    frame.resize_screen( SCREEN_WIDTH, SCREEN_HEIGHT );
+    gfx::text_screen screen;
+    screen.init( chargen, 40, 25, glm::vec2 { 32, 36 } );
+    screen.resize_screen( 384, 272 );
+    //------------------------------------------------------------------
+    // Random screen contents, changed on every upload.
+    std::mt19937 rng( 64 );
+    uint8_t chars[1000], colrs[1000];
+    for( int i = 0; i < 1000; i++ )
+    {
+        chars[i] = uint8_t( rng() );
+        colrs[i] = uint8_t( rng() & 15 );
+    }
+    bench.run( "text_screen::set_memories", [&] {
+        chars[ rng() % 1000 ]++;
+        screen.set_memories( chars, colrs );
+        glFinish();
+    } );
+    //------------------------------------------------------------------
+    //------------------------------------------------------------------
+    // The emulator's upload: 64K RAM, color RAM and the line registers.
+    std::vector<uint8_t> ram( 0x10000 ), color_ram( 0x400 ), line_regs( gfx::RASTER_LINES * 64 );
+    for( auto &b : ram ) b = uint8_t( rng() );
+    for( auto &b : color_ram ) b = uint8_t( rng() );
+    for( int line = 0; line < gfx::RASTER_LINES; line++ )
+    {
+        line_regs[ line * 64 + 0x11 ] = 0x1B;
+        line_regs[ line * 64 + 0x16 ] = 0xC8;
+        line_regs[ line * 64 + 0x18 ] = 0x14;
+        line_regs[ line * 64 + 0x20 ] = uint8_t( line >> 3 );   // Raster bars
+    }
+    //------------------------------------------------------------------
+    // The display state of a scroller with a status bar: the text rows
+    // from line $33, the last 3 rows unscrolled.
+    std::vector<uint8_t> display( gfx::RASTER_LINES * gfx::DISPLAY_BYTES );
+    for( int line = 0; line < gfx::RASTER_LINES; line++ )
+    {
+        int y = line - 0x33;
+        uint8_t *state = &display[ line * gfx::DISPLAY_BYTES ];
+        state[0] = uint8_t( std::max( y, 0 ) >> 3 );
+        state[1] = uint8_t( std::max( y, 0 ) & 7 );
+        state[3] = uint8_t( y >= 0 && y < 200 ? gfx::DISPLAY_ACTIVE : gfx::DISPLAY_BORDER );
+    }
+    int scroll = 0;
+    auto scroll_display = [&] {
+        scroll = (scroll + 1) & 7;
+        for( int line = 0x33; line < 0x33 + 176; line++ )
+            display[ line * gfx::DISPLAY_BYTES + 2 ] = uint8_t( 7 - scroll );
+    };
+    gfx::VideoMemory vic { ram.data(), color_ram.data(), line_regs.data(), display.data() };
+    bench.run( "text_screen::set_vic", [&] {
+        ram[ 0x0400 + rng() % 1000 ]++;
+        screen.set_vic( vic );
+        glFinish();
+    } );
+    bench.run( "text_screen::set_display", [&] {
+        scroll_display();
+        screen.set_display( display.data() );
+        glFinish();
+    } );
+    //------------------------------------------------------------------
+    bench.run( "text_screen::render", [&] {
+        frame.activate();
+        glViewport( 0, 0, 384, 272 );
+        screen.render();
+        glFinish();
+    } );
+    screen.use_glyph_atlas( true );
+    bench.run( "text_screen::render (glyph atlas)", [&] {
+        frame.activate();
+        glViewport( 0, 0, 384, 272 );
+        screen.render();
+        glFinish();
+    } );
+    screen.use_glyph_atlas( false );
+    //------------------------------------------------------------------
+    // Another mode each 8 lines: a band and shader variant for each.
+    std::vector<uint8_t> mixed_regs( line_regs );
+    for( int line = 0; line < gfx::RASTER_LINES; line++ )
+    {
+        mixed_regs[ line * 64 + 0x11 ] = uint8_t( 0x1B | ((line >> 3) & 3) << 5 );
+        mixed_regs[ line * 64 + 0x16 ] = uint8_t( 0xC8 | ((line >> 5) & 1) << 4 );
+    }
+    screen.set_vic( { ram.data(), color_ram.data(), mixed_regs.data(), display.data() } );
+    bench.run( "text_screen::render (mode per 8 lines)", [&] {
+        frame.activate();
+        glViewport( 0, 0, 384, 272 );
+        screen.render();
+        glFinish();
+    } );
+    screen.set_vic( vic );
+    //------------------------------------------------------------------
+    // Text grids up to 100k cells, the bigger ones as consoles: a new
+    // screen each frame, drawn into a framebuffer of its size.
+    const int grids[][2] = { { 40, 25 }, { 80, 50 }, { 256, 128 }, { 320, 320 } };
+    for( const auto &size : grids )
+    {
+        int cols = size[0], rows = size[1];
+        gfx::Framebuffer target;
+        target.init( cols * 8, rows * 8 );
+        gfx::text_screen grid;
+        grid.init( chargen, cols, rows, glm::vec2 { 0, 0 } );
+        grid.resize_screen( cols * 8, rows * 8 );
+        std::vector<uint8_t> grid_chars( size_t( cols * rows ) ), grid_colrs( grid_chars.size() );
+        for( size_t i = 0; i < grid_chars.size(); i++ )
+        {
+            grid_chars[i] = uint8_t( rng() );
+            grid_colrs[i] = uint8_t( rng() & 15 );
+        }
+        std::string name = "text grid " + std::to_string( cols ) + "x" + std::to_string( rows );
+        bench.run( name + " (set_memories + render)", [&] {
+            grid_chars[ rng() % grid_chars.size() ]++;
+            grid.set_memories( grid_chars.data(), grid_colrs.data() );
+            target.activate();
+            glViewport( 0, 0, cols * 8, rows * 8 );
+            grid.render();
+            glFinish();
+        } );
+        target.deactivate();
+    }
+    //------------------------------------------------------------------
+    gfx::Border border;
+    border.init( screen, 384, 272 );
+    bench.run( "Border::render", [&] {
+        frame.activate();
+        glViewport( 0, 0, 384, 272 );
+        border.render();
+        glFinish();
+    } );
+    frame.deactivate();
+    //------------------------------------------------------------------
+    bench.run( "Framebuffer::render", [&] {
+        glViewport( 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT );
+        frame.render();
+        glFinish();
+    } );
+    //------------------------------------------------------------------
+    // Startup of the whole renderer, then a full frame.
+    bench.seconds /= 5;
+    std::vector<std::unique_ptr<gfx::Graphics>> instances;
+    bench.run( "Graphics::init", [&] {
+        instances.push_back( std::make_unique<gfx::Graphics>() );
+        instances.back()->init();
+        glFinish();
+    } );
+    instances.clear();
+    // A session of a monitoring wall coming and going: everything from
+    // the GL pool, no shader is compiled and no GL object made.
+    size_t created = gfx::gl_pool().created();
+    size_t programs = gfx::gl_pool().programs();
+    bench.run( "Graphics::init (session from the pool)", [&] {
+        gfx::Graphics session;
+        session.init();
+        session.resize_screen( SCREEN_WIDTH, SCREEN_HEIGHT );
+        glFinish();
+    } );
+    if( gfx::gl_pool().created() != created || gfx::gl_pool().programs() != programs )
+        std::cout << "  (made " << (gfx::gl_pool().created() - created) << " GL objects and "
+                  << (gfx::gl_pool().programs() - programs) << " programs)\n";
+    bench.seconds *= 5;
+    gfx::Graphics graphics;
+    graphics.init();
+    graphics.resize_screen( SCREEN_WIDTH, SCREEN_HEIGHT );
+    bench.run( "Graphics::render", [&] {
+        ram[ 0x0400 + rng() % 1000 ]++;
+        scroll_display();
+        graphics.set_screen( vic );
+        graphics.render();
+        glFinish();
+    } );
+    //------------------------------------------------------------------
+    // Switching the palette between frames.
+    const auto &names = gfx::Palette::builtin_names();
+    std::vector<gfx::Palette> palettes;
+    for( const auto &name : names )
+        palettes.push_back( gfx::Palette::load( name ) );
+    size_t next = 0;
+    bench.run( "set_palette", [&] {
+        gfx::set_palette( palettes[ next++ % palettes.size() ] );
+        glFinish();
+    } );
+    //------------------------------------------------------------------
+    // A multiplexer: 8 sprites reused 16 times down the screen.
+    std::vector<gfx::SpriteSlice> slices;
+    for( int i = 0; i < 128; i++ )
+    {
+        gfx::SpriteSlice s {};
+        s.x     = int16_t( 24 + (i & 7) * 40 + (i >> 3) );
+        s.line  = int16_t( 50 + (i >> 3) * 12 );
+        s.lines = 12;
+        s.row   = 0;
+        s.data  = uint16_t( 0x3000 + (i & 7) * 64 );
+        s.color = uint8_t( i & 15 );
+        s.mc0   = 2;
+        s.mc1   = 7;
+        s.flags = uint8_t( (i & 1) ? gfx::SpriteSlice::MULTICOLOR : gfx::SpriteSlice::X_EXPAND );
+        slices.push_back( s );
+    }
+    bench.run( "Graphics::render (128 sprite slices)", [&] {
+        slices[ rng() % slices.size() ].x++;
+        graphics.set_screen( vic );
+        graphics.set_sprites( slices.data(), int( slices.size() ) );
+        graphics.render();
+        glFinish();
+    } );
+}
+
+//======================================================================
+int main(int argc, char** argv)
+{
+    Bench bench;
+    std::string json_file, baseline_file;
+    double threshold = 10.0;
+    bool use_gl = true;
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if( arg == "--json" && has_value )              json_file = argv[++i];
+        else if( arg == "--compare" && has_value )      baseline_file = argv[++i];
+        else if( arg == "--threshold" && has_value )    threshold = std::atof( argv[++i] );
+        else if( arg == "--time" && has_value )         bench.seconds = std::atof( argv[++i] );
+        else if( arg == "--filter" && has_value )       bench.filter = argv[++i];
+        else if( arg == "--no-gl" )                     use_gl = false;
+        else { usage(); return -1; }
+    }
+    //------------------------------------------------------------------
+    if( utils::RM.get_path().empty() )
+    {
+        std::cerr << "***ERROR: Can't find resource folder!\n";
+        return -1;
+    }
+    cpu_cases( bench );
+    if( use_gl )
+    {
+        if( !create_gl_context() )
+            return -1;
+        gl_cases( bench );
+    }
+    //------------------------------------------------------------------
+    if( !json_file.empty() )
+        write_json( json_file, bench.results );
+    if( !baseline_file.empty() && compare( bench.results, baseline_file, threshold ) > 0 )
+        return 1;
+    return 0;
+}
+
+//======================================================================
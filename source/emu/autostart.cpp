@@ -0,0 +1,183 @@
+//========================================================================
+#include "autostart.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Zero page pointers of BASIC.
+constexpr uint16_t TXTTAB = 0x2B;   // Start of the program.
+constexpr uint16_t VARTAB = 0x2D;   // Start of variables = end of program.
+constexpr uint16_t ARYTAB = 0x2F;
+constexpr uint16_t STREND = 0x31;
+constexpr uint16_t EAL    = 0xAE;   // End address of the last LOAD.
+
+//========================================================================
+static uint16_t get16( const uint8_t *p ) { return uint16_t( p[0] | (p[1] << 8) ); }
+
+//========================================================================
+// T64: a 64 byte header, then 32 byte directory entries. The end address
+// in the entries is wrong in many images, so the length is also limited
+// by the next entry's data and the file size.
+static Program parse_t64( const uint8_t *data, size_t size, const std::string &filename )
+{
+    if( size < 0x40 )
+        throw std::runtime_error( "Broken T64 file: " + filename );
+    int entries = std::min( int( get16( data + 0x22 ) ), int( (size - 0x40) / 32 ) );
+    for( int i = 0; i < entries; i++ )
+    {
+        const uint8_t *e = data + 0x40 + i * 32;
+        if( e[0] != 1 )
+            continue;   // Not a normal tape file.
+        size_t offset = e[8] | (e[9] << 8) | (e[10] << 16) | (size_t(e[11]) << 24);
+        uint16_t start = get16( e + 2 ), end = get16( e + 4 );
+        if( offset >= size )
+            continue;
+        //--------------------------------------------------------------
+        size_t length = size - offset;
+        if( end > start )
+            length = std::min( length, size_t( end - start ) );
+        for( int j = 0; j < entries; j++ )
+        {
+            const uint8_t *o = data + 0x40 + j * 32;
+            size_t other = o[8] | (o[9] << 8) | (o[10] << 16) | (size_t(o[11]) << 24);
+            if( o[0] == 1 && other > offset )
+                length = std::min( length, other - offset );
+        }
+        //--------------------------------------------------------------
+        Program program;
+        program.address = start;
+        program.data.assign( data + offset, data + offset + length );
+        for( int c = 0; c < 16 && e[0x10 + c] != 0x20 && e[0x10 + c] != 0xA0; c++ )
+            program.name += char( e[0x10 + c] );
+        return program;
+    }
+    throw std::runtime_error( "No program in T64 file: " + filename );
+}
+
+//========================================================================
+Program load_program( const std::string &filename )
+{
+    std::string name = filename;
+    if( std::filesystem::exists( filename ) )
+        name = std::filesystem::absolute( filename ).string();
+    utils::Buffer file;
+    try
+    {
+        file = utils::RM.load( name );
+    }
+    catch( int )
+    {
+        throw std::runtime_error( "Can't read program: " + filename );
+    }
+    //------------------------------------------------------------------
+    const uint8_t *data = reinterpret_cast<const uint8_t*>( file.data() );
+    size_t size = file.size();
+    if( size >= 3 && std::memcmp( data, "C64", 3 ) == 0 )
+        return parse_t64( data, size, filename );
+    if( size < 3 )
+        throw std::runtime_error( "Not a program file: " + filename );
+    //------------------------------------------------------------------
+    Program program;
+    program.name = std::filesystem::path( filename ).stem().string();
+    program.address = get16( data );
+    program.data.assign( data + 2, data + size );
+    return program;
+}
+
+//========================================================================
+void Autostart::inject( C64 &c64, const Program &program )
+{
+    size_t size = std::min( program.data.size(), size_t( 0x10000 - program.address ) );
+    std::memcpy( &c64.ram[ program.address ], program.data.data(), size );
+    uint16_t end = uint16_t( program.address + size );
+    //------------------------------------------------------------------
+    // Like LOAD: the end address, and for a BASIC program the start of
+    // the variables (RUN clears them from there).
+    auto put16 = [&c64]( uint16_t zp, uint16_t value )
+    {
+        c64.ram[zp] = uint8_t( value );
+        c64.ram[zp + 1] = uint8_t( value >> 8 );
+    };
+    put16( EAL, end );
+    if( program.address == get16( &c64.ram[TXTTAB] ) )
+    {
+        put16( VARTAB, end );
+        put16( ARYTAB, end );
+        put16( STREND, end );
+    }
+}
+
+//========================================================================
+void Autostart::boot( C64 &c64 )
+{
+    uint64_t start = c64.cycles_now();
+    c64.reset();
+    // Wait for READY, then a few frames more so BASIC sits in its input loop.
+    if( !wait_ready( c64, 1, 10.0 ) )
+        throw std::runtime_error( "The C64 didn't boot to READY." );
+    for( int i = 0; i < 5; i++ )
+        c64.run_frame();
+    m_BootSeconds = double( c64.cycles_now() - start ) / sound::PAL_CLOCK;
+    booted = std::make_unique<C64::Snapshot>();
+    c64.save_state( *booted );
+}
+
+//========================================================================
+void Autostart::start( C64 &c64, const Program &program )
+{
+    if( !booted )
+        boot( c64 );
+    c64.load_state( *booted );
+    inject( c64, program );
+    //------------------------------------------------------------------
+    uint16_t basic = get16( &c64.ram[TXTTAB] );
+    type_keys( c64, program.address == basic ? "RUN\n" : "SYS" + std::to_string( program.address ) + "\n" );
+}
+
+//========================================================================
+int count_ready( C64 &c64 )
+{
+    static const uint8_t ready[6] = { 18, 5, 1, 4, 25, 46 };  // Screen codes.
+    const uint8_t *screen = c64.video_matrix();
+    int count = 0;
+    for( int i = 0; i + 6 <= 1000; i++ )
+        if( std::memcmp( screen + i, ready, 6 ) == 0 )
+            count++;
+    return count;
+}
+
+//========================================================================
+bool wait_ready( C64 &c64, int count, double max_seconds )
+{
+    int frames = int( max_seconds * sound::PAL_CLOCK / CYCLES_PER_FRAME );
+    for( int i = 0; i < frames; i++ )
+    {
+        if( count_ready( c64 ) >= count )
+            return true;
+        c64.run_frame();
+    }
+    return false;
+}
+
+//========================================================================
+void type_keys( C64 &c64, const std::string &text )
+{
+    uint8_t n = c64.ram[0xC6];
+    for( size_t i = 0; i < text.size() && n < 10; i++ )
+        c64.ram[ 0x0277 + n++ ] = uint8_t( text[i] == '\n' ? 13 : text[i] );
+    c64.ram[0xC6] = n;
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
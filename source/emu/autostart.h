@@ -0,0 +1,72 @@
+#ifndef AUTOSTART_H
+#define AUTOSTART_H
+
+#include "c64.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// A program as it goes into memory.
+struct Program
+{
+    std::string name;
+    uint16_t address {0x0801};
+    std::vector<uint8_t> data;      // Without the load address.
+};
+
+//========================================================================
+// Load a PRG or T64 file (the first program in the tape image) through
+// utils::RM. A relative filename is tried in the current directory first,
+// then in the resource folder. Throws std::runtime_error.
+Program load_program( const std::string &filename );
+
+//========================================================================
+// Starts programs without LOADing them and without booting each time.
+//
+// The first start() boots the machine up to the READY prompt and keeps a
+// snapshot of it. Every start() restores that snapshot, writes the
+// program straight into RAM, fixes the BASIC pointers as LOAD would and
+// types RUN (or SYS for machine code) into the keyboard buffer. So the
+// KERNAL init is paid once per process.
+class Autostart
+{
+public:
+    //========================================================================
+    // Throws std::runtime_error if the machine doesn't reach READY.
+    void start( C64 &c64, const Program &program );
+    // Emulated time spent in booting (0 until the first start()).
+    double boot_seconds() const { return m_BootSeconds; }
+    //========================================================================
+    // Write the program into RAM and set the pointers, nothing else.
+    static void inject( C64 &c64, const Program &program );
+
+private:
+    //========================================================================
+    std::unique_ptr<C64::Snapshot> booted;
+    double m_BootSeconds {0.0};
+    //========================================================================
+    void boot( C64 &c64 );
+};
+
+//========================================================================
+// Helpers for driving the machine from the outside.
+//------------------------------------------------------------------------
+// Number of "READY." prompts on the text screen.
+int count_ready( C64 &c64 );
+// Run frames until there are "count" READY prompts on the screen.
+// Returns false if that didn't happen within "max_seconds".
+bool wait_ready( C64 &c64, int count, double max_seconds );
+// Put up to 10 characters into the KERNAL keyboard buffer. Upper case
+// ASCII and digits are the same in PETSCII, '\n' is RETURN.
+void type_keys( C64 &c64, const std::string &text );
+
+//========================================================================
+} // End of namespace emu
+
+#endif // AUTOSTART_H
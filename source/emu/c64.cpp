@@ -0,0 +1,638 @@
+//========================================================================
+#include "c64.h"
+#include "monitor.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+void C64::load_rom( const char *name, uint8_t *dest, size_t size )
+{
+    auto rom { utils::RM.load( std::string("roms/") + name ) };
+    if( rom.size() != size )
+    {
+        throw std::runtime_error( std::string("ROM has the wrong size: ") + name );
+    }
+    std::memcpy( dest, rom.data(), size );
+}
+
+//========================================================================
+void C64::init( sound::SIDModel model )
+{
+    load_rom( "basic",   basic_rom.data(),  basic_rom.size() );
+    load_rom( "kernal",  kernal_rom.data(), kernal_rom.size() );
+    load_rom( "chargen", char_rom.data(),   char_rom.size() );
+    //------------------------------------------------------------------
+    audio.init( model );
+    cpu.init( this );
+    scheduler.clear();
+    //------------------------------------------------------------------
+    // Wire the interrupt outputs of the chips to the CPU.
+    cia1.init( 0, scheduler, cpu.s.cycles, *this,
+               [](void *c, bool on) { static_cast<C64*>(c)->cpu.set_irq( IRQ_CIA1, on ); }, this );
+    cia2.init( 1, scheduler, cpu.s.cycles, *this,
+               [](void *c, bool on) { static_cast<C64*>(c)->cpu.set_nmi( NMI_CIA2, on ); }, this );
+    vic.init( scheduler, cpu.s.cycles,
+              [](void *c, bool on) { static_cast<C64*>(c)->cpu.set_irq( IRQ_VIC, on ); },
+              [](void *c, int stolen) { static_cast<C64*>(c)->cpu.s.cycles += uint64_t(stolen); },
+              this );
+    vic.set_memory( ram.data(), char_rom.data(), color_ram.data() );
+    //------------------------------------------------------------------
+    reset();
+}
+
+//========================================================================
+void C64::reset()
+{
+    cpu_port = 0;
+    cpu_ddr  = 0;
+    key_matrix.fill( 0xFF );
+    if( cartridge )
+        cartridge->reset();
+    update_banking();
+    //------------------------------------------------------------------
+    cia1.reset();
+    cia2.reset();
+    vic.reset();
+    drive.reset( cycles_now() );
+    audio.sid.reset();
+    sync_audio();
+    cpu.reset();
+}
+
+//========================================================================
+void C64::attach_cartridge( const std::string &filename, bool write_back )
+{
+    auto cart = std::make_unique<Cartridge>();
+    cart->load( filename, write_back );
+    cartridge = std::move( cart );
+    reset();
+}
+
+//========================================================================
+void C64::detach_cartridge()
+{
+    cartridge.reset();
+    reset();
+}
+
+//========================================================================
+// Set up the CPU page tables for the memory configuration selected by
+// the 6510 port (LORAM, HIRAM, CHAREN) and the cartridge (EXROM, GAME).
+void C64::update_banking()
+{
+    //------------------------------------------------------------------
+    // Input bits of the port are pulled up.
+    uint8_t p = uint8_t( (cpu_port | ~cpu_ddr) & 0x07 );
+    bool loram = p & 1, hiram = p & 2, charen = p & 4;
+    //------------------------------------------------------------------
+    for( int page = 0; page < 256; page++ )
+    {
+        mem_read[page]  = &ram[ page << 8 ];
+        mem_write[page] = &ram[ page << 8 ];
+    }
+    // Writes to page 0 must see the port at $00/$01.
+    mem_write[0] = nullptr;
+    //------------------------------------------------------------------
+    if( loram && hiram )
+        for( int page = 0xA0; page < 0xC0; page++ )
+            mem_read[page] = &basic_rom[ (page - 0xA0) << 8 ];
+    if( hiram )
+        for( int page = 0xE0; page < 0x100; page++ )
+            mem_read[page] = &kernal_rom[ (page - 0xE0) << 8 ];
+    if( loram || hiram )
+    {
+        for( int page = 0xD0; page < 0xE0; page++ )
+        {
+            if( charen )
+            {
+                mem_read[page]  = nullptr;
+                mem_write[page] = nullptr;
+            }
+            else
+                mem_read[page] = &char_rom[ (page - 0xD0) << 8 ];
+        }
+    }
+    //------------------------------------------------------------------
+    // The cartridge: 8K mode puts ROML at $8000, 16K mode adds ROMH at
+    // $A000. Ultimax mode has ROMH at $E000 and I/O, no RAM above $1000.
+    roml_page = romh_page = -1;
+    ultimax = cartridge && cartridge->game() && !cartridge->exrom();
+    if( ultimax )
+    {
+        for( int page = 0x10; page < 0x100; page++ )
+        {
+            mem_read[page]  = nullptr;
+            mem_write[page] = nullptr;
+        }
+        roml_page = 0x80;
+        romh_page = 0xE0;
+    }
+    else if( cartridge && cartridge->exrom() )
+    {
+        if( loram && hiram )
+            roml_page = 0x80;
+        if( hiram && cartridge->game() )
+            romh_page = 0xA0;
+    }
+    //------------------------------------------------------------------
+    // The CPU sees the same, except for the pages the monitor watches.
+    for( int page = 0; page < 256; page++ )
+    {
+        uint8_t flags = monitor ? monitor->page_flags( page ) : 0;
+        cpu.read_map[page]  = (flags & (Monitor::PAGE_FETCH | Monitor::PAGE_READ)) ? nullptr : mem_read[page];
+        cpu.write_map[page] = (flags & Monitor::PAGE_WRITE) ? nullptr : mem_write[page];
+    }
+    map_cartridge_banks();
+    //------------------------------------------------------------------
+    // Reads of $00/$01 go straight to RAM, so keep the port values there.
+    // (Bit 4 is the cassette sense, high when no button is pressed.)
+    ram[0] = cpu_ddr;
+    ram[1] = uint8_t( (cpu_port & cpu_ddr) | (~cpu_ddr & 0x17) );
+}
+
+//========================================================================
+// Point the ROML and ROMH pages at the selected banks. A bank switch only
+// needs this, not update_banking().
+void C64::map_cartridge_banks()
+{
+    if( !cartridge )
+        return;
+    // A flash chip in autoselect mode answers through chip_read().
+    bool direct = cartridge->direct_reads();
+    for( int i = 0; i < 0x20; i++ )
+    {
+        if( roml_page >= 0 )
+            set_read_page( roml_page + i, direct ? cartridge->roml() + (i << 8) : nullptr );
+        if( romh_page >= 0 )
+            set_read_page( romh_page + i, direct ? cartridge->romh() + (i << 8) : nullptr );
+    }
+}
+
+//========================================================================
+void C64::set_read_page( int page, const uint8_t *mem )
+{
+    mem_read[page] = mem;
+    uint8_t flags = monitor ? monitor->page_flags( page ) : 0;
+    cpu.read_map[page] = (flags & (Monitor::PAGE_FETCH | Monitor::PAGE_READ)) ? nullptr : mem;
+}
+
+//========================================================================
+void C64::cartridge_changed( Cartridge::Change change )
+{
+    if( change == Cartridge::CHANGED_LINES )
+        update_banking();
+    else if( change == Cartridge::CHANGED_BANKS )
+        map_cartridge_banks();
+}
+
+//========================================================================
+// Is "addr" in one of the pages ROML or ROMH are visible in?
+bool C64::cartridge_page( uint16_t addr ) const
+{
+    int page = addr >> 8;
+    return (roml_page >= 0 && page >= roml_page && page < roml_page + 0x20) ||
+           (romh_page >= 0 && page >= romh_page && page < romh_page + 0x20);
+}
+
+//========================================================================
+void C64::sync_audio()
+{
+    uint64_t now = cycles_now();
+    if( now > audio_clock )
+        audio.run( int( now - audio_clock ) );
+    audio_clock = now;
+}
+
+//========================================================================
+// Let the drive catch up. Called before every access to the serial bus.
+void C64::sync_drive()
+{
+    if( m_DriveMode == DriveMode::TRUE_DRIVE )
+        drive.run_until_host( cycles_now() );
+}
+
+//========================================================================
+void C64::set_drive_mode( DriveMode mode )
+{
+    patch_kernal( mode );
+    //------------------------------------------------------------------
+    if( mode == DriveMode::TRUE_DRIVE && m_DriveMode != DriveMode::TRUE_DRIVE )
+    {
+        if( !drive.initialized() )
+            drive.init();
+        uint8_t out = cia_out[1][0];
+        drive.set_host_lines( out & 0x08, out & 0x10, out & 0x20 );
+        drive.reset( cycles_now() );
+    }
+    m_DriveMode = mode;
+}
+
+//========================================================================
+// The fast loader needs a trap at the start of the KERNAL LOAD routine.
+void C64::patch_kernal( DriveMode mode )
+{
+    uint8_t &load = kernal_rom[ LOAD_TRAP - 0xE000 ];
+    if( mode == DriveMode::FAST_LOAD && load != CPU6502::TRAP_OPCODE )
+    {
+        if( load != 0x85 || kernal_rom[ LOAD_TRAP - 0xE000 + 1 ] != 0x93 )
+            throw std::runtime_error( "Unknown KERNAL, fast load isn't possible." );
+        load = CPU6502::TRAP_OPCODE;
+    }
+    else if( mode != DriveMode::FAST_LOAD && load == CPU6502::TRAP_OPCODE )
+        load = 0x85;
+}
+
+//========================================================================
+void C64::save_state( Snapshot &snap ) const
+{
+    snap.cpu         = cpu.s;
+    snap.scheduler   = scheduler.state;
+    snap.cia1        = cia1.state;
+    snap.cia2        = cia2.state;
+    snap.vic         = vic.state;
+    snap.vic_lines   = vic.line_log;
+    snap.sid         = audio.sid;
+    snap.ram         = ram;
+    snap.color_ram   = color_ram;
+    snap.cpu_port    = cpu_port;
+    snap.cpu_ddr     = cpu_ddr;
+    snap.key_matrix  = key_matrix;
+    snap.joy         = joy;
+    std::memcpy( snap.cia_out, cia_out, sizeof(cia_out) );
+    snap.audio_clock = audio_clock;
+    snap.drive_mode  = m_DriveMode;
+    if( drive.initialized() )
+        drive.save_state( snap.drive );
+    if( cartridge )
+        cartridge->save_state( snap.cartridge );
+}
+
+//========================================================================
+void C64::load_state( const Snapshot &snap )
+{
+    patch_kernal( snap.drive_mode );
+    if( snap.drive_mode == DriveMode::TRUE_DRIVE )
+    {
+        if( !drive.initialized() )
+            drive.init();
+        drive.load_state( snap.drive );
+    }
+    m_DriveMode = snap.drive_mode;
+    //------------------------------------------------------------------
+    cpu.s           = snap.cpu;
+    scheduler.state = snap.scheduler;
+    cia1.state      = snap.cia1;
+    cia2.state      = snap.cia2;
+    vic.state       = snap.vic;
+    vic.line_log    = snap.vic_lines;
+    audio.sid       = snap.sid;
+    ram             = snap.ram;
+    color_ram       = snap.color_ram;
+    cpu_port        = snap.cpu_port;
+    cpu_ddr         = snap.cpu_ddr;
+    key_matrix      = snap.key_matrix;
+    joy             = snap.joy;
+    std::memcpy( cia_out, snap.cia_out, sizeof(cia_out) );
+    audio_clock     = snap.audio_clock;
+    if( cartridge )
+        cartridge->load_state( snap.cartridge );
+    // The page tables point into this machine, rebuild them.
+    update_banking();
+}
+
+//========================================================================
+// An opcode fetch from an unmapped page: I/O, or a page with breakpoints.
+// For a breakpoint the monitor answers with the trap opcode, so the CPU
+// comes back to trap() before it executes anything.
+uint8_t C64::fetch( uint16_t addr )
+{
+    if( monitor )
+    {
+        if( monitor->on_fetch( addr ) )
+            return CPU6502::TRAP_OPCODE;
+        if( const uint8_t *page = mem_read[addr >> 8] )
+            return page[addr & 0xFF];
+    }
+    return chip_read( addr );
+}
+
+//========================================================================
+bool C64::trap( uint16_t pc )
+{
+    if( monitor && monitor->on_trap( pc ) )
+        return true;    // Stopped at a breakpoint, PC stays there.
+    if( pc != LOAD_TRAP || m_DriveMode != DriveMode::FAST_LOAD )
+        return false;
+    //------------------------------------------------------------------
+    // The replaced instruction: STA $93 (0 = load, 1 = verify).
+    ram[0x93] = cpu.s.a;
+    cpu.s.cycles += 3;
+    cpu.s.pc = uint16_t( pc + 2 );
+    // Only device 8 is ours, and the KERNAL reports a missing name.
+    if( ram[0xBA] == 8 && ram[0xB7] != 0 )
+        fast_load();
+    return true;
+}
+
+//========================================================================
+// Do what the KERNAL LOAD would do with the file from the disk image,
+// then return to the caller.
+void C64::fast_load()
+{
+    if( !drive.disk.inserted() )
+    {
+        kernal_return( true, 5 );   // DEVICE NOT PRESENT
+        return;
+    }
+    //------------------------------------------------------------------
+    std::string name;
+    uint16_t name_addr = uint16_t( ram[0xBB] | (ram[0xBC] << 8) );
+    for( int i = 0; i < ram[0xB7]; i++ )
+        name += char( cpu.read( uint16_t( name_addr + i ) ) );
+    std::vector<uint8_t> file;
+    if( !drive.disk.load_file( name, file ) || file.size() < 2 )
+    {
+        kernal_return( true, 4 );   // FILE NOT FOUND
+        return;
+    }
+    //------------------------------------------------------------------
+    // Secondary address 0: load to the address passed in X/Y,
+    // otherwise to the address in the file.
+    uint16_t addr = ram[0xB9] ? uint16_t( file[0] | (file[1] << 8) )
+                              : uint16_t( ram[0xC3] | (ram[0xC4] << 8) );
+    bool verify = ram[0x93] != 0;
+    ram[0x90] = 0;
+    for( size_t i = 2; i < file.size(); i++, addr++ )
+    {
+        if( !verify )
+            cpu.write( addr, file[i] );
+        else if( cpu.read( addr ) != file[i] )
+            ram[0x90] |= 0x10;      // VERIFY ERROR
+    }
+    ram[0x90] |= 0x40;              // End of file.
+    ram[0xAE] = uint8_t( addr );
+    ram[0xAF] = uint8_t( addr >> 8 );
+    cpu.s.x = ram[0xAE];
+    cpu.s.y = ram[0xAF];
+    kernal_return( false, cpu.s.a );
+}
+
+//========================================================================
+// Return from the LOAD routine: carry and A report errors.
+void C64::kernal_return( bool error, uint8_t a )
+{
+    cpu.s.a = a;
+    if( error ) cpu.s.p |= CPU6502::FLAG_C;
+    else        cpu.s.p &= uint8_t( ~CPU6502::FLAG_C );
+    uint8_t lo = cpu.read( uint16_t( 0x100 | ++cpu.s.sp ) );
+    uint8_t hi = cpu.read( uint16_t( 0x100 | ++cpu.s.sp ) );
+    cpu.s.pc = uint16_t( ((hi << 8) | lo) + 1 );
+    cpu.s.cycles += 6;
+}
+
+//========================================================================
+void C64::run_until( uint64_t target )
+{
+    scheduler.set_limit( target );
+    while( cpu.s.cycles < target && !m_Break )
+    {
+        if( lockstep )
+        {
+            step_lockstep();
+            continue;
+        }
+        cpu.run( scheduler.deadline() );
+        scheduler.dispatch( cpu.s.cycles );
+    }
+    sync_audio();
+    sync_drive();
+}
+
+//========================================================================
+// Reference mode: one instruction, then every chip gets to look at every
+// cycle that passed, and the SID is clocked along.
+void C64::step_lockstep()
+{
+    uint64_t start = cpu.s.cycles;
+    cpu.step();
+    for( uint64_t c = start + 1; c <= cpu.s.cycles; c++ )
+        scheduler.poll_all( c );
+    sync_audio();
+}
+
+//========================================================================
+void C64::run_frame()
+{
+    uint64_t now = cycles_now();
+    run_until( now - now % CYCLES_PER_FRAME + CYCLES_PER_FRAME );
+}
+
+//========================================================================
+uint8_t C64::peek( uint16_t addr ) const
+{
+    if( const uint8_t *page = mem_read[addr >> 8] )
+        return page[addr & 0xFF];
+    switch( addr >> 8 )
+    {
+    case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+        return vic.state.regs[ addr & 0x3F ];
+    case 0xD8: case 0xD9: case 0xDA: case 0xDB:
+        return color_ram[ addr & 0x3FF ] | 0xF0;
+    }
+    return 0xFF;
+}
+
+//========================================================================
+// Reads from unmapped pages: I/O, or pages the monitor watches.
+uint8_t C64::io_read( uint16_t addr )
+{
+    if( monitor )
+    {
+        monitor->on_read( addr );
+        if( const uint8_t *page = mem_read[addr >> 8] )
+            return page[addr & 0xFF];
+    }
+    return chip_read( addr );
+}
+
+//========================================================================
+void C64::io_write( uint16_t addr, uint8_t value )
+{
+    if( monitor )
+    {
+        monitor->on_write( addr, value );
+        if( uint8_t *page = mem_write[addr >> 8] )
+        {
+            page[addr & 0xFF] = value;
+            return;
+        }
+    }
+    chip_write( addr, value );
+}
+
+//========================================================================
+uint8_t C64::chip_read( uint16_t addr )
+{
+    switch( addr >> 8 )
+    {
+    case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+        return vic.read( uint8_t(addr) );
+    case 0xD4: case 0xD5: case 0xD6: case 0xD7:
+        // OSC3 and ENV3 depend on the SID being up to date.
+        sync_audio();
+        return audio.sid.read( addr & 0x1F );
+    case 0xD8: case 0xD9: case 0xDA: case 0xDB:
+        return color_ram[ addr & 0x3FF ] | 0xF0;
+    case 0xDC:
+        return cia1.read( uint8_t(addr) );
+    case 0xDD:
+        return cia2.read( uint8_t(addr) );
+    case 0xDE: case 0xDF:
+        return cartridge ? cartridge->io_read( addr ) : 0xFF;
+    }
+    if( cartridge_page( addr ) )
+        return cartridge->rom_read( addr );
+    return 0xFF; // Open bus, e.g. the empty pages of the Ultimax mode.
+}
+
+//========================================================================
+void C64::chip_write( uint16_t addr, uint8_t value )
+{
+    //------------------------------------------------------------------
+    // Zero page, including the 6510 port.
+    if( addr < 0x100 )
+    {
+        if( addr == 0 )      { cpu_ddr  = value; update_banking(); }
+        else if( addr == 1 ) { cpu_port = value; update_banking(); }
+        else ram[addr] = value;
+        return;
+    }
+    //------------------------------------------------------------------
+    switch( addr >> 8 )
+    {
+    case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+        vic.write( uint8_t(addr), value );
+        break;
+    case 0xD4: case 0xD5: case 0xD6: case 0xD7:
+        // Synthesize up to now with the old register values.
+        sync_audio();
+        audio.sid.write( addr & 0x1F, value );
+        break;
+    case 0xD8: case 0xD9: case 0xDA: case 0xDB:
+        color_ram[ addr & 0x3FF ] = value & 0x0F;
+        break;
+    case 0xDC:
+        cia1.write( uint8_t(addr), value );
+        break;
+    case 0xDD:
+        cia2.write( uint8_t(addr), value );
+        break;
+    case 0xDE: case 0xDF:
+        if( cartridge )
+            cartridge_changed( cartridge->io_write( addr, value ) );
+        break;
+    default:
+        // Only the Ultimax mode leaves the ROM pages without RAM below.
+        if( ultimax && cartridge_page( addr ) )
+            cartridge_changed( cartridge->rom_write( addr, value ) );
+        break;
+    }
+}
+
+//========================================================================
+uint8_t C64::port_read( int cia, int port, uint8_t output )
+{
+    uint8_t result = output;
+    if( cia == 0 )
+    {
+        //--------------------------------------------------------------
+        // CIA1: keyboard matrix and joysticks.
+        // Port A drives the columns, port B reads the rows - and
+        // the other way round, which some programs use.
+        if( port == 1 )
+        {
+            for( int col = 0; col < 8; col++ )
+                if( !(cia_out[0][0] & (1 << col)) )
+                    result &= key_matrix[col];
+            result &= joy[0];
+        }
+        else
+        {
+            for( int col = 0; col < 8; col++ )
+                if( (uint8_t(~key_matrix[col]) & uint8_t(~cia_out[0][1])) != 0 )
+                    result &= uint8_t( ~(1 << col) );
+            result &= joy[1];
+        }
+        return result;
+    }
+    //------------------------------------------------------------------
+    // CIA2 port A: serial bus inputs. The outputs (bits 3-5) are inverted
+    // on the bus, the inputs CLK (bit 6) and DATA (bit 7) are not.
+    // Without devices, a line is low only if the C64 pulls it itself.
+    if( port == 0 )
+    {
+        result &= 0x3F;
+        if( m_DriveMode == DriveMode::TRUE_DRIVE )
+        {
+            sync_drive();
+            if( !drive.clk_line() )  result |= 0x40;
+            if( !drive.data_line() ) result |= 0x80;
+        }
+        else
+        {
+            if( !(output & 0x10) ) result |= 0x40;
+            if( !(output & 0x20) ) result |= 0x80;
+        }
+    }
+    return result;
+}
+
+//========================================================================
+void C64::port_write( int cia, int port, uint8_t output )
+{
+    cia_out[cia][port] = output;
+    //------------------------------------------------------------------
+    // CIA2 port A bits 0-1 select the VIC bank (inverted),
+    // bits 3-5 drive ATN, CLK and DATA of the serial bus.
+    if( cia == 1 && port == 0 )
+    {
+        vic.set_bank( 3 - (output & 3) );
+        if( m_DriveMode == DriveMode::TRUE_DRIVE )
+        {
+            sync_drive();
+            drive.set_host_lines( output & 0x08, output & 0x10, output & 0x20 );
+        }
+    }
+}
+
+//========================================================================
+void C64::key( int col, int row, bool down )
+{
+    if( down ) key_matrix[col & 7] &= uint8_t( ~(1 << (row & 7)) );
+    else       key_matrix[col & 7] |= uint8_t(   1 << (row & 7)  );
+}
+
+//========================================================================
+void C64::joystick( int port, uint8_t bits )
+{
+    joy[ (port - 1) & 1 ] = uint8_t( ~(bits & 0x1F) );
+}
+
+//========================================================================
+// The RESTORE key is wired directly to the NMI line.
+void C64::restore( bool down )
+{
+    cpu.set_nmi( NMI_RESTORE, down );
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
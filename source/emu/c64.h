@@ -0,0 +1,202 @@
+#ifndef C64_H
+#define C64_H
+
+#include "cpu6502.h"
+#include "scheduler.h"
+#include "cia.h"
+#include "vic.h"
+#include "drive1541.h"
+#include "audio.h"
+#include "cartridge.h"
+#include "utils.h"
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+class Monitor;
+
+//========================================================================
+// How disk access on device 8 is handled.
+enum class DriveMode
+{
+    NONE,           // No drive on the bus.
+    FAST_LOAD,      // The KERNAL LOAD routine is trapped, files are copied
+                    // from the disk image straight into memory.
+    TRUE_DRIVE,     // A fully emulated 1541 on the serial bus.
+};
+
+//========================================================================
+// The C64: CPU, memory, CIAs, VIC and SID wired together.
+//
+// All chips register their future events with the Scheduler. The CPU
+// runs freely until the next event is due, then the due events are
+// dispatched. For comparison, set_lockstep(true) switches to the naive
+// scheme that looks at every chip after every cycle.
+class C64 : public Bus, public CIAPorts
+{
+public:
+    //========================================================================
+    C64() = default;
+    NO_COPY( C64 );
+    NO_MOVE( C64 );
+    virtual ~C64() = default;
+    //========================================================================
+    // Load the ROMs (basic, kernal, chargen) and power on.
+    void init( sound::SIDModel model = sound::SIDModel::MOS6581 );
+    void reset();
+    //========================================================================
+    // Run the emulation.
+    void run_cycles( uint64_t cycles ) { run_until( cycles_now() + cycles ); }
+    void run_until( uint64_t target );
+    // Run until the end of the current frame.
+    void run_frame();
+    uint64_t cycles_now() const { return cpu.s.cycles; }
+    //========================================================================
+    void set_lockstep( bool enable ) { lockstep = enable; }
+    //========================================================================
+    // Disk drive. Switching to TRUE_DRIVE loads the 1541 ROM, switching to
+    // FAST_LOAD patches the KERNAL; both throw std::runtime_error if that
+    // isn't possible.
+    void set_drive_mode( DriveMode mode );
+    DriveMode drive_mode() const { return m_DriveMode; }
+    void attach_disk( const std::string &filename ) { drive.insert_disk( filename ); }
+    //========================================================================
+    // Expansion port. Attaching loads the CRT file (see Cartridge::load(),
+    // throws std::runtime_error) and resets the machine, like detaching.
+    void attach_cartridge( const std::string &filename, bool write_back );
+    void detach_cartridge();
+    const Cartridge *attached_cartridge() const { return cartridge.get(); }
+    //========================================================================
+    // Complete state of the machine, plain data. The ROMs, the disk image
+    // and the cartridge's flash are not part of it. Restoring a TRUE_DRIVE
+    // snapshot loads the 1541 ROM if needed (and throws like
+    // set_drive_mode()).
+    struct Snapshot
+    {
+        CPU6502::State   cpu;
+        Scheduler::State scheduler;
+        CIA::State       cia1, cia2;
+        VIC::State       vic;
+        VIC::LineLog     vic_lines;
+        sound::SID       sid;
+        std::array<uint8_t, 0x10000> ram;
+        std::array<uint8_t, 0x0400>  color_ram;
+        uint8_t  cpu_port, cpu_ddr;
+        std::array<uint8_t, 8> key_matrix;
+        std::array<uint8_t, 2> joy;
+        uint8_t  cia_out[2][2];
+        uint64_t audio_clock;
+        DriveMode drive_mode;
+        Drive1541::Snapshot drive;
+        Cartridge::State cartridge;
+    };
+    void save_state( Snapshot &snap ) const;
+    void load_state( const Snapshot &snap );
+    //========================================================================
+    // Input. The keyboard matrix is addressed by column (CIA1 port A bit)
+    // and row (CIA1 port B bit). Joystick bits: 0 up, 1 down, 2 left,
+    // 3 right, 4 fire; "port" is 1 or 2.
+    void key( int col, int row, bool down );
+    void joystick( int port, uint8_t bits );
+    void restore( bool down );
+    //========================================================================
+    // Memory as seen by the VIC, for rendering.
+    uint8_t *video_matrix() { return &ram[ vic.video_matrix() ]; }
+    uint8_t *color_memory() { return color_ram.data(); }
+    // Read memory as the CPU sees it, without side effects. The VIC
+    // reads as its register values, the other chips as $FF.
+    uint8_t peek( uint16_t addr ) const;
+    //========================================================================
+    // Debugging. The attached Monitor gets the accesses to the pages it
+    // marks (see Monitor::page_flags()); those pages are left out of the
+    // CPU page tables, all other pages run at full speed. Call
+    // update_debug_pages() when the marks change.
+    void attach_monitor( Monitor *new_monitor ) { monitor = new_monitor; update_banking(); }
+    void update_debug_pages() { update_banking(); }
+    bool monitor_attached() const { return monitor != nullptr; }
+    // Stop run_until() after the current instruction. Until resume(),
+    // run_until() returns at once.
+    void request_break() { m_Break = true; scheduler.set_limit( cycles_now() ); }
+    void resume() { m_Break = false; }
+    bool break_requested() const { return m_Break; }
+    //========================================================================
+    CPU6502   cpu;
+    Scheduler scheduler;
+    CIA       cia1, cia2;
+    VIC       vic;
+    Drive1541 drive;        // Device 8. Its disk is also used by FAST_LOAD.
+    sound::Audio audio;     // Owns the SID.
+    //------------------------------------------------------------------
+    std::array<uint8_t, 0x10000> ram {};
+    std::array<uint8_t, 0x0400>  color_ram {};
+    std::array<uint8_t, 0x2000>  basic_rom {};
+    std::array<uint8_t, 0x2000>  kernal_rom {};
+    std::array<uint8_t, 0x1000>  char_rom {};
+    //========================================================================
+    // Bus
+    uint8_t io_read ( uint16_t addr ) override;
+    void    io_write( uint16_t addr, uint8_t value ) override;
+    bool    trap( uint16_t pc ) override;
+    uint8_t fetch( uint16_t addr ) override;
+    //========================================================================
+    // CIAPorts
+    uint8_t port_read ( int cia, int port, uint8_t output ) override;
+    void    port_write( int cia, int port, uint8_t output ) override;
+
+private:
+    //========================================================================
+    // IRQ and NMI sources.
+    enum : uint8_t { IRQ_CIA1 = 0x01, IRQ_VIC = 0x02 };
+    enum : uint8_t { NMI_CIA2 = 0x01, NMI_RESTORE = 0x02 };
+    //========================================================================
+    // The KERNAL serial LOAD starts with "STA $93" at $F4A5.
+    static constexpr uint16_t LOAD_TRAP = 0xF4A5;
+    //========================================================================
+    bool lockstep {false};
+    DriveMode m_DriveMode {DriveMode::NONE};
+    uint8_t cpu_port {0}, cpu_ddr {0};          // The 6510 I/O port at $00/$01.
+    std::array<uint8_t, 8> key_matrix;          // Bit cleared = key down.
+    std::array<uint8_t, 2> joy { 0xFF, 0xFF };  // Bit cleared = pressed.
+    uint8_t cia_out[2][2] {};                   // Last output of each CIA port.
+    uint64_t audio_clock {0};                   // The SID is synthesized up to here.
+    //------------------------------------------------------------------
+    // The memory configuration; the CPU page tables are a copy of it
+    // without the pages the monitor watches.
+    std::array<const uint8_t*, 256> mem_read {};
+    std::array<uint8_t*, 256>       mem_write {};
+    Monitor *monitor {nullptr};
+    bool m_Break {false};
+    //------------------------------------------------------------------
+    // The cartridge, and the first of the 32 pages its ROML and ROMH
+    // banks show up in (-1: not visible).
+    std::unique_ptr<Cartridge> cartridge;
+    int roml_page {-1}, romh_page {-1};
+    bool ultimax {false};
+    //========================================================================
+    void load_rom( const char *name, uint8_t *dest, size_t size );
+    void update_banking();
+    void map_cartridge_banks();
+    void set_read_page( int page, const uint8_t *mem );
+    void cartridge_changed( Cartridge::Change change );
+    bool cartridge_page( uint16_t addr ) const;
+    uint8_t chip_read ( uint16_t addr );
+    void    chip_write( uint16_t addr, uint8_t value );
+    void step_lockstep();
+    void sync_audio();
+    void sync_drive();
+    void patch_kernal( DriveMode mode );
+    void fast_load();
+    void kernal_return( bool error, uint8_t a );
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // C64_H
@@ -0,0 +1,470 @@
+//========================================================================
+#include "cartridge.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// The CRT format: a header, then a CHIP packet per ROM bank. All
+// numbers are big endian.
+static constexpr size_t CRT_HEADER = 0x40;
+static constexpr size_t CHIP_HEADER = 0x10;
+
+static uint16_t be16( const uint8_t *p ) { return uint16_t( (p[0] << 8) | p[1] ); }
+static uint32_t be32( const uint8_t *p ) { return (uint32_t(be16( p )) << 16) | be16( p + 2 ); }
+
+//========================================================================
+// Banks missing from the file read as erased flash.
+static uint8_t *empty_bank()
+{
+    static std::array<uint8_t, Cartridge::BANK_SIZE> bank = [] {
+        std::array<uint8_t, Cartridge::BANK_SIZE> b;
+        b.fill( 0xFF );
+        return b;
+    }();
+    return bank.data();
+}
+
+//========================================================================
+Cartridge::~Cartridge()
+{
+    if( m_Flusher.joinable() )
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_FlushMutex );
+            m_Stop = true;
+        }
+        m_FlushWake.notify_all();
+        m_Flusher.join();
+    }
+    if( m_WriteBack )
+        flush();
+}
+
+//========================================================================
+void Cartridge::load( const std::string &filename, bool write_back )
+{
+    if( !m_Filename.empty() )
+        throw std::runtime_error( "Cartridge loaded already" );
+    //------------------------------------------------------------------
+    // The header, from a read-only mapping first.
+    file.map( filename, utils::Buffer::Map::READ_ONLY );
+    const uint8_t *data = reinterpret_cast<const uint8_t*>( file.data() );
+    if( file.size() < CRT_HEADER || std::memcmp( data, "C64 CARTRIDGE   ", 16 ) != 0 )
+        throw std::runtime_error( "Not a CRT file: " + filename );
+    uint16_t type = be16( data + 0x16 );
+    if( type != uint16_t(Type::NORMAL) && type != uint16_t(Type::OCEAN) &&
+        type != uint16_t(Type::MAGIC_DESK) && type != uint16_t(Type::EASYFLASH) )
+        throw std::runtime_error( "Unsupported cartridge type " + std::to_string( type ) + ": " + filename );
+    m_Type = Type( type );
+    m_HeaderExrom = data[0x18] == 0;
+    m_HeaderGame  = data[0x19] == 0;
+    m_Name.assign( reinterpret_cast<const char*>( data + 0x20 ),
+                   strnlen( reinterpret_cast<const char*>( data + 0x20 ), 32 ) );
+    size_t pos = std::max( size_t( be32( data + 0x10 ) ), CRT_HEADER );
+    //------------------------------------------------------------------
+    // The flash of an EasyFlash is written through the mapping: shared
+    // with the file, or copy on write.
+    if( m_Type == Type::EASYFLASH )
+    {
+        file.map( filename, write_back ? utils::Buffer::Map::SHARED : utils::Buffer::Map::PRIVATE );
+        data = reinterpret_cast<const uint8_t*>( file.data() );
+    }
+    uint8_t *bytes = reinterpret_cast<uint8_t*>( file.data() );
+    //------------------------------------------------------------------
+    for( auto &chip : banks )
+        chip.fill( empty_bank() );
+    m_Banks = 1;
+    while( pos + CHIP_HEADER <= file.size() )
+    {
+        const uint8_t *chip = data + pos;
+        if( std::memcmp( chip, "CHIP", 4 ) != 0 )
+            throw std::runtime_error( "Bad CHIP packet in " + filename );
+        size_t packet = be32( chip + 4 );
+        int bank      = be16( chip + 0x0A );
+        int load      = be16( chip + 0x0C );
+        size_t size   = be16( chip + 0x0E );
+        if( packet < CHIP_HEADER + size || pos + packet > file.size() )
+            throw std::runtime_error( "Truncated CHIP packet in " + filename );
+        if( bank >= MAX_BANKS || (load != 0x8000 && load != 0xA000 && load != 0xE000) ||
+            (size != 0x2000 && size != 0x4000 && size != 0x1000) || (size == 0x4000 && load != 0x8000) )
+            throw std::runtime_error( "Unsupported CHIP packet in " + filename );
+        //--------------------------------------------------------------
+        int first = load == 0x8000 ? 0 : 1;
+        if( size == 0x1000 )
+        {
+            // 4K ROMs show up twice in their 8K.
+            auto &copy = extra[first][bank];
+            copy.reset( new uint8_t[BANK_SIZE] );
+            std::memcpy( copy.get(), chip + CHIP_HEADER, 0x1000 );
+            std::memcpy( copy.get() + 0x1000, chip + CHIP_HEADER, 0x1000 );
+            banks[first][bank] = copy.get();
+            extra_offset[first][bank] = -1;
+        }
+        else
+        {
+            banks[first][bank] = bytes + pos + CHIP_HEADER;
+            if( size == 0x4000 )
+                banks[1][bank] = bytes + pos + CHIP_HEADER + BANK_SIZE;
+        }
+        m_Banks = std::max( m_Banks, bank + 1 );
+        pos += packet;
+    }
+    //------------------------------------------------------------------
+    // Ocean carts have one row of banks, some of them loaded at $A000,
+    // and show the selected one in ROML and ROMH.
+    if( m_Type == Type::OCEAN )
+    {
+        for( int bank = 0; bank < MAX_BANKS; bank++ )
+            if( banks[0][bank] == empty_bank() )
+                banks[0][bank] = banks[1][bank];
+        banks[1] = banks[0];
+    }
+    //------------------------------------------------------------------
+    m_Filename  = filename;
+    m_WriteBack = write_back && m_Type == Type::EASYFLASH;
+    s = State {};
+    reset();
+    if( m_WriteBack )
+        m_Flusher = std::thread( &Cartridge::flush_loop, this );
+}
+
+//========================================================================
+void Cartridge::reset()
+{
+    s.bank = 0;
+    s.control = 0;
+    s.flash_step[0] = s.flash_step[1] = FLASH_READ;
+    m_Autoselect[0] = m_Autoselect[1] = false;
+    update();
+}
+
+//========================================================================
+// Work out the lines and banks from the registers.
+Cartridge::Change Cartridge::update()
+{
+    bool exrom = m_HeaderExrom, game = m_HeaderGame;
+    int bank = s.bank % MAX_BANKS;
+    switch( m_Type )
+    {
+    case Type::NORMAL:
+        bank = 0;
+        break;
+    case Type::OCEAN:
+        break;
+    case Type::MAGIC_DESK:
+        // 8K mode, bit 7 switches the cartridge off.
+        exrom = (s.control & 0x80) == 0;
+        game  = false;
+        break;
+    case Type::EASYFLASH:
+        // $DE02: bit 0 GAME, bit 1 EXROM, bit 2: GAME from bit 0, else
+        // from the jumper, which is at "boot" (GAME low, Ultimax).
+        exrom = (s.control & 0x02) != 0;
+        game  = (s.control & 0x04) ? (s.control & 0x01) != 0 : true;
+        break;
+    }
+    //------------------------------------------------------------------
+    Change change = CHANGED_NOTHING;
+    if( banks[0][bank] != m_Roml || banks[1][bank] != m_Romh )
+        change = CHANGED_BANKS;
+    if( exrom != m_Exrom || game != m_Game )
+        change = CHANGED_LINES;
+    m_Exrom = exrom;
+    m_Game  = game;
+    m_Roml  = banks[0][bank];
+    m_Romh  = banks[1][bank];
+    return change;
+}
+
+//========================================================================
+uint8_t Cartridge::io_read( uint16_t addr )
+{
+    if( m_Type == Type::EASYFLASH && addr >= 0xDF00 )
+        return s.ram[ addr & 0xFF ];
+    return 0xFF;
+}
+
+//========================================================================
+Cartridge::Change Cartridge::io_write( uint16_t addr, uint8_t value )
+{
+    bool io1 = addr < 0xDF00;
+    switch( m_Type )
+    {
+    case Type::NORMAL:
+        break;
+    case Type::OCEAN:
+        if( io1 )
+        {
+            s.bank = value & 0x3F;
+            return update();
+        }
+        break;
+    case Type::MAGIC_DESK:
+        if( io1 )
+        {
+            s.bank    = value & 0x7F;
+            s.control = value & 0x80;
+            return update();
+        }
+        break;
+    case Type::EASYFLASH:
+        if( !io1 )
+            s.ram[ addr & 0xFF ] = value;
+        else if( addr & 0x02 )
+        {
+            s.control = value & 0x87;
+            return update();
+        }
+        else
+        {
+            s.bank = value & 0x3F;
+            return update();
+        }
+        break;
+    }
+    return CHANGED_NOTHING;
+}
+
+//========================================================================
+uint8_t Cartridge::rom_read( uint16_t addr )
+{
+    int chip = addr < 0xA000 ? 0 : 1;
+    if( m_Autoselect[chip] )
+    {
+        // Manufacturer AMD, device AM29F040, sectors not protected.
+        switch( addr & 0x03 )
+        {
+        case 0:  return 0x01;
+        case 1:  return 0xA4;
+        default: return 0x00;
+        }
+    }
+    return (chip ? m_Romh : m_Roml)[ addr & (BANK_SIZE - 1) ];
+}
+
+//========================================================================
+Cartridge::Change Cartridge::rom_write( uint16_t addr, uint8_t value )
+{
+    if( m_Type != Type::EASYFLASH )
+        return CHANGED_NOTHING;
+    return flash_write( addr < 0xA000 ? 0 : 1, uint16_t( addr & (BANK_SIZE - 1) ), value );
+}
+
+//========================================================================
+// A bank that can be programmed: banks missing from the file get memory
+// of their own, erased.
+uint8_t *Cartridge::writable_bank( int chip, int bank )
+{
+    if( banks[chip][bank] == empty_bank() )
+    {
+        std::lock_guard<std::mutex> lock( m_FlushMutex );
+        extra[chip][bank].reset( new uint8_t[BANK_SIZE] );
+        std::memset( extra[chip][bank].get(), 0xFF, BANK_SIZE );
+        banks[chip][bank] = extra[chip][bank].get();
+    }
+    return banks[chip][bank];
+}
+
+//========================================================================
+// The command sequences of the flash chips. Programming and erasing are
+// done at once, so polling for the end of either finds it done.
+Cartridge::Change Cartridge::flash_write( int chip, uint16_t offset, uint8_t value )
+{
+    uint8_t &step = s.flash_step[chip];
+    int cmd = offset & 0x7FF;
+    Change change = CHANGED_NOTHING;
+    //------------------------------------------------------------------
+    if( value == 0xF0 )
+    {
+        // Reset, also ends the autoselect mode.
+        step = FLASH_READ;
+        if( m_Autoselect[chip] )
+        {
+            m_Autoselect[chip] = false;
+            change = CHANGED_LINES;
+        }
+        return change;
+    }
+    //------------------------------------------------------------------
+    switch( step )
+    {
+    case FLASH_READ:
+        step = (cmd == 0x555 && value == 0xAA) ? FLASH_UNLOCK1 : FLASH_READ;
+        break;
+    case FLASH_UNLOCK1:
+        step = (cmd == 0x2AA && value == 0x55) ? FLASH_UNLOCK2 : FLASH_READ;
+        break;
+    case FLASH_UNLOCK2:
+        step = FLASH_READ;
+        if( cmd == 0x555 && value == 0xA0 )
+            step = FLASH_PROGRAM;
+        else if( cmd == 0x555 && value == 0x80 )
+            step = FLASH_ERASE;
+        else if( cmd == 0x555 && value == 0x90 && !m_Autoselect[chip] )
+        {
+            m_Autoselect[chip] = true;
+            change = CHANGED_LINES;
+        }
+        break;
+    case FLASH_PROGRAM:
+    {
+        // Programming can only clear bits.
+        uint8_t *bank = writable_bank( chip, s.bank % MAX_BANKS );
+        {
+            std::lock_guard<std::mutex> lock( m_FlushMutex );
+            bank[offset] &= value;
+        }
+        step = FLASH_READ;
+        mark_dirty();
+        change = update();
+        break;
+    }
+    case FLASH_ERASE:
+        step = (cmd == 0x555 && value == 0xAA) ? FLASH_ERASE_UNLOCK1 : FLASH_READ;
+        break;
+    case FLASH_ERASE_UNLOCK1:
+        step = (cmd == 0x2AA && value == 0x55) ? FLASH_ERASE_UNLOCK2 : FLASH_READ;
+        break;
+    case FLASH_ERASE_UNLOCK2:
+    {
+        // Erase a sector of 64K (8 banks), or the whole 512K chip.
+        step = FLASH_READ;
+        int first = 0, count = 0;
+        if( value == 0x30 )
+        {
+            first = (s.bank & 0x38);
+            count = 8;
+        }
+        else if( cmd == 0x555 && value == 0x10 )
+            count = 64;
+        for( int bank = first; bank < first + count; bank++ )
+        {
+            if( banks[chip][bank] == empty_bank() )
+                continue;
+            std::lock_guard<std::mutex> lock( m_FlushMutex );
+            std::memset( banks[chip][bank], 0xFF, BANK_SIZE );
+        }
+        if( count )
+            mark_dirty();
+        break;
+    }
+    }
+    return change;
+}
+
+//========================================================================
+Cartridge::Change Cartridge::load_state( const State &state )
+{
+    s = state;
+    m_Autoselect[0] = m_Autoselect[1] = false;
+    update();
+    return CHANGED_LINES;
+}
+
+//========================================================================
+void Cartridge::mark_dirty()
+{
+    if( !m_WriteBack )
+        return;
+    {
+        std::lock_guard<std::mutex> lock( m_FlushMutex );
+        m_Dirty = true;
+    }
+    m_FlushWake.notify_all();
+}
+
+//========================================================================
+// Write the changes some time after they were made, so a burst of them
+// (a file being saved) goes to disk once.
+void Cartridge::flush_loop()
+{
+    std::unique_lock<std::mutex> lock( m_FlushMutex );
+    while( !m_Stop )
+    {
+        m_FlushWake.wait( lock, [this] { return m_Dirty || m_Stop; } );
+        m_FlushWake.wait_for( lock, std::chrono::milliseconds( 500 ), [this] { return m_Stop; } );
+        if( m_Stop || !m_Dirty )
+            continue;
+        m_Dirty = false;
+        lock.unlock();
+        write_file();
+        lock.lock();
+    }
+}
+
+//========================================================================
+void Cartridge::flush()
+{
+    if( !m_WriteBack )
+        return;
+    {
+        std::lock_guard<std::mutex> lock( m_FlushMutex );
+        m_Dirty = false;
+    }
+    write_file();
+}
+
+//========================================================================
+// The banks in the file through the mapping, the others as CHIP packets
+// appended to it (once, then rewritten in place).
+void Cartridge::write_file()
+{
+    std::lock_guard<std::mutex> writing( m_WriteMutex );
+    file.sync( 0, file.size() );
+    //------------------------------------------------------------------
+    std::fstream out;
+    std::vector<uint8_t> copy( BANK_SIZE );
+    for( int chip = 0; chip < 2; chip++ )
+    {
+        for( int bank = 0; bank < MAX_BANKS; bank++ )
+        {
+            long offset;
+            {
+                std::lock_guard<std::mutex> lock( m_FlushMutex );
+                if( !extra[chip][bank] || extra_offset[chip][bank] < 0 )
+                    continue;
+                std::memcpy( copy.data(), extra[chip][bank].get(), BANK_SIZE );
+                offset = extra_offset[chip][bank];
+            }
+            if( !out.is_open() )
+            {
+                out.open( m_Filename, std::ios::in | std::ios::out | std::ios::binary );
+                if( !out )
+                    return;     // Tried again with the next change.
+            }
+            //----------------------------------------------------------
+            if( offset == 0 )
+            {
+                uint16_t load = chip ? 0xA000 : 0x8000;
+                const uint8_t head[CHIP_HEADER] = {
+                    'C', 'H', 'I', 'P',
+                    0x00, 0x00, 0x20, 0x10,                 // Packet length
+                    0x00, 0x02,                             // Flash
+                    uint8_t( bank >> 8 ), uint8_t( bank ),
+                    uint8_t( load >> 8 ), uint8_t( load ),
+                    0x20, 0x00 };                           // Size
+                out.seekp( 0, std::ios::end );
+                offset = long( out.tellp() ) + long( CHIP_HEADER );
+                out.write( reinterpret_cast<const char*>( head ), CHIP_HEADER );
+                std::lock_guard<std::mutex> lock( m_FlushMutex );
+                extra_offset[chip][bank] = offset;
+            }
+            out.seekp( offset );
+            out.write( reinterpret_cast<const char*>( copy.data() ), BANK_SIZE );
+        }
+    }
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
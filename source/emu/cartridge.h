@@ -0,0 +1,140 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include "utils.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// A cartridge from a CRT file: plain 8K/16K/Ultimax ROMs, Ocean type 1,
+// Magic Desk and EasyFlash.
+//
+// The file is mapped (see utils::Buffer::map()), and the banks are
+// pointers into the mapping, so nothing is copied at load time or when
+// a bank is switched: the C64 points its ROML and ROMH pages at the
+// selected banks (see C64::update_banking()).
+//
+// The flash chips of an EasyFlash can be programmed and erased. With
+// write-back, the file is mapped shared and a thread writes the changes
+// to disk in the background; banks the file does not have are added to
+// it as new CHIP packets then. Without, changes are lost at exit.
+class Cartridge
+{
+public:
+    //========================================================================
+    // The hardware types of the CRT header that are supported.
+    enum class Type : uint16_t
+    {
+        NORMAL     = 0,
+        OCEAN      = 5,
+        MAGIC_DESK = 19,
+        EASYFLASH  = 32
+    };
+    static constexpr int BANK_SIZE = 0x2000;
+    static constexpr int MAX_BANKS = 128;
+    //------------------------------------------------------------------
+    // What a write to the cartridge changed, see io_write().
+    enum Change { CHANGED_NOTHING, CHANGED_BANKS, CHANGED_LINES };
+    //------------------------------------------------------------------
+    // The registers, part of C64::Snapshot. The ROMs are not.
+    struct State
+    {
+        uint8_t bank {0};
+        uint8_t control {0};            // EasyFlash $DE02, Magic Desk bit 7.
+        uint8_t flash_step[2] {};       // Command state of ROML's and ROMH's flash chip.
+        std::array<uint8_t, 256> ram {};    // EasyFlash $DF00-$DFFF.
+    };
+    //========================================================================
+    Cartridge() = default;
+    NO_COPY( Cartridge );
+    NO_MOVE( Cartridge );
+    virtual ~Cartridge();
+    //========================================================================
+    // Load a CRT file. "write_back": EasyFlash changes go to the file.
+    // Throws std::runtime_error.
+    void load( const std::string &filename, bool write_back );
+    Type type() const { return m_Type; }
+    const std::string &name() const { return m_Name; }
+    void reset();
+    //========================================================================
+    // The expansion port lines, true = pulled low. GAME without EXROM
+    // is the Ultimax mode.
+    bool exrom() const { return m_Exrom; }
+    bool game() const { return m_Game; }
+    // The selected 8K banks. ROMH is at $A000, or $E000 in Ultimax mode.
+    const uint8_t *roml() const { return m_Roml; }
+    const uint8_t *romh() const { return m_Romh; }
+    // False while a flash chip is in autoselect mode: the ROM pages must
+    // be read through rom_read() then.
+    bool direct_reads() const { return !m_Autoselect[0] && !m_Autoselect[1]; }
+    //========================================================================
+    // I/O 1 ($DE00-$DEFF) and I/O 2 ($DF00-$DFFF).
+    uint8_t io_read( uint16_t addr );
+    Change  io_write( uint16_t addr, uint8_t value );
+    // Ultimax mode: accesses to $8000-$9FFF and $E000-$FFFF.
+    uint8_t rom_read( uint16_t addr );
+    Change  rom_write( uint16_t addr, uint8_t value );
+    //========================================================================
+    void save_state( State &state ) const { state = s; }
+    Change load_state( const State &state );
+    // Write the changed flash banks to the file now.
+    void flush();
+
+private:
+    //========================================================================
+    // Flash chip commands (AM29F040), by step of the command sequence.
+    enum : uint8_t
+    {
+        FLASH_READ, FLASH_UNLOCK1, FLASH_UNLOCK2, FLASH_PROGRAM,
+        FLASH_ERASE, FLASH_ERASE_UNLOCK1, FLASH_ERASE_UNLOCK2
+    };
+    //========================================================================
+    utils::Buffer file;
+    std::string m_Filename;
+    Type m_Type {Type::NORMAL};
+    std::string m_Name;
+    bool m_HeaderExrom {false}, m_HeaderGame {false};
+    bool m_WriteBack {false};
+    //------------------------------------------------------------------
+    // Each bank of ROML (chip 0) and ROMH (chip 1): in the mapped file,
+    // in "extra", or the empty bank.
+    std::array<std::array<uint8_t*, MAX_BANKS>, 2> banks {};
+    std::array<std::array<std::unique_ptr<uint8_t[]>, MAX_BANKS>, 2> extra;
+    // Where "extra" banks are in the file, 0: not yet, -1: never (4K ROMs).
+    std::array<std::array<long, MAX_BANKS>, 2> extra_offset {};
+    int m_Banks {1};
+    //------------------------------------------------------------------
+    State s;
+    bool m_Exrom {false}, m_Game {false};
+    const uint8_t *m_Roml {nullptr}, *m_Romh {nullptr};
+    bool m_Autoselect[2] {false, false};
+    //------------------------------------------------------------------
+    // The background writer.
+    std::thread m_Flusher;
+    std::mutex m_FlushMutex;            // Guards the flags and the flash contents.
+    std::mutex m_WriteMutex;            // One write_file() at a time.
+    std::condition_variable m_FlushWake;
+    bool m_Dirty {false}, m_Stop {false};
+    //========================================================================
+    Change update();
+    uint8_t *writable_bank( int chip, int bank );
+    Change flash_write( int chip, uint16_t offset, uint8_t value );
+    void mark_dirty();
+    void flush_loop();
+    void write_file();
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // CARTRIDGE_H
@@ -0,0 +1,313 @@
+//========================================================================
+#include "cia.h"
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Cycles per 1/10 s of the time-of-day clock (PAL).
+constexpr uint64_t TOD_PERIOD = 98525;
+
+//========================================================================
+void CIA::init( int id, Scheduler &new_sched, const uint64_t &new_clock, CIAPorts &new_ports,
+                void (*irq)(void *ctx, bool active), void *ctx )
+{
+    m_Id    = id;
+    sched   = &new_sched;
+    clock   = &new_clock;
+    ports   = &new_ports;
+    irq_out = irq;
+    irq_ctx = ctx;
+    slot[EV_TA]  = sched->add_slot( this, EV_TA );
+    slot[EV_TB]  = sched->add_slot( this, EV_TB );
+    slot[EV_TOD] = sched->add_slot( this, EV_TOD );
+}
+
+//========================================================================
+void CIA::reset()
+{
+    state = State {};
+    for( int s : slot ) sched->cancel( s );
+    sched->schedule( slot[EV_TOD], *clock + TOD_PERIOD );
+    irq_out( irq_ctx, false );
+    ports->port_write( m_Id, 0, port_a() );
+    ports->port_write( m_Id, 1, port_b() );
+}
+
+//========================================================================
+// Timer A counts cycles unless it counts CNT pulses (bit 5).
+// Timer B counts cycles only in mode 00 (bits 5-6).
+bool CIA::counts_cycles( const Timer &t ) const
+{
+    if( &t == &state.ta ) return !(t.control & 0x20);
+    return (t.control & 0x60) == 0x00;
+}
+
+//========================================================================
+uint16_t CIA::timer_value( const Timer &t ) const
+{
+    if( !running(t) || !counts_cycles(t) ) return t.value;
+    uint64_t elapsed = *clock - t.base;
+    return elapsed >= t.value ? 0 : uint16_t( t.value - elapsed );
+}
+
+//========================================================================
+// Store the current value of the timer, it stops counting.
+void CIA::freeze( Timer &t )
+{
+    t.value = timer_value( t );
+    t.base  = *clock;
+}
+
+//========================================================================
+// A running timer underflows one cycle after it reached zero.
+void CIA::schedule_timer( Timer &t, int ev )
+{
+    if( running(t) && counts_cycles(t) )
+        sched->schedule( slot[ev], t.base + t.value + 1 );
+    else
+        sched->cancel( slot[ev] );
+}
+
+//========================================================================
+void CIA::start( Timer &t, int ev )
+{
+    t.base = *clock;
+    schedule_timer( t, ev );
+}
+
+//========================================================================
+void CIA::write_control( Timer &t, int ev, uint8_t value )
+{
+    freeze( t );
+    t.control = value & ~0x10;  // The force load bit is a strobe.
+    if( value & 0x10 )
+        t.value = t.latch;
+    start( t, ev );
+}
+
+//========================================================================
+void CIA::underflow_a( uint64_t time )
+{
+    Timer &t = state.ta;
+    interrupt( 0x01 );
+    //------------------------------------------------------------------
+    // Timer B can count the underflows of timer A.
+    Timer &b = state.tb;
+    if( running(b) && tb_counts_ta() )
+    {
+        if( b.value == 0 ) underflow_b( time );
+        else               b.value--;
+    }
+    //------------------------------------------------------------------
+    t.value = t.latch;
+    t.base  = time + 1;
+    if( t.control & 0x08 )
+        t.control &= ~0x01; // One-shot: stop.
+    if( running(t) )
+        sched->schedule( slot[EV_TA], t.base + t.value );
+}
+
+//========================================================================
+void CIA::underflow_b( uint64_t time )
+{
+    Timer &t = state.tb;
+    interrupt( 0x02 );
+    t.value = t.latch;
+    t.base  = time + 1;
+    if( t.control & 0x08 )
+        t.control &= ~0x01;
+    if( running(t) && counts_cycles(t) )
+        sched->schedule( slot[EV_TB], t.base + t.value );
+}
+
+//========================================================================
+void CIA::on_event( int tag, uint64_t time )
+{
+    switch( tag )
+    {
+    case EV_TA:  underflow_a( time ); break;
+    case EV_TB:  underflow_b( time ); break;
+    case EV_TOD:
+        tod_tick();
+        sched->schedule( slot[EV_TOD], time + TOD_PERIOD );
+        break;
+    }
+}
+
+//========================================================================
+void CIA::interrupt( uint8_t bits )
+{
+    state.icr_flags |= bits;
+    update_irq();
+}
+
+//========================================================================
+void CIA::update_irq()
+{
+    bool active = (state.icr_flags & state.icr_mask) != 0;
+    if( active != state.irq )
+    {
+        state.irq = active;
+        irq_out( irq_ctx, active );
+    }
+}
+
+//========================================================================
+void CIA::flag()
+{
+    interrupt( 0x10 );
+}
+
+//========================================================================
+// Increment a BCD value, wrap at "limit" (BCD). Returns true on wrap.
+static bool bcd_inc( uint8_t &v, uint8_t limit )
+{
+    v++;
+    if( (v & 0x0F) > 9 ) v = uint8_t( (v & 0xF0) + 0x10 );
+    if( v >= limit ) { v = 0; return true; }
+    return false;
+}
+
+//========================================================================
+void CIA::tod_tick()
+{
+    if( state.tod_stopped ) return;
+    uint8_t *t = state.tod;
+    //------------------------------------------------------------------
+    if( bcd_inc( t[0], 0x0A ) && bcd_inc( t[1], 0x60 ) && bcd_inc( t[2], 0x60 ) )
+    {
+        // Hours: 1-12 with the PM flag in bit 7.
+        uint8_t pm = t[3] & 0x80;
+        uint8_t h  = t[3] & 0x1F;
+        bcd_inc( h, 0x13 );
+        if( h == 0 ) h = 1;
+        if( h == 0x12 ) pm ^= 0x80;
+        t[3] = h | pm;
+    }
+    //------------------------------------------------------------------
+    if( t[0] == state.tod_alarm[0] && t[1] == state.tod_alarm[1] &&
+        t[2] == state.tod_alarm[2] && t[3] == state.tod_alarm[3] )
+        interrupt( 0x04 );
+}
+
+//========================================================================
+uint8_t CIA::peek( uint8_t reg ) const
+{
+    const uint8_t *tod = state.tod_latched ? state.tod_latch : state.tod;
+    switch( reg & 0x0F )
+    {
+    case 0x0: return state.pra;
+    case 0x1: return state.prb;
+    case 0x2: return state.ddra;
+    case 0x3: return state.ddrb;
+    case 0x4: return uint8_t( timer_value( state.ta ) & 0xFF );
+    case 0x5: return uint8_t( timer_value( state.ta ) >> 8 );
+    case 0x6: return uint8_t( timer_value( state.tb ) & 0xFF );
+    case 0x7: return uint8_t( timer_value( state.tb ) >> 8 );
+    case 0x8: return tod[0];
+    case 0x9: return tod[1];
+    case 0xA: return tod[2];
+    case 0xB: return tod[3];
+    case 0xC: return state.sdr;
+    case 0xD: return uint8_t( state.icr_flags | (state.irq ? 0x80 : 0) );
+    case 0xE: return state.ta.control;
+    case 0xF: return state.tb.control;
+    }
+    return 0xFF;
+}
+
+//========================================================================
+uint8_t CIA::read( uint8_t reg )
+{
+    reg &= 0x0F;
+    switch( reg )
+    {
+    case 0x0: return ports->port_read( m_Id, 0, port_a() );
+    case 0x1: return ports->port_read( m_Id, 1, port_b() );
+    case 0x8:
+    {
+        // Reading the 10ths releases the latch.
+        uint8_t v = peek( reg );
+        state.tod_latched = false;
+        return v;
+    }
+    case 0xB:
+        // Reading the hours latches the time until the 10ths are read.
+        if( !state.tod_latched )
+        {
+            for( int i = 0; i < 4; i++ ) state.tod_latch[i] = state.tod[i];
+            state.tod_latched = true;
+        }
+        return state.tod_latch[3];
+    case 0xD:
+    {
+        // Reading the ICR acknowledges all interrupts.
+        uint8_t v = peek( reg );
+        state.icr_flags = 0;
+        update_irq();
+        return v;
+    }
+    }
+    return peek( reg );
+}
+
+//========================================================================
+void CIA::write( uint8_t reg, uint8_t value )
+{
+    reg &= 0x0F;
+    switch( reg )
+    {
+    case 0x0: state.pra  = value; ports->port_write( m_Id, 0, port_a() ); break;
+    case 0x1: state.prb  = value; ports->port_write( m_Id, 1, port_b() ); break;
+    case 0x2: state.ddra = value; ports->port_write( m_Id, 0, port_a() ); break;
+    case 0x3: state.ddrb = value; ports->port_write( m_Id, 1, port_b() ); break;
+    //------------------------------------------------------------------
+    // Writing the high byte of a stopped timer loads the counter.
+    case 0x4: state.ta.latch = (state.ta.latch & 0xFF00) | value; break;
+    case 0x5:
+        state.ta.latch = uint16_t( (state.ta.latch & 0x00FF) | (value << 8) );
+        if( !running(state.ta) ) state.ta.value = state.ta.latch;
+        break;
+    case 0x6: state.tb.latch = (state.tb.latch & 0xFF00) | value; break;
+    case 0x7:
+        state.tb.latch = uint16_t( (state.tb.latch & 0x00FF) | (value << 8) );
+        if( !running(state.tb) ) state.tb.value = state.tb.latch;
+        break;
+    //------------------------------------------------------------------
+    // Time of day or alarm, depending on CRB bit 7.
+    // Writing the hours stops the clock until the 10ths are written.
+    case 0x8: case 0x9: case 0xA: case 0xB:
+    {
+        int i = reg - 0x8;
+        uint8_t v = (i == 0) ? (value & 0x0F) : (i == 3) ? (value & 0x9F) : (value & 0x7F);
+        if( state.tb.control & 0x80 )
+            state.tod_alarm[i] = v;
+        else
+        {
+            state.tod[i] = v;
+            if( i == 3 ) state.tod_stopped = true;
+            if( i == 0 ) state.tod_stopped = false;
+        }
+        break;
+    }
+    case 0xC:
+        state.sdr = value;
+        break;
+    case 0xD:
+        // Bit 7 selects whether the other bits set or clear the mask.
+        if( value & 0x80 ) state.icr_mask |= (value & 0x1F);
+        else               state.icr_mask &= ~(value & 0x1F);
+        update_irq();
+        break;
+    case 0xE: write_control( state.ta, EV_TA, value ); break;
+    case 0xF: write_control( state.tb, EV_TB, value ); break;
+    }
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
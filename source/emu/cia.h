@@ -0,0 +1,108 @@
+#ifndef CIA_H
+#define CIA_H
+
+#include "scheduler.h"
+
+#include <cstdint>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// The I/O ports of a CIA are wired to the outside world by the machine.
+class CIAPorts
+{
+public:
+    virtual ~CIAPorts() = default;
+    // Return the levels of the port pins. "output" is what the CIA
+    // drives itself (PRx | ~DDRx), so the result is usually output & input.
+    virtual uint8_t port_read ( int cia, int port, uint8_t output ) = 0;
+    // Called whenever the output value of a port changes.
+    virtual void    port_write( int cia, int port, uint8_t output ) = 0;
+};
+
+//========================================================================
+// The 6526 Complex Interface Adapter.
+//
+// The timers are not decremented every cycle. A running timer remembers
+// its value at a base cycle; reads compute the current value from the
+// system clock, and the underflow is an event in the Scheduler. The
+// time-of-day clock is an event every 1/10 s.
+class CIA : public EventHandler
+{
+public:
+    //========================================================================
+    // id: 0 = CIA1, 1 = CIA2 (passed to the port callbacks).
+    // irq: called when the interrupt output changes.
+    void init( int id, Scheduler &sched, const uint64_t &clock, CIAPorts &ports,
+               void (*irq)(void *ctx, bool active), void *irq_ctx );
+    void reset();
+    //========================================================================
+    uint8_t read ( uint8_t reg );
+    uint8_t peek ( uint8_t reg ) const;   // Read without side effects.
+    void    write( uint8_t reg, uint8_t value );
+    //========================================================================
+    // Signal a negative edge on the FLAG input.
+    void flag();
+    //========================================================================
+    void on_event( int tag, uint64_t time ) override;
+    //========================================================================
+    struct Timer
+    {
+        uint16_t latch {0xFFFF};
+        uint16_t value {0xFFFF};    // Counter value at cycle "base".
+        uint64_t base {0};
+        uint8_t  control {0};       // CRA / CRB.
+    };
+    struct State
+    {
+        Timer    ta, tb;
+        uint8_t  pra {0}, prb {0}, ddra {0}, ddrb {0};
+        uint8_t  icr_flags {0}, icr_mask {0};
+        bool     irq {false};
+        //--------------------------------------------------------------
+        // Time of day: 10ths, seconds, minutes, hours (BCD).
+        uint8_t  tod[4] {0, 0, 0, 1};
+        uint8_t  tod_alarm[4] {0, 0, 0, 0};
+        uint8_t  tod_latch[4] {0, 0, 0, 0};
+        bool     tod_latched {false};
+        bool     tod_stopped {false};
+        uint8_t  sdr {0};
+    };
+    State state;
+    //========================================================================
+    // Current value of a timer, computed from the system clock.
+    uint16_t timer_value( const Timer &t ) const;
+
+private:
+    //========================================================================
+    enum { EV_TA, EV_TB, EV_TOD };
+    //========================================================================
+    int m_Id {0};
+    Scheduler *sched {nullptr};
+    const uint64_t *clock {nullptr};
+    CIAPorts *ports {nullptr};
+    void (*irq_out)(void *, bool) {nullptr};
+    void *irq_ctx {nullptr};
+    int slot[3] {};
+    //========================================================================
+    bool running( const Timer &t ) const { return t.control & 0x01; }
+    bool counts_cycles( const Timer &t ) const;
+    bool tb_counts_ta() const { return (state.tb.control & 0x40) != 0; }
+    void freeze( Timer &t );
+    void start( Timer &t, int ev );
+    void schedule_timer( Timer &t, int ev );
+    void underflow_a( uint64_t time );
+    void underflow_b( uint64_t time );
+    void write_control( Timer &t, int ev, uint8_t value );
+    void interrupt( uint8_t bits );
+    void update_irq();
+    void tod_tick();
+    uint8_t port_a() const { return state.pra | uint8_t(~state.ddra); }
+    uint8_t port_b() const { return state.prb | uint8_t(~state.ddrb); }
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // CIA_H
@@ -0,0 +1,489 @@
+//========================================================================
+#include "cpu6502.h"
+#include "profiler.h"
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Base cycle count of every opcode (including the undocumented ones).
+// Page crossing and branch penalties are added during execution.
+static const uint8_t cycle_table[256] = {
+//  0 1 2 3 4 5 6 7 8 9 A B C D E F
+    7,6,0,8,3,3,5,5,3,2,2,2,4,4,6,6, // 0x00
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0x10
+    6,6,0,8,3,3,5,5,4,2,2,2,4,4,6,6, // 0x20
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0x30
+    6,6,0,8,3,3,5,5,3,2,2,2,3,4,6,6, // 0x40
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0x50
+    6,6,0,8,3,3,5,5,4,2,2,2,5,4,6,6, // 0x60
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0x70
+    2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, // 0x80
+    2,6,0,6,4,4,4,4,2,5,2,5,5,5,5,5, // 0x90
+    2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, // 0xA0
+    2,5,0,5,4,4,4,4,2,4,2,4,4,4,4,4, // 0xB0
+    2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, // 0xC0
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0xD0
+    2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, // 0xE0
+    2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7, // 0xF0
+};
+
+//========================================================================
+// The opcodes that call a subroutine, for the Profiler: JSR and BRK.
+static const uint8_t call_table[256] = { 1, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                         1 };
+
+//========================================================================
+void CPU6502::init( Bus *new_bus )
+{
+    bus = new_bus;
+}
+
+//========================================================================
+void CPU6502::reset()
+{
+    uint64_t cycles = s.cycles;
+    s = State {};
+    s.cycles = cycles + 7;
+    s.pc = uint16_t( read(0xFFFC) | (read(0xFFFD) << 8) );
+}
+
+//========================================================================
+void CPU6502::run( const uint64_t &deadline )
+{
+    if( m_Profiler )
+        run_loop<true>( deadline );
+    else
+        run_loop<false>( deadline );
+}
+
+//========================================================================
+void CPU6502::step()
+{
+    if( m_Profiler )
+        step_one<true>();
+    else
+        step_one<false>();
+}
+
+//========================================================================
+template<bool PROFILE>
+void CPU6502::run_loop( const uint64_t &deadline )
+{
+    while( s.cycles < deadline )
+    {
+        step_one<PROFILE>();
+    }
+}
+
+//========================================================================
+template<bool PROFILE>
+void CPU6502::step_one()
+{
+    //------------------------------------------------------------------
+    // A jammed CPU doesn't do anything until reset.
+    if( s.jammed )
+    {
+        s.cycles++;
+        return;
+    }
+    [[maybe_unused]] const uint16_t pc = s.pc;
+    [[maybe_unused]] const uint64_t start = s.cycles;
+    //------------------------------------------------------------------
+    // Interrupts are checked between instructions.
+    if( s.nmi_pending )
+    {
+        s.nmi_pending = false;
+        interrupt( 0xFFFA, false );
+        if constexpr( PROFILE )
+            m_Profiler->interrupt( s.pc, uint32_t( s.cycles - start ) );
+        return;
+    }
+    if( s.irq_lines && !(s.p & FLAG_I) )
+    {
+        interrupt( 0xFFFE, false );
+        if constexpr( PROFILE )
+            m_Profiler->interrupt( s.pc, uint32_t( s.cycles - start ) );
+        return;
+    }
+    //------------------------------------------------------------------
+    uint8_t opcode = fetch( s.pc++ );
+    s.cycles += cycle_table[opcode];
+    execute( opcode );
+    if constexpr( PROFILE )
+        m_Profiler->instruction( pc, uint32_t( s.cycles - start ), s.pc, call_table[opcode] );
+}
+
+//========================================================================
+void CPU6502::interrupt( uint16_t vector, bool brk )
+{
+    push( uint8_t(s.pc >> 8) );
+    push( uint8_t(s.pc & 0xFF) );
+    push( uint8_t( (s.p | FLAG_U | (brk ? FLAG_B : 0)) & ~(brk ? 0 : FLAG_B) ) );
+    s.p |= FLAG_I;
+    s.pc = uint16_t( read(vector) | (read(vector+1) << 8) );
+    if( !brk ) s.cycles += 7;
+}
+
+//========================================================================
+void CPU6502::op_adc( uint8_t v )
+{
+    unsigned c = s.p & FLAG_C;
+    if( !(s.p & FLAG_D) )
+    {
+        unsigned sum = unsigned(s.a) + v + c;
+        set_flag( FLAG_V, (~(s.a ^ v) & (s.a ^ sum) & 0x80) != 0 );
+        set_flag( FLAG_C, sum > 0xFF );
+        s.a = uint8_t(sum);
+        set_nz( s.a );
+        return;
+    }
+    //------------------------------------------------------------------
+    // Decimal mode, including the NMOS flag quirks.
+    unsigned tmp = (s.a & 0x0F) + (v & 0x0F) + c;
+    if( tmp > 0x09 ) tmp += 0x06;
+    if( tmp <= 0x0F ) tmp = (tmp & 0x0F) + (s.a & 0xF0) + (v & 0xF0);
+    else              tmp = (tmp & 0x0F) + (s.a & 0xF0) + (v & 0xF0) + 0x10;
+    set_flag( FLAG_Z, ((s.a + v + c) & 0xFF) == 0 );
+    set_flag( FLAG_N, (tmp & 0x80) != 0 );
+    set_flag( FLAG_V, ((s.a ^ tmp) & 0x80) && !((s.a ^ v) & 0x80) );
+    if( (tmp & 0x1F0) > 0x90 ) tmp += 0x60;
+    set_flag( FLAG_C, (tmp & 0xFF0) > 0xF0 );
+    s.a = uint8_t(tmp);
+}
+
+//========================================================================
+void CPU6502::op_sbc( uint8_t v )
+{
+    unsigned borrow = (s.p & FLAG_C) ? 0 : 1;
+    unsigned diff = unsigned(s.a) - v - borrow;
+    if( !(s.p & FLAG_D) )
+    {
+        set_flag( FLAG_V, ((s.a ^ v) & (s.a ^ diff) & 0x80) != 0 );
+        set_flag( FLAG_C, diff < 0x100 );
+        s.a = uint8_t(diff);
+        set_nz( s.a );
+        return;
+    }
+    //------------------------------------------------------------------
+    // Decimal mode. Flags are set from the binary result.
+    unsigned tmp = (s.a & 0x0F) - (v & 0x0F) - borrow;
+    if( tmp & 0x10 ) tmp = ((tmp - 6) & 0x0F) | ((s.a & 0xF0) - (v & 0xF0) - 0x10);
+    else             tmp = (tmp & 0x0F) | ((s.a & 0xF0) - (v & 0xF0));
+    if( tmp & 0x100 ) tmp -= 0x60;
+    set_flag( FLAG_V, ((s.a ^ v) & (s.a ^ diff) & 0x80) != 0 );
+    set_flag( FLAG_C, (diff & 0xFFFF) < 0x100 );
+    set_nz( uint8_t(diff) );
+    s.a = uint8_t(tmp);
+}
+
+//========================================================================
+void CPU6502::op_cmp( uint8_t reg, uint8_t v )
+{
+    unsigned diff = unsigned(reg) - v;
+    set_flag( FLAG_C, reg >= v );
+    set_nz( uint8_t(diff) );
+}
+
+//========================================================================
+void CPU6502::op_bit( uint8_t v )
+{
+    s.p = uint8_t( (s.p & ~(FLAG_N | FLAG_V | FLAG_Z)) | (v & (FLAG_N | FLAG_V)) | ((s.a & v) ? 0 : FLAG_Z) );
+}
+
+//========================================================================
+uint8_t CPU6502::op_asl( uint8_t v )
+{
+    set_flag( FLAG_C, v & 0x80 );
+    v = uint8_t(v << 1);
+    set_nz( v );
+    return v;
+}
+uint8_t CPU6502::op_lsr( uint8_t v )
+{
+    set_flag( FLAG_C, v & 0x01 );
+    v >>= 1;
+    set_nz( v );
+    return v;
+}
+uint8_t CPU6502::op_rol( uint8_t v )
+{
+    uint8_t c = s.p & FLAG_C;
+    set_flag( FLAG_C, v & 0x80 );
+    v = uint8_t( (v << 1) | c );
+    set_nz( v );
+    return v;
+}
+uint8_t CPU6502::op_ror( uint8_t v )
+{
+    uint8_t c = (s.p & FLAG_C) ? 0x80 : 0;
+    set_flag( FLAG_C, v & 0x01 );
+    v = uint8_t( (v >> 1) | c );
+    set_nz( v );
+    return v;
+}
+
+//========================================================================
+void CPU6502::branch( bool condition )
+{
+    int8_t offset = int8_t( read( s.pc++ ) );
+    if( !condition ) return;
+    uint16_t target = uint16_t( s.pc + offset );
+    s.cycles += ((target ^ s.pc) & 0xFF00) ? 2 : 1;
+    s.pc = target;
+}
+
+//========================================================================
+// Shorthands for the big opcode switch.
+#define IMM         (s.pc++)
+#define ZP          am_zp()
+#define ZPX         am_zpx()
+#define ZPY         am_zpy()
+#define ABS         am_abs()
+#define ABX         am_abx(true)
+#define ABY         am_aby(true)
+#define IZX         am_izx()
+#define IZY         am_izy(true)
+#define ABX_W       am_abx(false)
+#define ABY_W       am_aby(false)
+#define IZY_W       am_izy(false)
+
+// Read instructions: v is the operand.
+#define R(code, mode, stmt)   case code: { uint8_t v = read(mode); stmt; } break;
+// Write instructions: a is the address.
+#define W(code, mode, stmt)   case code: { uint16_t a = mode; stmt; } break;
+// Read-modify-write instructions: v is the result.
+#define M(code, mode, op, stmt) case code: { uint8_t v = rmw( mode, [this](uint8_t x) { return op; } ); (void)v; stmt; } break;
+
+// The 8 addressing modes of the ALU group (ORA, AND, EOR, ADC, LDA, CMP, SBC).
+#define ALU(base, stmt) \
+    R(base+0x01, IZX, stmt) R(base+0x05, ZP,  stmt) R(base+0x09, IMM, stmt) R(base+0x0D, ABS, stmt) \
+    R(base+0x11, IZY, stmt) R(base+0x15, ZPX, stmt) R(base+0x19, ABY, stmt) R(base+0x1D, ABX, stmt)
+// The 5 addressing modes of the shift group (ASL, ROL, LSR, ROR, DEC, INC).
+#define SHIFT(base, op) \
+    M(base+0x06, ZP,  op, ) M(base+0x0E, ABS,   op, ) \
+    M(base+0x16, ZPX, op, ) M(base+0x1E, ABX_W, op, )
+// The 7 addressing modes of the undocumented RMW+ALU group (SLO, RLA, ...)
+#define ILLEGAL_RMW(base, op, stmt) \
+    M(base+0x03, IZX,   op, stmt) M(base+0x07, ZP,    op, stmt) M(base+0x0F, ABS,   op, stmt) \
+    M(base+0x13, IZY_W, op, stmt) M(base+0x17, ZPX,   op, stmt) M(base+0x1B, ABY_W, op, stmt) \
+    M(base+0x1F, ABX_W, op, stmt)
+
+//========================================================================
+void CPU6502::execute( uint8_t opcode )
+{
+    switch( opcode )
+    {
+    //------------------------------------------------------------------
+    // ALU group.
+    ALU( 0x00, s.a |= v; set_nz(s.a) )
+    ALU( 0x20, s.a &= v; set_nz(s.a) )
+    ALU( 0x40, s.a ^= v; set_nz(s.a) )
+    ALU( 0x60, op_adc(v) )
+    ALU( 0xA0, s.a = v; set_nz(s.a) )
+    ALU( 0xC0, op_cmp(s.a, v) )
+    ALU( 0xE0, op_sbc(v) )
+    R( 0xEB, IMM, op_sbc(v) )
+    //------------------------------------------------------------------
+    // STA
+    W( 0x81, IZX,   write(a, s.a) )
+    W( 0x85, ZP,    write(a, s.a) )
+    W( 0x8D, ABS,   write(a, s.a) )
+    W( 0x91, IZY_W, write(a, s.a) )
+    W( 0x95, ZPX,   write(a, s.a) )
+    W( 0x99, ABY_W, write(a, s.a) )
+    W( 0x9D, ABX_W, write(a, s.a) )
+    //------------------------------------------------------------------
+    // Shifts, rotates, increments and decrements.
+    SHIFT( 0x00, op_asl(x) )
+    SHIFT( 0x20, op_rol(x) )
+    SHIFT( 0x40, op_lsr(x) )
+    SHIFT( 0x60, op_ror(x) )
+    SHIFT( 0xC0, (set_nz(uint8_t(x-1)), uint8_t(x-1)) )
+    SHIFT( 0xE0, (set_nz(uint8_t(x+1)), uint8_t(x+1)) )
+    case 0x0A: s.a = op_asl(s.a); break;
+    case 0x2A: s.a = op_rol(s.a); break;
+    case 0x4A: s.a = op_lsr(s.a); break;
+    case 0x6A: s.a = op_ror(s.a); break;
+    //------------------------------------------------------------------
+    // X and Y register loads, stores and compares.
+    R( 0xA2, IMM, s.x = v; set_nz(s.x) )
+    R( 0xA6, ZP,  s.x = v; set_nz(s.x) )
+    R( 0xAE, ABS, s.x = v; set_nz(s.x) )
+    R( 0xB6, ZPY, s.x = v; set_nz(s.x) )
+    R( 0xBE, ABY, s.x = v; set_nz(s.x) )
+    R( 0xA0, IMM, s.y = v; set_nz(s.y) )
+    R( 0xA4, ZP,  s.y = v; set_nz(s.y) )
+    R( 0xAC, ABS, s.y = v; set_nz(s.y) )
+    R( 0xB4, ZPX, s.y = v; set_nz(s.y) )
+    R( 0xBC, ABX, s.y = v; set_nz(s.y) )
+    W( 0x86, ZP,  write(a, s.x) )
+    W( 0x8E, ABS, write(a, s.x) )
+    W( 0x96, ZPY, write(a, s.x) )
+    W( 0x84, ZP,  write(a, s.y) )
+    W( 0x8C, ABS, write(a, s.y) )
+    W( 0x94, ZPX, write(a, s.y) )
+    R( 0xE0, IMM, op_cmp(s.x, v) )
+    R( 0xE4, ZP,  op_cmp(s.x, v) )
+    R( 0xEC, ABS, op_cmp(s.x, v) )
+    R( 0xC0, IMM, op_cmp(s.y, v) )
+    R( 0xC4, ZP,  op_cmp(s.y, v) )
+    R( 0xCC, ABS, op_cmp(s.y, v) )
+    R( 0x24, ZP,  op_bit(v) )
+    R( 0x2C, ABS, op_bit(v) )
+    //------------------------------------------------------------------
+    // Branches.
+    case 0x10: branch( !(s.p & FLAG_N) ); break;
+    case 0x30: branch(  (s.p & FLAG_N) ); break;
+    case 0x50: branch( !(s.p & FLAG_V) ); break;
+    case 0x70: branch(  (s.p & FLAG_V) ); break;
+    case 0x90: branch( !(s.p & FLAG_C) ); break;
+    case 0xB0: branch(  (s.p & FLAG_C) ); break;
+    case 0xD0: branch( !(s.p & FLAG_Z) ); break;
+    case 0xF0: branch(  (s.p & FLAG_Z) ); break;
+    //------------------------------------------------------------------
+    // Jumps, subroutines and interrupts.
+    case 0x4C: s.pc = fetch16(); break;
+    case 0x6C:
+    {
+        // JMP ($xxFF) fetches the high byte from $xx00.
+        uint16_t ptr = fetch16();
+        uint16_t hi  = uint16_t( (ptr & 0xFF00) | ((ptr + 1) & 0x00FF) );
+        s.pc = uint16_t( read(ptr) | (read(hi) << 8) );
+        break;
+    }
+    case 0x20:
+    {
+        uint16_t target = fetch16();
+        uint16_t ret = uint16_t( s.pc - 1 );
+        push( uint8_t(ret >> 8) );
+        push( uint8_t(ret & 0xFF) );
+        s.pc = target;
+        break;
+    }
+    case 0x60:
+    {
+        uint16_t lo = pull();
+        uint16_t hi = pull();
+        s.pc = uint16_t( ((hi << 8) | lo) + 1 );
+        break;
+    }
+    case 0x40:
+    {
+        s.p = uint8_t( (pull() | FLAG_U) & ~FLAG_B );
+        uint16_t lo = pull();
+        uint16_t hi = pull();
+        s.pc = uint16_t( (hi << 8) | lo );
+        break;
+    }
+    case 0x00:
+        s.pc++; // BRK skips a padding byte.
+        interrupt( 0xFFFE, true );
+        break;
+    //------------------------------------------------------------------
+    // Stack.
+    case 0x08: push( s.p | FLAG_B | FLAG_U ); break;
+    case 0x28: s.p = uint8_t( (pull() | FLAG_U) & ~FLAG_B ); break;
+    case 0x48: push( s.a ); break;
+    case 0x68: s.a = pull(); set_nz( s.a ); break;
+    //------------------------------------------------------------------
+    // Register transfers, increments and decrements.
+    case 0xAA: s.x = s.a; set_nz( s.x ); break;
+    case 0xA8: s.y = s.a; set_nz( s.y ); break;
+    case 0x8A: s.a = s.x; set_nz( s.a ); break;
+    case 0x98: s.a = s.y; set_nz( s.a ); break;
+    case 0xBA: s.x = s.sp; set_nz( s.x ); break;
+    case 0x9A: s.sp = s.x; break;
+    case 0xE8: s.x++; set_nz( s.x ); break;
+    case 0xC8: s.y++; set_nz( s.y ); break;
+    case 0xCA: s.x--; set_nz( s.x ); break;
+    case 0x88: s.y--; set_nz( s.y ); break;
+    //------------------------------------------------------------------
+    // Flags.
+    case 0x18: s.p &= ~FLAG_C; break;
+    case 0x38: s.p |=  FLAG_C; break;
+    case 0x58: s.p &= ~FLAG_I; break;
+    case 0x78: s.p |=  FLAG_I; break;
+    case 0xB8: s.p &= ~FLAG_V; break;
+    case 0xD8: s.p &= ~FLAG_D; break;
+    case 0xF8: s.p |=  FLAG_D; break;
+    //------------------------------------------------------------------
+    // NOPs, documented and undocumented.
+    case 0xEA: case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
+        break;
+    case 0x80: case 0x82: case 0x89: case 0xC2: case 0xE2:
+        s.pc++; break;
+    R( 0x04, ZP,  (void)v ) R( 0x44, ZP,  (void)v ) R( 0x64, ZP,  (void)v )
+    R( 0x14, ZPX, (void)v ) R( 0x34, ZPX, (void)v ) R( 0x54, ZPX, (void)v )
+    R( 0x74, ZPX, (void)v ) R( 0xD4, ZPX, (void)v ) R( 0xF4, ZPX, (void)v )
+    R( 0x0C, ABS, (void)v )
+    R( 0x1C, ABX, (void)v ) R( 0x3C, ABX, (void)v ) R( 0x5C, ABX, (void)v )
+    R( 0x7C, ABX, (void)v ) R( 0xDC, ABX, (void)v ) R( 0xFC, ABX, (void)v )
+    //------------------------------------------------------------------
+    // Undocumented read-modify-write combinations.
+    ILLEGAL_RMW( 0x00, op_asl(x), s.a |= v; set_nz(s.a) )                  // SLO
+    ILLEGAL_RMW( 0x20, op_rol(x), s.a &= v; set_nz(s.a) )                  // RLA
+    ILLEGAL_RMW( 0x40, op_lsr(x), s.a ^= v; set_nz(s.a) )                  // SRE
+    ILLEGAL_RMW( 0x60, op_ror(x), op_adc(v) )                              // RRA
+    ILLEGAL_RMW( 0xC0, uint8_t(x-1), op_cmp(s.a, v) )                      // DCP
+    ILLEGAL_RMW( 0xE0, uint8_t(x+1), op_sbc(v) )                           // ISC
+    //------------------------------------------------------------------
+    // Undocumented loads and stores.
+    R( 0xA3, IZX, s.a = s.x = v; set_nz(v) )                              // LAX
+    R( 0xA7, ZP,  s.a = s.x = v; set_nz(v) )
+    R( 0xAF, ABS, s.a = s.x = v; set_nz(v) )
+    R( 0xB3, IZY, s.a = s.x = v; set_nz(v) )
+    R( 0xB7, ZPY, s.a = s.x = v; set_nz(v) )
+    R( 0xBF, ABY, s.a = s.x = v; set_nz(v) )
+    R( 0xAB, IMM, s.a = s.x = uint8_t((s.a | 0xEE) & v); set_nz(s.a) )     // LXA (unstable)
+    W( 0x83, IZX, write(a, s.a & s.x) )                                    // SAX
+    W( 0x87, ZP,  write(a, s.a & s.x) )
+    W( 0x8F, ABS, write(a, s.a & s.x) )
+    W( 0x97, ZPY, write(a, s.a & s.x) )
+    //------------------------------------------------------------------
+    // Undocumented immediate operations.
+    R( 0x0B, IMM, s.a &= v; set_nz(s.a); set_flag(FLAG_C, s.a & 0x80) )    // ANC
+    R( 0x2B, IMM, s.a &= v; set_nz(s.a); set_flag(FLAG_C, s.a & 0x80) )
+    R( 0x4B, IMM, s.a = op_lsr(s.a & v) )                                  // ALR
+    R( 0x6B, IMM,                                                          // ARR
+        s.a = uint8_t( ((s.a & v) >> 1) | ((s.p & FLAG_C) ? 0x80 : 0) );
+        set_nz(s.a);
+        set_flag(FLAG_C, s.a & 0x40);
+        set_flag(FLAG_V, ((s.a >> 6) ^ (s.a >> 5)) & 1) )
+    R( 0xCB, IMM,                                                          // SBX
+        unsigned t = unsigned(s.a & s.x) - v;
+        set_flag(FLAG_C, t < 0x100);
+        s.x = uint8_t(t); set_nz(s.x) )
+    R( 0x8B, IMM, s.a = uint8_t((s.a | 0xEE) & s.x & v); set_nz(s.a) )    // ANE (unstable)
+    R( 0xBB, ABY, s.a = s.x = s.sp = uint8_t(v & s.sp); set_nz(s.a) )      // LAS
+    //------------------------------------------------------------------
+    // Undocumented stores that AND with the address high byte + 1.
+    case 0x93: { uint16_t base = zp_read16( read(s.pc++) ); uint16_t a = uint16_t(base + s.y);
+                 write( a, uint8_t(s.a & s.x & ((base >> 8) + 1)) ); } break; // SHA (zp),Y
+    case 0x9F: { uint16_t base = fetch16(); uint16_t a = uint16_t(base + s.y);
+                 write( a, uint8_t(s.a & s.x & ((base >> 8) + 1)) ); } break; // SHA abs,Y
+    case 0x9C: { uint16_t base = fetch16(); uint16_t a = uint16_t(base + s.x);
+                 write( a, uint8_t(s.y & ((base >> 8) + 1)) ); } break;       // SHY abs,X
+    case 0x9E: { uint16_t base = fetch16(); uint16_t a = uint16_t(base + s.y);
+                 write( a, uint8_t(s.x & ((base >> 8) + 1)) ); } break;       // SHX abs,Y
+    case 0x9B: { uint16_t base = fetch16(); uint16_t a = uint16_t(base + s.y);
+                 s.sp = s.a & s.x;
+                 write( a, uint8_t(s.sp & ((base >> 8) + 1)) ); } break;      // TAS abs,Y
+    //------------------------------------------------------------------
+    // JAM: the CPU locks up, unless the owner placed a trap here.
+    default:
+        s.pc--;
+        if( opcode == TRAP_OPCODE && bus->trap( s.pc ) )
+            break;
+        s.jammed = true;
+        break;
+    }
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,178 @@
+#ifndef CPU6502_H
+#define CPU6502_H
+
+#include <cstdint>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+class Profiler;
+
+//========================================================================
+// Everything the CPU can't reach through a direct page pointer.
+class Bus
+{
+public:
+    virtual ~Bus() = default;
+    virtual uint8_t io_read ( uint16_t addr ) = 0;
+    virtual void    io_write( uint16_t addr, uint8_t value ) = 0;
+    // Called when the CPU executes TRAP_OPCODE at "pc". Returns false if
+    // the owner has no trap there (the CPU jams then). Otherwise the owner
+    // has done the work, including updating PC and the cycle counter.
+    virtual bool    trap( uint16_t pc ) { (void)pc; return false; }
+    // Opcode fetches from pages without a read pointer come here, all
+    // other reads go to io_read(). A debugger unmaps the pages it wants
+    // to watch, so the pages it doesn't watch cost nothing extra.
+    virtual uint8_t fetch( uint16_t addr ) { return io_read( addr ); }
+};
+
+//========================================================================
+// The 6502 CPU (also used as the 6510 of the C64 and the 6502 of the
+// 1541 drive). Instruction-exact: all memory accesses of an instruction
+// happen at once and the cycle counter advances by the instruction's
+// cycle count, including page crossing and branch penalties.
+//
+// Memory is accessed through per-page pointers. A page with a valid
+// pointer is plain memory (RAM or ROM), a null pointer sends the access
+// to the Bus. The owner of the CPU maintains the page tables (e.g. when
+// the C64 memory configuration changes).
+class CPU6502
+{
+public:
+    //========================================================================
+    // Status register flags.
+    enum : uint8_t { FLAG_C = 0x01, FLAG_Z = 0x02, FLAG_I = 0x04, FLAG_D = 0x08,
+                     FLAG_B = 0x10, FLAG_U = 0x20, FLAG_V = 0x40, FLAG_N = 0x80 };
+    //========================================================================
+    // One of the JAM opcodes, patched into ROM to call Bus::trap().
+    static constexpr uint8_t TRAP_OPCODE = 0x02;
+    //========================================================================
+    // All state of the CPU. Plain data, so it can be copied for snapshots.
+    struct State
+    {
+        uint16_t pc {0};
+        uint8_t  a {0}, x {0}, y {0}, sp {0xFD};
+        uint8_t  p {FLAG_U | FLAG_I};
+        uint64_t cycles {0};        // Cycle counter, the clock of the system.
+        uint8_t  irq_lines {0};     // One bit per IRQ source, level triggered.
+        uint8_t  nmi_lines {0};     // One bit per NMI source, edge triggered.
+        bool     nmi_pending {false};
+        bool     jammed {false};    // A JAM/KIL opcode halted the CPU.
+    };
+    State s;
+    //========================================================================
+    // Page tables. Set up by the owner.
+    const uint8_t *read_map[256] {};
+    uint8_t       *write_map[256] {};
+    //========================================================================
+    void init( Bus *bus );
+    void reset();
+    //========================================================================
+    // Run instructions until the cycle counter reaches "deadline".
+    // The deadline is re-read before every instruction.
+    void run( const uint64_t &deadline );
+    // Execute exactly one instruction (or interrupt sequence).
+    void step();
+    //========================================================================
+    // Count every instruction in "profiler" (nullptr: stop). The profiled
+    // and the plain loop are two instances of one template, so the plain
+    // one has no trace of the profiler.
+    void set_profiler( Profiler *profiler ) { m_Profiler = profiler; }
+    Profiler *profiler() const { return m_Profiler; }
+    //========================================================================
+    // Interrupt inputs. "source" is a bit mask identifying the device.
+    void set_irq( uint8_t source, bool active )
+    {
+        if( active ) s.irq_lines |= source; else s.irq_lines &= uint8_t(~source);
+    }
+    void set_nmi( uint8_t source, bool active )
+    {
+        uint8_t before = s.nmi_lines;
+        if( active ) s.nmi_lines |= source; else s.nmi_lines &= uint8_t(~source);
+        if( before == 0 && s.nmi_lines != 0 ) s.nmi_pending = true;
+    }
+    // The SO pin sets the overflow flag (used by the 1541 disk controller).
+    void set_overflow() { s.p |= FLAG_V; }
+    //========================================================================
+    // Memory access as seen by the CPU.
+    uint8_t read( uint16_t addr )
+    {
+        const uint8_t *page = read_map[addr >> 8];
+        return page ? page[addr & 0xFF] : bus->io_read( addr );
+    }
+    void write( uint16_t addr, uint8_t value )
+    {
+        uint8_t *page = write_map[addr >> 8];
+        if( page ) page[addr & 0xFF] = value; else bus->io_write( addr, value );
+    }
+    // The read of an opcode, see Bus::fetch().
+    uint8_t fetch( uint16_t addr )
+    {
+        const uint8_t *page = read_map[addr >> 8];
+        return page ? page[addr & 0xFF] : bus->fetch( addr );
+    }
+
+private:
+    //========================================================================
+    Bus *bus {nullptr};
+    Profiler *m_Profiler {nullptr};
+    //========================================================================
+    template<bool PROFILE> void run_loop( const uint64_t &deadline );
+    template<bool PROFILE> void step_one();
+    void execute( uint8_t opcode );
+    void interrupt( uint16_t vector, bool brk );
+    //========================================================================
+    // Stack.
+    void push( uint8_t v ) { write( 0x0100 | s.sp--, v ); }
+    uint8_t pull() { return read( 0x0100 | ++s.sp ); }
+    //========================================================================
+    // Flags.
+    void set_nz( uint8_t v ) { s.p = uint8_t( (s.p & ~(FLAG_N|FLAG_Z)) | (v & FLAG_N) | (v ? 0 : FLAG_Z) ); }
+    void set_flag( uint8_t f, bool on ) { s.p = on ? (s.p | f) : (s.p & ~f); }
+    //========================================================================
+    // Addressing modes. Return the effective address.
+    uint16_t fetch16() { uint16_t v = uint16_t( read(s.pc) | (read(uint16_t(s.pc+1)) << 8) ); s.pc += 2; return v; }
+    uint16_t zp_read16( uint8_t zp ) { return uint16_t( read(zp) | (read(uint8_t(zp+1)) << 8) ); }
+    uint16_t am_zp()  { return read( s.pc++ ); }
+    uint16_t am_zpx() { return uint8_t( read( s.pc++ ) + s.x ); }
+    uint16_t am_zpy() { return uint8_t( read( s.pc++ ) + s.y ); }
+    uint16_t am_abs() { return fetch16(); }
+    uint16_t am_abx( bool penalty ) { return indexed( fetch16(), s.x, penalty ); }
+    uint16_t am_aby( bool penalty ) { return indexed( fetch16(), s.y, penalty ); }
+    uint16_t am_izx() { return zp_read16( uint8_t( read( s.pc++ ) + s.x ) ); }
+    uint16_t am_izy( bool penalty ) { return indexed( zp_read16( read( s.pc++ ) ), s.y, penalty ); }
+    uint16_t indexed( uint16_t base, uint8_t index, bool penalty )
+    {
+        uint16_t addr = uint16_t( base + index );
+        if( penalty && ((base ^ addr) & 0xFF00) ) s.cycles++;
+        return addr;
+    }
+    //========================================================================
+    // Operations.
+    void op_adc( uint8_t v );
+    void op_sbc( uint8_t v );
+    void op_cmp( uint8_t reg, uint8_t v );
+    void op_bit( uint8_t v );
+    uint8_t op_asl( uint8_t v );
+    uint8_t op_lsr( uint8_t v );
+    uint8_t op_rol( uint8_t v );
+    uint8_t op_ror( uint8_t v );
+    void branch( bool condition );
+    //------------------------------------------------------------------
+    // Read-modify-write: the 6502 writes the unmodified value first.
+    // That matters for I/O registers (e.g. "INC $D019"), not for memory.
+    template<typename OP> uint8_t rmw( uint16_t addr, OP op )
+    {
+        uint8_t v = read( addr );
+        if( write_map[addr >> 8] == nullptr ) write( addr, v );
+        v = op( v );
+        write( addr, v );
+        return v;
+    }
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // CPU6502_H
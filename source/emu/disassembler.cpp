@@ -0,0 +1,91 @@
+//========================================================================
+#include "disassembler.h"
+
+#include <cstdio>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+enum Mode { IMP, ACC, IMM, ZP, ZPX, ZPY, ABS, ABX, ABY, IND, IZX, IZY, REL };
+
+struct Opcode { const char *name; Mode mode; };
+
+static const Opcode opcodes[256] = {
+    { "BRK", IMP }, { "ORA", IZX }, { "JAM", IMP }, { "SLO", IZX }, { "NOP", ZP }, { "ORA", ZP }, { "ASL", ZP }, { "SLO", ZP },
+    { "PHP", IMP }, { "ORA", IMM }, { "ASL", ACC }, { "ANC", IMM }, { "NOP", ABS }, { "ORA", ABS }, { "ASL", ABS }, { "SLO", ABS }, // 0x00
+    { "BPL", REL }, { "ORA", IZY }, { "JAM", IMP }, { "SLO", IZY }, { "NOP", ZPX }, { "ORA", ZPX }, { "ASL", ZPX }, { "SLO", ZPX },
+    { "CLC", IMP }, { "ORA", ABY }, { "NOP", IMP }, { "SLO", ABY }, { "NOP", ABX }, { "ORA", ABX }, { "ASL", ABX }, { "SLO", ABX }, // 0x10
+    { "JSR", ABS }, { "AND", IZX }, { "JAM", IMP }, { "RLA", IZX }, { "BIT", ZP }, { "AND", ZP }, { "ROL", ZP }, { "RLA", ZP },
+    { "PLP", IMP }, { "AND", IMM }, { "ROL", ACC }, { "ANC", IMM }, { "BIT", ABS }, { "AND", ABS }, { "ROL", ABS }, { "RLA", ABS }, // 0x20
+    { "BMI", REL }, { "AND", IZY }, { "JAM", IMP }, { "RLA", IZY }, { "NOP", ZPX }, { "AND", ZPX }, { "ROL", ZPX }, { "RLA", ZPX },
+    { "SEC", IMP }, { "AND", ABY }, { "NOP", IMP }, { "RLA", ABY }, { "NOP", ABX }, { "AND", ABX }, { "ROL", ABX }, { "RLA", ABX }, // 0x30
+    { "RTI", IMP }, { "EOR", IZX }, { "JAM", IMP }, { "SRE", IZX }, { "NOP", ZP }, { "EOR", ZP }, { "LSR", ZP }, { "SRE", ZP },
+    { "PHA", IMP }, { "EOR", IMM }, { "LSR", ACC }, { "ALR", IMM }, { "JMP", ABS }, { "EOR", ABS }, { "LSR", ABS }, { "SRE", ABS }, // 0x40
+    { "BVC", REL }, { "EOR", IZY }, { "JAM", IMP }, { "SRE", IZY }, { "NOP", ZPX }, { "EOR", ZPX }, { "LSR", ZPX }, { "SRE", ZPX },
+    { "CLI", IMP }, { "EOR", ABY }, { "NOP", IMP }, { "SRE", ABY }, { "NOP", ABX }, { "EOR", ABX }, { "LSR", ABX }, { "SRE", ABX }, // 0x50
+    { "RTS", IMP }, { "ADC", IZX }, { "JAM", IMP }, { "RRA", IZX }, { "NOP", ZP }, { "ADC", ZP }, { "ROR", ZP }, { "RRA", ZP },
+    { "PLA", IMP }, { "ADC", IMM }, { "ROR", ACC }, { "ARR", IMM }, { "JMP", IND }, { "ADC", ABS }, { "ROR", ABS }, { "RRA", ABS }, // 0x60
+    { "BVS", REL }, { "ADC", IZY }, { "JAM", IMP }, { "RRA", IZY }, { "NOP", ZPX }, { "ADC", ZPX }, { "ROR", ZPX }, { "RRA", ZPX },
+    { "SEI", IMP }, { "ADC", ABY }, { "NOP", IMP }, { "RRA", ABY }, { "NOP", ABX }, { "ADC", ABX }, { "ROR", ABX }, { "RRA", ABX }, // 0x70
+    { "NOP", IMM }, { "STA", IZX }, { "NOP", IMM }, { "SAX", IZX }, { "STY", ZP }, { "STA", ZP }, { "STX", ZP }, { "SAX", ZP },
+    { "DEY", IMP }, { "NOP", IMM }, { "TXA", IMP }, { "ANE", IMM }, { "STY", ABS }, { "STA", ABS }, { "STX", ABS }, { "SAX", ABS }, // 0x80
+    { "BCC", REL }, { "STA", IZY }, { "JAM", IMP }, { "SHA", IZY }, { "STY", ZPX }, { "STA", ZPX }, { "STX", ZPY }, { "SAX", ZPY },
+    { "TYA", IMP }, { "STA", ABY }, { "TXS", IMP }, { "TAS", ABY }, { "SHY", ABX }, { "STA", ABX }, { "SHX", ABY }, { "SHA", ABY }, // 0x90
+    { "LDY", IMM }, { "LDA", IZX }, { "LDX", IMM }, { "LAX", IZX }, { "LDY", ZP }, { "LDA", ZP }, { "LDX", ZP }, { "LAX", ZP },
+    { "TAY", IMP }, { "LDA", IMM }, { "TAX", IMP }, { "LXA", IMM }, { "LDY", ABS }, { "LDA", ABS }, { "LDX", ABS }, { "LAX", ABS }, // 0xA0
+    { "BCS", REL }, { "LDA", IZY }, { "JAM", IMP }, { "LAX", IZY }, { "LDY", ZPX }, { "LDA", ZPX }, { "LDX", ZPY }, { "LAX", ZPY },
+    { "CLV", IMP }, { "LDA", ABY }, { "TSX", IMP }, { "LAS", ABY }, { "LDY", ABX }, { "LDA", ABX }, { "LDX", ABY }, { "LAX", ABY }, // 0xB0
+    { "CPY", IMM }, { "CMP", IZX }, { "NOP", IMM }, { "DCP", IZX }, { "CPY", ZP }, { "CMP", ZP }, { "DEC", ZP }, { "DCP", ZP },
+    { "INY", IMP }, { "CMP", IMM }, { "DEX", IMP }, { "SBX", IMM }, { "CPY", ABS }, { "CMP", ABS }, { "DEC", ABS }, { "DCP", ABS }, // 0xC0
+    { "BNE", REL }, { "CMP", IZY }, { "JAM", IMP }, { "DCP", IZY }, { "NOP", ZPX }, { "CMP", ZPX }, { "DEC", ZPX }, { "DCP", ZPX },
+    { "CLD", IMP }, { "CMP", ABY }, { "NOP", IMP }, { "DCP", ABY }, { "NOP", ABX }, { "CMP", ABX }, { "DEC", ABX }, { "DCP", ABX }, // 0xD0
+    { "CPX", IMM }, { "SBC", IZX }, { "NOP", IMM }, { "ISC", IZX }, { "CPX", ZP }, { "SBC", ZP }, { "INC", ZP }, { "ISC", ZP },
+    { "INX", IMP }, { "SBC", IMM }, { "NOP", IMP }, { "SBC", IMM }, { "CPX", ABS }, { "SBC", ABS }, { "INC", ABS }, { "ISC", ABS }, // 0xE0
+    { "BEQ", REL }, { "SBC", IZY }, { "JAM", IMP }, { "ISC", IZY }, { "NOP", ZPX }, { "SBC", ZPX }, { "INC", ZPX }, { "ISC", ZPX },
+    { "SED", IMP }, { "SBC", ABY }, { "NOP", IMP }, { "ISC", ABY }, { "NOP", ABX }, { "SBC", ABX }, { "INC", ABX }, { "ISC", ABX }, // 0xF0
+};
+
+//========================================================================
+int instruction_length( uint8_t opcode )
+{
+    switch( opcodes[opcode].mode )
+    {
+    case IMP: case ACC:                         return 1;
+    case ABS: case ABX: case ABY: case IND:     return 3;
+    default:                                    return 2;
+    }
+}
+
+//========================================================================
+std::string disassemble( uint16_t pc, const uint8_t bytes[3] )
+{
+    const Opcode &op = opcodes[ bytes[0] ];
+    int b = bytes[1];
+    int w = bytes[1] | (bytes[2] << 8);
+    char operand[16] = "";
+    switch( op.mode )
+    {
+    case IMP:                                                           break;
+    case ACC: std::snprintf( operand, sizeof(operand), " A" );          break;
+    case IMM: std::snprintf( operand, sizeof(operand), " #$%02X", b );  break;
+    case ZP:  std::snprintf( operand, sizeof(operand), " $%02X", b );   break;
+    case ZPX: std::snprintf( operand, sizeof(operand), " $%02X,X", b ); break;
+    case ZPY: std::snprintf( operand, sizeof(operand), " $%02X,Y", b ); break;
+    case ABS: std::snprintf( operand, sizeof(operand), " $%04X", w );   break;
+    case ABX: std::snprintf( operand, sizeof(operand), " $%04X,X", w ); break;
+    case ABY: std::snprintf( operand, sizeof(operand), " $%04X,Y", w ); break;
+    case IND: std::snprintf( operand, sizeof(operand), " ($%04X)", w ); break;
+    case IZX: std::snprintf( operand, sizeof(operand), " ($%02X,X)", b ); break;
+    case IZY: std::snprintf( operand, sizeof(operand), " ($%02X),Y", b ); break;
+    case REL: std::snprintf( operand, sizeof(operand), " $%04X", (pc + 2 + int8_t(b)) & 0xFFFF ); break;
+    }
+    return std::string( op.name ) + operand;
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,25 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstdint>
+#include <string>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// 6502 disassembler, undocumented opcodes included.
+
+//========================================================================
+// Length of the instruction starting with "opcode" (1 to 3 bytes).
+int instruction_length( uint8_t opcode );
+
+//========================================================================
+// Disassemble the instruction at "pc", "bytes" are the opcode and the
+// following two bytes, e.g. "LDA ($FB),Y". Branch targets are absolute.
+std::string disassemble( uint16_t pc, const uint8_t bytes[3] );
+
+//========================================================================
+} // End of namespace emu
+
+#endif // DISASSEMBLER_H
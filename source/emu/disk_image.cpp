@@ -0,0 +1,489 @@
+//========================================================================
+#include "disk_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// 4 bit nybble -> 5 bit GCR code, and back (0xFF = invalid code).
+static const uint8_t gcr_codes[16] = {
+    0x0A, 0x0B, 0x12, 0x13, 0x0E, 0x0F, 0x16, 0x17,
+    0x09, 0x19, 0x1A, 0x1B, 0x0D, 0x1D, 0x1E, 0x15,
+};
+static const uint8_t gcr_nybbles[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x08, 0x00, 0x01, 0xFF, 0x0C, 0x04, 0x05,
+    0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x0F, 0x06, 0x07,
+    0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0xFF,
+};
+
+//========================================================================
+// Layout of a sector on a track written by the 1541 DOS.
+constexpr int SYNC_BYTES   = 5;
+constexpr int HEADER_GCR   = 10;    // 8 bytes encoded.
+constexpr int HEADER_GAP   = 9;
+constexpr int DATA_GCR     = 325;   // 260 bytes encoded.
+constexpr int SECTOR_GCR   = SYNC_BYTES + HEADER_GCR + HEADER_GAP + SYNC_BYTES + DATA_GCR;
+constexpr uint8_t GAP_BYTE = 0x55;
+
+//========================================================================
+// Location of the BAM and directory.
+constexpr int DIR_TRACK = 18;
+
+//========================================================================
+int DiskImage::sectors_per_track( int track )
+{
+    if( track <= 17 ) return 21;
+    if( track <= 24 ) return 19;
+    if( track <= 30 ) return 18;
+    return 17;
+}
+
+//========================================================================
+int DiskImage::speed_zone( int track )
+{
+    if( track <= 17 ) return 3;
+    if( track <= 24 ) return 2;
+    if( track <= 30 ) return 1;
+    return 0;
+}
+
+//========================================================================
+int DiskImage::track_capacity( int track )
+{
+    static const int capacity[4] = { 6250, 6666, 7142, 7692 };
+    return capacity[ speed_zone( track ) ];
+}
+
+//========================================================================
+void DiskImage::gcr_encode( const uint8_t *in, uint8_t *out )
+{
+    uint64_t bits = 0;
+    for( int i = 0; i < 4; i++ )
+        bits = (bits << 10) | (gcr_codes[ in[i] >> 4 ] << 5) | gcr_codes[ in[i] & 0x0F ];
+    for( int i = 4; i >= 0; i-- )
+    {
+        out[i] = uint8_t(bits);
+        bits >>= 8;
+    }
+}
+
+//========================================================================
+bool DiskImage::gcr_decode( const uint8_t *in, uint8_t *out )
+{
+    uint64_t bits = 0;
+    for( int i = 0; i < 5; i++ )
+        bits = (bits << 8) | in[i];
+    bool ok = true;
+    for( int i = 3; i >= 0; i-- )
+    {
+        uint8_t lo = gcr_nybbles[ bits & 0x1F ];
+        uint8_t hi = gcr_nybbles[ (bits >> 5) & 0x1F ];
+        ok = ok && lo != 0xFF && hi != 0xFF;
+        out[i] = uint8_t( (hi << 4) | (lo & 0x0F) );
+        bits >>= 10;
+    }
+    return ok;
+}
+
+//========================================================================
+void DiskImage::load( const std::string &filename )
+{
+    eject();
+    try
+    {
+        image.load( filename );
+    }
+    catch( int )
+    {
+        throw std::runtime_error( "Can't read disk image: " + filename );
+    }
+    //------------------------------------------------------------------
+    const uint8_t *data = reinterpret_cast<const uint8_t*>( image.data() );
+    size_t size = image.size();
+    if( size >= 12 && std::memcmp( data, "GCR-1541", 8 ) == 0 )
+    {
+        format = Format::G64;
+        num_tracks = std::min( int(data[9]), MAX_HALFTRACKS ) / 2;
+        if( 12 + size_t(data[9]) * 8 > size )
+        {
+            eject();
+            throw std::runtime_error( "Broken G64 image: " + filename );
+        }
+        return;
+    }
+    //------------------------------------------------------------------
+    // D64: 35, 40 or 42 tracks, optionally followed by one error byte
+    // per sector (which is ignored).
+    for( int tracks_in_file : { 35, 40, 42 } )
+    {
+        size_t sectors = 0;
+        for( int t = 1; t <= tracks_in_file; t++ )
+            sectors += size_t( sectors_per_track(t) );
+        if( size == sectors * SECTOR_SIZE || size == sectors * (SECTOR_SIZE + 1) )
+        {
+            format = Format::D64;
+            num_tracks = tracks_in_file;
+            long bam = d64_offset( DIR_TRACK, 0 );
+            disk_id[0] = data[ bam + 0xA2 ];
+            disk_id[1] = data[ bam + 0xA3 ];
+            return;
+        }
+    }
+    eject();
+    throw std::runtime_error( "Not a D64 or G64 image: " + filename );
+}
+
+//========================================================================
+void DiskImage::eject()
+{
+    format = Format::NONE;
+    num_tracks = 0;
+    image = utils::Buffer();
+    for( auto &t : tracks )
+        t = Track {};
+}
+
+//========================================================================
+long DiskImage::d64_offset( int track, int sector ) const
+{
+    long offset = 0;
+    for( int t = 1; t < track; t++ )
+        offset += sectors_per_track( t );
+    return (offset + sector) * SECTOR_SIZE;
+}
+
+//========================================================================
+DiskImage::Track &DiskImage::gcr_track( int halftrack )
+{
+    halftrack = std::max( 2, std::min( halftrack, MAX_HALFTRACKS + 1 ) );
+    Track &t = tracks[ halftrack ];
+    if( t.gcr_valid )
+        return t;
+    t.gcr_valid = true;
+    //------------------------------------------------------------------
+    if( format == Format::D64 )
+    {
+        if( (halftrack & 1) == 0 )
+            encode_track( halftrack / 2, t );
+    }
+    else if( format == Format::G64 )
+    {
+        const uint8_t *data = reinterpret_cast<const uint8_t*>( image.data() );
+        int index = halftrack - 2;
+        if( index < data[9] )
+        {
+            const uint8_t *p = data + 12 + index * 4;
+            size_t offset = p[0] | (p[1] << 8) | (p[2] << 16) | (size_t(p[3]) << 24);
+            if( offset != 0 && offset + 2 <= image.size() )
+            {
+                size_t length = data[offset] | (data[offset + 1] << 8);
+                length = std::min( length, image.size() - offset - 2 );
+                t.gcr.assign( data + offset + 2, data + offset + 2 + length );
+            }
+        }
+    }
+    return t;
+}
+
+//========================================================================
+void DiskImage::mark_dirty( int halftrack )
+{
+    Track &t = tracks[ std::max( 2, std::min( halftrack, MAX_HALFTRACKS + 1 ) ) ];
+    t.gcr_dirty = true;
+    t.sectors_valid = false;
+}
+
+//========================================================================
+// Write the sectors of a D64 track as the DOS would format it:
+// header block, gap, data block, gap - and fill the rest of the track.
+void DiskImage::encode_track( int track, Track &t )
+{
+    t.gcr.clear();
+    if( track < 1 || track > num_tracks )
+        return;
+    //------------------------------------------------------------------
+    const uint8_t *data = reinterpret_cast<const uint8_t*>( image.data() );
+    int count = sectors_per_track( track );
+    int capacity = track_capacity( track );
+    int tail_gap = (capacity - count * SECTOR_GCR) / count;
+    t.gcr.reserve( size_t(capacity) );
+    auto append = [&t]( const uint8_t *raw, int size )
+    {
+        uint8_t gcr[5];
+        for( int i = 0; i < size; i += 4 )
+        {
+            gcr_encode( raw + i, gcr );
+            t.gcr.insert( t.gcr.end(), gcr, gcr + 5 );
+        }
+    };
+    //------------------------------------------------------------------
+    for( int sector = 0; sector < count; sector++ )
+    {
+        uint8_t header[8] = {
+            0x08, uint8_t( sector ^ track ^ disk_id[1] ^ disk_id[0] ), uint8_t(sector), uint8_t(track),
+            disk_id[1], disk_id[0], 0x0F, 0x0F };
+        t.gcr.insert( t.gcr.end(), SYNC_BYTES, 0xFF );
+        append( header, 8 );
+        t.gcr.insert( t.gcr.end(), HEADER_GAP, GAP_BYTE );
+        //--------------------------------------------------------------
+        uint8_t block[260];
+        block[0] = 0x07;
+        std::memcpy( block + 1, data + d64_offset( track, sector ), SECTOR_SIZE );
+        uint8_t checksum = 0;
+        for( int i = 1; i <= SECTOR_SIZE; i++ )
+            checksum ^= block[i];
+        block[257] = checksum;
+        block[258] = block[259] = 0x00;
+        t.gcr.insert( t.gcr.end(), SYNC_BYTES, 0xFF );
+        append( block, 260 );
+        t.gcr.insert( t.gcr.end(), size_t(tail_gap), GAP_BYTE );
+    }
+    t.gcr.resize( size_t(capacity), GAP_BYTE );
+}
+
+//========================================================================
+// Find the sectors in the GCR bit stream. Works on bits, so data blocks
+// don't need to be byte aligned after the sync mark (as in many G64s).
+void DiskImage::decode_track( int track, Track &t )
+{
+    int count = sectors_per_track( track );
+    t.sectors.assign( size_t(count) * SECTOR_SIZE, 0 );
+    t.sector_ok.assign( size_t(count), false );
+    t.sectors_valid = true;
+    //------------------------------------------------------------------
+    const std::vector<uint8_t> &gcr = gcr_track( track * 2 ).gcr;
+    size_t total = gcr.size() * 8;
+    if( total == 0 )
+        return;
+    auto bit = [&gcr, total]( size_t i ) { i %= total; return (gcr[i >> 3] >> (7 - (i & 7))) & 1; };
+    auto read_bytes = [&bit]( size_t pos, uint8_t *out, int n )
+    {
+        for( int i = 0; i < n; i++, pos += 8 )
+        {
+            uint8_t v = 0;
+            for( int b = 0; b < 8; b++ )
+                v = uint8_t( (v << 1) | bit( pos + size_t(b) ) );
+            out[i] = v;
+        }
+    };
+    //------------------------------------------------------------------
+    // One revolution plus a sector, so a sector across the index is found.
+    int ones = 0;
+    int sector = -1;    // Header seen, waiting for the data block.
+    for( size_t i = 0; i < total + SECTOR_GCR * 8; i++ )
+    {
+        if( bit( i ) )
+        {
+            ones++;
+            continue;
+        }
+        bool after_sync = ones >= 10;
+        ones = 0;
+        if( !after_sync )
+            continue;
+        //--------------------------------------------------------------
+        uint8_t raw_gcr[DATA_GCR];
+        uint8_t raw[260];
+        read_bytes( i, raw_gcr, 5 );
+        gcr_decode( raw_gcr, raw );
+        if( raw[0] == 0x08 )
+        {
+            read_bytes( i, raw_gcr, HEADER_GCR );
+            bool ok = gcr_decode( raw_gcr, raw ) && gcr_decode( raw_gcr + 5, raw + 4 );
+            sector = (ok && raw[3] == track && raw[2] < count) ? raw[2] : -1;
+        }
+        else if( raw[0] == 0x07 && sector >= 0 )
+        {
+            read_bytes( i, raw_gcr, DATA_GCR );
+            bool ok = true;
+            for( int g = 0; g < DATA_GCR; g += 5 )
+                ok = gcr_decode( raw_gcr + g, raw + g / 5 * 4 ) && ok;
+            uint8_t checksum = 0;
+            for( int b = 1; b <= SECTOR_SIZE; b++ )
+                checksum ^= raw[b];
+            if( ok && checksum == raw[257] && !t.sector_ok[ size_t(sector) ] )
+            {
+                std::memcpy( &t.sectors[ size_t(sector) * SECTOR_SIZE ], raw + 1, SECTOR_SIZE );
+                t.sector_ok[ size_t(sector) ] = true;
+            }
+            sector = -1;
+        }
+    }
+}
+
+//========================================================================
+bool DiskImage::read_sector( int track, int sector, uint8_t *out )
+{
+    if( track < 1 || track > num_tracks || sector < 0 || sector >= sectors_per_track( track ) )
+        return false;
+    //------------------------------------------------------------------
+    Track &t = tracks[ track * 2 ];
+    if( format == Format::D64 && !t.gcr_dirty )
+    {
+        std::memcpy( out, image.data() + d64_offset( track, sector ), SECTOR_SIZE );
+        return true;
+    }
+    if( !t.sectors_valid )
+        decode_track( track, t );
+    if( !t.sector_ok[ size_t(sector) ] )
+        return false;
+    std::memcpy( out, &t.sectors[ size_t(sector) * SECTOR_SIZE ], SECTOR_SIZE );
+    return true;
+}
+
+//========================================================================
+// Walk the directory, return the first sector of the first file whose
+// name matches.
+bool DiskImage::find_file( const std::string &pattern, int &track, int &sector )
+{
+    uint8_t block[SECTOR_SIZE];
+    int t = DIR_TRACK, s = 1;
+    for( int guard = 0; t != 0 && guard < 64; guard++ )
+    {
+        if( !read_sector( t, s, block ) )
+            return false;
+        for( int entry = 0; entry < 8; entry++ )
+        {
+            const uint8_t *e = block + entry * 32;
+            // Closed files only, no deleted entries.
+            if( (e[2] & 0x80) == 0 || (e[2] & 0x07) == 0 )
+                continue;
+            //----------------------------------------------------------
+            bool match = true;
+            size_t i = 0;
+            for( ; i < 16; i++ )
+            {
+                uint8_t c = e[5 + i];
+                if( i >= pattern.size() )       { match = (c == 0xA0); break; }
+                if( pattern[i] == '*' )         break;
+                if( c == 0xA0 )                 { match = false; break; }
+                if( pattern[i] != '?' && uint8_t(pattern[i]) != c ) { match = false; break; }
+            }
+            if( i == 16 && pattern.size() > 16 && pattern[16] != '*' )
+                match = false;
+            if( match )
+            {
+                track  = e[3];
+                sector = e[4];
+                return true;
+            }
+        }
+        t = block[0];
+        s = block[1];
+    }
+    return false;
+}
+
+//========================================================================
+bool DiskImage::load_file( const std::string &pattern, std::vector<uint8_t> &out )
+{
+    out.clear();
+    if( !inserted() )
+        return false;
+    //------------------------------------------------------------------
+    std::string name = pattern;
+    size_t colon = name.find( ':' );
+    if( colon != std::string::npos && colon <= 1 )
+        name.erase( 0, colon + 1 );
+    if( name.empty() )
+        return false;
+    if( name == "$" )
+    {
+        directory_listing( out );
+        return true;
+    }
+    //------------------------------------------------------------------
+    int t, s;
+    if( !find_file( name, t, s ) )
+        return false;
+    uint8_t block[SECTOR_SIZE];
+    for( int guard = 0; t != 0 && guard < 1024; guard++ )
+    {
+        if( !read_sector( t, s, block ) )
+            return false;
+        // The last sector tells how many of its bytes are used.
+        int used = block[0] ? SECTOR_SIZE : block[1] + 1;
+        out.insert( out.end(), block + 2, block + std::max( 2, used ) );
+        t = block[0];
+        s = block[1];
+    }
+    return true;
+}
+
+//========================================================================
+// Lines: disk name and id, one per file ("blocks, name, type"), and the
+// number of free blocks. Loads to $0401 like on the real drive.
+void DiskImage::directory_listing( std::vector<uint8_t> &out )
+{
+    out = { 0x01, 0x04 };
+    uint16_t addr = 0x0401;
+    auto add_line = [&out, &addr]( int number, const std::vector<uint8_t> &text )
+    {
+        addr = uint16_t( addr + 4 + text.size() + 1 );
+        out.push_back( uint8_t(addr) );
+        out.push_back( uint8_t(addr >> 8) );
+        out.push_back( uint8_t(number) );
+        out.push_back( uint8_t(number >> 8) );
+        out.insert( out.end(), text.begin(), text.end() );
+        out.push_back( 0 );
+    };
+    //------------------------------------------------------------------
+    uint8_t bam[SECTOR_SIZE] {};
+    read_sector( DIR_TRACK, 0, bam );
+    std::vector<uint8_t> text { 0x12, '"' };
+    for( int i = 0; i < 16; i++ )
+        text.push_back( bam[0x90 + i] == 0xA0 ? ' ' : bam[0x90 + i] );
+    text.insert( text.end(), { '"', ' ', bam[0xA2], bam[0xA3], ' ', bam[0xA5], bam[0xA6] } );
+    add_line( 0, text );
+    //------------------------------------------------------------------
+    static const char *types[8] = { "DEL", "SEQ", "PRG", "USR", "REL", "???", "???", "???" };
+    uint8_t block[SECTOR_SIZE];
+    int t = DIR_TRACK, s = 1;
+    for( int guard = 0; t != 0 && guard < 64 && read_sector( t, s, block ); guard++ )
+    {
+        for( int entry = 0; entry < 8; entry++ )
+        {
+            const uint8_t *e = block + entry * 32;
+            if( e[2] == 0 )
+                continue;
+            int blocks = e[30] | (e[31] << 8);
+            text.assign( blocks < 10 ? 3 : blocks < 100 ? 2 : 1, ' ' );
+            text.push_back( '"' );
+            int len = 0;
+            while( len < 16 && e[5 + len] != 0xA0 )
+                text.push_back( e[5 + len++] );
+            text.push_back( '"' );
+            text.insert( text.end(), size_t(16 - len), ' ' );
+            text.push_back( (e[2] & 0x80) ? ' ' : '*' );
+            const char *type = types[ e[2] & 0x07 ];
+            text.insert( text.end(), type, type + 3 );
+            if( e[2] & 0x40 )
+                text.push_back( '<' );
+            add_line( blocks, text );
+        }
+        t = block[0];
+        s = block[1];
+    }
+    //------------------------------------------------------------------
+    int free_blocks = 0;
+    for( int track = 1; track <= 35; track++ )
+        if( track != DIR_TRACK )
+            free_blocks += bam[ 4 * track ];
+    const char *blocks_free = "BLOCKS FREE.";
+    text.assign( blocks_free, blocks_free + std::strlen( blocks_free ) );
+    add_line( free_blocks, text );
+    out.push_back( 0 );
+    out.push_back( 0 );
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
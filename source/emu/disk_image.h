@@ -0,0 +1,98 @@
+#ifndef DISK_IMAGE_H
+#define DISK_IMAGE_H
+
+#include "utils.h"
+
+#include <cstdint>
+#include <array>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// A 1541 disk: D64 (sector dump) or G64 (raw GCR tracks) image.
+//
+// The image file stays in a utils::Buffer as it was loaded. Each side
+// gets what it needs on demand, one track at a time, and keeps it:
+// - The drive mechanics read GCR bytes. For a D64, a track is GCR
+//   encoded the first time the head moves onto it.
+// - The fast loader and the directory code read sectors. For a G64, or
+//   a D64 track the drive has written to, the track is decoded once.
+// Writes of the drive go into the cached GCR track. (They are not
+// written back to the file.)
+class DiskImage
+{
+public:
+    //========================================================================
+    static constexpr int MAX_TRACKS     = 42;
+    static constexpr int MAX_HALFTRACKS = MAX_TRACKS * 2;
+    static constexpr int SECTOR_SIZE    = 256;
+    //========================================================================
+    enum class Format { NONE, D64, G64 };
+    //========================================================================
+    struct Track
+    {
+        std::vector<uint8_t> gcr;       // Raw track data, empty if unformatted.
+        bool gcr_valid {false};
+        bool gcr_dirty {false};         // Written to by the drive.
+        std::vector<uint8_t> sectors;   // Decoded data, SECTOR_SIZE per sector.
+        std::vector<bool> sector_ok;
+        bool sectors_valid {false};
+    };
+    //========================================================================
+    DiskImage() = default;
+    NO_COPY( DiskImage );
+    //========================================================================
+    // Throws std::runtime_error if the file can't be read or isn't a
+    // D64/G64 image.
+    void load( const std::string &filename );
+    void eject();
+    bool inserted() const { return format != Format::NONE; }
+    //========================================================================
+    // Raw GCR data of a half track (2 = track 1, 3 = track 1.5, ...).
+    // The returned track may be written to, call mark_dirty() then.
+    Track &gcr_track( int halftrack );
+    void mark_dirty( int halftrack );
+    //========================================================================
+    // Read a sector (tracks count from 1). Returns false if the sector
+    // doesn't exist or can't be decoded.
+    bool read_sector( int track, int sector, uint8_t *out );
+    //========================================================================
+    // The contents of a file, including the two byte load address.
+    // "pattern" is PETSCII and may contain '*' and '?' wildcards, a
+    // leading "0:" is ignored. Returns false if there is no such file.
+    bool load_file( const std::string &pattern, std::vector<uint8_t> &out );
+    // The directory as the BASIC program the drive sends for LOAD"$".
+    void directory_listing( std::vector<uint8_t> &out );
+    //========================================================================
+    static int sectors_per_track( int track );
+    // Number of GCR bytes that fit on a track at its standard density.
+    static int track_capacity( int track );
+    // Speed zone (0-3) the DOS uses for a track.
+    static int speed_zone( int track );
+    //========================================================================
+    // GCR encoding of 4 bytes into 5 and back. decode returns false if
+    // there is an invalid GCR code.
+    static void gcr_encode( const uint8_t *in, uint8_t *out );
+    static bool gcr_decode( const uint8_t *in, uint8_t *out );
+
+private:
+    //========================================================================
+    utils::Buffer image;
+    Format format {Format::NONE};
+    int num_tracks {0};
+    std::array<Track, MAX_HALFTRACKS + 2> tracks;
+    uint8_t disk_id[2] {};
+    //========================================================================
+    long d64_offset( int track, int sector ) const;
+    void encode_track( int track, Track &t );
+    void decode_track( int track, Track &t );
+    bool find_file( const std::string &pattern, int &track, int &sector );
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // DISK_IMAGE_H
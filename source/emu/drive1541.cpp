@@ -0,0 +1,350 @@
+//========================================================================
+#include "drive1541.h"
+#include "sid.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+void Drive1541::init()
+{
+    auto image { utils::RM.load( "roms/1541" ) };
+    if( image.size() != rom.size() )
+    {
+        throw std::runtime_error( "ROM has the wrong size: 1541" );
+    }
+    std::memcpy( rom.data(), image.data(), rom.size() );
+    //------------------------------------------------------------------
+    // Only patch the idle loop if the ROM is the one we expect there.
+    uint8_t *idle = &rom[ IDLE_TRAP - 0xC000 ];
+    idle_trap = idle[0] == 0x4C && idle[1] == (IDLE_CONTINUE & 0xFF) && idle[2] == (IDLE_CONTINUE >> 8);
+    if( idle_trap )
+        idle[0] = CPU6502::TRAP_OPCODE;
+    //------------------------------------------------------------------
+    // Memory map: RAM mirrored below $1800, the VIAs at $1800 and $1C00
+    // (both mirrored in every 8K block below $8000), the ROM at $C000
+    // and mirrored at $8000.
+    cpu.init( this );
+    for( int page = 0; page < 256; page++ )
+    {
+        int block = page & 0x1F;
+        if( page >= 0x80 )
+        {
+            cpu.read_map[page]  = &rom[ (page & 0x3F) << 8 ];
+            cpu.write_map[page] = nullptr;
+        }
+        else if( block < 0x18 )
+        {
+            cpu.read_map[page]  = &ram[ (block & 0x07) << 8 ];
+            cpu.write_map[page] = &ram[ (block & 0x07) << 8 ];
+        }
+        else
+        {
+            cpu.read_map[page]  = nullptr;
+            cpu.write_map[page] = nullptr;
+        }
+    }
+    //------------------------------------------------------------------
+    scheduler.clear();
+    via1.init( 0, scheduler, cpu.s.cycles, *this,
+               [](void *d, bool on) { static_cast<Drive1541*>(d)->cpu.set_irq( IRQ_VIA1, on ); }, this );
+    via2.init( 1, scheduler, cpu.s.cycles, *this,
+               [](void *d, bool on) { static_cast<Drive1541*>(d)->cpu.set_irq( IRQ_VIA2, on ); }, this );
+    byte_slot = scheduler.add_slot( this, EV_BYTE );
+    ready = true;
+}
+
+//========================================================================
+uint64_t Drive1541::host_to_drive( uint64_t host_cycles )
+{
+    return uint64_t( host_cycles * uint64_t(CLOCK) / uint64_t(sound::PAL_CLOCK) );
+}
+
+//========================================================================
+void Drive1541::reset( uint64_t host_cycles )
+{
+    if( !ready )
+        return;
+    //------------------------------------------------------------------
+    // The head stays where it is.
+    int halftrack = state.halftrack;
+    bool atn = state.host_atn, clk = state.host_clk, data = state.host_data;
+    uint64_t idle = state.idle_cycles;
+    state = State {};
+    state.halftrack = halftrack;
+    state.host_atn = atn;
+    state.host_clk = clk;
+    state.host_data = data;
+    state.idle_cycles = idle;
+    //------------------------------------------------------------------
+    cpu.s.cycles = std::max( cpu.s.cycles, host_to_drive( host_cycles ) );
+    state.rot_time = cpu.s.cycles;
+    head_track = &disk.gcr_track( state.halftrack );
+    via1.reset();
+    via2.reset();
+    via1.set_ca1( state.host_atn );
+    scheduler.cancel( byte_slot );
+    cpu.reset();
+}
+
+//========================================================================
+void Drive1541::save_state( Snapshot &snap ) const
+{
+    snap.state     = state;
+    snap.cpu       = cpu.s;
+    snap.scheduler = scheduler.state;
+    snap.via1      = via1.state;
+    snap.via2      = via2.state;
+    snap.ram       = ram;
+}
+
+//========================================================================
+void Drive1541::load_state( const Snapshot &snap )
+{
+    state           = snap.state;
+    cpu.s           = snap.cpu;
+    scheduler.state = snap.scheduler;
+    via1.state      = snap.via1;
+    via2.state      = snap.via2;
+    ram             = snap.ram;
+    head_track      = &disk.gcr_track( state.halftrack );
+}
+
+//========================================================================
+void Drive1541::insert_disk( const std::string &filename )
+{
+    disk.load( filename );
+    if( ready )
+    {
+        head_track = &disk.gcr_track( state.halftrack );
+        state.rot_pos = 0;
+        update_rotation();
+    }
+}
+
+//========================================================================
+void Drive1541::eject_disk()
+{
+    disk.eject();
+    if( ready )
+    {
+        head_track = &disk.gcr_track( state.halftrack );
+        update_rotation();
+    }
+}
+
+//========================================================================
+void Drive1541::run_until_host( uint64_t host_cycles )
+{
+    if( !ready )
+        return;
+    uint64_t target = host_to_drive( host_cycles );
+    scheduler.set_limit( target );
+    while( cpu.s.cycles < target )
+    {
+        cpu.run( scheduler.deadline() );
+        scheduler.dispatch( cpu.s.cycles );
+    }
+}
+
+//========================================================================
+void Drive1541::set_host_lines( bool atn, bool clk, bool data )
+{
+    state.host_atn  = atn;
+    state.host_clk  = clk;
+    state.host_data = data;
+    // ATN IN is also wired to CA1, its edge interrupts the drive.
+    via1.set_ca1( atn );
+}
+
+//========================================================================
+// The idle loop: jump back to its start, and if nothing can happen
+// before the next event, fast forward to it.
+bool Drive1541::trap( uint16_t pc )
+{
+    if( !idle_trap || pc != IDLE_TRAP )
+        return false;
+    cpu.s.pc = IDLE_CONTINUE;
+    cpu.s.cycles += 3;
+    if( !state.host_atn && scheduler.deadline() > cpu.s.cycles )
+    {
+        state.idle_cycles += scheduler.deadline() - cpu.s.cycles;
+        cpu.s.cycles = scheduler.deadline();
+    }
+    return true;
+}
+
+//========================================================================
+uint8_t Drive1541::io_read( uint16_t addr )
+{
+    switch( addr & 0x1C00 )
+    {
+    case 0x1800: return via1.read( uint8_t(addr) );
+    case 0x1C00: return via2.read( uint8_t(addr) );
+    }
+    return 0xFF;
+}
+
+//========================================================================
+void Drive1541::io_write( uint16_t addr, uint8_t value )
+{
+    if( addr >= 0x8000 )
+        return; // ROM.
+    switch( addr & 0x1C00 )
+    {
+    case 0x1800: via1.write( uint8_t(addr), value ); break;
+    case 0x1C00: via2.write( uint8_t(addr), value ); break;
+    }
+}
+
+//========================================================================
+uint8_t Drive1541::via_read( int via, int port, uint8_t output )
+{
+    if( via == 0 )
+    {
+        //--------------------------------------------------------------
+        // VIA1 port B: bus inputs (inverted by the line receivers), the
+        // device number jumpers on PB5-6 select device 8.
+        if( port == 1 )
+            return uint8_t( (output & 0x1A) | (data_line() ? 0x01 : 0) |
+                            (clk_line() ? 0x04 : 0) | (state.host_atn ? 0x80 : 0) );
+        return output;
+    }
+    //------------------------------------------------------------------
+    // VIA2: port A is the data from the disk, port B has the SYNC
+    // signal (PB7, low active) and write protect (PB4, high = writable).
+    if( port == 0 )
+        return state.data_latch;
+    advance( cpu.s.cycles );
+    return uint8_t( (output & 0x6F) | 0x10 | (sync( state.rot_pos + 1 ) ? 0x00 : 0x80) );
+}
+
+//========================================================================
+void Drive1541::via_write( int via, int port, uint8_t output )
+{
+    // The bus lines are derived from the VIA1 outputs when read.
+    if( via != 1 || port != 1 )
+        return;
+    //------------------------------------------------------------------
+    // VIA2 port B: stepper (PB0-1), motor (PB2), density (PB5-6).
+    advance( cpu.s.cycles );
+    step_head( output & 0x03 );
+    state.motor = (output & 0x04) != 0;
+    scheduler.cancel( byte_slot );
+    update_rotation();
+}
+
+//========================================================================
+// Let the disk turn up to "now".
+void Drive1541::advance( uint64_t now )
+{
+    if( now <= state.rot_time )
+        return;
+    int cpb = cycles_per_byte();
+    uint64_t bytes = (now - state.rot_time) / uint64_t(cpb);
+    if( !state.motor )
+    {
+        state.rot_time = now;
+        return;
+    }
+    size_t length = head_track->gcr.size();
+    if( length )
+        state.rot_pos = size_t( (state.rot_pos + bytes) % length );
+    state.rot_time += bytes * uint64_t(cpb);
+}
+
+//========================================================================
+// The byte ready events run while the motor turns and there is data.
+void Drive1541::update_rotation()
+{
+    if( state.motor && !head_track->gcr.empty() )
+    {
+        if( scheduler.pending( byte_slot ) == Scheduler::NEVER )
+            scheduler.schedule( byte_slot, state.rot_time + uint64_t( cycles_per_byte() ) );
+    }
+    else
+        scheduler.cancel( byte_slot );
+}
+
+//========================================================================
+// The stepper motor moves the head half a track per phase.
+void Drive1541::step_head( uint8_t phase )
+{
+    int step = 0;
+    if( phase == ((state.stepper + 1) & 3) ) step = 1;
+    if( phase == ((state.stepper - 1) & 3) ) step = -1;
+    state.stepper = phase;
+    int halftrack = std::max( 2, std::min( state.halftrack + step, DiskImage::MAX_HALFTRACKS + 1 ) );
+    if( halftrack == state.halftrack )
+        return;
+    //------------------------------------------------------------------
+    // Keep the angular position on the new track.
+    size_t old_length = head_track->gcr.size();
+    state.halftrack = halftrack;
+    head_track = &disk.gcr_track( halftrack );
+    size_t new_length = head_track->gcr.size();
+    state.rot_pos = (old_length && new_length) ? state.rot_pos * new_length / old_length : 0;
+}
+
+//========================================================================
+// SYNC: a run of 1 bits, i.e. two 0xFF bytes in a row. "pos" is the
+// byte under the head; SYNC ends with the first 0 bit after the run,
+// so the byte after a sync mark is read normally.
+bool Drive1541::sync( size_t pos ) const
+{
+    const std::vector<uint8_t> &gcr = head_track->gcr;
+    if( !state.motor || gcr.empty() || !via2.cb2() )
+        return false;
+    pos %= gcr.size();
+    size_t prev = pos ? pos - 1 : gcr.size() - 1;
+    return gcr[ pos ] == 0xFF && gcr[ prev ] == 0xFF;
+}
+
+//========================================================================
+void Drive1541::on_event( int tag, uint64_t time )
+{
+    (void)tag;
+    advance( time );
+    byte_ready( time );
+    update_rotation();
+}
+
+//========================================================================
+// A byte passed the head: read it (or write the one in port A), and
+// signal BYTE READY on the SO pin and CA1 unless the head is in a sync.
+void Drive1541::byte_ready( uint64_t time )
+{
+    std::vector<uint8_t> &gcr = head_track->gcr;
+    scheduler.schedule( byte_slot, time + uint64_t( cycles_per_byte() ) );
+    //------------------------------------------------------------------
+    if( !via2.cb2() )
+    {
+        // CB2 low: write mode.
+        gcr[ state.rot_pos ] = via2.port_a();
+        disk.mark_dirty( state.halftrack );
+    }
+    else if( sync( state.rot_pos ) )
+    {
+        state.data_latch = 0xFF;
+        return;
+    }
+    else
+        state.data_latch = gcr[ state.rot_pos ];
+    //------------------------------------------------------------------
+    // CA2 is the byte ready enable (SOE).
+    if( via2.ca2() )
+        cpu.set_overflow();
+    via2.set_ca1( true );
+    via2.set_ca1( false );
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,145 @@
+#ifndef DRIVE1541_H
+#define DRIVE1541_H
+
+#include "cpu6502.h"
+#include "scheduler.h"
+#include "via.h"
+#include "disk_image.h"
+#include "utils.h"
+
+#include <cstdint>
+#include <array>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// The 1541 floppy drive: its own 6502, 2K RAM, DOS ROM, two VIAs and the
+// disk mechanics. VIA1 is the serial (IEC) bus, VIA2 the disk controller.
+//
+// The drive has its own clock (1 MHz) and Scheduler. It doesn't run in
+// lockstep with the C64: the C64 lets it catch up before every access
+// to the serial bus and at the end of each run, which is exact because
+// the two only see each other through the bus lines.
+//
+// The disk is a lazily GCR encoded DiskImage. Its rotation is computed
+// from the clock; "byte ready" is an event every 26-32 cycles, only
+// while the motor runs.
+//
+// Sleeping: the DOS idle loop is patched with a trap. When the drive
+// reaches it and ATN is not asserted, it skips straight to its next
+// event (usually the job loop interrupt) instead of executing the loop.
+class Drive1541 : public Bus, public VIAPorts, public EventHandler
+{
+public:
+    //========================================================================
+    static constexpr double CLOCK = 1000000.0;
+    //========================================================================
+    Drive1541() = default;
+    NO_COPY( Drive1541 );
+    NO_MOVE( Drive1541 );
+    virtual ~Drive1541() = default;
+    //========================================================================
+    // Load the DOS ROM (roms/1541, 16K) and wire the chips.
+    // Throws std::runtime_error if the ROM isn't there.
+    void init();
+    bool initialized() const { return ready; }
+    // Reset. "host_cycles" is the current C64 cycle, the drive clock is
+    // kept in step with it from here on.
+    void reset( uint64_t host_cycles );
+    //========================================================================
+    // Insert an image (throws like DiskImage::load) or remove it.
+    void insert_disk( const std::string &filename );
+    void eject_disk();
+    //========================================================================
+    // Run the drive up to the given C64 cycle.
+    void run_until_host( uint64_t host_cycles );
+    //========================================================================
+    // Serial bus. Lines are true when pulled low (asserted).
+    void set_host_lines( bool atn, bool clk, bool data );
+    bool clk_line() const  { return state.host_clk || (via1.port_b() & 0x08); }
+    bool data_line() const
+    {
+        // The drive acknowledges ATN in hardware: DATA is pulled while
+        // ATN and the ATNA output (PB4) disagree.
+        bool atna = (via1.port_b() & 0x10) != 0;
+        return state.host_data || (via1.port_b() & 0x02) || (state.host_atn != atna);
+    }
+    //========================================================================
+    bool motor_on() const { return (via2.port_b() & 0x04) != 0; }
+    bool led_on() const   { return (via2.port_b() & 0x08) != 0; }
+    int  track() const    { return state.halftrack / 2; }
+    // Drive cycles skipped in the idle loop, and cycles run in total.
+    uint64_t idle_cycles() const  { return state.idle_cycles; }
+    uint64_t total_cycles() const { return cpu.s.cycles; }
+    //========================================================================
+    DiskImage disk;
+    //------------------------------------------------------------------
+    CPU6502   cpu;
+    Scheduler scheduler;
+    VIA       via1, via2;
+    std::array<uint8_t, 0x0800> ram {};
+    std::array<uint8_t, 0x4000> rom {};
+    //========================================================================
+    struct State
+    {
+        int      halftrack {36};        // Track 18.
+        uint8_t  stepper {0};           // Phase of the stepper motor (PB0-1).
+        bool     motor {false};
+        size_t   rot_pos {0};           // Byte that passed the head at rot_time.
+        uint64_t rot_time {0};
+        uint8_t  data_latch {0};        // Last byte read, VIA2 port A.
+        bool     host_atn {false}, host_clk {false}, host_data {false};
+        uint64_t idle_cycles {0};
+    };
+    State state;
+    //========================================================================
+    // Everything that changes while the drive runs. (Not the disk.)
+    struct Snapshot
+    {
+        State state;
+        CPU6502::State cpu;
+        Scheduler::State scheduler;
+        VIA::State via1, via2;
+        std::array<uint8_t, 0x0800> ram;
+    };
+    void save_state( Snapshot &snap ) const;
+    void load_state( const Snapshot &snap );
+    //========================================================================
+    // Bus
+    uint8_t io_read ( uint16_t addr ) override;
+    void    io_write( uint16_t addr, uint8_t value ) override;
+    bool    trap( uint16_t pc ) override;
+    //========================================================================
+    // VIAPorts
+    uint8_t via_read ( int via, int port, uint8_t output ) override;
+    void    via_write( int via, int port, uint8_t output ) override;
+    //========================================================================
+    void on_event( int tag, uint64_t time ) override;
+
+private:
+    //========================================================================
+    enum : uint8_t { IRQ_VIA1 = 0x01, IRQ_VIA2 = 0x02 };
+    enum { EV_BYTE };
+    // The DOS idle loop ends with "JMP $EBFF" at $EC9B.
+    static constexpr uint16_t IDLE_TRAP     = 0xEC9B;
+    static constexpr uint16_t IDLE_CONTINUE = 0xEBFF;
+    //========================================================================
+    bool ready {false};
+    bool idle_trap {false};
+    int byte_slot {0};
+    DiskImage::Track *head_track {nullptr};
+    //========================================================================
+    static uint64_t host_to_drive( uint64_t host_cycles );
+    int  cycles_per_byte() const { return 32 - 2 * ((via2.port_b() >> 5) & 3); }
+    void advance( uint64_t now );
+    void update_rotation();
+    void step_head( uint8_t phase );
+    bool sync( size_t pos ) const;
+    void byte_ready( uint64_t time );
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // DRIVE1541_H
@@ -0,0 +1,461 @@
+//========================================================================
+#include "monitor.h"
+#include "disassembler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+static const char *help_text =
+    "r                        Registers and the next instruction.\n"
+    "m [from [to]]            Memory dump.\n"
+    "d [from [to]]            Disassemble.\n"
+    "> addr byte...           Write memory.\n"
+    "break [addr]             Set a breakpoint, or list them.\n"
+    "watch [r|w|rw] from [to] Stop on reads and/or writes (default: w).\n"
+    "delete addr|all          Delete breakpoints and watchpoints.\n"
+    "list                     Breakpoints and watchpoints.\n"
+    "g [addr]                 Go on (at addr).\n"
+    "step [n]                 Execute n instructions (default: 1).\n"
+    "stop                     Stop the machine.\n"
+    "trace on|off             Record the executed instructions.\n"
+    "trace save <file>        Save the trace for offline decoding.\n"
+    "trace show [n]           The last n traced instructions (default: 20).\n"
+    "Numbers are hex, '$' is optional.\n";
+
+//========================================================================
+static std::string hex( unsigned value, int digits )
+{
+    char text[8];
+    std::snprintf( text, sizeof(text), "%0*X", digits, value );
+    return text;
+}
+
+//========================================================================
+static bool parse_hex( const std::string &text, unsigned &value )
+{
+    std::string t = (!text.empty() && text[0] == '$') ? text.substr( 1 ) : text;
+    if( t.empty() || t.size() > 4 || t.find_first_not_of( "0123456789abcdefABCDEF" ) != std::string::npos )
+        return false;
+    value = unsigned( std::stoul( t, nullptr, 16 ) );
+    return true;
+}
+
+//========================================================================
+void Monitor::attach( C64 &c64 )
+{
+    detach();
+    m_C64 = &c64;
+    m_NextCode = c64.cpu.s.pc;
+    update_pages();
+}
+
+//========================================================================
+void Monitor::detach()
+{
+    if( !m_C64 )
+        return;
+    m_C64->resume();
+    m_C64->attach_monitor( nullptr );
+    m_C64 = nullptr;
+}
+
+//========================================================================
+void Monitor::add_breakpoint( uint16_t addr )
+{
+    if( !break_at[addr] )
+        breakpoints.push_back( addr );
+    update_bits();
+}
+
+//========================================================================
+void Monitor::add_watchpoint( uint16_t first, uint16_t last, uint8_t kinds )
+{
+    watches.push_back( { first, std::max( first, last ), kinds } );
+    update_bits();
+}
+
+//========================================================================
+int Monitor::remove( uint16_t addr )
+{
+    size_t before = breakpoints.size() + watches.size();
+    breakpoints.erase( std::remove( breakpoints.begin(), breakpoints.end(), addr ), breakpoints.end() );
+    watches.erase( std::remove_if( watches.begin(), watches.end(),
+                                   [addr]( const Watch &w ) { return w.first == addr; } ),
+                   watches.end() );
+    update_bits();
+    return int( before - breakpoints.size() - watches.size() );
+}
+
+//========================================================================
+void Monitor::remove_all()
+{
+    breakpoints.clear();
+    watches.clear();
+    update_bits();
+}
+
+//========================================================================
+void Monitor::update_bits()
+{
+    break_at.reset();
+    watch_read.reset();
+    watch_write.reset();
+    for( uint16_t addr : breakpoints )
+        break_at[addr] = true;
+    for( const auto &w : watches )
+        for( unsigned a = w.first; a <= w.last; a++ )
+        {
+            if( w.kinds & WATCH_READ )  watch_read[a] = true;
+            if( w.kinds & WATCH_WRITE ) watch_write[a] = true;
+        }
+    update_pages();
+}
+
+//========================================================================
+// Mark the pages the hooks need to see, and have the C64 unmap them.
+void Monitor::update_pages()
+{
+    pages.fill( (m_Trace || m_Steps >= 0) ? PAGE_FETCH : 0 );
+    for( uint16_t addr : breakpoints )
+        pages[addr >> 8] |= PAGE_FETCH;
+    for( const auto &w : watches )
+        for( unsigned page = w.first >> 8; page <= unsigned( w.last >> 8 ); page++ )
+        {
+            if( w.kinds & WATCH_READ )  pages[page] |= PAGE_READ;
+            if( w.kinds & WATCH_WRITE ) pages[page] |= PAGE_WRITE;
+        }
+    if( m_C64 )
+        m_C64->attach_monitor( this );
+}
+
+//========================================================================
+void Monitor::stop( const std::string &reason )
+{
+    if( !m_C64 )
+        return;
+    m_Event = reason;
+    m_NextCode = m_C64->cpu.s.pc;
+    if( m_Steps >= 0 )
+    {
+        m_Steps = -1;
+        update_pages();
+    }
+    m_C64->request_break();
+}
+
+//========================================================================
+void Monitor::go()
+{
+    if( !m_C64 )
+        return;
+    m_ResumePc = m_C64->cpu.s.pc;
+    m_C64->resume();
+}
+
+//========================================================================
+void Monitor::step( int count )
+{
+    m_Steps = std::max( count, 1 );
+    update_pages();
+    go();
+}
+
+//========================================================================
+std::string Monitor::take_event()
+{
+    std::string event;
+    event.swap( m_Event );
+    return event;
+}
+
+//========================================================================
+void Monitor::set_trace( bool on )
+{
+    if( on && m_TraceRing.capacity() < TRACE_RECORDS )
+        m_TraceRing.init( TRACE_RECORDS );
+    m_Trace = on;
+    update_pages();
+}
+
+//========================================================================
+bool Monitor::on_fetch( uint16_t pc )
+{
+    bool resumed = (pc == m_ResumePc);
+    m_ResumePc = -1;
+    if( m_Steps == 0 )
+    {
+        stop( "Step" );
+        m_BreakPending = true;
+        return true;
+    }
+    if( m_Steps > 0 )
+        m_Steps--;
+    if( break_at[pc] && !resumed )
+    {
+        stop( "Breakpoint at $" + hex( pc, 4 ) );
+        m_BreakPending = true;
+        return true;
+    }
+    if( m_Trace )
+        record( pc );
+    return false;
+}
+
+//========================================================================
+bool Monitor::on_trap( uint16_t pc )
+{
+    (void)pc;
+    bool pending = m_BreakPending;
+    m_BreakPending = false;
+    return pending;
+}
+
+//========================================================================
+void Monitor::watch_hit( uint16_t addr, bool write, uint8_t value )
+{
+    if( m_C64->break_requested() )
+        return;
+    stop( write ? "Watchpoint: write $" + hex( addr, 4 ) + " = $" + hex( value, 2 )
+                : "Watchpoint: read $" + hex( addr, 4 ) );
+}
+
+//========================================================================
+void Monitor::record( uint16_t pc )
+{
+    const auto &s = m_C64->cpu.s;
+    TraceRecord r;
+    r.cycle = uint32_t( s.cycles );
+    r.pc    = pc;
+    for( int i = 0; i < 3; i++ )
+        r.bytes[i] = m_C64->peek( uint16_t( pc + i ) );
+    r.a = s.a; r.x = s.x; r.y = s.y; r.sp = s.sp; r.p = s.p;
+    m_TraceRing.push( r );
+}
+
+//========================================================================
+std::string Monitor::registers() const
+{
+    const auto &s = m_C64->cpu.s;
+    std::string flags;
+    for( int bit = 7; bit >= 0; bit-- )
+        flags += (s.p & (1 << bit)) ? "NV-BDIZC"[7 - bit] : '.';
+    return "PC:" + hex( s.pc, 4 ) + " A:" + hex( s.a, 2 ) + " X:" + hex( s.x, 2 )
+         + " Y:" + hex( s.y, 2 ) + " SP:" + hex( s.sp, 2 ) + " " + flags
+         + " Cycle:" + std::to_string( s.cycles ) + "\n";
+}
+
+//========================================================================
+std::string Monitor::memory( uint16_t from, uint16_t to )
+{
+    std::string out;
+    unsigned addr = from;
+    while( addr <= to )
+    {
+        std::string bytes, text;
+        out += ":" + hex( addr, 4 ) + " ";
+        for( int i = 0; i < 16 && addr <= to; i++, addr++ )
+        {
+            uint8_t b = m_C64->peek( uint16_t( addr ) );
+            bytes += " " + hex( b, 2 );
+            text += (b >= 0x20 && b < 0x7F) ? char( b ) : '.';
+        }
+        out += bytes + std::string( 16 * 3 - bytes.size() + 2, ' ' ) + text + "\n";
+    }
+    m_NextMemory = uint16_t( addr );
+    return out;
+}
+
+//========================================================================
+// "count" instructions, or up to "to" if that is not negative.
+std::string Monitor::code( uint16_t from, int count, int to )
+{
+    std::string out;
+    unsigned addr = from;
+    for( int n = 0; to >= 0 ? addr <= unsigned( to ) : n < count; n++ )
+    {
+        uint8_t bytes[3];
+        for( int i = 0; i < 3; i++ )
+            bytes[i] = m_C64->peek( uint16_t( addr + i ) );
+        int length = instruction_length( bytes[0] );
+        std::string raw;
+        for( int i = 0; i < 3; i++ )
+            raw += i < length ? hex( bytes[i], 2 ) + " " : "   ";
+        out += (addr == m_C64->cpu.s.pc ? ">" : ".") + hex( addr, 4 ) + "  " + raw
+             + (break_at[addr] ? "* " : "  ") + disassemble( uint16_t( addr ), bytes ) + "\n";
+        addr += unsigned( length );
+        if( addr > 0xFFFF )
+            break;
+    }
+    m_NextCode = uint16_t( addr );
+    return out;
+}
+
+//========================================================================
+std::string Monitor::list() const
+{
+    std::string out;
+    for( uint16_t addr : breakpoints )
+        out += "break $" + hex( addr, 4 ) + "\n";
+    for( const auto &w : watches )
+        out += std::string( "watch " ) + ((w.kinds & WATCH_READ) ? "r" : "") + ((w.kinds & WATCH_WRITE) ? "w" : "")
+             + " $" + hex( w.first, 4 ) + (w.last != w.first ? "-$" + hex( w.last, 4 ) : "") + "\n";
+    if( m_Trace )
+        out += "trace on (" + std::to_string( m_TraceRing.pushed() ) + " instructions)\n";
+    return out.empty() ? "No breakpoints or watchpoints.\n" : out;
+}
+
+//========================================================================
+std::string Monitor::command( const std::string &line )
+{
+    if( !m_C64 )
+        return "No machine attached.\n";
+    std::istringstream in( line );
+    std::vector<std::string> args;
+    for( std::string word; in >> word; )
+        args.push_back( word );
+    if( args.empty() )
+        return "";
+    const std::string &cmd = args[0];
+    //------------------------------------------------------------------
+    // Up to three numbers after the command.
+    unsigned num[3] {};
+    size_t nums = 0;
+    while( nums < 3 && nums + 1 < args.size() && parse_hex( args[nums + 1], num[nums] ) )
+        nums++;
+    //------------------------------------------------------------------
+    if( cmd == "help" || cmd == "?" )
+        return help_text;
+    if( cmd == "r" )
+        return registers() + code( m_C64->cpu.s.pc, 1, -1 );
+    if( cmd == "m" )
+    {
+        uint16_t from = nums > 0 ? uint16_t( num[0] ) : m_NextMemory;
+        uint16_t to   = nums > 1 ? uint16_t( num[1] ) : uint16_t( std::min( 0xFFFF, from + 0x7F ) );
+        return memory( from, std::max( from, to ) );
+    }
+    if( cmd == "d" )
+        return code( nums > 0 ? uint16_t( num[0] ) : m_NextCode, 20, nums > 1 ? int( num[1] ) : -1 );
+    if( cmd == ">" )
+    {
+        if( nums == 0 )
+            return "Usage: > addr byte...\n";
+        unsigned addr = num[0];
+        for( size_t i = 2; i < args.size(); i++, addr++ )
+        {
+            unsigned value;
+            if( !parse_hex( args[i], value ) || value > 0xFF )
+                return "Not a byte: " + args[i] + "\n";
+            m_C64->cpu.write( uint16_t( addr ), uint8_t( value ) );
+        }
+        return "";
+    }
+    //------------------------------------------------------------------
+    if( cmd == "break" )
+    {
+        if( nums == 0 )
+            return list();
+        add_breakpoint( uint16_t( num[0] ) );
+        return "";
+    }
+    if( cmd == "watch" )
+    {
+        uint8_t kinds = WATCH_WRITE;
+        size_t first = 1;
+        if( args.size() > 1 && (args[1] == "r" || args[1] == "w" || args[1] == "rw") )
+        {
+            kinds = uint8_t( (args[1].find( 'r' ) != std::string::npos ? WATCH_READ : 0)
+                           | (args[1].find( 'w' ) != std::string::npos ? WATCH_WRITE : 0) );
+            first = 2;
+        }
+        unsigned range[2] {};
+        size_t n = 0;
+        while( n < 2 && first + n < args.size() && parse_hex( args[first + n], range[n] ) )
+            n++;
+        if( n == 0 )
+            return "Usage: watch [r|w|rw] from [to]\n";
+        add_watchpoint( uint16_t( range[0] ), uint16_t( n > 1 ? range[1] : range[0] ), kinds );
+        return "";
+    }
+    if( cmd == "delete" )
+    {
+        if( args.size() > 1 && args[1] == "all" )
+        {
+            remove_all();
+            return "";
+        }
+        if( nums == 0 )
+            return "Usage: delete addr|all\n";
+        return remove( uint16_t( num[0] ) ) ? "" : "Nothing at $" + hex( num[0], 4 ) + ".\n";
+    }
+    if( cmd == "list" )
+        return list();
+    //------------------------------------------------------------------
+    if( cmd == "g" )
+    {
+        if( nums > 0 )
+            m_C64->cpu.s.pc = uint16_t( num[0] );
+        go();
+        return "";
+    }
+    if( cmd == "step" || cmd == "z" )
+    {
+        step( nums > 0 ? int( num[0] ) : 1 );
+        return "";
+    }
+    if( cmd == "stop" )
+    {
+        if( !stopped() )
+            stop( "Stopped" );
+        return "";
+    }
+    //------------------------------------------------------------------
+    if( cmd == "trace" && args.size() > 1 )
+    {
+        if( args[1] == "on" || args[1] == "off" )
+        {
+            set_trace( args[1] == "on" );
+            return "";
+        }
+        if( args[1] == "save" && args.size() > 2 )
+        {
+            try
+            {
+                m_TraceRing.save( args[2] );
+            }
+            catch( const std::runtime_error &e )
+            {
+                return std::string( e.what() ) + "\n";
+            }
+            return "Saved " + std::to_string( std::min( m_TraceRing.pushed(), m_TraceRing.capacity() ) )
+                 + " instructions.\n";
+        }
+        if( args[1] == "show" )
+        {
+            unsigned count = 20;
+            if( args.size() > 2 )
+                count = unsigned( std::atoi( args[2].c_str() ) );
+            std::vector<TraceRecord> records;
+            m_TraceRing.snapshot( records );
+            if( records.size() > count )
+                records.erase( records.begin(), records.end() - std::ptrdiff_t( count ) );
+            std::ostringstream out;
+            TraceRing::decode( records, out );
+            return out.str();
+        }
+    }
+    return "Unknown command, try help.\n";
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
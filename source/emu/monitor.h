@@ -0,0 +1,126 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "c64.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Machine code monitor: breakpoints, watchpoints, memory, disassembly,
+// single steps and an instruction trace.
+//
+// The CPU loop has no debugging checks. Instead, the monitor marks the
+// pages it is interested in, and the C64 leaves them out of the CPU page
+// tables, so accesses to them go through the Bus (C64::fetch(),
+// io_read(), io_write()) and on to the hooks below. Pages without
+// breakpoints or watchpoints run at full speed:
+//  - A breakpoint unmaps the page for reads. When the opcode at the
+//    breakpoint is fetched, on_fetch() returns the trap opcode, so the
+//    CPU stops in C64::trap() before the instruction is executed.
+//  - A watchpoint unmaps the page for reads and/or writes. The machine
+//    stops after the instruction that made the access.
+//  - Tracing and single steps unmap all pages for reads.
+// Stopping pulls in the scheduler deadline, so the CPU returns at once,
+// and C64::run_until() does nothing until go() or step().
+//
+// The frontends (the console of the headless program, the socket of the
+// main window) pass text lines to command(), see "help".
+class Monitor
+{
+public:
+    //========================================================================
+    // Marks of a page, see C64::update_debug_pages().
+    enum : uint8_t { PAGE_FETCH = 1, PAGE_READ = 2, PAGE_WRITE = 4 };
+    // Kinds of watchpoints.
+    enum : uint8_t { WATCH_READ = 1, WATCH_WRITE = 2 };
+    // Records kept by the trace (16 bytes each).
+    static constexpr size_t TRACE_RECORDS = size_t(1) << 20;
+    //========================================================================
+    Monitor() = default;
+    NO_COPY( Monitor );
+    NO_MOVE( Monitor );
+    virtual ~Monitor() { detach(); }
+    //========================================================================
+    void attach( C64 &c64 );
+    void detach();
+    //========================================================================
+    void add_breakpoint( uint16_t addr );
+    void add_watchpoint( uint16_t first, uint16_t last, uint8_t kinds );
+    // Remove the breakpoint at "addr" and the watchpoints starting there.
+    // Returns the number removed.
+    int  remove( uint16_t addr );
+    void remove_all();
+    //========================================================================
+    bool stopped() const { return m_C64 && m_C64->break_requested(); }
+    void stop( const std::string &reason );
+    void go();
+    // Execute "count" instructions, then stop.
+    void step( int count = 1 );
+    // Why the machine stopped last, once. Empty if nothing happened.
+    std::string take_event();
+    //========================================================================
+    void set_trace( bool on );
+    bool tracing() const { return m_Trace; }
+    const TraceRing &trace() const { return m_TraceRing; }
+    //========================================================================
+    // Execute a command line, returns the output.
+    std::string command( const std::string &line );
+    //========================================================================
+    // Hooks for the C64.
+    uint8_t page_flags( int page ) const { return pages[page]; }
+    bool on_fetch( uint16_t pc );   // True: stop here.
+    bool on_trap( uint16_t pc );    // True: the trap was a breakpoint.
+    void on_read( uint16_t addr )
+    {
+        if( (pages[addr >> 8] & PAGE_READ) && watch_read[addr] )
+            watch_hit( addr, false, 0 );
+    }
+    void on_write( uint16_t addr, uint8_t value )
+    {
+        if( (pages[addr >> 8] & PAGE_WRITE) && watch_write[addr] )
+            watch_hit( addr, true, value );
+    }
+
+private:
+    C64 *m_C64 {nullptr};
+    std::array<uint8_t, 256> pages {};
+    //------------------------------------------------------------------
+    struct Watch { uint16_t first, last; uint8_t kinds; };
+    std::vector<uint16_t> breakpoints;
+    std::vector<Watch> watches;
+    std::bitset<0x10000> break_at, watch_read, watch_write;
+    //------------------------------------------------------------------
+    bool m_BreakPending {false};    // on_fetch() returned the trap opcode.
+    int  m_ResumePc {-1};           // No breakpoint on the first instruction.
+    int  m_Steps {-1};              // Instructions left to step, -1: not stepping.
+    bool m_Trace {false};
+    TraceRing m_TraceRing;
+    std::string m_Event;
+    //------------------------------------------------------------------
+    uint16_t m_NextMemory {0};      // Where "m" and "d" continue.
+    uint16_t m_NextCode {0};
+    //========================================================================
+    void update_pages();
+    void update_bits();
+    void watch_hit( uint16_t addr, bool write, uint8_t value );
+    void record( uint16_t pc );
+    //========================================================================
+    std::string registers() const;
+    std::string memory( uint16_t from, uint16_t to );
+    std::string code( uint16_t from, int count, int to );
+    std::string list() const;
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // MONITOR_H
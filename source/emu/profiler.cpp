@@ -0,0 +1,137 @@
+//========================================================================
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+Profiler::Profiler()
+    : m_Instructions( ADDRESSES ), m_Cycles( ADDRESSES ), m_Calls( ADDRESSES )
+{
+}
+
+//========================================================================
+void Profiler::clear()
+{
+    std::fill( m_Instructions.begin(), m_Instructions.end(), 0 );
+    std::fill( m_Cycles.begin(), m_Cycles.end(), 0 );
+    std::fill( m_Calls.begin(), m_Calls.end(), 0 );
+}
+
+//========================================================================
+uint64_t Profiler::total_instructions() const
+{
+    return std::accumulate( m_Instructions.begin(), m_Instructions.end(), uint64_t(0) );
+}
+
+//========================================================================
+uint64_t Profiler::total_cycles() const
+{
+    return std::accumulate( m_Cycles.begin(), m_Cycles.end(), uint64_t(0) );
+}
+
+//========================================================================
+std::vector<Profiler::Routine> Profiler::routines() const
+{
+    std::vector<Routine> list;
+    int idle = GAP;     // Bytes since the last one that ran.
+    for( int a = 0; a < ADDRESSES; a++ )
+    {
+        bool ran = m_Instructions[a] != 0 || m_Cycles[a] != 0;
+        if( m_Calls[a] != 0 || (ran && idle >= GAP) )
+        {
+            Routine routine;
+            routine.entry = routine.last = uint16_t(a);
+            routine.calls = m_Calls[a];
+            list.push_back( routine );
+        }
+        if( !ran )
+        {
+            idle++;
+            continue;
+        }
+        idle = 0;
+        Routine &routine = list.back();
+        routine.last = uint16_t(a);
+        routine.instructions += m_Instructions[a];
+        routine.cycles += m_Cycles[a];
+    }
+    //------------------------------------------------------------------
+    list.erase( std::remove_if( list.begin(), list.end(), []( const Routine &r ) { return r.cycles == 0; } ),
+                list.end() );
+    std::stable_sort( list.begin(), list.end(), []( const Routine &a, const Routine &b ) { return a.cycles > b.cycles; } );
+    return list;
+}
+
+//========================================================================
+void Profiler::report( std::ostream &out, size_t count ) const
+{
+    std::vector<Routine> list = routines();
+    uint64_t total = total_cycles();
+    char line[96];
+    std::snprintf( line, sizeof(line), "Profile: %llu instructions, %llu cycles, %zu routines.\n",
+                   (unsigned long long)total_instructions(), (unsigned long long)total, list.size() );
+    out << line;
+    if( total == 0 )
+        return;
+    out << "Routine      Cycles      %       Calls  Instructions\n";
+    for( size_t i = 0; i < std::min( count, list.size() ); i++ )
+    {
+        const Routine &r = list[i];
+        std::snprintf( line, sizeof(line), "$%04X-%04X %12llu %6.2f %11llu %13llu\n",
+                       r.entry, r.last, (unsigned long long)r.cycles, 100.0 * double( r.cycles ) / double( total ),
+                       (unsigned long long)r.calls, (unsigned long long)r.instructions );
+        out << line;
+    }
+}
+
+//========================================================================
+// The format: https://valgrind.org/docs/manual/cl-format.html
+// Positions are instruction addresses, in hex.
+void Profiler::write_callgrind( const std::string &filename, const std::string &command ) const
+{
+    std::ofstream out( filename );
+    if( !out )
+        throw std::runtime_error( "Can't write profile: " + filename );
+    out << "# callgrind format\n"
+           "version: 1\n"
+           "creator: glMurks64\n"
+           "cmd: " << command << "\n"
+           "positions: instr\n"
+           "events: Instructions Cycles\n"
+           "summary: " << total_instructions() << " " << total_cycles() << "\n\n"
+           "ob=C64\n"
+           "fl=memory\n";
+    //------------------------------------------------------------------
+    std::vector<Routine> list = routines();
+    std::sort( list.begin(), list.end(), []( const Routine &a, const Routine &b ) { return a.entry < b.entry; } );
+    char line[64];
+    for( const Routine &r : list )
+    {
+        std::snprintf( line, sizeof(line), "fn=$%04X\n", r.entry );
+        out << line;
+        for( int a = r.entry; a <= r.last; a++ )
+        {
+            if( m_Instructions[a] == 0 && m_Cycles[a] == 0 )
+                continue;
+            std::snprintf( line, sizeof(line), "0x%04x %llu %llu\n", a,
+                           (unsigned long long)m_Instructions[a], (unsigned long long)m_Cycles[a] );
+            out << line;
+        }
+    }
+    if( !out )
+        throw std::runtime_error( "Can't write profile: " + filename );
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
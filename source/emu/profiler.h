@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "utils.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Where the guest's cycles go: instructions and cycles per address of
+// the CPU it is attached to (see CPU6502::set_profiler()).
+//
+// The counters are flat arrays of 64K entries, the CPU adds to them
+// after every instruction without a branch: the count and the cycles at
+// the PC of the instruction, and 1 or 0 (from a table of the opcodes
+// JSR and BRK) to the calls of the next PC. Interrupts add a call of
+// their handler. Without a profiler the CPU runs a loop that has none
+// of this compiled in.
+//
+// The addresses are those the CPU executed, whatever was mapped there:
+// a routine in RAM under the KERNAL shows up at the KERNAL's address.
+// Frames run again by run-ahead or a rollback count again.
+class Profiler
+{
+public:
+    //========================================================================
+    static constexpr int ADDRESSES = 0x10000;
+    //========================================================================
+    Profiler();
+    NO_COPY( Profiler );
+    void clear();
+    //========================================================================
+    // From the CPU.
+    void instruction( uint16_t pc, uint32_t cycles, uint16_t next_pc, uint8_t call )
+    {
+        m_Instructions[pc]++;
+        m_Cycles[pc] += cycles;
+        m_Calls[next_pc] += call;
+    }
+    void interrupt( uint16_t handler, uint32_t cycles )
+    {
+        m_Cycles[handler] += cycles;
+        m_Calls[handler]++;
+    }
+    //========================================================================
+    uint64_t instructions( uint16_t addr ) const { return m_Instructions[addr]; }
+    uint64_t cycles( uint16_t addr ) const { return m_Cycles[addr]; }
+    uint64_t calls( uint16_t addr ) const { return m_Calls[addr]; }
+    uint64_t total_instructions() const;
+    uint64_t total_cycles() const;
+    //========================================================================
+    // The code from one entry to the next. Entries are the addresses that
+    // were called (JSR targets, interrupt handlers), and code that was
+    // reached otherwise after GAP bytes that didn't run (e.g. a main loop
+    // entered with JMP). The cycles are the routine's own, without those
+    // of the routines it calls.
+    static constexpr int GAP = 0x100;
+    struct Routine
+    {
+        uint16_t entry {0};
+        uint16_t last {0};              // Address of the last instruction.
+        uint64_t calls {0};
+        uint64_t instructions {0};
+        uint64_t cycles {0};
+    };
+    // All routines that ran, by cycles, most first.
+    std::vector<Routine> routines() const;
+    //========================================================================
+    // The "count" hottest routines, with their share of the cycles.
+    void report( std::ostream &out, size_t count = 20 ) const;
+    // For KCachegrind & co.: one function per routine, costs per
+    // instruction address. Throws std::runtime_error.
+    void write_callgrind( const std::string &filename, const std::string &command ) const;
+
+private:
+    std::vector<uint64_t> m_Instructions;
+    std::vector<uint64_t> m_Cycles;
+    std::vector<uint64_t> m_Calls;
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // PROFILER_H
@@ -0,0 +1,204 @@
+//========================================================================
+#include "rollback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+static uint64_t mix( uint64_t h, uint64_t v )
+{
+    h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+static uint64_t mix_bytes( uint64_t h, const uint8_t *data, size_t size )
+{
+    for( ; size >= 8; data += 8, size -= 8 )
+    {
+        uint64_t v;
+        std::memcpy( &v, data, 8 );
+        h = mix( h, v );
+    }
+    while( size-- > 0 )
+        h = mix( h, *data++ );
+    return h;
+}
+
+//========================================================================
+// Field by field: the padding of the structs is not part of the state.
+uint64_t Rollback::hash( const C64::Snapshot &snap )
+{
+    uint64_t h = mix_bytes( 0, snap.ram.data(), snap.ram.size() );
+    h = mix_bytes( h, snap.color_ram.data(), snap.color_ram.size() );
+    const auto &cpu = snap.cpu;
+    h = mix( h, cpu.pc | uint64_t( cpu.a ) << 16 | uint64_t( cpu.x ) << 24 |
+                uint64_t( cpu.y ) << 32 | uint64_t( cpu.sp ) << 40 | uint64_t( cpu.p ) << 48 );
+    h = mix( h, cpu.cycles );
+    return mix_bytes( h, snap.vic.regs, sizeof(snap.vic.regs) );
+}
+
+//========================================================================
+void Rollback::start( C64 &machine, int port )
+{
+    c64 = &machine;
+    local_port = port == 1 ? 1 : 2;
+    remote_port = 3 - local_port;
+    if( !saved )
+        saved = std::make_unique<C64::Snapshot[]>( MAX_FRAMES );
+    m_Frame = 0;
+    remote_count = remote_ack = 0;
+    rollback_from = NONE;
+    next_check = 0;
+    outgoing = Check {};
+    local_checks.fill( Check {} );
+    remote_checks.fill( Check {} );
+    m_Desync = false;
+    m_ChecksPassed = m_Rollbacks = m_FramesRerun = 0;
+    m_MaxRollbackMs = 0.0;
+}
+
+//========================================================================
+bool Rollback::advance( uint8_t local_input )
+{
+    if( m_Frame >= remote_count + MAX_FRAMES )
+        return false;
+    if( rollback_from != NONE )
+        roll_back();
+    check_confirmed();
+    //------------------------------------------------------------------
+    c64->save_state( saved[ m_Frame % MAX_FRAMES ] );
+    local_inputs[ m_Frame % INPUTS ] = local_input;
+    run( m_Frame++ );
+    return true;
+}
+
+//========================================================================
+void Rollback::remote_input( uint32_t frame, uint8_t input, uint32_t ack )
+{
+    if( frame != remote_count )
+        throw std::runtime_error( "Link: remote input for frame " + std::to_string( frame ) +
+                                  ", expected " + std::to_string( remote_count ) );
+    remote_inputs[ frame % INPUTS ] = input;
+    remote_count = frame + 1;
+    remote_ack = ack;
+    if( frame < m_Frame && used_inputs[ frame % INPUTS ] != input )
+        rollback_from = std::min( rollback_from, frame );
+}
+
+//========================================================================
+void Rollback::remote_check( uint32_t frame, uint64_t hash )
+{
+    remote_checks[ (frame / CHECK_INTERVAL) % CHECK_SLOTS ] = { frame, hash };
+    compare( frame );
+}
+
+//========================================================================
+bool Rollback::take_check( uint32_t &frame, uint64_t &hash )
+{
+    if( outgoing.frame == NONE )
+        return false;
+    frame = outgoing.frame;
+    hash = outgoing.hash;
+    outgoing = Check {};
+    return true;
+}
+
+//========================================================================
+// Our lead over the remote input we have, minus its lead over ours: with
+// the same latency both ways, the difference is twice the time one side
+// is ahead.
+int Rollback::frames_ahead() const
+{
+    int ours = int( m_Frame ) - int( remote_count );
+    int theirs = int( remote_count ) - int( remote_ack );
+    return (ours - theirs) / 2;
+}
+
+//========================================================================
+// The last input the remote player is known to have given.
+uint8_t Rollback::predict( uint32_t frame ) const
+{
+    if( frame < remote_count )
+        return remote_inputs[ frame % INPUTS ];
+    return remote_count ? remote_inputs[ (remote_count - 1) % INPUTS ] : 0;
+}
+
+//========================================================================
+void Rollback::run( uint32_t frame )
+{
+    uint8_t remote = predict( frame );
+    used_inputs[ frame % INPUTS ] = remote;
+    c64->joystick( local_port, local_inputs[ frame % INPUTS ] );
+    c64->joystick( remote_port, remote );
+    c64->run_frame();
+}
+
+//========================================================================
+// Back to the first frame that ran with a wrong prediction, and the
+// frames up to now again, without sound: it was heard already.
+void Rollback::roll_back()
+{
+    auto start = std::chrono::steady_clock::now();
+    c64->load_state( saved[ rollback_from % MAX_FRAMES ] );
+    c64->audio.set_output( false );
+    for( uint32_t f = rollback_from; f < m_Frame; f++ )
+    {
+        if( f != rollback_from )
+            c64->save_state( saved[ f % MAX_FRAMES ] );
+        run( f );
+        m_FramesRerun++;
+    }
+    c64->audio.set_output( true );
+    rollback_from = NONE;
+    m_Rollbacks++;
+    double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    m_MaxRollbackMs = std::max( m_MaxRollbackMs, ms );
+}
+
+//========================================================================
+// The snapshot before frame f only depends on the inputs of the frames
+// before f: once those are all known (and any rollback is done), it is
+// the same on both sides.
+void Rollback::check_confirmed()
+{
+    while( next_check < m_Frame && next_check <= remote_count )
+    {
+        uint32_t frame = next_check;
+        next_check += CHECK_INTERVAL;
+        if( frame + MAX_FRAMES < m_Frame )
+            continue;   // No longer saved.
+        outgoing = { frame, hash( saved[ frame % MAX_FRAMES ] ) };
+        local_checks[ (frame / CHECK_INTERVAL) % CHECK_SLOTS ] = outgoing;
+        compare( frame );
+    }
+}
+
+//========================================================================
+void Rollback::compare( uint32_t frame )
+{
+    int slot = (frame / CHECK_INTERVAL) % CHECK_SLOTS;
+    Check &ours = local_checks[ size_t(slot) ];
+    Check &theirs = remote_checks[ size_t(slot) ];
+    if( ours.frame != frame || theirs.frame != frame )
+        return;
+    if( ours.hash == theirs.hash )
+        m_ChecksPassed++;
+    else if( !m_Desync )
+    {
+        m_Desync = true;
+        m_DesyncFrame = frame;
+    }
+    ours = theirs = Check {};
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
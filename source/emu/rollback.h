@@ -0,0 +1,119 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include "c64.h"
+#include "utils.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Two players on two machines in two processes, one joystick each: the
+// rollback scheme that keeps them in step without waiting for the other
+// side's input (the transport is LinkSocket).
+//
+// Both machines start from the same state and run the same frames with
+// the same inputs, the core is deterministic. A frame is run at once with
+// the local input and a prediction of the remote one: the remote player
+// keeps doing what they did last. When the real input arrives and the
+// prediction was wrong, the machine goes back to the snapshot before
+// that frame and runs the frames since then again, silently, before the
+// next frame is shown. The local side can be at most MAX_FRAMES ahead of
+// the remote input it has; then advance() has to wait.
+//
+// Every CHECK_INTERVAL frames both sides exchange a checksum of a state
+// that no prediction went into, a difference means the machines went
+// apart (a different program, or state outside C64::Snapshot, e.g. an
+// EasyFlash being programmed or a TRUE_DRIVE writing to the disk).
+class Rollback
+{
+public:
+    //========================================================================
+    static constexpr int MAX_FRAMES = 8;
+    static constexpr int CHECK_INTERVAL = 50;
+    //========================================================================
+    Rollback() = default;
+    NO_COPY( Rollback );
+    //========================================================================
+    // Start the session with the current state of "c64", which has to be
+    // the same on both sides. The local player has joystick "local_port"
+    // (1 or 2), the remote player the other one.
+    void start( C64 &c64, int local_port );
+    bool started() const { return c64 != nullptr; }
+    // The next frame to run, counted from the start.
+    uint32_t frame() const { return m_Frame; }
+    //========================================================================
+    // Run the next frame with the local joystick bits (see C64::joystick()),
+    // after a rollback if a prediction turned out wrong. Returns false,
+    // without running anything, if the remote side is too far behind.
+    bool advance( uint8_t local_input );
+    //========================================================================
+    // From the remote side, in the order it sent them: its input for
+    // "frame", and how many of our inputs it had then ("ack").
+    // Throws std::runtime_error if a frame is missing.
+    void remote_input( uint32_t frame, uint8_t input, uint32_t ack );
+    void remote_check( uint32_t frame, uint64_t hash );
+    // The frames of remote input we have, i.e. what to "ack".
+    uint32_t remote_frames() const { return remote_count; }
+    // A checksum to send to the remote side, if one is due.
+    bool take_check( uint32_t &frame, uint64_t &hash );
+    //========================================================================
+    // How many frames this side is ahead of the other one, by what each
+    // side has of the other's input. Above 1, run a frame less.
+    int frames_ahead() const;
+    //========================================================================
+    bool desynced() const { return m_Desync; }
+    uint32_t desync_frame() const { return m_DesyncFrame; }
+    uint64_t checks_passed() const { return m_ChecksPassed; }
+    uint64_t rollbacks() const { return m_Rollbacks; }
+    uint64_t frames_rerun() const { return m_FramesRerun; }
+    double max_rollback_ms() const { return m_MaxRollbackMs; }
+    //========================================================================
+    // What the checks compare: memory, CPU and VIC registers.
+    static uint64_t hash( const C64::Snapshot &snap );
+
+private:
+    //========================================================================
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+    static constexpr int INPUTS = 64;   // More than the frames in flight.
+    static constexpr int CHECK_SLOTS = 4;
+    //========================================================================
+    struct Check { uint32_t frame {NONE}; uint64_t hash {0}; };
+    //========================================================================
+    C64 *c64 {nullptr};
+    int local_port {2}, remote_port {1};
+    uint32_t m_Frame {0};
+    std::unique_ptr<C64::Snapshot[]> saved;     // Before frame f at f % MAX_FRAMES.
+    std::array<uint8_t, INPUTS> local_inputs {};
+    std::array<uint8_t, INPUTS> remote_inputs {};
+    std::array<uint8_t, INPUTS> used_inputs {};   // The remote input a frame ran with.
+    uint32_t remote_count {0};
+    uint32_t remote_ack {0};
+    uint32_t rollback_from {NONE};
+    //------------------------------------------------------------------
+    uint32_t next_check {0};
+    Check outgoing;
+    std::array<Check, CHECK_SLOTS> local_checks, remote_checks;
+    bool m_Desync {false};
+    uint32_t m_DesyncFrame {0};
+    uint64_t m_ChecksPassed {0};
+    //------------------------------------------------------------------
+    uint64_t m_Rollbacks {0};
+    uint64_t m_FramesRerun {0};
+    double m_MaxRollbackMs {0.0};
+    //========================================================================
+    uint8_t predict( uint32_t frame ) const;
+    void run( uint32_t frame );
+    void roll_back();
+    void check_confirmed();
+    void compare( uint32_t frame );
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // ROLLBACK_H
@@ -0,0 +1,59 @@
+//========================================================================
+#include "run_ahead.h"
+
+#include <algorithm>
+#include <ctime>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// CPU time of this thread: what run-ahead costs doesn't depend on the
+// other threads or on how long the main loop sleeps.
+static double cpu_seconds()
+{
+    timespec ts;
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return double( ts.tv_sec ) + double( ts.tv_nsec ) * 1e-9;
+}
+
+//========================================================================
+void RunAhead::set_frames( int frames )
+{
+    m_Frames = std::clamp( frames, 0, MAX_FRAMES );
+    if( m_Frames && !saved )
+        saved = std::make_unique<C64::Snapshot>();
+    reset_stats();
+}
+
+//========================================================================
+bool RunAhead::begin( C64 &c64 )
+{
+    active = m_Frames > 0 && !c64.monitor_attached() && !c64.break_requested();
+    if( !active )
+        return false;
+    started = cpu_seconds();
+    c64.save_state( *saved );
+    c64.audio.set_output( false );
+    c64.run_cycles( uint64_t( m_Frames ) * CYCLES_PER_FRAME );
+    return true;
+}
+
+//========================================================================
+void RunAhead::end( C64 &c64 )
+{
+    if( !active )
+        return;
+    c64.load_state( *saved );
+    c64.audio.set_output( true );
+    active = false;
+    m_Seconds += cpu_seconds() - started;
+    m_Runs++;
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,64 @@
+#ifndef RUN_AHEAD_H
+#define RUN_AHEAD_H
+
+#include "c64.h"
+#include "utils.h"
+
+#include <cstdint>
+#include <memory>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// Run-ahead: hides the frames a game takes to react to its input.
+//
+// Once per displayed frame, after the input was applied, begin() saves
+// the machine and emulates "frames" more frames. Those are never heard,
+// the audio output is off for them (see Audio::set_output()). The picture
+// is taken from the machine as it is then, e.g. with VIC::raster_lines(),
+// and end() restores the saved state, so the real timeline goes on as if
+// nothing happened. The next begin() starts over from there with the
+// newest input.
+//
+// The hidden frames see the whole machine, except what isn't part of a
+// C64::Snapshot: a TRUE_DRIVE writing to the disk image or an EasyFlash
+// being programmed would do so twice. Nothing is run ahead while a
+// monitor is attached, its breakpoints would go off in the hidden frames.
+class RunAhead
+{
+public:
+    //========================================================================
+    static constexpr int MAX_FRAMES = 8;
+    //========================================================================
+    RunAhead() = default;
+    NO_COPY( RunAhead );
+    // 0 switches run-ahead off.
+    void set_frames( int frames );
+    int frames() const { return m_Frames; }
+    //========================================================================
+    // Returns false if nothing was run (off, monitor attached, stopped);
+    // end() must be called either way.
+    bool begin( C64 &c64 );
+    void end( C64 &c64 );
+    //========================================================================
+    // What begin() and end() cost: CPU time in milliseconds per frame, on
+    // average over the runs since the last reset_stats().
+    double average_ms() const { return m_Runs ? m_Seconds * 1000.0 / double( m_Runs ) : 0.0; }
+    uint64_t runs() const { return m_Runs; }
+    void reset_stats() { m_Seconds = 0.0; m_Runs = 0; }
+
+private:
+    //========================================================================
+    std::unique_ptr<C64::Snapshot> saved;   // About 100 KB, not on the stack.
+    int m_Frames {0};
+    bool active {false};
+    double started {0.0};
+    double m_Seconds {0.0};
+    uint64_t m_Runs {0};
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // RUN_AHEAD_H
@@ -0,0 +1,155 @@
+//========================================================================
+#include "scheduler.h"
+
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+int Scheduler::add_slot( EventHandler *handler, int tag )
+{
+    if( slot_count == MAX_SLOTS )
+    {
+        throw std::runtime_error( "Scheduler: too many event slots!" );
+    }
+    int slot = slot_count++;
+    slots[slot] = { handler, tag };
+    state.time[slot] = NEVER;
+    state.index[slot] = 0xFF;
+    return slot;
+}
+
+//========================================================================
+void Scheduler::clear()
+{
+    state.time.fill( NEVER );
+    state.index.fill( 0xFF );
+    state.heap_size = 0;
+    state.limit = NEVER;
+    update_deadline();
+}
+
+//========================================================================
+void Scheduler::update_deadline()
+{
+    uint64_t next = state.heap_size ? state.time[ state.heap[0] ] : NEVER;
+    state.deadline = next < state.limit ? next : state.limit;
+}
+
+//========================================================================
+void Scheduler::swap( int a, int b )
+{
+    std::swap( state.heap[a], state.heap[b] );
+    state.index[ state.heap[a] ] = uint8_t(a);
+    state.index[ state.heap[b] ] = uint8_t(b);
+}
+
+//========================================================================
+void Scheduler::sift_up( int pos )
+{
+    while( pos > 0 )
+    {
+        int parent = (pos - 1) / 2;
+        if( state.time[ state.heap[parent] ] <= state.time[ state.heap[pos] ] ) break;
+        swap( pos, parent );
+        pos = parent;
+    }
+}
+
+//========================================================================
+void Scheduler::sift_down( int pos )
+{
+    for(;;)
+    {
+        int smallest = pos;
+        int l = 2*pos + 1, r = 2*pos + 2;
+        if( l < state.heap_size && state.time[ state.heap[l] ] < state.time[ state.heap[smallest] ] ) smallest = l;
+        if( r < state.heap_size && state.time[ state.heap[r] ] < state.time[ state.heap[smallest] ] ) smallest = r;
+        if( smallest == pos ) break;
+        swap( pos, smallest );
+        pos = smallest;
+    }
+}
+
+//========================================================================
+void Scheduler::remove( int slot )
+{
+    int pos = state.index[slot];
+    if( pos == 0xFF ) return;
+    int last = --state.heap_size;
+    if( pos != last )
+    {
+        swap( pos, last );
+        sift_down( pos );
+        sift_up( pos );
+    }
+    state.index[slot] = 0xFF;
+    state.time[slot] = NEVER;
+}
+
+//========================================================================
+void Scheduler::schedule( int slot, uint64_t time )
+{
+    if( state.index[slot] == 0xFF )
+    {
+        int pos = state.heap_size++;
+        state.heap[pos] = uint8_t(slot);
+        state.index[slot] = uint8_t(pos);
+        state.time[slot] = time;
+        sift_up( pos );
+    }
+    else
+    {
+        uint64_t old = state.time[slot];
+        state.time[slot] = time;
+        if( time < old ) sift_up( state.index[slot] );
+        else             sift_down( state.index[slot] );
+    }
+    update_deadline();
+}
+
+//========================================================================
+void Scheduler::cancel( int slot )
+{
+    remove( slot );
+    update_deadline();
+}
+
+//========================================================================
+void Scheduler::dispatch( uint64_t now )
+{
+    //------------------------------------------------------------------
+    // The handler may schedule the same slot again (periodic events), so
+    // the event is removed before calling it.
+    while( state.heap_size && state.time[ state.heap[0] ] <= now )
+    {
+        int slot = state.heap[0];
+        uint64_t time = state.time[slot];
+        remove( slot );
+        slots[slot].handler->on_event( slots[slot].tag, time );
+    }
+    update_deadline();
+}
+
+//========================================================================
+void Scheduler::poll_all( uint64_t now )
+{
+    for( int slot = 0; slot < slot_count; slot++ )
+    {
+        uint64_t time = state.time[slot];
+        if( time <= now )
+        {
+            remove( slot );
+            slots[slot].handler->on_event( slots[slot].tag, time );
+        }
+    }
+    update_deadline();
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
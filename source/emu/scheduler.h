@@ -0,0 +1,92 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+#include <array>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// A component that wants to be called back at a given cycle.
+class EventHandler
+{
+public:
+    virtual ~EventHandler() = default;
+    // Called when the event "tag" is due. "time" is the cycle the event
+    // was scheduled for (the current cycle may be a little later).
+    virtual void on_event( int tag, uint64_t time ) = 0;
+};
+
+//========================================================================
+// Central cycle scheduler.
+//
+// Instead of stepping every chip on every cycle, each component registers
+// its future events (timer underflows, raster line starts, bad line DMA...)
+// here. The CPU runs freely until deadline(), then dispatch() calls all
+// handlers whose event is due.
+//
+// Every registered slot has at most one pending event. The pending events
+// are kept in an indexed binary min-heap, so (re)scheduling and cancelling
+// are O(log n) and the next deadline is O(1).
+//
+// All state except the handler table is plain data, so a copy of
+// Scheduler::State is a complete snapshot of the pending events.
+class Scheduler
+{
+public:
+    //========================================================================
+    static constexpr int MAX_SLOTS = 32;
+    static constexpr uint64_t NEVER = ~uint64_t(0);
+    //========================================================================
+    // Register a slot, returns its id. Done once at machine setup.
+    int add_slot( EventHandler *handler, int tag );
+    //========================================================================
+    void schedule( int slot, uint64_t time );   // Replaces a pending event.
+    void cancel( int slot );
+    uint64_t pending( int slot ) const { return state.time[slot]; }
+    //========================================================================
+    // The CPU may run until this cycle. It is the earlier of the next
+    // event and the limit set by the owner. Because the CPU reads this
+    // through a reference, an event scheduled by an I/O write during
+    // the CPU run shortens the current run immediately.
+    const uint64_t &deadline() const { return state.deadline; }
+    void set_limit( uint64_t limit ) { state.limit = limit; update_deadline(); }
+    //========================================================================
+    // Call the handlers of all events that are due at cycle "now".
+    void dispatch( uint64_t now );
+    //========================================================================
+    // Reference mode for benchmarks: look at every slot, every cycle.
+    // (How a naive lockstep emulator polls its components.)
+    void poll_all( uint64_t now );
+    //========================================================================
+    void clear();
+    //========================================================================
+    struct State
+    {
+        std::array<uint64_t, MAX_SLOTS> time;  // Pending time per slot, NEVER if none.
+        std::array<uint8_t,  MAX_SLOTS> heap;  // Slots ordered as min-heap on time.
+        std::array<uint8_t,  MAX_SLOTS> index; // Position of each slot in the heap.
+        int heap_size {0};
+        uint64_t limit {NEVER};
+        uint64_t deadline {NEVER};
+    };
+    State state;
+
+private:
+    //========================================================================
+    struct Slot { EventHandler *handler {nullptr}; int tag {0}; };
+    std::array<Slot, MAX_SLOTS> slots;
+    int slot_count {0};
+    //========================================================================
+    void sift_up( int pos );
+    void sift_down( int pos );
+    void swap( int a, int b );
+    void remove( int slot );
+    void update_deadline();
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // SCHEDULER_H
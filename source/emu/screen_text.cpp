@@ -0,0 +1,364 @@
+//========================================================================
+#include "screen_text.h"
+#include "c64.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// The character of each screen code in each character set.
+struct DecodeTables
+{
+    char chars[2][256];
+};
+
+static constexpr DecodeTables make_tables()
+{
+    DecodeTables t {};
+    constexpr char G = ScreenText::GRAPHIC;
+    for( int set = 0; set < 2; set++ )
+    {
+        for( int code = 0; code < 128; code++ )
+        {
+            char c = G;
+            if( code == 0 )                     c = '@';
+            else if( code <= 26 )               c = char( (set ? 'a' : 'A') + code - 1 );
+            else if( code == 27 )               c = '[';
+            else if( code == 29 )               c = ']';
+            else if( code == 30 )               c = '^';    // Arrow up
+            else if( code == 31 )               c = '_';    // Arrow left
+            else if( code >= 32 && code < 64 )  c = char( code );
+            else if( set && code >= 65 && code <= 90 )
+                                                c = char( 'A' + code - 65 );
+            else if( code == 96 )               c = ' ';    // Shifted space
+            t.chars[set][code] = c;
+            t.chars[set][code + 128] = c;       // Reverse
+        }
+    }
+    return t;
+}
+static constexpr DecodeTables tables = make_tables();
+
+//========================================================================
+char ScreenText::decode( uint8_t code, Charset charset )
+{
+    return tables.chars[ int(charset) ][ code ];
+}
+
+//========================================================================
+// The first and the last index where "a" and "b" differ, -1 if nowhere.
+static int first_difference( const uint8_t *a, const uint8_t *b, int n )
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for( ; i + 16 <= n; i += 16 )
+    {
+        __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) );
+        __m128i y = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) );
+        unsigned same = unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) ) );
+        if( same != 0xFFFF )
+            return i + __builtin_ctz( ~same );
+    }
+#endif
+    for( ; i < n; i++ )
+        if( a[i] != b[i] )
+            return i;
+    return -1;
+}
+
+static int last_difference( const uint8_t *a, const uint8_t *b, int n )
+{
+    int i = n;
+#if defined(__SSE2__)
+    for( ; i >= 16; i -= 16 )
+    {
+        __m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i - 16 ) );
+        __m128i y = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i - 16 ) );
+        unsigned diff = ~unsigned( _mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) ) ) & 0xFFFF;
+        if( diff )
+            return i - 16 + 31 - __builtin_clz( diff );
+    }
+#endif
+    while( --i >= 0 )
+        if( a[i] != b[i] )
+            return i;
+    return -1;
+}
+
+//========================================================================
+// Only the cells that changed are decoded: a typed key or a blinking
+// cursor costs the compare and a few table lookups.
+bool ScreenText::update( const uint8_t *cells, Charset charset )
+{
+    int first = 0, last = CELLS - 1;
+    if( m_Valid && charset == m_Charset )
+    {
+        first = first_difference( codes.data(), cells, CELLS );
+        if( first < 0 )
+            return false;
+        last = first + last_difference( codes.data() + first, cells + first, CELLS - first );
+    }
+    //------------------------------------------------------------------
+    // A blinking cursor changes the codes, not the text.
+    const char *table = tables.chars[ int(charset) ];
+    bool changed = !m_Valid;
+    for( int i = first; i <= last; i++ )
+    {
+        char c = table[ cells[i] ];
+        changed |= c != m_Text[i];
+        m_Text[i] = c;
+        codes[i] = cells[i];
+    }
+    m_Charset = charset;
+    m_Valid = true;
+    if( changed )
+        m_Generation++;
+    return changed;
+}
+
+//========================================================================
+bool ScreenText::update( C64 &c64 )
+{
+    bool lower = (c64.vic.state.regs[0x18] & 0x02) != 0;
+    return update( c64.video_matrix(), lower ? Charset::LOWER_CASE : Charset::UPPER_CASE );
+}
+
+//========================================================================
+std::string ScreenText::to_string() const
+{
+    std::string out;
+    for( int y = 0; y < ROWS; y++ )
+    {
+        std::string_view line = row( y );
+        size_t end = line.find_last_not_of( ' ' );
+        out.append( line.substr( 0, end == std::string_view::npos ? 0 : end + 1 ) );
+        out += '\n';
+    }
+    return out;
+}
+
+//========================================================================
+// 16 start positions at a time: compare their first and their last
+// character with the needle's, and only where both match the rest.
+int ScreenText::find( std::string_view needle, int from ) const
+{
+    size_t n = needle.size();
+    if( from < 0 || n > size_t( CELLS - from ) )
+        return -1;
+    if( n == 0 )
+        return from;
+#if defined(__SSE2__)
+    const char *text = m_Text.data();
+    size_t last = CELLS - n;
+    const __m128i first_char = _mm_set1_epi8( needle[0] );
+    const __m128i last_char  = _mm_set1_epi8( needle[n - 1] );
+    for( size_t i = size_t(from); i <= last; i += 16 )
+    {
+        __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( text + i ) );
+        __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( text + i + n - 1 ) );
+        unsigned mask = unsigned( _mm_movemask_epi8(
+            _mm_and_si128( _mm_cmpeq_epi8( a, first_char ), _mm_cmpeq_epi8( b, last_char ) ) ) );
+        while( mask )
+        {
+            size_t pos = i + size_t( __builtin_ctz( mask ) );
+            if( pos > last )
+                return -1;
+            if( n <= 2 || std::memcmp( text + pos + 1, needle.data() + 1, n - 2 ) == 0 )
+                return int(pos);
+            mask &= mask - 1;
+        }
+    }
+    return -1;
+#else
+    size_t pos = std::string_view( m_Text.data(), CELLS ).find( needle, size_t(from) );
+    return pos == std::string_view::npos ? -1 : int(pos);
+#endif
+}
+
+//========================================================================
+int ScreenText::count( std::string_view needle ) const
+{
+    int n = 0;
+    for( int pos = find( needle ); pos >= 0; pos = find( needle, pos + 1 ) )
+        n++;
+    return n;
+}
+
+//========================================================================
+TextPattern::TextPattern( const std::string &pattern ) : m_Pattern( pattern )
+{
+    auto error = [&]( const char *what ) {
+        return std::runtime_error( std::string( what ) + " in pattern \"" + pattern + "\"" );
+    };
+    auto add = []( Atom &atom, char c ) { uint8_t u = uint8_t( c ); atom.set[u >> 6] |= uint64_t(1) << (u & 63); };
+    //------------------------------------------------------------------
+    size_t i = 0, n = pattern.size();
+    if( i < n && pattern[i] == '^' )
+    {
+        m_Begin = true;
+        i++;
+    }
+    std::string run;    // The current literal part.
+    while( i < n )
+    {
+        char c = pattern[i++];
+        if( c == '$' && i == n )
+        {
+            m_End = true;
+            break;
+        }
+        Atom atom;
+        bool plain = false;
+        if( c == '.' )
+            atom.set.fill( ~uint64_t(0) );
+        else if( c == '[' )
+        {
+            bool negate = i < n && pattern[i] == '^';
+            if( negate )
+                i++;
+            while( true )
+            {
+                if( i >= n )
+                    throw error( "Missing ]" );
+                char from = pattern[i++];
+                if( from == ']' )
+                    break;
+                if( from == '\\' && i < n )
+                    from = pattern[i++];
+                char to = from;
+                if( i + 1 < n && pattern[i] == '-' && pattern[i + 1] != ']' )
+                {
+                    to = pattern[i + 1];
+                    i += 2;
+                }
+                for( int ch = uint8_t(from); ch <= uint8_t(to); ch++ )
+                    add( atom, char(ch) );
+            }
+            if( negate )
+                for( auto &bits : atom.set )
+                    bits = ~bits;
+        }
+        else if( c == '*' || c == '+' || c == '?' )
+            throw error( "Nothing to repeat" );
+        else
+        {
+            if( c == '\\' )
+            {
+                if( i == n )
+                    throw error( "Trailing \\" );
+                c = pattern[i++];
+            }
+            add( atom, c );
+            plain = true;
+        }
+        //--------------------------------------------------------------
+        if( i < n && (pattern[i] == '*' || pattern[i] == '+' || pattern[i] == '?') )
+        {
+            char q = pattern[i++];
+            atom.min = q == '+' ? 1 : 0;
+            atom.max = q == '?' ? 1 : ScreenText::COLUMNS;
+            plain = false;
+        }
+        if( plain )
+            run += c;
+        else
+            run.clear();
+        if( run.size() > literal.size() )
+            literal = run;
+        atoms.push_back( atom );
+    }
+}
+
+//========================================================================
+// Backtracking, longest repeat first. Rows are short, that is fast.
+bool TextPattern::match_here( size_t index, const char *s, const char *end ) const
+{
+    if( index == atoms.size() )
+        return !m_End || s == end;
+    const Atom &atom = atoms[index];
+    size_t n = 0;
+    while( n < atom.max && s + n < end && atom.has( s[n] ) )
+        n++;
+    for( size_t k = n; k >= atom.min; k-- )
+    {
+        if( match_here( index + 1, s + k, end ) )
+            return true;
+        if( k == 0 )
+            break;
+    }
+    return false;
+}
+
+//========================================================================
+int TextPattern::find( const ScreenText &screen ) const
+{
+    constexpr int COLUMNS = ScreenText::COLUMNS;
+    //------------------------------------------------------------------
+    // The rows the literal part is in (not split between two rows). A
+    // match starts before the literal does, at the latest where it last
+    // starts in the row.
+    std::array<int, ScreenText::ROWS> last;
+    last.fill( m_Begin ? 0 : COLUMNS - 1 );
+    uint32_t rows = (1u << ScreenText::ROWS) - 1;
+    if( !literal.empty() )
+    {
+        rows = 0;
+        int len = int( literal.size() );
+        for( int pos = screen.find( literal ); pos >= 0; pos = screen.find( literal, pos + 1 ) )
+        {
+            int y = pos / COLUMNS;
+            if( (pos + len - 1) / COLUMNS == y )
+            {
+                rows |= 1u << y;
+                last[y] = m_Begin ? 0 : pos % COLUMNS;
+            }
+        }
+    }
+    //------------------------------------------------------------------
+    for( int y = 0; rows; y++, rows >>= 1 )
+    {
+        if( (rows & 1) == 0 )
+            continue;
+        const char *row = screen.text() + y * COLUMNS;
+        for( int x = 0; x <= last[y]; x++ )
+            if( match_here( 0, row + x, row + COLUMNS ) )
+                return y * COLUMNS + x;
+    }
+    return -1;
+}
+
+//========================================================================
+bool ScreenWatch::check( const uint8_t *cells, Charset charset )
+{
+    if( m_Screen.update( cells, charset ) )
+    {
+        m_Result = m_Pattern.matches( m_Screen );
+        m_Evaluations++;
+    }
+    return m_Result;
+}
+
+//========================================================================
+bool ScreenWatch::check( C64 &c64 )
+{
+    if( m_Screen.update( c64 ) )
+    {
+        m_Result = m_Pattern.matches( m_Screen );
+        m_Evaluations++;
+    }
+    return m_Result;
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,143 @@
+#ifndef SCREEN_TEXT_H
+#define SCREEN_TEXT_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+class C64;
+
+//========================================================================
+// The two halves of the character ROM, selected by $D018 bit 1.
+enum class Charset
+{
+    UPPER_CASE,     // Upper case and graphics, after power on.
+    LOWER_CASE      // Lower and upper case.
+};
+
+//========================================================================
+// The text on the screen: the 1000 screen codes of the video matrix
+// (the memory the text screen renders, see C64::video_matrix()) as
+// ASCII, one char per cell and 40 cells per row without line breaks.
+//
+// Reverse characters read like the normal ones. Letters are upper case
+// in UPPER_CASE, both cases in LOWER_CASE. Graphics characters (and the
+// pound sign) have no ASCII: they read as GRAPHIC.
+class ScreenText
+{
+public:
+    static constexpr int COLUMNS = 40;
+    static constexpr int ROWS    = 25;
+    static constexpr int CELLS   = COLUMNS * ROWS;
+    static constexpr char GRAPHIC = '\x7F';
+    //========================================================================
+    // The character of a screen code, from a precomputed table.
+    static char decode( uint8_t code, Charset charset );
+    //========================================================================
+    // Decode the screen codes "cells" (CELLS of them), unless they are the
+    // same as last time. Returns true if the text changed.
+    bool update( const uint8_t *cells, Charset charset );
+    // The same for the video matrix and character set of the VIC.
+    bool update( C64 &c64 );
+    // Increments with every change of the text.
+    uint64_t generation() const { return m_Generation; }
+    //========================================================================
+    const char *text() const { return m_Text.data(); }
+    std::string_view row( int y ) const { return { m_Text.data() + y * COLUMNS, COLUMNS }; }
+    // The rows, separated by '\n', trailing blanks removed.
+    std::string to_string() const;
+    //========================================================================
+    // The first cell at or after "from" where "needle" starts, or -1. The
+    // cells are one string here, so a match can go on in the next row.
+    int find( std::string_view needle, int from = 0 ) const;
+    // Number of cells where "needle" starts.
+    int count( std::string_view needle ) const;
+
+private:
+    //========================================================================
+    // The vector search reads up to 16 bytes past the last cell, the
+    // padding never matches.
+    static constexpr int PADDING = 32;
+    std::array<uint8_t, CELLS> codes {};
+    std::array<char, CELLS + PADDING> m_Text {};
+    Charset m_Charset {Charset::UPPER_CASE};
+    uint64_t m_Generation {0};
+    bool m_Valid {false};
+};
+
+//========================================================================
+// A regular expression of a few features, matched within the rows of a
+// ScreenText:
+//   c       the character c, \c for any of the special characters
+//   .       any character
+//   [a-z0]  one of the characters, [^...] none of them
+//   * + ?   0 or more, 1 or more, 0 or 1 of what precedes
+//   ^ $     first and last column of a row
+// Without special characters, it is a substring within one row.
+//
+// Rows are only tried where the longest literal part of the pattern
+// (found by ScreenText::find()) is, so most screens never get to the
+// backtracking matcher.
+class TextPattern
+{
+public:
+    //========================================================================
+    // Throws std::runtime_error if the pattern is malformed.
+    explicit TextPattern( const std::string &pattern );
+    const std::string &pattern() const { return m_Pattern; }
+    //========================================================================
+    bool matches( const ScreenText &screen ) const { return find( screen ) >= 0; }
+    // The cell of the first match, or -1.
+    int find( const ScreenText &screen ) const;
+
+private:
+    //========================================================================
+    // A character set with a repeat count.
+    struct Atom
+    {
+        std::array<uint64_t, 4> set {};
+        uint16_t min {1}, max {1};
+        bool has( char c ) const { uint8_t u = uint8_t( c ); return (set[u >> 6] >> (u & 63)) & 1; }
+    };
+    std::string m_Pattern;
+    std::vector<Atom> atoms;
+    bool m_Begin {false}, m_End {false};    // ^ and $
+    std::string literal;                    // Must be in every match.
+    //========================================================================
+    bool match_here( size_t atom, const char *s, const char *end ) const;
+};
+
+//========================================================================
+// A pattern watched on the screen of one machine, for batch jobs that
+// wait for a prompt. The pattern is only matched again when the screen
+// text changed since the last check(), so the check of an unchanged
+// screen costs a compare of 1000 bytes. Many watches can share a pattern.
+class ScreenWatch
+{
+public:
+    explicit ScreenWatch( const TextPattern &pattern ) : m_Pattern( pattern ) {}
+    //========================================================================
+    bool check( C64 &c64 );
+    bool check( const uint8_t *cells, Charset charset );
+    const ScreenText &screen() const { return m_Screen; }
+    // How often the pattern was actually matched.
+    uint64_t evaluations() const { return m_Evaluations; }
+
+private:
+    //========================================================================
+    const TextPattern &m_Pattern;
+    ScreenText m_Screen;
+    bool m_Result {false};
+    uint64_t m_Evaluations {0};
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // SCREEN_TEXT_H
@@ -0,0 +1,99 @@
+//========================================================================
+#include "trace.h"
+#include "disassembler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+static const char TRACE_MAGIC[8] = { 'C', '6', '4', 'T', 'R', 'A', 'C', 'E' };
+static constexpr uint32_t TRACE_VERSION = 1;
+
+//========================================================================
+void TraceRing::init( size_t capacity )
+{
+    size_t cap = 1;
+    while( cap < capacity ) cap <<= 1;
+    buffer.assign( cap, TraceRecord {} );
+    mask = cap - 1;
+    head.store( 0, std::memory_order_release );
+}
+
+//========================================================================
+void TraceRing::snapshot( std::vector<TraceRecord> &out ) const
+{
+    size_t before = head.load( std::memory_order_acquire );
+    size_t first = before > capacity() ? before - capacity() : 0;
+    out.resize( before - first );
+    for( size_t i = first; i < before; i++ )
+        out[i - first] = buffer[ i & mask ];
+    //------------------------------------------------------------------
+    // Everything the producer wrote meanwhile replaced the oldest records.
+    size_t after = head.load( std::memory_order_acquire );
+    size_t lost = std::min( after - before, out.size() );
+    out.erase( out.begin(), out.begin() + std::ptrdiff_t( lost ) );
+}
+
+//========================================================================
+void TraceRing::save( const std::string &filename ) const
+{
+    std::vector<TraceRecord> records;
+    snapshot( records );
+    std::ofstream out( filename, std::ios::binary );
+    uint32_t header[2] = { TRACE_VERSION, uint32_t( records.size() ) };
+    out.write( TRACE_MAGIC, sizeof(TRACE_MAGIC) );
+    out.write( reinterpret_cast<const char*>( header ), sizeof(header) );
+    out.write( reinterpret_cast<const char*>( records.data() ),
+               std::streamsize( records.size() * sizeof(TraceRecord) ) );
+    if( !out )
+        throw std::runtime_error( "Can't write trace " + filename );
+}
+
+//========================================================================
+std::vector<TraceRecord> TraceRing::load( const std::string &filename )
+{
+    std::ifstream in( filename, std::ios::binary );
+    char magic[sizeof(TRACE_MAGIC)];
+    uint32_t header[2];
+    in.read( magic, sizeof(magic) );
+    in.read( reinterpret_cast<char*>( header ), sizeof(header) );
+    if( !in || std::memcmp( magic, TRACE_MAGIC, sizeof(magic) ) != 0 || header[0] != TRACE_VERSION )
+        throw std::runtime_error( "Not a trace file: " + filename );
+    std::vector<TraceRecord> records( header[1] );
+    in.read( reinterpret_cast<char*>( records.data() ),
+             std::streamsize( records.size() * sizeof(TraceRecord) ) );
+    if( !in )
+        throw std::runtime_error( "Trace file is truncated: " + filename );
+    return records;
+}
+
+//========================================================================
+void TraceRing::decode( const std::vector<TraceRecord> &records, std::ostream &out )
+{
+    char line[96];
+    for( const auto &r : records )
+    {
+        int length = instruction_length( r.bytes[0] );
+        char bytes[10] = "        ";
+        for( int i = 0; i < length; i++ )
+            std::snprintf( bytes + i * 3, 4, "%02X ", r.bytes[i] );
+        bytes[8] = 0;
+        std::snprintf( line, sizeof(line), "%10u  %04X  %-9s%-14s A:%02X X:%02X Y:%02X SP:%02X P:%02X\n",
+                       unsigned( r.cycle ), r.pc, bytes, disassemble( r.pc, r.bytes ).c_str(),
+                       r.a, r.x, r.y, r.sp, r.p );
+        out << line;
+    }
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// One executed instruction: the registers before it, and its bytes.
+// 16 bytes, written to trace files as they are in memory.
+struct TraceRecord
+{
+    uint32_t cycle;         // Low 32 bits of the cycle counter.
+    uint16_t pc;
+    uint8_t  bytes[3];      // Opcode and operands.
+    uint8_t  a, x, y, sp, p;
+    uint8_t  reserved {0};
+};
+static_assert( sizeof(TraceRecord) == 16, "Trace files depend on the record layout." );
+
+//========================================================================
+// Flight recorder of the last instructions: a ring that the emulation
+// overwrites without ever blocking, and that can be copied out while it
+// is written. push() is a store of the record and a release store of
+// the head. snapshot() reads the head before and after copying, and
+// drops the records the producer may have overwritten in between.
+//
+// Trace files are a header ("C64TRACE", version, count) followed by
+// the records, oldest first. They are decoded offline by decode().
+class TraceRing
+{
+public:
+    //========================================================================
+    // "capacity" is rounded up to a power of two. Call init() before
+    // the first push() when default constructed.
+    TraceRing() = default;
+    explicit TraceRing( size_t capacity ) { init( capacity ); }
+    void init( size_t capacity );
+    //========================================================================
+    void push( const TraceRecord &record )
+    {
+        size_t h = head.load( std::memory_order_relaxed );
+        buffer[ h & mask ] = record;
+        head.store( h + 1, std::memory_order_release );
+    }
+    void clear() { head.store( 0, std::memory_order_release ); }
+    //========================================================================
+    // Records pushed since init() or clear(), including overwritten ones.
+    size_t pushed() const { return head.load( std::memory_order_acquire ); }
+    size_t capacity() const { return buffer.size(); }
+    // The records still in the ring, oldest first.
+    void snapshot( std::vector<TraceRecord> &out ) const;
+    //========================================================================
+    // Write the snapshot to a file. Throws std::runtime_error.
+    void save( const std::string &filename ) const;
+    // Read a trace file. Throws std::runtime_error.
+    static std::vector<TraceRecord> load( const std::string &filename );
+    // One line per record: cycle, PC, bytes, disassembly, registers.
+    static void decode( const std::vector<TraceRecord> &records, std::ostream &out );
+
+private:
+    std::vector<TraceRecord> buffer;
+    size_t mask {0};
+    std::atomic<size_t> head {0};
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // TRACE_H
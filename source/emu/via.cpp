@@ -0,0 +1,241 @@
+//========================================================================
+#include "via.h"
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+void VIA::init( int id, Scheduler &new_sched, const uint64_t &new_clock, VIAPorts &new_ports,
+                void (*irq)(void *ctx, bool active), void *ctx )
+{
+    m_Id    = id;
+    sched   = &new_sched;
+    clock   = &new_clock;
+    ports   = &new_ports;
+    irq_out = irq;
+    irq_ctx = ctx;
+    slot[EV_T1] = sched->add_slot( this, EV_T1 );
+    slot[EV_T2] = sched->add_slot( this, EV_T2 );
+}
+
+//========================================================================
+void VIA::reset()
+{
+    bool ca1 = state.ca1, cb1 = state.cb1;  // Input levels survive a reset.
+    state = State {};
+    state.ca1 = ca1;
+    state.cb1 = cb1;
+    for( int s : slot ) sched->cancel( s );
+    irq_out( irq_ctx, false );
+    ports->via_write( m_Id, 0, port_a() );
+    ports->via_write( m_Id, 1, port_b() );
+}
+
+//========================================================================
+// The counter reaches zero "value" cycles after loading, the interrupt
+// follows one cycle later. In free running mode timer 1 reloads then,
+// so the period is latch + 2.
+void VIA::start_t1( uint16_t value )
+{
+    state.t1_value = value;
+    state.t1_base  = *clock;
+    state.t1_armed = true;
+    sched->schedule( slot[EV_T1], state.t1_base + value + 1 );
+}
+
+//========================================================================
+void VIA::start_t2( uint16_t value )
+{
+    state.t2_value = value;
+    state.t2_base  = *clock;
+    state.t2_armed = true;
+    sched->schedule( slot[EV_T2], state.t2_base + value + 1 );
+}
+
+//========================================================================
+void VIA::on_event( int tag, uint64_t time )
+{
+    if( tag == EV_T1 )
+    {
+        interrupt( IF_T1 );
+        if( state.acr & 0x40 )
+        {
+            state.t1_value = state.t1_latch;
+            state.t1_base  = time + 1;
+            sched->schedule( slot[EV_T1], state.t1_base + state.t1_value + 1 );
+        }
+        else
+            state.t1_armed = false; // One-shot: keeps counting, no interrupt.
+    }
+    else
+    {
+        interrupt( IF_T2 );
+        state.t2_armed = false;
+    }
+}
+
+//========================================================================
+void VIA::interrupt( uint8_t bits )
+{
+    state.ifr |= bits;
+    update_irq();
+}
+
+//========================================================================
+void VIA::acknowledge( uint8_t bits )
+{
+    state.ifr &= uint8_t(~bits);
+    update_irq();
+}
+
+//========================================================================
+void VIA::update_irq()
+{
+    bool active = (state.ifr & state.ier & 0x7F) != 0;
+    if( active != state.irq )
+    {
+        state.irq = active;
+        irq_out( irq_ctx, active );
+    }
+}
+
+//========================================================================
+void VIA::set_ca1( bool level )
+{
+    if( level == state.ca1 ) return;
+    state.ca1 = level;
+    // PCR bit 0: 0 = negative edge, 1 = positive edge.
+    if( level == bool(state.pcr & 0x01) )
+        interrupt( IF_CA1 );
+}
+
+//========================================================================
+void VIA::set_cb1( bool level )
+{
+    if( level == state.cb1 ) return;
+    state.cb1 = level;
+    if( level == bool(state.pcr & 0x10) )
+        interrupt( IF_CB1 );
+}
+
+//========================================================================
+uint8_t VIA::peek( uint8_t reg ) const
+{
+    switch( reg & 0x0F )
+    {
+    case 0x0: return state.orb;
+    case 0x1: return state.ora;
+    case 0x2: return state.ddrb;
+    case 0x3: return state.ddra;
+    case 0x4: return uint8_t( t1_counter() & 0xFF );
+    case 0x5: return uint8_t( t1_counter() >> 8 );
+    case 0x6: return uint8_t( state.t1_latch & 0xFF );
+    case 0x7: return uint8_t( state.t1_latch >> 8 );
+    case 0x8: return uint8_t( t2_counter() & 0xFF );
+    case 0x9: return uint8_t( t2_counter() >> 8 );
+    case 0xA: return state.sr;
+    case 0xB: return state.acr;
+    case 0xC: return state.pcr;
+    case 0xD: return uint8_t( state.ifr | (state.irq ? 0x80 : 0) );
+    case 0xE: return uint8_t( state.ier | 0x80 );
+    case 0xF: return state.ora;
+    }
+    return 0xFF;
+}
+
+//========================================================================
+uint8_t VIA::read( uint8_t reg )
+{
+    reg &= 0x0F;
+    switch( reg )
+    {
+    case 0x0:
+    {
+        acknowledge( IF_CB1 | IF_CB2 );
+        uint8_t in = ports->via_read( m_Id, 1, port_b() );
+        return uint8_t( (state.orb & state.ddrb) | (in & ~state.ddrb) );
+    }
+    case 0x1:
+        acknowledge( IF_CA1 | IF_CA2 );
+        return ports->via_read( m_Id, 0, port_a() );
+    case 0xF:
+        return ports->via_read( m_Id, 0, port_a() );
+    case 0x4:
+        acknowledge( IF_T1 );
+        return peek( reg );
+    case 0x8:
+        acknowledge( IF_T2 );
+        return peek( reg );
+    case 0xA:
+        acknowledge( IF_SR );
+        return peek( reg );
+    }
+    return peek( reg );
+}
+
+//========================================================================
+void VIA::write( uint8_t reg, uint8_t value )
+{
+    reg &= 0x0F;
+    switch( reg )
+    {
+    case 0x0:
+        acknowledge( IF_CB1 | IF_CB2 );
+        state.orb = value;
+        ports->via_write( m_Id, 1, port_b() );
+        break;
+    case 0x1:
+        acknowledge( IF_CA1 | IF_CA2 );
+        [[fallthrough]];
+    case 0xF:
+        state.ora = value;
+        ports->via_write( m_Id, 0, port_a() );
+        break;
+    case 0x2: state.ddrb = value; ports->via_write( m_Id, 1, port_b() ); break;
+    case 0x3: state.ddra = value; ports->via_write( m_Id, 0, port_a() ); break;
+    //------------------------------------------------------------------
+    // Writing the high byte of timer 1 or timer 2 starts the timer.
+    case 0x4: case 0x6:
+        state.t1_latch = uint16_t( (state.t1_latch & 0xFF00) | value );
+        break;
+    case 0x5:
+        state.t1_latch = uint16_t( (state.t1_latch & 0x00FF) | (value << 8) );
+        acknowledge( IF_T1 );
+        start_t1( state.t1_latch );
+        break;
+    case 0x7:
+        state.t1_latch = uint16_t( (state.t1_latch & 0x00FF) | (value << 8) );
+        acknowledge( IF_T1 );
+        break;
+    case 0x8:
+        state.t2_latch = value;
+        break;
+    case 0x9:
+        acknowledge( IF_T2 );
+        start_t2( uint16_t( (value << 8) | (state.t2_latch & 0xFF) ) );
+        break;
+    //------------------------------------------------------------------
+    case 0xA:
+        state.sr = value;
+        acknowledge( IF_SR );
+        break;
+    case 0xB: state.acr = value; break;
+    case 0xC: state.pcr = value; break;
+    case 0xD:
+        acknowledge( value & 0x7F );
+        break;
+    case 0xE:
+        // Bit 7 selects whether the other bits set or clear the enables.
+        if( value & 0x80 ) state.ier |= (value & 0x7F);
+        else               state.ier &= uint8_t( ~(value & 0x7F) );
+        update_irq();
+        break;
+    }
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
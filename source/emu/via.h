@@ -0,0 +1,100 @@
+#ifndef VIA_H
+#define VIA_H
+
+#include "scheduler.h"
+
+#include <cstdint>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// The I/O ports of a VIA are wired to the outside world by the device.
+class VIAPorts
+{
+public:
+    virtual ~VIAPorts() = default;
+    // Return the levels of the port pins. "output" is what the VIA
+    // drives itself (ORx | ~DDRx).
+    virtual uint8_t via_read ( int via, int port, uint8_t output ) = 0;
+    // Called whenever the output value of a port changes.
+    virtual void    via_write( int via, int port, uint8_t output ) = 0;
+};
+
+//========================================================================
+// The 6522 Versatile Interface Adapter, as used in the 1541.
+//
+// Same approach as the CIA: the timers are computed from the clock of
+// the device, the underflows are events in the device's Scheduler.
+// Timer 2 pulse counting and the shift register are not emulated.
+class VIA : public EventHandler
+{
+public:
+    //========================================================================
+    // id: passed to the port callbacks.
+    // irq: called when the interrupt output changes.
+    void init( int id, Scheduler &sched, const uint64_t &clock, VIAPorts &ports,
+               void (*irq)(void *ctx, bool active), void *irq_ctx );
+    void reset();
+    //========================================================================
+    uint8_t read ( uint8_t reg );
+    uint8_t peek ( uint8_t reg ) const;   // Read without side effects.
+    void    write( uint8_t reg, uint8_t value );
+    //========================================================================
+    // Control line inputs. CA1/CB1 trigger on the edge selected in PCR.
+    void set_ca1( bool level );
+    void set_cb1( bool level );
+    // Control line outputs (manual output mode, high otherwise).
+    bool ca2() const { return (state.pcr & 0x0E) != 0x0C; }
+    bool cb2() const { return (state.pcr & 0xE0) != 0xC0; }
+    //========================================================================
+    uint8_t port_a() const { return state.ora | uint8_t(~state.ddra); }
+    uint8_t port_b() const { return state.orb | uint8_t(~state.ddrb); }
+    //========================================================================
+    void on_event( int tag, uint64_t time ) override;
+    //========================================================================
+    struct State
+    {
+        uint8_t  ora {0}, orb {0}, ddra {0}, ddrb {0};
+        uint8_t  acr {0}, pcr {0}, sr {0};
+        uint8_t  ifr {0}, ier {0};
+        bool     irq {false};
+        bool     ca1 {false}, cb1 {false};
+        uint16_t t1_latch {0xFFFF};
+        uint16_t t1_value {0xFFFF};     // Counter value at cycle t1_base.
+        uint64_t t1_base {0};
+        bool     t1_armed {false};      // An underflow will interrupt.
+        uint16_t t2_latch {0xFFFF};     // Only the low byte is used.
+        uint16_t t2_value {0xFFFF};
+        uint64_t t2_base {0};
+        bool     t2_armed {false};
+    };
+    State state;
+
+private:
+    //========================================================================
+    enum { EV_T1, EV_T2 };
+    enum : uint8_t { IF_CA2 = 0x01, IF_CA1 = 0x02, IF_SR = 0x04, IF_CB2 = 0x08,
+                     IF_CB1 = 0x10, IF_T2 = 0x20, IF_T1 = 0x40 };
+    //========================================================================
+    int m_Id {0};
+    Scheduler *sched {nullptr};
+    const uint64_t *clock {nullptr};
+    VIAPorts *ports {nullptr};
+    void (*irq_out)(void *, bool) {nullptr};
+    void *irq_ctx {nullptr};
+    int slot[2] {};
+    //========================================================================
+    uint16_t t1_counter() const { return uint16_t( state.t1_value - (*clock - state.t1_base) ); }
+    uint16_t t2_counter() const { return uint16_t( state.t2_value - (*clock - state.t2_base) ); }
+    void start_t1( uint16_t value );
+    void start_t2( uint16_t value );
+    void interrupt( uint8_t bits );
+    void acknowledge( uint8_t bits );
+    void update_irq();
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // VIA_H
@@ -0,0 +1,547 @@
+//========================================================================
+#include "vic.h"
+
+#include <algorithm>
+#include <cstring>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// A bad line stops the CPU from cycle 12 (BA low) until the end of the
+// character fetches at cycle 54: the CPU is left with 20 of 63 cycles.
+constexpr int BADLINE_START = 12;
+constexpr int BADLINE_STOLEN = 43;
+
+//========================================================================
+void VIC::init( Scheduler &new_sched, const uint64_t &new_clock,
+                void (*irq)(void *ctx, bool active),
+                void (*stall)(void *ctx, int cycles), void *new_ctx )
+{
+    sched     = &new_sched;
+    clock     = &new_clock;
+    irq_out   = irq;
+    stall_cpu = stall;
+    ctx       = new_ctx;
+    slot[EV_RASTER]  = sched->add_slot( this, EV_RASTER );
+    slot[EV_BADLINE] = sched->add_slot( this, EV_BADLINE );
+    slot[EV_FRAME]   = sched->add_slot( this, EV_FRAME );
+}
+
+//========================================================================
+void VIC::set_memory( const uint8_t *new_ram, const uint8_t *new_char_rom, const uint8_t *new_color_ram )
+{
+    ram       = new_ram;
+    char_rom  = new_char_rom;
+    color_ram = new_color_ram;
+}
+
+//========================================================================
+void VIC::reset()
+{
+    uint8_t bank = state.bank;
+    state = State {};
+    state.bank = bank;
+    irq_out( ctx, false );
+    schedule_raster( false );
+    schedule_badline();
+    sched->schedule( slot[EV_FRAME], *clock - *clock % CYCLES_PER_FRAME + CYCLES_PER_FRAME );
+}
+
+//========================================================================
+int VIC::rom_charset() const
+{
+    uint16_t base = char_base();
+    if( (state.bank & 1) == 0 )
+    {
+        if( (base & 0x3800) == 0x1000 ) return 0;
+        if( (base & 0x3800) == 0x1800 ) return 1;
+    }
+    return -1;
+}
+
+//========================================================================
+// Fill the lines the raster passed since the last register change with
+// the current registers. If the clock is behind the log (the VIC state
+// was set without the log), the last frame is redone.
+void VIC::log_lines()
+{
+    uint64_t now = *clock / CYCLES_PER_LINE;
+    if( now < line_log.logged )
+        line_log.logged = 0;
+    if( now == line_log.logged )
+        return;
+    uint64_t from = std::max( line_log.logged, now >= LINES_PER_FRAME ? now - LINES_PER_FRAME : 0 );
+    //------------------------------------------------------------------
+    uint8_t regs[LINE_REGS] {};
+    std::memcpy( regs, state.regs, 0x2F );
+    if( ram )
+        for( int n = 0; n < 8; n++ )
+            regs[LINE_POINTERS + n] = ram[ video_matrix() + 0x3F8 + n ];
+    regs[LINE_BANK] = state.bank;
+    for( uint64_t line = from; line < now; line++ )
+    {
+        // The events belong to the line that was current when they happened.
+        regs[LINE_EVENTS] = line == line_log.logged ? state.line_events : 0;
+        std::memcpy( &line_log.regs[ (line % LINES_PER_FRAME) * LINE_REGS ], regs, LINE_REGS );
+    }
+    state.line_events = 0;
+    line_log.logged = now;
+}
+
+//========================================================================
+// One pass of the sequencer over the log, starting with the vertical
+// border flip-flop "border". Returns the flip-flop after the last line.
+//
+// A line is a bad line if the display was enabled on line $30 and its
+// low 3 bits match the Y scroll. A bad line resets RC and switches to
+// display state; after RC 7 the row is done, VCBASE moves on by 40 and
+// the sequencer goes idle unless the next bad line follows.
+bool VIC::update_display( bool border )
+{
+    bool enabled = false, active = false;
+    int vcbase = 0, rc = 0;
+    for( int line = 0; line < LINES_PER_FRAME; line++ )
+    {
+        const uint8_t *regs = &line_log.regs[ line * LINE_REGS ];
+        bool den = regs[0x11] & 0x10, rsel = regs[0x11] & 0x08;
+        if( line == 0x30 )
+            enabled = den;
+        bool bad = enabled && line >= 0x30 && line <= 0xF7 && (line & 7) == (regs[0x11] & 7);
+        if( bad )
+        {
+            active = true;
+            rc = 0;
+        }
+        //--------------------------------------------------------------
+        // The border flip-flop is set on the bottom line, and cleared on
+        // the top line if the display is enabled.
+        if( line == (rsel ? 0xFB : 0xF7) )
+            border = true;
+        else if( line == (rsel ? 0x33 : 0x37) && den )
+            border = false;
+        //--------------------------------------------------------------
+        uint8_t *out = &display[ line * DISPLAY_BYTES ];
+        out[0] = uint8_t( vcbase / 40 );
+        out[1] = uint8_t( rc );
+        out[2] = regs[0x16] & 0x07;
+        out[3] = uint8_t( (active ? DISPLAY_ACTIVE : 0) | (border ? DISPLAY_BORDER : 0) |
+                          ((regs[0x16] & 0x08) ? DISPLAY_40COLS : 0) |
+                          ((regs[LINE_EVENTS] & LINE_SIDES_OPEN) ? DISPLAY_SIDES_OPEN : 0) );
+        //--------------------------------------------------------------
+        if( active && rc == 7 )
+        {
+            vcbase = (vcbase + 40) & 0x3FF;
+            active = bad;
+        }
+        if( active )
+            rc = (rc + 1) & 7;
+    }
+    return border;
+}
+
+//========================================================================
+// The border flip-flop at the start of the frame is where the previous
+// frame left it, so it is open at the top if the bottom border was opened.
+// The log holds at most one frame, so the first pass finds that state.
+const uint8_t *VIC::display_lines()
+{
+    log_lines();
+    update_display( update_display( true ) );
+    return display.data();
+}
+
+//========================================================================
+bool VIC::is_bad_line( int line ) const
+{
+    return (state.regs[0x11] & 0x10) &&
+           line >= 0x30 && line <= 0xF7 &&
+           (line & 7) == (state.regs[0x11] & 7);
+}
+
+//========================================================================
+// Schedule the raster interrupt for the next time the raster reaches the
+// compare line. Setting the compare to the current line triggers at once.
+void VIC::schedule_raster( bool allow_now )
+{
+    int compare = raster_compare();
+    if( compare >= LINES_PER_FRAME )
+    {
+        sched->cancel( slot[EV_RASTER] );
+        return;
+    }
+    uint64_t now = *clock;
+    uint64_t frame_start = now - now % CYCLES_PER_FRAME;
+    uint64_t line_start = frame_start + uint64_t(compare) * CYCLES_PER_LINE;
+    //------------------------------------------------------------------
+    if( line_start < now )
+    {
+        if( allow_now && compare == raster_line() )
+            line_start = now;
+        else
+            line_start += CYCLES_PER_FRAME;
+    }
+    sched->schedule( slot[EV_RASTER], line_start );
+}
+
+//========================================================================
+// Schedule the DMA of the next bad line, if the display is enabled.
+void VIC::schedule_badline()
+{
+    if( !(state.regs[0x11] & 0x10) )
+    {
+        sched->cancel( slot[EV_BADLINE] );
+        return;
+    }
+    uint64_t now = *clock;
+    uint64_t frame_start = now - now % CYCLES_PER_FRAME;
+    //------------------------------------------------------------------
+    // The rest of this frame, then the first bad line of the next one.
+    for( int line = raster_line(); line <= 0xF7; line++ )
+    {
+        uint64_t t = frame_start + uint64_t(line) * CYCLES_PER_LINE + BADLINE_START;
+        if( t >= now && is_bad_line( line ) )
+        {
+            sched->schedule( slot[EV_BADLINE], t );
+            return;
+        }
+    }
+    int first = 0x30 + (state.regs[0x11] & 7);
+    sched->schedule( slot[EV_BADLINE], frame_start + CYCLES_PER_FRAME +
+                                       uint64_t(first) * CYCLES_PER_LINE + BADLINE_START );
+}
+
+//========================================================================
+void VIC::on_event( int tag, uint64_t time )
+{
+    switch( tag )
+    {
+    case EV_RASTER:
+        interrupt( 0x01 );
+        sched->schedule( slot[EV_RASTER], time + CYCLES_PER_FRAME );
+        break;
+    case EV_BADLINE:
+        stall_cpu( ctx, BADLINE_STOLEN );
+        schedule_badline();
+        break;
+    case EV_FRAME:
+        // The log holds the whole frame that just ended.
+        log_lines();
+        check_collisions( LINES_PER_FRAME );
+        state.collision_line = 0;
+        sched->schedule( slot[EV_FRAME], time + CYCLES_PER_FRAME );
+        break;
+    }
+}
+
+//========================================================================
+void VIC::interrupt( uint8_t bits )
+{
+    state.irq_flags |= bits;
+    update_irq();
+}
+
+//========================================================================
+void VIC::update_irq()
+{
+    bool active = (state.irq_flags & state.irq_mask) != 0;
+    if( active != state.irq )
+    {
+        state.irq = active;
+        irq_out( ctx, active );
+    }
+}
+
+//========================================================================
+uint8_t VIC::peek( uint8_t reg ) const
+{
+    reg &= 0x3F;
+    int line = raster_line();
+    switch( reg )
+    {
+    case 0x11: return uint8_t( (state.regs[0x11] & 0x7F) | ((line & 0x100) >> 1) );
+    case 0x12: return uint8_t( line & 0xFF );
+    case 0x16: return state.regs[0x16] | 0xC0;
+    case 0x18: return state.regs[0x18] | 0x01;
+    case 0x19: return uint8_t( state.irq_flags | 0x70 | (state.irq ? 0x80 : 0) );
+    case 0x1A: return state.irq_mask | 0xF0;
+    }
+    if( reg >= 0x20 && reg <= 0x2E ) return state.regs[reg] | 0xF0;
+    if( reg >= 0x2F ) return 0xFF;
+    return state.regs[reg];
+}
+
+//========================================================================
+uint8_t VIC::read( uint8_t reg )
+{
+    reg &= 0x3F;
+    if( reg == 0x1E || reg == 0x1F )
+    {
+        log_lines();
+        check_collisions( raster_line() );
+    }
+    uint8_t v = peek( reg );
+    // The collision registers are cleared by reading.
+    if( reg == 0x1E || reg == 0x1F ) state.regs[reg] = 0;
+    return v;
+}
+
+//========================================================================
+void VIC::write( uint8_t reg, uint8_t value )
+{
+    reg &= 0x3F;
+    log_lines();
+    switch( reg )
+    {
+    case 0x11:
+        state.regs[0x11] = value;
+        schedule_raster( true );
+        schedule_badline();
+        break;
+    case 0x12:
+        state.regs[0x12] = value;
+        schedule_raster( true );
+        break;
+    case 0x19:
+        // Writing 1 bits acknowledges the interrupts.
+        state.irq_flags &= ~(value & 0x0F);
+        update_irq();
+        break;
+    case 0x1A:
+        state.irq_mask = value & 0x0F;
+        update_irq();
+        break;
+    case 0x16:
+        // Switching to 38 columns after the compare for 38 columns (X=$14F,
+        // cycle 56) and before the one for 40 columns (X=$158, cycle 57)
+        // keeps the side border from starting. The clock is at the end of
+        // the storing instruction, a cycle after the write.
+        if( (state.regs[0x16] & 0x08) && !(value & 0x08) &&
+            raster_cycle() >= 55 && raster_cycle() <= 57 )
+            state.line_events |= LINE_SIDES_OPEN;
+        state.regs[0x16] = value;
+        break;
+    case 0x1E: case 0x1F:
+        break; // Read only.
+    default:
+        if( reg < 0x2F ) state.regs[reg] = value;
+        break;
+    }
+}
+
+//========================================================================
+// A byte as the VIC sees it: the character ROM shows up at $1000-$1FFF
+// in banks 0 and 2.
+uint8_t VIC::vic_read( int bank, int addr ) const
+{
+    addr &= 0x3FFF;
+    if( (bank & 1) == 0 && (addr & 0x3000) == 0x1000 )
+        return char_rom[ addr & 0x0FFF ];
+    return ram[ bank * 0x4000 + addr ];
+}
+
+//========================================================================
+// The sprite display logic over the lines [0, end) of the log. A sprite
+// starts when its Y coordinate matches the raster line and is shown from
+// the next line on, 21 rows (each twice if Y expanded). For every shown
+// line visit( line, sprite, row in half rows, registers ) is called.
+template<typename Visit>
+void VIC::scan_sprites( int end, Visit visit ) const
+{
+    bool active[8] {};
+    int row[8] {};
+    for( int line = 0; line < end; line++ )
+    {
+        const uint8_t *regs = &line_log.regs[ line * LINE_REGS ];
+        for( int n = 0; n < 8; n++ )
+        {
+            if( !(regs[0x15] & (1 << n)) )
+            {
+                active[n] = false;
+                continue;
+            }
+            if( active[n] )
+            {
+                visit( line, n, row[n], regs );
+                row[n] += (regs[0x17] & (1 << n)) ? 1 : 2;
+                active[n] = row[n] < 42;
+            }
+            if( !active[n] && regs[1 + 2*n] == (line & 0xFF) )
+            {
+                active[n] = true;
+                row[n] = 0;
+            }
+        }
+    }
+}
+
+//========================================================================
+void VIC::sprite_slices( std::vector<SpriteSlice> &slices )
+{
+    log_lines();
+    scratch.reset();
+    utils::ArenaVector<SpriteSlice> per_sprite[8] { scratch, scratch, scratch, scratch,
+                                                    scratch, scratch, scratch, scratch };
+    scan_sprites( LINES_PER_FRAME, [&]( int line, int n, int row, const uint8_t *regs )
+    {
+        int bit = 1 << n;
+        SpriteSlice s;
+        s.x      = int16_t( regs[2*n] | ((regs[0x10] & bit) ? 0x100 : 0) );
+        s.line   = int16_t( line );
+        s.lines  = 1;
+        s.row    = int16_t( row );
+        s.data   = uint16_t( (regs[LINE_BANK] << 14) | (regs[LINE_POINTERS + n] << 6) );
+        s.color  = regs[0x27 + n] & 0x0F;
+        s.mc0    = regs[0x25] & 0x0F;
+        s.mc1    = regs[0x26] & 0x0F;
+        s.flags  = uint8_t( ((regs[0x1D] & bit) ? SpriteSlice::X_EXPAND : 0) |
+                            ((regs[0x17] & bit) ? SpriteSlice::Y_EXPAND : 0) |
+                            ((regs[0x1C] & bit) ? SpriteSlice::MULTICOLOR : 0) |
+                            ((regs[0x1B] & bit) ? SpriteSlice::BEHIND : 0) );
+        s.sprite = uint8_t( n );
+        //--------------------------------------------------------------
+        // Continue the last slice of this sprite if nothing changed.
+        auto &list = per_sprite[n];
+        if( row != 0 && !list.empty() )
+        {
+            SpriteSlice &last = list.back();
+            if( last.line + last.lines == line && last.x == s.x && last.data == s.data &&
+                last.color == s.color && last.mc0 == s.mc0 && last.mc1 == s.mc1 && last.flags == s.flags )
+            {
+                last.lines++;
+                return;
+            }
+        }
+        list.push_back( s );
+    } );
+    //------------------------------------------------------------------
+    slices.clear();
+    for( int n = 7; n >= 0; n-- )
+        slices.insert( slices.end(), per_sprite[n].begin(), per_sprite[n].end() );
+}
+
+//========================================================================
+// Pixels on a raster line as bits, sprite X coordinates, MSB first.
+constexpr int LINE_WORDS = 9;
+using LineBits = std::array<uint64_t, LINE_WORDS>;
+
+static void put_bits( LineBits &line, int x, uint64_t bits, int width )
+{
+    if( x < 0 || x >= LINE_WORDS * 64 )
+        return;
+    uint64_t v = bits << (64 - width);
+    int word = x >> 6, shift = x & 63;
+    line[word] |= v >> shift;
+    if( shift && word + 1 < LINE_WORDS )
+        line[word + 1] |= v << (64 - shift);
+}
+
+static bool overlap( const LineBits &a, const LineBits &b )
+{
+    uint64_t any = 0;
+    for( int i = 0; i < LINE_WORDS; i++ )
+        any |= a[i] & b[i];
+    return any != 0;
+}
+
+//========================================================================
+// Sprite-sprite and sprite-background collisions on the lines from
+// state.collision_line to "end". The background foreground pixels are
+// the set pixels in hires and the %10 and %11 pixels in multicolor.
+void VIC::check_collisions( int end )
+{
+    if( !ram || end <= state.collision_line )
+        return;
+    display_lines();
+    uint8_t sprites = 0, background = 0;
+    int current = -1;
+    uint8_t present = 0;
+    LineBits mask[8];
+    //------------------------------------------------------------------
+    auto finish_line = [&]( int line )
+    {
+        for( int i = 0; i < 8; i++ )
+            for( int j = i + 1; j < 8; j++ )
+                if( (present & (1 << i)) && (present & (1 << j)) && overlap( mask[i], mask[j] ) )
+                    sprites |= uint8_t( (1 << i) | (1 << j) );
+        //--------------------------------------------------------------
+        const uint8_t *regs = &line_log.regs[ line * LINE_REGS ];
+        const uint8_t *disp = &display[ line * DISPLAY_BYTES ];
+        if( disp[3] & DISPLAY_BORDER )
+            return;
+        LineBits bg {};
+        int bank = regs[LINE_BANK], d018 = regs[0x18];
+        bool ecm = regs[0x11] & 0x40, bmm = regs[0x11] & 0x20, mcm = regs[0x16] & 0x10;
+        bool active = disp[3] & DISPLAY_ACTIVE;
+        int rc = disp[1];
+        for( int col = 0; col < 40; col++ )
+        {
+            // In idle state the VIC shows the last byte of the bank.
+            int cell = (disp[0] * 40 + col) & 0x3FF;
+            int c = active ? vic_read( bank, ((d018 & 0xF0) << 6) + cell ) : 0;
+            int data = !active ? vic_read( bank, ecm ? 0x39FF : 0x3FFF )
+                     : bmm     ? vic_read( bank, ((d018 & 0x08) << 10) + cell * 8 + rc )
+                               : vic_read( bank, ((d018 & 0x0E) << 10) + (ecm ? c & 0x3F : c) * 8 + rc );
+            if( mcm && (bmm || (active && (color_ram[cell] & 0x08))) )
+                data = (data & 0xAA) | ((data & 0xAA) >> 1);
+            put_bits( bg, 24 + disp[2] + col * 8, uint64_t(data), 8 );
+        }
+        for( int n = 0; n < 8; n++ )
+            if( (present & (1 << n)) && overlap( mask[n], bg ) )
+                background |= uint8_t( 1 << n );
+    };
+    //------------------------------------------------------------------
+    scan_sprites( end, [&]( int line, int n, int row, const uint8_t *regs )
+    {
+        if( line < state.collision_line )
+            return;
+        if( line != current )
+        {
+            if( present )
+                finish_line( current );
+            current = line;
+            present = 0;
+        }
+        int bit = 1 << n;
+        int base = (regs[LINE_POINTERS + n] << 6) + (row >> 1) * 3;
+        uint32_t bits = uint32_t( (vic_read( regs[LINE_BANK], base ) << 16) |
+                                  (vic_read( regs[LINE_BANK], base + 1 ) << 8) |
+                                   vic_read( regs[LINE_BANK], base + 2 ) );
+        if( regs[0x1C] & bit )
+        {
+            uint32_t pairs = (bits | (bits >> 1)) & 0x555555;
+            bits = pairs | (pairs << 1);
+        }
+        int width = 24;
+        uint64_t pixels = bits;
+        if( regs[0x1D] & bit )
+        {
+            pixels = 0;
+            for( int i = 23; i >= 0; i-- )
+                pixels = (pixels << 2) | ((bits >> i) & 1 ? 3 : 0);
+            width = 48;
+        }
+        mask[n] = LineBits {};
+        put_bits( mask[n], regs[2*n] | ((regs[0x10] & bit) ? 0x100 : 0), pixels, width );
+        present |= uint8_t( bit );
+    } );
+    if( present )
+        finish_line( current );
+    state.collision_line = end;
+    //------------------------------------------------------------------
+    // The interrupts fire when the first collision is registered.
+    uint8_t irq = 0;
+    if( sprites && !state.regs[0x1E] )    irq |= 0x04;
+    if( background && !state.regs[0x1F] ) irq |= 0x02;
+    state.regs[0x1E] |= sprites;
+    state.regs[0x1F] |= background;
+    if( irq )
+        interrupt( irq );
+}
+
+//========================================================================
+} // End of namespace emu
+
+//========================================================================
+// End of file.
+//========================================================================
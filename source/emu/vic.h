@@ -0,0 +1,166 @@
+#ifndef VIC_H
+#define VIC_H
+
+#include "scheduler.h"
+#include "frame_arena.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+//========================================================================
+namespace emu {
+
+//========================================================================
+// PAL (6569) timing.
+constexpr int CYCLES_PER_LINE  = 63;
+constexpr int LINES_PER_FRAME  = 312;
+constexpr int CYCLES_PER_FRAME = CYCLES_PER_LINE * LINES_PER_FRAME;
+
+//========================================================================
+// The VIC-II video chip, as far as the emulation core is concerned:
+// registers, raster counter, raster interrupt and bad line DMA.
+// The picture itself is rendered by the gfx module from the registers
+// and the memory this class points to.
+//
+// The raster position is derived from the system clock (frame 0 starts at
+// cycle 0), so the VIC doesn't need to be stepped. The raster interrupt
+// and the bad lines are events in the Scheduler.
+class VIC : public EventHandler
+{
+public:
+    //========================================================================
+    // irq:   called when the interrupt output changes.
+    // stall: called at a bad line, the CPU is stopped for that many cycles.
+    void init( Scheduler &sched, const uint64_t &clock,
+               void (*irq)(void *ctx, bool active),
+               void (*stall)(void *ctx, int cycles), void *ctx );
+    void reset();
+    //========================================================================
+    uint8_t read ( uint8_t reg );
+    uint8_t peek ( uint8_t reg ) const;   // Read without side effects.
+    void    write( uint8_t reg, uint8_t value );
+    //========================================================================
+    void on_event( int tag, uint64_t time ) override;
+    //========================================================================
+    // Current raster position.
+    int raster_line() const  { return int( (*clock / CYCLES_PER_LINE) % LINES_PER_FRAME ); }
+    int raster_cycle() const { return int( *clock % CYCLES_PER_LINE ); }
+    //========================================================================
+    // Memory as seen by the VIC. "bank" (0-3) comes from CIA2 port A.
+    void set_bank( int bank ) { log_lines(); state.bank = uint8_t(bank & 3); }
+    uint16_t video_matrix() const { return uint16_t( state.bank * 0x4000 + ((state.regs[0x18] >> 4) & 0x0F) * 0x0400 ); }
+    uint16_t char_base()    const { return uint16_t( state.bank * 0x4000 + ((state.regs[0x18] >> 1) & 0x07) * 0x0800 ); }
+    // The character ROM is visible to the VIC at $1000-$1FFF in banks 0 and 2.
+    // Returns 0 (upper case) or 1 (lower case) for the ROM, -1 for a RAM charset.
+    int rom_charset() const;
+    //========================================================================
+    uint8_t border_color()     const { return state.regs[0x20] & 0x0F; }
+    uint8_t background_color() const { return state.regs[0x21] & 0x0F; }
+    //========================================================================
+    // The registers as they were on each raster line, so the renderer can
+    // show mode, color and bank splits: LINE_REGS bytes per line with
+    // $D000-$D02E and the bank at LINE_BANK. A register written during a
+    // line counts for that line. Lines the raster hasn't reached in this
+    // frame yet hold the values of the previous frame. The sprite pointers
+    // (at the end of the video matrix) are logged at LINE_POINTERS, what
+    // happened within the line as LINE_* bits at LINE_EVENTS.
+    static constexpr int LINE_REGS = 64;
+    static constexpr int LINE_POINTERS = 0x30;
+    static constexpr int LINE_EVENTS = 0x38;
+    static constexpr int LINE_BANK = 0x3F;
+    enum : uint8_t
+    {
+        LINE_SIDES_OPEN = 1     // 38 columns selected between the right border compares.
+    };
+    const uint8_t *raster_lines() { log_lines(); return line_log.regs.data(); }
+    // The log is part of the machine state: the collision checks read it
+    // for the lines of the frame that already passed.
+    struct LineLog
+    {
+        std::array<uint8_t, LINES_PER_FRAME * LINE_REGS> regs {};
+        uint64_t logged {0};    // The log is complete up to this line (clock / CYCLES_PER_LINE).
+    };
+    LineLog line_log;
+    //========================================================================
+    // The display state of each raster line, worked out from the log with
+    // the VIC's sequencer rules: bad lines (by the line's Y scroll), the
+    // row counter and the vertical border flip-flop. DISPLAY_BYTES per
+    // line: the text row (VCBASE / 40), the row in the character (RC),
+    // the X scroll and the DISPLAY_* flags. With these, a scroll value or
+    // a 38 column/24 row switch that changes mid-frame shows as it would.
+    static constexpr int DISPLAY_BYTES = 4;
+    enum : uint8_t
+    {
+        DISPLAY_ACTIVE = 1,     // Display state, else idle state.
+        DISPLAY_BORDER = 2,     // The vertical border covers the line.
+        DISPLAY_40COLS = 4,     // CSEL: 40 columns, else 38.
+        DISPLAY_SIDES_OPEN = 8  // The side borders are opened.
+    };
+    const uint8_t *display_lines();
+    //========================================================================
+    // The memory the VIC reads, for sprite pointers and collisions.
+    void set_memory( const uint8_t *ram, const uint8_t *char_rom, const uint8_t *color_ram );
+    //========================================================================
+    // A sprite shown with the same settings on consecutive raster lines.
+    // Multiplexers reuse the 8 sprites by changing the registers during the
+    // frame, every reuse (and every color or pointer change) is a slice.
+    struct SpriteSlice
+    {
+        enum : uint8_t { X_EXPAND = 1, Y_EXPAND = 2, MULTICOLOR = 4, BEHIND = 8 };
+        int16_t  x;         // Sprite X coordinate.
+        int16_t  line;      // First raster line.
+        int16_t  lines;     // Number of raster lines.
+        int16_t  row;       // Sprite data row on the first line, in half rows.
+        uint16_t data;      // Sprite data: bank * $4000 + pointer * 64.
+        uint8_t  color, mc0, mc1, flags;
+        uint8_t  sprite;    // 0-7
+    };
+    // The sprite slices of the frame in raster_lines(), sprite 7 first so
+    // drawing them in order gives sprite 0 the highest priority.
+    void sprite_slices( std::vector<SpriteSlice> &slices );
+    //========================================================================
+    struct State
+    {
+        uint8_t regs[0x40] {};
+        uint8_t irq_flags {0};      // $D019 bits 0-3
+        uint8_t irq_mask {0};       // $D01A bits 0-3
+        bool    irq {false};
+        uint8_t bank {0};
+        uint8_t line_events {0};    // LINE_* bits of the current line.
+        int     collision_line {0}; // Collisions are checked up to this line of the frame.
+    };
+    State state;
+
+private:
+    //========================================================================
+    enum { EV_RASTER, EV_BADLINE, EV_FRAME };
+    //========================================================================
+    Scheduler *sched {nullptr};
+    const uint64_t *clock {nullptr};
+    void (*irq_out)(void *, bool) {nullptr};
+    void (*stall_cpu)(void *, int) {nullptr};
+    void *ctx {nullptr};
+    int slot[3] {};
+    const uint8_t *ram {nullptr}, *char_rom {nullptr}, *color_ram {nullptr};
+    //------------------------------------------------------------------
+    std::array<uint8_t, LINES_PER_FRAME * DISPLAY_BYTES> display {};
+    utils::FrameArena scratch;  // The lists of sprite_slices().
+    //========================================================================
+    void log_lines();
+    bool update_display( bool border );
+    uint8_t vic_read( int bank, int addr ) const;
+    template<typename Visit> void scan_sprites( int end, Visit visit ) const;
+    void check_collisions( int end );
+    int raster_compare() const { return ((state.regs[0x11] & 0x80) << 1) | state.regs[0x12]; }
+    bool is_bad_line( int line ) const;
+    void schedule_raster( bool allow_now );
+    void schedule_badline();
+    void interrupt( uint8_t bits );
+    void update_irq();
+};
+
+//========================================================================
+} // End of namespace emu
+
+#endif // VIC_H
@@ -0,0 +1,152 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+//========================================================================
+#include "utils.h"
+//========================================================================
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+//======================================================================
+namespace utils {
+
+//======================================================================
+// A bump allocator for the transient data of a frame: reset() at the
+// start of the frame frees all of it at once. What doesn't fit into the
+// block goes into extra blocks, and the next reset() replaces them all
+// by one block that is large enough. After a few frames of warmup, a
+// frame allocates nothing.
+class FrameArena
+{
+public:
+    //========================================================================
+    explicit FrameArena( size_t capacity = 16 * 1024 ) : m_Capacity( capacity ) {}
+    NO_COPY( FrameArena );
+    //========================================================================
+    void *allocate( size_t bytes, size_t align = alignof(std::max_align_t) )
+    {
+        size_t start = (m_Used + align - 1) & ~(align - 1);
+        if( !block || start + bytes > m_Capacity )
+            return allocate_extra( bytes, align );
+        m_Used = start + bytes;
+        return block.get() + start;
+    }
+    // Room for "count" objects that need no destructor.
+    template<typename T> T *allocate_array( size_t count )
+    {
+        static_assert( std::is_trivially_destructible_v<T>, "The arena doesn't call destructors" );
+        return static_cast<T*>( allocate( count * sizeof(T), alignof(T) ) );
+    }
+    //========================================================================
+    void reset()
+    {
+        if( !block || !extra.empty() )
+        {
+            m_Capacity += extra_bytes;
+            block = std::make_unique<std::byte[]>( m_Capacity );
+            extra.clear();
+            extra_bytes = 0;
+        }
+        m_Used = 0;
+    }
+    size_t capacity() const { return m_Capacity; }
+    size_t used() const { return m_Used + extra_bytes; }
+
+private:
+    //========================================================================
+    std::unique_ptr<std::byte[]> block;
+    size_t m_Capacity;
+    size_t m_Used {0};
+    std::vector<std::unique_ptr<std::byte[]>> extra;
+    size_t extra_bytes {0};
+    //========================================================================
+    void *allocate_extra( size_t bytes, size_t align )
+    {
+        extra.push_back( std::make_unique<std::byte[]>( bytes + align ) );
+        extra_bytes += bytes + align;
+        auto address = reinterpret_cast<uintptr_t>( extra.back().get() );
+        return reinterpret_cast<void*>( (address + align - 1) & ~uintptr_t( align - 1 ) );
+    }
+};
+
+//======================================================================
+// A list that lives in a FrameArena until its next reset(). Growing
+// doubles the room and leaves the old one to the arena. Only for types
+// that can be copied with memcpy().
+template<typename T>
+class ArenaVector
+{
+    static_assert( std::is_trivially_copyable_v<T>, "ArenaVector copies with memcpy()" );
+public:
+    //========================================================================
+    ArenaVector( FrameArena &arena ) : m_Arena( &arena ) {}
+    //========================================================================
+    void push_back( const T &value )
+    {
+        if( m_Size == m_Room )
+        {
+            size_t room = m_Room ? m_Room * 2 : 16;
+            T *items = m_Arena->allocate_array<T>( room );
+            if( m_Size )
+                std::memcpy( static_cast<void*>( items ), m_Items, m_Size * sizeof(T) );
+            m_Items = items;
+            m_Room = room;
+        }
+        m_Items[ m_Size++ ] = value;
+    }
+    //========================================================================
+    T &back() { return m_Items[ m_Size - 1 ]; }
+    T *begin() const { return m_Items; }
+    T *end() const { return m_Items + m_Size; }
+    size_t size() const { return m_Size; }
+    bool empty() const { return m_Size == 0; }
+
+private:
+    FrameArena *m_Arena;
+    T *m_Items {nullptr};
+    size_t m_Size {0}, m_Room {0};
+};
+
+//======================================================================
+// Objects that are used for a while and then handed back, e.g. buffers:
+// acquire() returns one that was released before if there is one, with
+// its memory (the capacity of a string or vector) still allocated.
+// The pool owns all of them; release() doesn't reset an object.
+template<typename T>
+class ObjectPool
+{
+public:
+    //========================================================================
+    ObjectPool() = default;
+    NO_COPY( ObjectPool );
+    //========================================================================
+    T *acquire()
+    {
+        if( spare.empty() )
+        {
+            all.push_back( std::make_unique<T>() );
+            spare.reserve( all.size() );
+            return all.back().get();
+        }
+        T *object = spare.back();
+        spare.pop_back();
+        return object;
+    }
+    void release( T *object ) { spare.push_back( object ); }
+    //========================================================================
+    size_t size() const { return all.size(); }
+    size_t available() const { return spare.size(); }
+
+private:
+    std::vector<std::unique_ptr<T>> all;
+    std::vector<T*> spare;
+};
+
+//======================================================================
+} // End of namespace utils.
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,107 @@
+//======================================================================
+#include "frame_pacer.h"
+//======================================================================
+#include <algorithm>
+
+//======================================================================
+void FramePacer::init( SDL_Window *window )
+{
+    frequency = double( SDL_GetPerformanceFrequency() );
+    SDL_DisplayMode mode;
+    if( SDL_GetWindowDisplayMode( window, &mode ) == 0 && mode.refresh_rate > 0 )
+        period = 1.0 / mode.refresh_rate;
+    last_present = SDL_GetPerformanceCounter();
+    latencies.reserve( 4096 );
+    pending_inputs.reserve( 64 );
+}
+
+//======================================================================
+double FramePacer::render_budget() const
+{
+    int n = std::min( render_count, HISTORY );
+    if( n == 0 )
+        return period;  // Nothing known yet: don't sleep.
+    std::array<double, HISTORY> sorted = render_times;
+    std::nth_element( sorted.begin(), sorted.begin() + (n * 95) / 100, sorted.begin() + n );
+    return sorted[ (n * 95) / 100 ];
+}
+
+//======================================================================
+// Sleep until the next vblank minus the render budget. SDL_Delay is
+// only good to a millisecond or so, the rest is spent spinning.
+void FramePacer::wait()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 ticks = Uint64( period * frequency );
+    Uint64 vblank = last_present + ticks;
+    while( vblank <= now )
+        vblank += ticks;
+    double lead = render_budget() + SAFETY_MARGIN;
+    if( lead < period )
+    {
+        Uint64 wake = vblank - Uint64( lead * frequency );
+        if( wake > now )
+        {
+            double remaining = double( wake - now ) / frequency;
+            if( remaining > 0.002 )
+                SDL_Delay( Uint32( (remaining - 0.001) * 1000.0 ) );
+            while( SDL_GetPerformanceCounter() < wake )
+                ;
+        }
+    }
+    frame_start = SDL_GetPerformanceCounter();
+}
+
+//======================================================================
+void FramePacer::rendered()
+{
+    double t = double( SDL_GetPerformanceCounter() - frame_start ) / frequency;
+    render_times[ render_count++ % HISTORY ] = t;
+}
+
+//======================================================================
+void FramePacer::presented()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    // Every full period beyond the first is a refresh that showed the
+    // previous frame again. Not counted before the first frame.
+    double periods = double( now - last_present ) / frequency / period;
+    if( presents++ > 0 && periods > 1.5 )
+        dropped_frames += uint64_t( periods + 0.5 ) - 1;
+    last_present = now;
+    for( Uint64 arrival : pending_inputs )
+        if( latencies.size() < latencies.capacity() && arrival < last_present )
+            latencies.push_back( double( last_present - arrival ) / frequency );
+    pending_inputs.clear();
+}
+
+//======================================================================
+Uint64 FramePacer::event_time( Uint32 timestamp )
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint32 age = SDL_GetTicks() - timestamp;
+    Uint64 age_ticks = Uint64( age ) * SDL_GetPerformanceFrequency() / 1000;
+    return age_ticks < now ? now - age_ticks : 0;
+}
+
+//======================================================================
+void FramePacer::report( std::ostream &out ) const
+{
+    out << "Refresh: " << (period * 1000.0) << " ms, render budget: "
+        << (render_budget() * 1000.0) << " ms\n";
+    if( latencies.empty() )
+    {
+        out << "Input-to-photon latency: no input\n";
+        return;
+    }
+    std::vector<double> sorted = latencies;
+    std::sort( sorted.begin(), sorted.end() );
+    double sum = 0;
+    for( double l : sorted ) sum += l;
+    auto pct = [&sorted]( int p ) { return sorted[ (sorted.size() - 1) * size_t(p) / 100 ] * 1000.0; };
+    out << "Input-to-photon latency (" << sorted.size() << " events): mean "
+        << (sum / double(sorted.size()) * 1000.0) << " ms, median " << pct( 50 )
+        << " ms, p95 " << pct( 95 ) << " ms, max " << (sorted.back() * 1000.0) << " ms\n";
+}
+
+//======================================================================
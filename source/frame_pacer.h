@@ -0,0 +1,69 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+//======================================================================
+#include <SDL2/SDL.h>
+//======================================================================
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+//======================================================================
+// Just-in-time frame presentation.
+//
+// With vsync, a frame that is started right after the previous swap
+// shows input that is up to one refresh old. The pacer instead learns
+// how long emulating and rendering a frame takes, and sleeps until just
+// before the next vblank, so input is polled as late as possible:
+//
+//     pacer.wait();           // Sleep until the frame must be started.
+//     ...poll input, emulate, render...
+//     pacer.rendered();
+//     SDL_GL_SwapWindow(); glFinish();
+//     pacer.presented();
+//
+// It also keeps input-to-photon statistics: the time from the arrival
+// of an input event until the swap of the first frame that includes it.
+class FramePacer
+{
+public:
+    //========================================================================
+    // Reads the refresh rate of the window's display.
+    void init( SDL_Window *window );
+    //========================================================================
+    void wait();
+    void rendered();
+    void presented();
+    //========================================================================
+    // An input event arrived at "counter" (performance counter) and is
+    // part of the frame being rendered.
+    void input( Uint64 counter ) { pending_inputs.push_back( counter ); }
+    // Convert an SDL event timestamp (ms) to the performance counter.
+    static Uint64 event_time( Uint32 timestamp );
+    //========================================================================
+    double refresh_period() const { return period; }
+    // Refreshes that passed without a new frame, since init().
+    uint64_t dropped() const { return dropped_frames; }
+    // Render budget: 95th percentile of the recent render times.
+    double render_budget() const;
+    void report( std::ostream &out ) const;
+
+private:
+    //========================================================================
+    static constexpr double SAFETY_MARGIN = 0.0015;     // Seconds.
+    static constexpr int    HISTORY = 120;              // Frames.
+    //========================================================================
+    double period {1.0 / 60.0};
+    double frequency {1.0};         // Performance counter ticks per second.
+    Uint64 last_present {0};
+    Uint64 frame_start {0};
+    uint64_t presents {0};
+    uint64_t dropped_frames {0};
+    std::array<double, HISTORY> render_times {};
+    int render_count {0};
+    std::vector<Uint64> pending_inputs;
+    std::vector<double> latencies;  // Seconds, for the report.
+};
+
+#endif // FRAME_PACER_H
+//======================================================================
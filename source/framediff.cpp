@@ -0,0 +1,221 @@
+//======================================================================
+// glMurks64-framediff: compares frames with golden images, see
+// gfx::PackedFrame. The headless runner writes and checks them with
+// --capture and --golden.
+//======================================================================
+#include "frame_diff.h"
+#include "palette.h"
+#include "video_memory.h"
+#include "utils.h"
+//======================================================================
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+//======================================================================
+static void usage()
+{
+    std::cerr <<
+        "Usage: glMurks64-framediff [options] <expected> <actual>\n"
+        "Compares two frame files, or each frame file (*.frm) in the directory\n"
+        "<expected> with the one of the same name in the directory <actual>.\n"
+        "The exit code is 1 if a comparison failed.\n"
+        "  --tolerance <n>         Differing pixels that still pass (default: 0).\n"
+        "  --diff-dir <dir>        Where the images of the failed comparisons go,\n"
+        "                          as <name>.diff.ppm (default: the current folder).\n"
+        "  --no-images             Don't write images.\n"
+        "  --palette <name|file>   Colors of the images, see glMurks64 --palette.\n"
+        "  --threads <n>           Comparisons in parallel (default: all cores).\n"
+        "  --to-ppm <frame> <ppm>  Convert a frame file to an image, and exit.\n"
+        "  --bench <n>             Time n comparisons in memory, and exit.\n";
+}
+
+//======================================================================
+// The outcome of one comparison; boxes only for the failed ones.
+struct Result
+{
+    std::string name;
+    gfx::FrameDiff diff;
+    std::string error;
+    bool failed {false};
+};
+
+//======================================================================
+struct Options
+{
+    int tolerance {0};
+    bool images {true};
+    fs::path diff_dir {"."};
+    gfx::Palette palette;
+};
+
+//======================================================================
+// Count first, the boxes and the image are only worked out on failure.
+static void compare( const fs::path &expected, const fs::path &actual, const Options &options, Result &result )
+{
+    try
+    {
+        gfx::PackedFrame want = gfx::PackedFrame::load( expected.string() );
+        gfx::PackedFrame got  = gfx::PackedFrame::load( actual.string() );
+        result.diff = gfx::compare_frames( want, got, false );
+        if( result.diff.pixels <= options.tolerance )
+            return;
+        result.failed = true;
+        result.diff = gfx::compare_frames( want, got, true );
+        if( options.images )
+            gfx::write_diff_image( (options.diff_dir / (result.name + ".diff.ppm")).string(),
+                                   want, got, result.diff, options.palette );
+    }
+    catch( const std::runtime_error &e )
+    {
+        result.failed = true;
+        result.error = e.what();
+    }
+}
+
+//======================================================================
+static void print( const Result &result )
+{
+    std::cout << result.name << ": ";
+    if( !result.error.empty() )
+    {
+        std::cout << result.error << "\n";
+        return;
+    }
+    std::cout << result.diff.pixels << " pixels differ";
+    for( const auto &box : result.diff.boxes )
+        std::cout << ", " << box.pixels << " in (" << box.x0 << "," << box.y0 << ")-("
+                  << box.x1 << "," << box.y1 << ")";
+    std::cout << "\n";
+}
+
+//======================================================================
+// Comparisons of frames already in memory, half of them with a few
+// differing pixels. The time of loading the files is not included.
+static void bench( int count )
+{
+    std::vector<uint8_t> indices( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    for( int y = 0; y < gfx::FRAME_HEIGHT; y++ )
+        for( int x = 0; x < gfx::FRAME_WIDTH; x++ )
+            indices[ size_t( y * gfx::FRAME_WIDTH + x ) ] = uint8_t( ((x >> 3) ^ (y >> 3)) & 15 );
+    gfx::PackedFrame expected = gfx::PackedFrame::pack( indices.data(), gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    gfx::PackedFrame same = expected;
+    for( int i = 0; i < 40; i++ )
+        indices[ size_t( (100 + i / 8) * gfx::FRAME_WIDTH + 200 + i % 8 ) ] ^= 1;
+    gfx::PackedFrame different = gfx::PackedFrame::pack( indices.data(), gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    //------------------------------------------------------------------
+    auto start = std::chrono::steady_clock::now();
+    long pixels = 0;
+    for( int i = 0; i < count; i++ )
+        pixels += gfx::compare_frames( expected, (i & 1) ? different : same, false ).pixels;
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    std::cout << count << " comparisons in " << seconds << " s (" << (count / seconds) << " per second, "
+              << (double( count ) * 2 * expected.pitch() * expected.height() / seconds / 1e9) << " GB/s), "
+              << pixels << " differing pixels.\n";
+}
+
+//======================================================================
+int main(int argc, char** argv)
+{
+    Options options;
+    unsigned threads = std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector<std::string> paths;
+    try
+    {
+        for( int i = 1; i < argc; i++ )
+        {
+            std::string arg = argv[i];
+            bool has_value = (i + 1 < argc);
+            if( arg == "--tolerance" && has_value )     options.tolerance = std::atoi( argv[++i] );
+            else if( arg == "--diff-dir" && has_value ) options.diff_dir = argv[++i];
+            else if( arg == "--no-images" )             options.images = false;
+            else if( arg == "--palette" && has_value )  options.palette = gfx::Palette::load( argv[++i] );
+            else if( arg == "--threads" && has_value )  threads = unsigned( std::max( 1, std::atoi( argv[++i] ) ) );
+            else if( arg == "--bench" && has_value )
+            {
+                bench( std::atoi( argv[++i] ) );
+                return 0;
+            }
+            else if( arg == "--to-ppm" && i + 2 < argc )
+            {
+                gfx::write_frame_image( argv[i + 2], gfx::PackedFrame::load( argv[i + 1] ), options.palette );
+                return 0;
+            }
+            else if( arg.size() > 1 && arg[0] == '-' ) { usage(); return -1; }
+            else paths.push_back( arg );
+        }
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << "\n";
+        return -1;
+    }
+    if( paths.size() != 2 )
+    {
+        usage();
+        return -1;
+    }
+    //------------------------------------------------------------------
+    // The pairs: one, or the frames of the expected folder by name.
+    fs::path expected = paths[0], actual = paths[1];
+    std::vector<Result> results;
+    std::error_code error;
+    bool folder = fs::is_directory( expected, error );
+    if( folder )
+    {
+        for( const auto &entry : fs::directory_iterator( expected, error ) )
+            if( entry.path().extension() == ".frm" )
+                results.push_back( Result { entry.path().stem().string(), {}, {}, false } );
+        std::sort( results.begin(), results.end(),
+                   []( const Result &a, const Result &b ) { return a.name < b.name; } );
+    }
+    else
+        results.push_back( Result { expected.stem().string(), {}, {}, false } );
+    if( error )
+    {
+        std::cerr << "***ERROR: " << expected.string() << ": " << error.message() << "\n";
+        return -1;
+    }
+    //------------------------------------------------------------------
+    std::atomic<size_t> next { 0 };
+    auto work = [&]() {
+        for( size_t i = next++; i < results.size(); i = next++ )
+        {
+            fs::path want = folder ? expected / (results[i].name + ".frm") : expected;
+            fs::path got  = folder ? actual / (results[i].name + ".frm") : actual;
+            compare( want, got, options, results[i] );
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for( unsigned t = 1; t < std::min( threads, unsigned( results.size() ) ); t++ )
+        workers.emplace_back( work );
+    work();
+    for( auto &worker : workers )
+        worker.join();
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    //------------------------------------------------------------------
+    size_t failed = 0;
+    for( const Result &result : results )
+    {
+        if( !result.failed )
+            continue;
+        print( result );
+        failed++;
+    }
+    std::cout << failed << " of " << results.size() << " frames differ (" << seconds << " s).\n";
+    return failed ? 1 : 0;
+}
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,159 @@
+
+#include "border.h"
+#include "gfx_utils.h"
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gfx {
+
+//========================================================================
+// Vertex shader: 4 rectangles of 2 triangles each, no vertex buffer.
+static const char *vxs =
+R"(
+#version 460 core
+
+uniform mat4 MVP;           // Model-View-Projection Matrix (Camera)
+uniform vec4 rects[4];      // x0, y0, x1, y1 in pixels.
+
+out vec2 pixel;             // Output: the position in the framebuffer in pixels.
+
+const vec2 corners[6] = vec2[6]( vec2(0,0), vec2(1,0), vec2(0,1),
+                                 vec2(1,0), vec2(1,1), vec2(0,1) );
+
+void main()
+{
+    vec4 rect   = rects[ gl_VertexID / 6 ];
+    pixel       = mix( rect.xy, rect.zw, corners[ gl_VertexID % 6 ] );
+    gl_Position = MVP * vec4( pixel, 0, 1 );
+}
+)";
+
+//========================================================================
+static const char *fts =
+R"(
+#version 460 core
+
+uniform usamplerBuffer MEMORY; // 64K RAM, character ROM at $10000.
+uniform usampler2D LINES;      // VIC registers of each raster line, 4 per texel.
+uniform usampler2D DISPLAY;    // Display state of each raster line: row, RC, X scroll, flags.
+uniform sampler2D SPRITES;     // The sprite layer, alpha: 1 = in front, 0.5 = behind.
+layout( std140, binding = 0 ) uniform Palette { vec4 palette[16]; };  // Linear RGB
+uniform int first_line;        // Raster line of the first pixel row.
+uniform int first_x;           // Sprite X coordinate of the first pixel column.
+
+in vec2 pixel;
+
+out vec4 FragColor;
+
+const int CHAR_ROM = 0x10000;
+
+const int DISPLAY_BORDER = 2;
+const int DISPLAY_40COLS = 4;
+const int DISPLAY_SIDES_OPEN = 8;
+
+int vic_read( int bank, int addr )
+{
+   if( (bank & 1) == 0 && (addr & 0x3000) == 0x1000 )
+      return int( texelFetch( MEMORY, CHAR_ROM + (addr & 0x0FFF) ).r );
+   return int( texelFetch( MEMORY, bank * 0x4000 + addr ).r );
+}
+
+vec4 color( int c )
+{
+   return vec4( palette[c & 15].rgb, 1 );
+}
+
+void main()
+{
+   int line = (first_line + int(pixel.y)) % 312;
+   int x    = first_x + int(pixel.x);
+   uvec4 r10   = texelFetch( LINES, ivec2( 0x10 >> 2, line ), 0 );  // $D011 in y
+   uvec4 r20   = texelFetch( LINES, ivec2( 0x20 >> 2, line ), 0 );  // $D020, $D021 in xy
+   uvec4 r3C   = texelFetch( LINES, ivec2( 0x3C >> 2, line ), 0 );  // Bank in w
+   uvec4 state = texelFetch( DISPLAY, ivec2( 0, line ), 0 );
+   int flags   = int(state.w);
+   //---------------------------------------------------------------
+   // The side border starts at X=$158 (40 columns) or $14F (38) and
+   // ends at X=$18 or $1F.
+   bool cols40 = (flags & DISPLAY_40COLS) != 0;
+   bool side   = (flags & DISPLAY_SIDES_OPEN) == 0 &&
+                 (x < (cols40 ? 0x18 : 0x1F) || x >= (cols40 ? 0x158 : 0x14F));
+   if( (flags & DISPLAY_BORDER) != 0 || side )
+   {
+      FragColor = color( int(r20.x) );
+      return;
+   }
+   //---------------------------------------------------------------
+   // An opened border: the sequencer is idle, it shows the last byte
+   // of the bank like hires text in black, and the sprites.
+   int bank = int(r3C.w) & 3;
+   int data = vic_read( bank, (r10.y & 0x40u) != 0u ? 0x39FF : 0x3FFF );
+   bool set = ((data >> (7 - ((x - 0x18 - int(state.z)) & 7))) & 1) != 0;
+   FragColor = color( set ? 0 : int(r20.y) );
+   vec4 sprite = texelFetch( SPRITES, ivec2( gl_FragCoord.xy ), 0 );
+   if( sprite.a > 0.75 || (sprite.a > 0.25 && !set) )
+      FragColor = vec4( sprite.rgb, 1 );
+}
+)";
+
+//========================================================================
+void Border::init( text_screen &screen, int width, int height )
+{
+    m_Screen = &screen;
+    //------------------------------------------------------------------
+    program_id = gl_pool().program( "border", vxs, fts );
+    //------------------------------------------------------------------
+    loc_MVP        = glGetUniformLocation( program_id, "MVP" );
+    loc_rects      = glGetUniformLocation( program_id, "rects" );
+    loc_MEMORY     = glGetUniformLocation( program_id, "MEMORY" );
+    loc_LINES      = glGetUniformLocation( program_id, "LINES" );
+    loc_DISPLAY    = glGetUniformLocation( program_id, "DISPLAY" );
+    loc_SPRITES    = glGetUniformLocation( program_id, "SPRITES" );
+    loc_first_line = glGetUniformLocation( program_id, "first_line" );
+    loc_first_x    = glGetUniformLocation( program_id, "first_x" );
+    //------------------------------------------------------------------
+    // The frame around the text area: X $18-$157, raster lines $33-$FA.
+    float left   = float( 0x18 - FRAME_FIRST_X );
+    float top    = float( 0x33 - FRAME_FIRST_LINE );
+    float right  = left + 320;
+    float bottom = top + 200;
+    float w = float(width), h = float(height);
+    rects[0] = { 0,     0,      w,     top    };
+    rects[1] = { 0,     bottom, w,     h      };
+    rects[2] = { 0,     top,    left,  bottom };
+    rects[3] = { right, top,    w,     bottom };
+    //------------------------------------------------------------------
+    // The program is shared (see GLPool), render() sets the uniforms.
+    MVP = glm::ortho<float>( 0, w, h, 0, 1, -1 );
+    bind_palette();
+    //------------------------------------------------------------------
+    // Core profile needs a vertex array, even without attributes.
+    vertex_array_id.acquire();
+}
+
+//========================================================================
+void Border::render()
+{
+    m_Screen->bind_textures();
+    glUseProgram( program_id );
+    glUniformMatrix4fv( loc_MVP, 1, false, &MVP[0][0] );
+    glUniform4fv( loc_rects, 4, &rects[0][0] );
+    glUniform1i( loc_MEMORY, MEMORY_UNIT );
+    glUniform1i( loc_LINES, LINES_UNIT );
+    glUniform1i( loc_DISPLAY, DISPLAY_UNIT );
+    glUniform1i( loc_SPRITES, SPRITE_LAYER_UNIT );
+    glUniform1i( loc_first_line, FRAME_FIRST_LINE );
+    glUniform1i( loc_first_x, FRAME_FIRST_X );
+    glBindVertexArray( vertex_array_id );
+    glDrawArrays( GL_TRIANGLES, 0, 4 * 6 );
+    glBindVertexArray( 0 );
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
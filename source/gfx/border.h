@@ -0,0 +1,57 @@
+#ifndef BORDER_H
+#define BORDER_H
+
+#include "text_screen.h"
+#include "gfx_utils.h"
+#include "gl_pool.h"
+#include "utils.h"
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+// The border around the text screen: the frame outside the 40x25 text
+// area, drawn as 4 rectangles from gl_VertexID. The color comes from
+// $D020 of each raster line, so raster bars show. Where the emulator
+// reports the border as opened (top/bottom or sides), the background
+// color, the idle graphics and the sprites show instead.
+//
+// The 38 column and 24 row borders inside the text area are drawn by
+// the text screen, whose textures (see text_screen::bind_textures())
+// this class reads.
+class Border
+{
+public:
+    //========================================================================
+    Border() = default;
+    NO_COPY( Border );
+    NO_MOVE( Border );
+    virtual ~Border() = default;
+    //======================================================================
+    // "screen": the text screen, for its textures; "width", "height": the
+    // size of the render target (the 384x272 framebuffer).
+    void init( text_screen &screen, int width, int height );
+    void render();
+
+private:
+    text_screen *m_Screen {nullptr};
+    //======================================================================
+    GLuint program_id;  // Shared, see GLPool.
+    PooledVertexArray vertex_array_id;
+    glm::mat4 MVP {1.0f};
+    glm::vec4 rects[4];
+    //======================================================================
+    GLint loc_MVP;
+    GLint loc_rects;
+    GLint loc_MEMORY;
+    GLint loc_LINES;
+    GLint loc_DISPLAY;
+    GLint loc_SPRITES;
+    GLint loc_first_line;
+    GLint loc_first_x;
+};
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // BORDER_H
@@ -0,0 +1,288 @@
+//======================================================================
+#include "frame_diff.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+static constexpr char FRAME_MAGIC[8] = { 'C', '6', '4', 'F', 'R', 'A', 'M', 'E' };
+static constexpr size_t FRAME_HEADER = 16;
+
+//======================================================================
+PackedFrame::PackedFrame( int width, int height )
+    : m_Width( width ), m_Height( height ), pixels( size_t( width / 2 * height ) )
+{
+    if( width <= 0 || height <= 0 || (width & 1) )
+        throw std::runtime_error( "Bad frame size " + std::to_string( width ) + "x" + std::to_string( height ) );
+}
+
+//======================================================================
+PackedFrame PackedFrame::pack( const uint8_t *indices, int width, int height )
+{
+    PackedFrame frame( width, height );
+    size_t count = frame.pixels.size();
+    for( size_t i = 0; i < count; i++ )
+        frame.pixels[i] = uint8_t( (indices[i * 2] << 4) | (indices[i * 2 + 1] & 15) );
+    return frame;
+}
+
+//======================================================================
+void PackedFrame::unpack( uint8_t *indices ) const
+{
+    for( size_t i = 0; i < pixels.size(); i++ )
+    {
+        indices[i * 2]     = pixels[i] >> 4;
+        indices[i * 2 + 1] = pixels[i] & 15;
+    }
+}
+
+//======================================================================
+PackedFrame PackedFrame::load( const std::string &filename )
+{
+    std::ifstream in( filename, std::ios::binary );
+    uint8_t head[FRAME_HEADER];
+    if( !in.read( reinterpret_cast<char*>( head ), FRAME_HEADER ) )
+        throw std::runtime_error( "Can't read frame " + filename );
+    if( std::memcmp( head, FRAME_MAGIC, sizeof(FRAME_MAGIC) ) != 0 )
+        throw std::runtime_error( "Not a frame file: " + filename );
+    PackedFrame frame( head[8] | (head[9] << 8), head[10] | (head[11] << 8) );
+    if( !in.read( reinterpret_cast<char*>( frame.pixels.data() ), std::streamsize( frame.pixels.size() ) ) )
+        throw std::runtime_error( "Truncated frame file: " + filename );
+    return frame;
+}
+
+//======================================================================
+void PackedFrame::save( const std::string &filename ) const
+{
+    uint8_t head[FRAME_HEADER] = {};
+    std::memcpy( head, FRAME_MAGIC, sizeof(FRAME_MAGIC) );
+    head[8]  = uint8_t( m_Width );
+    head[9]  = uint8_t( m_Width >> 8 );
+    head[10] = uint8_t( m_Height );
+    head[11] = uint8_t( m_Height >> 8 );
+    std::ofstream out( filename, std::ios::binary );
+    out.write( reinterpret_cast<const char*>( head ), FRAME_HEADER );
+    out.write( reinterpret_cast<const char*>( pixels.data() ), std::streamsize( pixels.size() ) );
+    if( !out )
+        throw std::runtime_error( "Can't write frame " + filename );
+}
+
+//======================================================================
+// The differing pixels of a row: the XOR of the packed bytes has a non
+// zero nibble for each. 16 bytes at a time, the nibbles are folded onto
+// bits 0 and 4 of each byte, and those are summed up with PSADBW.
+static int row_differences( const uint8_t *a, const uint8_t *b, int bytes )
+{
+    int count = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i lows = _mm_set1_epi8( 0x01 );
+    __m128i sum = _mm_setzero_si128();
+    for( ; i + 16 <= bytes; i += 16 )
+    {
+        __m128i x = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) ),
+                                   _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) ) );
+        // Shifting 16 bit lanes mixes the neighbour byte into bits 5-7 only.
+        x = _mm_or_si128( x, _mm_srli_epi16( x, 2 ) );
+        x = _mm_or_si128( x, _mm_srli_epi16( x, 1 ) );
+        x = _mm_add_epi8( _mm_and_si128( x, lows ), _mm_and_si128( _mm_srli_epi16( x, 4 ), lows ) );
+        sum = _mm_add_epi64( sum, _mm_sad_epu8( x, _mm_setzero_si128() ) );
+    }
+    count = _mm_cvtsi128_si32( sum ) + _mm_cvtsi128_si32( _mm_srli_si128( sum, 8 ) );
+#endif
+    for( ; i < bytes; i++ )
+    {
+        uint8_t x = a[i] ^ b[i];
+        count += ((x & 0xF0) != 0) + ((x & 0x0F) != 0);
+    }
+    return count;
+}
+
+//======================================================================
+static void grow( DiffBox &box, const DiffBox &other )
+{
+    box.x0 = std::min( box.x0, other.x0 );
+    box.y0 = std::min( box.y0, other.y0 );
+    box.x1 = std::max( box.x1, other.x1 );
+    box.y1 = std::max( box.y1, other.y1 );
+    box.pixels += other.pixels;
+}
+
+//======================================================================
+// The cells with differences that touch (also diagonally) make a box.
+static std::vector<DiffBox> group_cells( std::vector<DiffBox> &cells, int cols, int rows )
+{
+    std::vector<DiffBox> boxes;
+    std::vector<int> stack;
+    for( int start = 0; start < cols * rows; start++ )
+    {
+        if( cells[start].pixels == 0 )
+            continue;
+        DiffBox box = cells[start];
+        cells[start].pixels = 0;
+        stack.push_back( start );
+        while( !stack.empty() )
+        {
+            int cell = stack.back();
+            stack.pop_back();
+            int cx = cell % cols, cy = cell / cols;
+            for( int ny = std::max( cy - 1, 0 ); ny <= std::min( cy + 1, rows - 1 ); ny++ )
+            {
+                for( int nx = std::max( cx - 1, 0 ); nx <= std::min( cx + 1, cols - 1 ); nx++ )
+                {
+                    DiffBox &next = cells[ ny * cols + nx ];
+                    if( next.pixels == 0 )
+                        continue;
+                    grow( box, next );
+                    next.pixels = 0;
+                    stack.push_back( ny * cols + nx );
+                }
+            }
+        }
+        boxes.push_back( box );
+    }
+    return boxes;
+}
+
+//======================================================================
+FrameDiff compare_frames( const PackedFrame &expected, const PackedFrame &actual, bool boxes )
+{
+    if( expected.width() != actual.width() || expected.height() != actual.height() )
+        throw std::runtime_error( "The frames have different sizes" );
+    FrameDiff diff;
+    int pitch = expected.pitch();
+    int cols = (expected.width() + 7) / 8;
+    int rows = (expected.height() + 7) / 8;
+    std::vector<DiffBox> cells;     // Only needed when there are differences.
+    //------------------------------------------------------------------
+    for( int y = 0; y < expected.height(); y++ )
+    {
+        const uint8_t *a = expected.data() + y * pitch;
+        const uint8_t *b = actual.data() + y * pitch;
+        int count = row_differences( a, b, pitch );
+        if( count == 0 )
+            continue;
+        diff.pixels += count;
+        if( !boxes )
+            continue;
+        //--------------------------------------------------------------
+        // The bounds of the differences in each 8x8 cell.
+        if( cells.empty() )
+            cells.assign( size_t( cols * rows ), DiffBox { INT_MAX, INT_MAX, INT_MIN, INT_MIN, 0 } );
+        for( int i = 0; i < pitch; i++ )
+        {
+            uint8_t x = a[i] ^ b[i];
+            for( int half = 0; half < 2 && x; half++ )
+            {
+                if( (x & (half ? 0x0F : 0xF0)) == 0 )
+                    continue;
+                int px = i * 2 + half;
+                grow( cells[ (y / 8) * cols + px / 8 ], DiffBox { px, y, px + 1, y + 1, 1 } );
+            }
+        }
+    }
+    //------------------------------------------------------------------
+    if( boxes && diff.pixels )
+        diff.boxes = group_cells( cells, cols, rows );
+    return diff;
+}
+
+//======================================================================
+static void write_ppm( const std::string &filename, int width, int height, const std::vector<uint8_t> &rgb )
+{
+    std::ofstream out( filename, std::ios::binary );
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write( reinterpret_cast<const char*>( rgb.data() ), std::streamsize( rgb.size() ) );
+    if( !out )
+        throw std::runtime_error( "Can't write " + filename );
+}
+
+//======================================================================
+// The 8 bit sRGB of a palette index.
+static const uint8_t *rgb_of( const Palette &palette, uint8_t index )
+{
+    return reinterpret_cast<const uint8_t*>( &palette.pixels()[ index ] );
+}
+
+//======================================================================
+void write_frame_image( const std::string &filename, const PackedFrame &frame, const Palette &palette )
+{
+    std::vector<uint8_t> rgb( size_t( frame.width() * frame.height() * 3 ) );
+    for( int y = 0; y < frame.height(); y++ )
+    {
+        for( int x = 0; x < frame.width(); x++ )
+        {
+            std::memcpy( &rgb[ size_t( (y * frame.width() + x) * 3 ) ], rgb_of( palette, frame.pixel( x, y ) ), 3 );
+        }
+    }
+    write_ppm( filename, frame.width(), frame.height(), rgb );
+}
+
+//======================================================================
+void write_diff_image( const std::string &filename, const PackedFrame &expected,
+                       const PackedFrame &actual, const FrameDiff &diff, const Palette &palette )
+{
+    int w = expected.width(), h = expected.height();
+    int width = w * 3;
+    std::vector<uint8_t> rgb( size_t( width * h * 3 ) );
+    auto put = [&]( int x, int y, int r, int g, int b ) {
+        uint8_t *p = &rgb[ size_t( (y * width + x) * 3 ) ];
+        p[0] = uint8_t( r );
+        p[1] = uint8_t( g );
+        p[2] = uint8_t( b );
+    };
+    //------------------------------------------------------------------
+    for( int y = 0; y < h; y++ )
+    {
+        for( int x = 0; x < w; x++ )
+        {
+            const uint8_t *want = rgb_of( palette, expected.pixel( x, y ) );
+            const uint8_t *got  = rgb_of( palette, actual.pixel( x, y ) );
+            put( x, y, want[0], want[1], want[2] );
+            put( x + w, y, got[0], got[1], got[2] );
+            if( expected.pixel( x, y ) != actual.pixel( x, y ) )
+                put( x + 2 * w, y, 255, 0, 0 );
+            else
+            {
+                int gray = (want[0] * 3 + want[1] * 6 + want[2]) / 40;
+                put( x + 2 * w, y, gray, gray, gray );
+            }
+        }
+    }
+    //------------------------------------------------------------------
+    // The boxes, one pixel outside of them where there is room.
+    for( const DiffBox &box : diff.boxes )
+    {
+        int x0 = std::max( box.x0 - 1, 0 ), x1 = std::min( box.x1, w - 1 );
+        int y0 = std::max( box.y0 - 1, 0 ), y1 = std::min( box.y1, h - 1 );
+        for( int x = x0; x <= x1; x++ )
+        {
+            put( x + 2 * w, y0, 255, 255, 0 );
+            put( x + 2 * w, y1, 255, 255, 0 );
+        }
+        for( int y = y0; y <= y1; y++ )
+        {
+            put( x0 + 2 * w, y, 255, 255, 0 );
+            put( x1 + 2 * w, y, 255, 255, 0 );
+        }
+    }
+    write_ppm( filename, width, h, rgb );
+}
+
+//======================================================================
+} // End of namespace gfx
+
+//======================================================================
+// End of file.
+//======================================================================
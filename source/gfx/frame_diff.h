@@ -0,0 +1,86 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+class Palette;
+
+//======================================================================
+// A frame of palette indices at 4 bits per pixel, two pixels per byte,
+// the left one in the high nibble: 52K for the 384x272 framebuffer.
+// The golden images of the regression tests are kept like this.
+class PackedFrame
+{
+public:
+    //======================================================================
+    PackedFrame() = default;
+    // A frame of color 0. The width must be even.
+    PackedFrame( int width, int height );
+    // Pack width * height palette indices, of which the low nibbles count.
+    static PackedFrame pack( const uint8_t *indices, int width, int height );
+    void unpack( uint8_t *indices ) const;
+    //======================================================================
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+    int pitch() const { return m_Width / 2; }
+    const uint8_t *data() const { return pixels.data(); }
+    uint8_t pixel( int x, int y ) const
+    {
+        uint8_t b = pixels[ size_t( y * pitch() + x / 2 ) ];
+        return (x & 1) ? b & 15 : b >> 4;
+    }
+    //======================================================================
+    // A frame file: "C64FRAME", width and height (16 bit little endian),
+    // 4 bytes reserved, then the packed pixels. Throw std::runtime_error.
+    static PackedFrame load( const std::string &filename );
+    void save( const std::string &filename ) const;
+
+private:
+    //======================================================================
+    int m_Width {0}, m_Height {0};
+    std::vector<uint8_t> pixels;
+};
+
+//======================================================================
+// Differing pixels in a rectangle, x1 and y1 exclusive.
+struct DiffBox
+{
+    int x0, y0, x1, y1;
+    int pixels;
+};
+
+//======================================================================
+// The result of compare_frames().
+struct FrameDiff
+{
+    int pixels {0};                 // Differing pixels in all.
+    std::vector<DiffBox> boxes;     // The touching 8x8 cells with differences.
+    bool same() const { return pixels == 0; }
+};
+
+//======================================================================
+// Compare two frames of the same size (else std::runtime_error). Equal
+// rows cost an XOR per 32 pixels; only the rows that differ are looked
+// at pixel by pixel, and only if "boxes" are wanted.
+FrameDiff compare_frames( const PackedFrame &expected, const PackedFrame &actual, bool boxes = true );
+
+//======================================================================
+// A PPM image of a failed comparison, three frames side by side: the
+// expected, the actual, and the expected dimmed with the differing
+// pixels in red and the boxes around them in yellow.
+// Throws std::runtime_error.
+void write_diff_image( const std::string &filename, const PackedFrame &expected,
+                       const PackedFrame &actual, const FrameDiff &diff, const Palette &palette );
+// A frame as a PPM image. Throws std::runtime_error.
+void write_frame_image( const std::string &filename, const PackedFrame &frame, const Palette &palette );
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // FRAME_DIFF_H
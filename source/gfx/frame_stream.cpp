@@ -0,0 +1,418 @@
+//======================================================================
+#include "frame_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+using namespace stream;
+
+namespace {
+    enum : uint8_t
+    {
+        OP_SKIP      = 0x00,
+        OP_REF       = 0x40,
+        OP_SOLID     = 0x80,
+        OP_SOLID_RUN = 0xA0,
+        OP_TWO       = 0xC0,
+        OP_RAW       = 0xC1
+    };
+    constexpr int SKIP_MAX = 64;    // In the op byte.
+} // End of namespace
+
+//======================================================================
+uint32_t FrameEncoder::hash( const Tile &tile )
+{
+    uint64_t h = 0;
+    for( int i = 0; i < 32; i += 8 )
+    {
+        uint64_t v;
+        std::memcpy( &v, tile.data() + i, 8 );
+        h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    }
+    return uint32_t( h >> 32 );
+}
+
+//======================================================================
+void FrameEncoder::init( int width, int height, int keyframe_interval )
+{
+    if( width <= 0 || height <= 0 || width % TILE || height % TILE || width > 0xFFFF || height > 0xFFFF )
+        throw std::runtime_error( "Bad frame size for streaming" );
+    m_Width = width;
+    m_Height = height;
+    cols = width / TILE;
+    rows = height / TILE;
+    m_Interval = std::max( keyframe_interval, 1 );
+    m_Frame = 0;
+    m_Force = true;
+    previous.assign( size_t( width * height ), 0 );
+    dictionary.assign( DICTIONARY, Tile {} );
+    hashes.assign( DICTIONARY, 0 );
+    index.assign( INDEX_SIZE, NONE );
+    message.reserve( max_message() );
+    reset_dictionary();
+}
+
+//======================================================================
+// A keyframe of raw tiles: header, and an op plus the tile for each.
+size_t FrameEncoder::max_message() const
+{
+    return LENGTH_BYTES + 9 + size_t( cols * rows ) * (1 + sizeof(Tile));
+}
+
+//======================================================================
+void FrameEncoder::reset_dictionary()
+{
+    std::fill( index.begin(), index.end(), NONE );
+    next_slot = 0;
+    entries = 0;
+}
+
+//======================================================================
+// The slot of the tile in the dictionary, or -1.
+int FrameEncoder::find( const Tile &tile, uint32_t h ) const
+{
+    for( int i = int( h % INDEX_SIZE ); index[ size_t(i) ] != NONE; i = (i + 1) % INDEX_SIZE )
+    {
+        int slot = index[ size_t(i) ];
+        if( hashes[ size_t(slot) ] == h && dictionary[ size_t(slot) ] == tile )
+            return slot;
+    }
+    return -1;
+}
+
+//======================================================================
+// The entries after a removed one move back if they are no longer in
+// their probe sequence otherwise (no tombstones).
+void FrameEncoder::remove_from_index( int slot )
+{
+    int i = int( hashes[ size_t(slot) ] % INDEX_SIZE );
+    while( index[ size_t(i) ] != slot )
+        i = (i + 1) % INDEX_SIZE;
+    for( int j = (i + 1) % INDEX_SIZE; index[ size_t(j) ] != NONE; j = (j + 1) % INDEX_SIZE )
+    {
+        int home = int( hashes[ index[ size_t(j) ] ] % INDEX_SIZE );
+        // Can the entry at j move to i: is i on the way from home to j?
+        bool on_way = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if( on_way )
+        {
+            index[ size_t(i) ] = index[ size_t(j) ];
+            i = j;
+        }
+    }
+    index[ size_t(i) ] = NONE;
+}
+
+//======================================================================
+void FrameEncoder::add_to_dictionary( const Tile &tile, uint32_t h )
+{
+    if( entries == DICTIONARY )
+        remove_from_index( next_slot );
+    else
+        entries++;
+    dictionary[ size_t(next_slot) ] = tile;
+    hashes[ size_t(next_slot) ] = h;
+    int i = int( h % INDEX_SIZE );
+    while( index[ size_t(i) ] != NONE )
+        i = (i + 1) % INDEX_SIZE;
+    index[ size_t(i) ] = uint16_t( next_slot );
+    next_slot = (next_slot + 1) % DICTIONARY;
+}
+
+//======================================================================
+void FrameEncoder::put_varint( uint32_t value )
+{
+    while( value >= 0x80 )
+    {
+        message += char( (value & 0x7F) | 0x80 );
+        value >>= 7;
+    }
+    message += char( value );
+}
+
+//======================================================================
+void FrameEncoder::put_skip( int count )
+{
+    if( count <= 0 )
+        return;
+    if( count < SKIP_MAX )
+        message += char( OP_SKIP | (count - 1) );
+    else
+    {
+        message += char( OP_SKIP | (SKIP_MAX - 1) );
+        put_varint( uint32_t( count - SKIP_MAX ) );
+    }
+}
+
+//======================================================================
+void FrameEncoder::put_solid( int color, int count )
+{
+    if( count == 1 )
+        message += char( OP_SOLID | color );
+    else if( count > 1 )
+    {
+        message += char( OP_SOLID_RUN | color );
+        put_varint( uint32_t( count - 2 ) );
+    }
+}
+
+//======================================================================
+// A tile of more than one color: from the dictionary, or as two colors
+// and a mask, or raw.
+void FrameEncoder::put_tile( const Tile &tile )
+{
+    uint32_t h = hash( tile );
+    int slot = find( tile, h );
+    if( slot >= 0 )
+    {
+        message += char( OP_REF | (slot >> 8) );
+        message += char( slot & 0xFF );
+        return;
+    }
+    add_to_dictionary( tile, h );
+    //------------------------------------------------------------------
+    int bg = tile[0] >> 4, fg = -1;
+    uint8_t mask[8] = {};
+    for( int i = 0; i < 64; i++ )
+    {
+        uint8_t b = tile[ size_t( i / 2 ) ];
+        int c = (i & 1) ? b & 15 : b >> 4;
+        if( c == bg )
+            continue;
+        if( fg < 0 )
+            fg = c;
+        else if( c != fg )
+        {
+            message += char( OP_RAW );
+            message.append( reinterpret_cast<const char*>( tile.data() ), tile.size() );
+            return;
+        }
+        mask[ i / 8 ] |= uint8_t( 0x80 >> (i % 8) );
+    }
+    message += char( OP_TWO );
+    message += char( (bg << 4) | fg );
+    message.append( reinterpret_cast<const char*>( mask ), sizeof(mask) );
+}
+
+//======================================================================
+// The 8 rows of a tile, 8 bytes each, as one 64 bit compare per row.
+bool FrameEncoder::same_tile( const uint8_t *a, const uint8_t *b ) const
+{
+    uint64_t diff = 0;
+    for( int y = 0; y < TILE; y++, a += m_Width, b += m_Width )
+    {
+        uint64_t x, z;
+        std::memcpy( &x, a, 8 );
+        std::memcpy( &z, b, 8 );
+        diff |= x ^ z;
+    }
+    return diff == 0;
+}
+
+//======================================================================
+const std::string &FrameEncoder::encode( const uint8_t *indices )
+{
+    m_Keyframe = m_Force || m_Frame % uint32_t( m_Interval ) == 0;
+    m_Force = false;
+    message.assign( LENGTH_BYTES, '\0' );
+    message += char( m_Keyframe ? KEYFRAME : DELTA );
+    for( int i = 0; i < 4; i++ )
+        message += char( m_Frame >> (i * 8) );
+    if( m_Keyframe )
+    {
+        for( int value : { m_Width, m_Height } )
+        {
+            message += char( value & 0xFF );
+            message += char( value >> 8 );
+        }
+        reset_dictionary();
+    }
+    //------------------------------------------------------------------
+    // The runs of unchanged and of single color tiles are written when
+    // they end.
+    int skip = 0, solid_color = -1, solid_run = 0;
+    Tile tile;
+    for( int ty = 0; ty < rows; ty++ )
+    {
+        for( int tx = 0; tx < cols; tx++ )
+        {
+            size_t offset = size_t( ty * TILE * m_Width + tx * TILE );
+            if( !m_Keyframe && same_tile( indices + offset, previous.data() + offset ) )
+            {
+                put_solid( solid_color, solid_run );
+                solid_run = 0;
+                skip++;
+                continue;
+            }
+            const uint8_t *src = indices + offset;
+            for( int y = 0; y < TILE; y++, src += m_Width )
+                for( int x = 0; x < TILE; x += 2 )
+                    tile[ size_t( y * 4 + x / 2 ) ] = uint8_t( (src[x] << 4) | (src[x + 1] & 15) );
+            put_skip( skip );
+            skip = 0;
+            //----------------------------------------------------------
+            int color = tile[0] & 15;
+            bool solid = (tile[0] >> 4) == color;
+            for( size_t i = 1; solid && i < tile.size(); i++ )
+                solid = tile[i] == tile[0];
+            if( solid && solid_run && color == solid_color )
+            {
+                solid_run++;
+                continue;
+            }
+            put_solid( solid_color, solid_run );
+            solid_run = 0;
+            if( solid )
+            {
+                solid_color = color;
+                solid_run = 1;
+            }
+            else
+                put_tile( tile );
+        }
+    }
+    put_solid( solid_color, solid_run );
+    std::memcpy( previous.data(), indices, previous.size() );
+    //------------------------------------------------------------------
+    uint32_t length = uint32_t( message.size() - LENGTH_BYTES );
+    for( size_t i = 0; i < LENGTH_BYTES; i++ )
+        message[i] = char( length >> (i * 8) );
+    m_Frame++;
+    return message;
+}
+
+//======================================================================
+bool FrameDecoder::decode( const uint8_t *data, size_t size )
+{
+    size_t pos = 0;
+    auto need = [&]( size_t n ) {
+        if( size - pos < n )
+            throw std::runtime_error( "Truncated frame message" );
+    };
+    auto byte = [&]() { need( 1 ); return data[pos++]; };
+    auto varint = [&]() {
+        uint32_t value = 0;
+        for( int shift = 0; shift < 35; shift += 7 )
+        {
+            uint8_t b = byte();
+            value |= uint32_t( b & 0x7F ) << shift;
+            if( (b & 0x80) == 0 )
+                return value;
+        }
+        throw std::runtime_error( "Bad varint in frame message" );
+    };
+    //------------------------------------------------------------------
+    uint8_t kind = byte();
+    if( kind != KEYFRAME && kind != DELTA )
+        throw std::runtime_error( "Unknown frame message" );
+    need( 4 );
+    uint32_t frame = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16) | (uint32_t( data[pos + 3] ) << 24);
+    pos += 4;
+    if( kind == KEYFRAME )
+    {
+        need( 4 );
+        int width  = data[pos] | (data[pos + 1] << 8);
+        int height = data[pos + 2] | (data[pos + 3] << 8);
+        pos += 4;
+        if( width <= 0 || height <= 0 || width % TILE || height % TILE )
+            throw std::runtime_error( "Bad frame size in keyframe" );
+        m_Width = width;
+        m_Height = height;
+        pixels.assign( size_t( width * height ), 0 );
+        dictionary.assign( DICTIONARY, {} );
+        next_slot = 0;
+    }
+    else if( pixels.empty() )
+        return false;
+    m_Frame = frame;
+    //------------------------------------------------------------------
+    int cols = m_Width / TILE;
+    int tiles = cols * (m_Height / TILE);
+    int tile = 0;
+    auto solid = [&]( int color, uint32_t count ) {
+        if( count > uint32_t( tiles - tile ) )
+            throw std::runtime_error( "Too many tiles in frame message" );
+        for( ; count; count--, tile++ )
+        {
+            uint8_t *dst = &pixels[ size_t( (tile / cols) * TILE * m_Width + (tile % cols) * TILE ) ];
+            for( int y = 0; y < TILE; y++, dst += m_Width )
+                std::memset( dst, color, TILE );
+        }
+    };
+    auto packed = [&]( const uint8_t *src ) {
+        if( tile >= tiles )
+            throw std::runtime_error( "Too many tiles in frame message" );
+        uint8_t *dst = &pixels[ size_t( (tile / cols) * TILE * m_Width + (tile % cols) * TILE ) ];
+        for( int y = 0; y < TILE; y++, dst += m_Width )
+            for( int x = 0; x < TILE; x += 2 )
+            {
+                dst[x]     = src[ y * 4 + x / 2 ] >> 4;
+                dst[x + 1] = src[ y * 4 + x / 2 ] & 15;
+            }
+        tile++;
+    };
+    //------------------------------------------------------------------
+    while( pos < size )
+    {
+        uint8_t op = byte();
+        if( op < OP_REF )
+        {
+            uint32_t count = uint32_t( op & 0x3F ) + 1;
+            if( count == SKIP_MAX )
+                count += varint();
+            if( count > uint32_t( tiles - tile ) )
+                throw std::runtime_error( "Too many tiles in frame message" );
+            tile += int( count );
+        }
+        else if( op < OP_SOLID )
+        {
+            int index = ((op & 0x3F) << 8) | byte();
+            if( index >= DICTIONARY )
+                throw std::runtime_error( "Bad dictionary index in frame message" );
+            packed( dictionary[ size_t( index ) ].data() );
+        }
+        else if( (op & 0xF0) == OP_SOLID )
+            solid( op & 15, 1 );
+        else if( (op & 0xF0) == OP_SOLID_RUN )
+            solid( op & 15, varint() + 2 );
+        else if( op == OP_TWO || op == OP_RAW )
+        {
+            auto &entry = dictionary[ size_t( next_slot ) ];
+            next_slot = (next_slot + 1) % DICTIONARY;
+            if( op == OP_RAW )
+            {
+                need( entry.size() );
+                std::memcpy( entry.data(), data + pos, entry.size() );
+                pos += entry.size();
+            }
+            else
+            {
+                uint8_t colors = byte();
+                need( 8 );
+                for( int i = 0; i < 64; i++ )
+                {
+                    int c = (data[ pos + size_t( i / 8 ) ] & (0x80 >> (i % 8))) ? colors & 15 : colors >> 4;
+                    uint8_t &b = entry[ size_t( i / 2 ) ];
+                    b = (i & 1) ? uint8_t( (b & 0xF0) | c ) : uint8_t( (b & 0x0F) | (c << 4) );
+                }
+                pos += 8;
+            }
+            packed( entry.data() );
+        }
+        else
+            throw std::runtime_error( "Unknown op in frame message" );
+    }
+    return true;
+}
+
+//======================================================================
+} // End of namespace gfx
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,128 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+// A stream of frames of palette indices (see render_frame()) in 8x8
+// tiles, for viewers in other processes. Only the tiles that changed
+// since the last frame are sent.
+//
+// A message is its length (32 bit little endian, the rest of the
+// message), the kind ('K' keyframe or 'D' delta), the frame number
+// (32 bit), for keyframes the width and height (16 bit each), then the
+// tiles in rows from the top left. Each op byte is:
+//   00nnnnnn          n + 1 tiles unchanged (n = 63: plus a varint)
+//   01iiiiii iiiiiiii the tile in the dictionary at index i
+//   1000cccc          one tile of color c
+//   1010cccc varint   a run of 2 + varint tiles of color c
+//   11000000 bg|fg m  two colors (the background in the high nibble)
+//                     and 8 bytes of mask (a set bit is fg, MSB left)
+//   11000001 32 bytes the pixels, 4 bits each, the left one high
+// Tiles after the last op are unchanged. Two color and raw tiles also
+// go into the dictionary, at the next of DICTIONARY slots round robin,
+// so the glyphs of a text screen cost 2 bytes once they were sent.
+// Keyframes have all tiles and start with an empty dictionary: a viewer
+// can start at any keyframe.
+//
+// An unchanged frame is 9 bytes, a blinking cursor a few more.
+namespace stream {
+    constexpr uint8_t KEYFRAME = 'K';
+    constexpr uint8_t DELTA    = 'D';
+    constexpr size_t  LENGTH_BYTES = 4;
+    constexpr int     DICTIONARY = 4096;
+    constexpr int     TILE = 8;
+} // End of namespace stream
+
+//======================================================================
+class FrameEncoder
+{
+public:
+    //======================================================================
+    // Frames of width x height indices, both multiples of 8. A keyframe
+    // every "keyframe_interval" frames.
+    void init( int width, int height, int keyframe_interval = 250 );
+    // Make the next frame a keyframe, e.g. for a new viewer.
+    void request_keyframe() { m_Force = true; }
+    //======================================================================
+    // The message of the next frame: width * height palette indices, of
+    // which the low nibbles count. Returns the message, valid until the
+    // next call.
+    const std::string &encode( const uint8_t *indices );
+    bool last_was_keyframe() const { return m_Keyframe; }
+    uint32_t frames() const { return m_Frame; }
+    // The size of the largest message (a keyframe of tiles that are all
+    // different), for buffers that must not grow.
+    size_t max_message() const;
+
+private:
+    //======================================================================
+    // A tile as 8 rows of 4 bytes, like the rows of a PackedFrame.
+    using Tile = std::array<uint8_t, 32>;
+    // The index of the dictionary: linear probing in a table of twice its
+    // size, with the slots of the tiles. Nothing in the encoder allocates
+    // after init().
+    static constexpr int INDEX_SIZE = 2 * stream::DICTIONARY;
+    static constexpr uint16_t NONE = 0xFFFF;
+    int m_Width {0}, m_Height {0};
+    int cols {0}, rows {0};
+    int m_Interval {250};
+    uint32_t m_Frame {0};
+    bool m_Force {true};
+    bool m_Keyframe {false};
+    std::vector<uint8_t> previous;  // The frame the viewers have.
+    std::vector<Tile> dictionary;
+    std::vector<uint32_t> hashes;   // Of the tiles in the dictionary.
+    std::vector<uint16_t> index;    // Dictionary slots, or NONE.
+    int next_slot {0};
+    int entries {0};
+    std::string message;
+    //======================================================================
+    static uint32_t hash( const Tile &tile );
+    void reset_dictionary();
+    int find( const Tile &tile, uint32_t h ) const;
+    void add_to_dictionary( const Tile &tile, uint32_t h );
+    void remove_from_index( int slot );
+    bool same_tile( const uint8_t *a, const uint8_t *b ) const;
+    void put_tile( const Tile &tile );
+    void put_skip( int count );
+    void put_solid( int color, int count );
+    void put_varint( uint32_t value );
+};
+
+//======================================================================
+class FrameDecoder
+{
+public:
+    //======================================================================
+    // Decode a message without its length. Deltas before the first
+    // keyframe are ignored: returns false then. Throws std::runtime_error
+    // if the message is malformed.
+    bool decode( const uint8_t *data, size_t size );
+    //======================================================================
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+    uint32_t frame() const { return m_Frame; }
+    // The palette indices of the frame, width * height.
+    const uint8_t *indices() const { return pixels.data(); }
+    bool has_frame() const { return !pixels.empty(); }
+
+private:
+    //======================================================================
+    int m_Width {0}, m_Height {0};
+    uint32_t m_Frame {0};
+    std::vector<uint8_t> pixels;
+    std::vector<std::array<uint8_t, 32>> dictionary;
+    int next_slot {0};
+};
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // FRAME_STREAM_H
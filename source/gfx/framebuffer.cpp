@@ -17,12 +17,13 @@ namespace gfx {
     {
         // --------------------------------------------------------------
         // Generate a framebuffer and bind it.
-        glGenFramebuffers(1,&framebuffer_name);
+        framebuffer_name.acquire();
         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_name);
         // --------------------------------------------------------------
-        // Generate a texture for the framebuffer.
-        Rect.tex.gen().activate(0).bind(GL_TEXTURE_2D)
-            .iformat(GL_RGB).size(w,h).format(GL_RGB).type(GL_UNSIGNED_BYTE).Image2D( nullptr )
+        // Generate a texture for the framebuffer. It holds sRGB, so
+        // the linear filtering when it is drawn is done on linear colors.
+        Rect.tex.activate(0)
+            .iformat(GL_SRGB8_ALPHA8).size(w,h).format(GL_RGBA).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
             .Pi(GL_TEXTURE_WRAP_S, GL_CLAMP)
             .Pi(GL_TEXTURE_WRAP_T, GL_CLAMP)
             .Pi(GL_TEXTURE_MIN_FILTER, GL_LINEAR) //GL_LINEAR_MIPMAP_LINEAR)
@@ -41,6 +42,7 @@ namespace gfx {
         // --------------------------------------------------------------
         // Create the rectangle for drawing the framebuffer on the screen.
         Rect.init( 0,0, w, h );
+        Rect.encode_srgb( true );
         // --------------------------------------------------------------
     }
     //========================================================================
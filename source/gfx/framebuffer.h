@@ -3,6 +3,7 @@
 
 #include "rectangle.h"
 #include "gfx_utils.h"
+#include "gl_pool.h"
 #include <glad/glad.h>
 #include <stdexcept>
 
@@ -34,7 +35,7 @@ public:
     Rectangle Rect; // Provides a texture and a rectangle shader for drawing the framebuffer on the screen.
     //========================================================================
 private:
-    GLuint framebuffer_name {0};
+    PooledFramebuffer framebuffer_name;
 };
 
 //========================================================================
@@ -6,6 +6,46 @@
 //========================================================================
 namespace gfx {
 
+//========================================================================
+// A function, so the palette is made after the built-in tables.
+static Palette &palette()
+{
+    static Palette current;
+    return current;
+}
+static GLuint palette_buffer {0};
+
+//========================================================================
+void bind_palette()
+{
+    if( palette_buffer == 0 )
+    {
+        glGenBuffers( 1, &palette_buffer );
+        glBindBuffer( GL_UNIFORM_BUFFER, palette_buffer );
+        glBufferData( GL_UNIFORM_BUFFER, sizeof(palette().linear()), palette().linear().data(), GL_DYNAMIC_DRAW );
+        glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    }
+    glBindBufferBase( GL_UNIFORM_BUFFER, PALETTE_BINDING, palette_buffer );
+}
+
+//========================================================================
+void set_palette( const Palette &new_palette )
+{
+    palette() = new_palette;
+    if( palette_buffer != 0 )
+    {
+        glBindBuffer( GL_UNIFORM_BUFFER, palette_buffer );
+        glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(palette().linear()), palette().linear().data() );
+        glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    }
+}
+
+//========================================================================
+const Palette &current_palette()
+{
+    return palette();
+}
+
 //========================================================================
 GLuint compile_shader(GLenum type, const char * code )
 {
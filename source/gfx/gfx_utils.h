@@ -6,11 +6,27 @@
 #include <glad/glad.h>
 #include <array>
 
+#include "palette.h"
+
 //========================================================================
 namespace gfx {
 
 //========================================================================
-extern std::array<glm::ivec3, 16> color_table;
+// The palette of all renderers is a uniform buffer, shared by their
+// programs through the binding point PALETTE_BINDING:
+//
+//     layout( std140, binding = 0 ) uniform Palette { vec4 palette[16]; };
+//
+// with the colors as linear RGB. The renderers draw into sRGB textures,
+// so the output is converted back when it is written.
+constexpr GLuint PALETTE_BINDING = 0;
+// Create the buffer (with the current palette) if there is none yet, and
+// bind it. Done by the renderers at init.
+void bind_palette();
+// Switch to another palette. Only the buffer is updated, so this takes
+// effect with the next frame.
+void set_palette( const Palette &palette );
+const Palette &current_palette();
 
 //========================================================================
 template<typename T>
@@ -0,0 +1,111 @@
+#ifndef GL_OBJECTS_H
+#define GL_OBJECTS_H
+
+#include "utils.h"
+
+#include <glad/glad.h>
+
+//========================================================================
+namespace gfx {
+
+//========================================================================
+// The kinds of GL objects: how to make and delete one, and how to reset
+// one to its initial state before it is used again (see GLPool).
+struct BufferKind
+{
+    static constexpr int INDEX = 0;
+    static GLuint create() { GLuint name; glGenBuffers( 1, &name ); return name; }
+    static void destroy( GLuint name ) { glDeleteBuffers( 1, &name ); }
+    static void clean( GLuint ) {}
+};
+
+struct TextureKind
+{
+    static constexpr int INDEX = 1;
+    static GLuint create() { GLuint name; glGenTextures( 1, &name ); return name; }
+    static void destroy( GLuint name ) { glDeleteTextures( 1, &name ); }
+    static void clean( GLuint ) {}
+};
+
+struct VertexArrayKind
+{
+    static constexpr int INDEX = 2;
+    static GLuint create() { GLuint name; glGenVertexArrays( 1, &name ); return name; }
+    static void destroy( GLuint name ) { glDeleteVertexArrays( 1, &name ); }
+    // No attributes: the text screen and the border draw with an empty
+    // one. 16 is the least GL_MAX_VERTEX_ATTRIBS, more than we use.
+    static void clean( GLuint name )
+    {
+        glBindVertexArray( name );
+        for( GLuint i = 0; i < 16; i++ )
+        {
+            glDisableVertexAttribArray( i );
+            glVertexAttribDivisor( i, 0 );
+        }
+        glBindVertexArray( 0 );
+    }
+};
+
+struct FramebufferKind
+{
+    static constexpr int INDEX = 3;
+    static GLuint create() { GLuint name; glGenFramebuffers( 1, &name ); return name; }
+    static void destroy( GLuint name ) { glDeleteFramebuffers( 1, &name ); }
+    // Let go of the texture, it goes back to the pool on its own.
+    static void clean( GLuint name )
+    {
+        glBindFramebuffer( GL_FRAMEBUFFER, name );
+        glFramebufferTexture( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0 );
+        glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    }
+};
+
+struct ProgramKind
+{
+    static GLuint create() { return glCreateProgram(); }
+    static void destroy( GLuint name ) { glDeleteProgram( name ); }
+};
+
+constexpr int POOLED_KINDS = 4;
+
+//========================================================================
+// Owns a GL object ("name") of a kind: deleted with the handle, can be
+// moved (into containers), not copied. 0 is no object.
+template<typename Kind>
+class GLObject
+{
+public:
+    //========================================================================
+    GLObject() = default;
+    explicit GLObject( GLuint name ) : m_Name( name ) {}
+    GLObject( GLObject &&other ) noexcept : m_Name( other.release() ) {}
+    GLObject &operator=( GLObject &&other ) noexcept { reset( other.release() ); return *this; }
+    NO_COPY( GLObject );
+    ~GLObject() { reset(); }
+    //========================================================================
+    static GLObject create() { return GLObject( Kind::create() ); }
+    operator GLuint() const { return m_Name; }
+    // Give up the object without deleting it.
+    GLuint release() { GLuint name = m_Name; m_Name = 0; return name; }
+    // Delete the object, and own "name" instead.
+    void reset( GLuint name = 0 )
+    {
+        if( m_Name != 0 )
+            Kind::destroy( m_Name );
+        m_Name = name;
+    }
+
+private:
+    GLuint m_Name {0};
+};
+
+using GLBuffer      = GLObject<BufferKind>;
+using GLTexture     = GLObject<TextureKind>;
+using GLVertexArray = GLObject<VertexArrayKind>;
+using GLFramebuffer = GLObject<FramebufferKind>;
+using GLProgram     = GLObject<ProgramKind>;
+
+//========================================================================
+} // End of namespace gfx
+
+#endif // GL_OBJECTS_H
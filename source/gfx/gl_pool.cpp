@@ -0,0 +1,74 @@
+#include "gl_pool.h"
+#include "gfx_utils.h"
+
+//========================================================================
+namespace gfx {
+
+//========================================================================
+GLPool &gl_pool()
+{
+    static GLPool pool;
+    return pool;
+}
+
+//========================================================================
+GLuint GLPool::program( const std::string &name, const char *vxs, const char *fts, const char *gms )
+{
+    auto found = shared_programs.find( name );
+    if( found != shared_programs.end() )
+        return found->second;
+    //------------------------------------------------------------------
+    GLuint vxs_id = compile_shader( GL_VERTEX_SHADER, vxs );
+    GLuint gms_id = gms ? compile_shader( GL_GEOMETRY_SHADER, gms ) : 0;
+    GLuint fts_id = compile_shader( GL_FRAGMENT_SHADER, fts );
+    GLProgram program( link_program( vxs_id, fts_id, gms_id ) );
+    glDeleteShader( vxs_id );
+    if( gms_id )
+        glDeleteShader( gms_id );
+    glDeleteShader( fts_id );
+    //------------------------------------------------------------------
+    GLuint id = program;
+    shared_programs.emplace( name, std::move( program ) );
+    return id;
+}
+
+//========================================================================
+ShaderVariants &GLPool::variants( const std::string &name, const std::function<void(ShaderVariants&)> &init )
+{
+    auto &variants = shared_variants[ name ];
+    if( !variants )
+    {
+        variants = std::make_unique<ShaderVariants>();
+        init( *variants );
+    }
+    return *variants;
+}
+
+//========================================================================
+size_t GLPool::programs() const
+{
+    size_t count = shared_programs.size();
+    for( const auto &variants : shared_variants )
+        count += variants.second->size();
+    return count;
+}
+
+//========================================================================
+void GLPool::clear()
+{
+    for( const auto &s : spare[ BufferKind::INDEX ] )      BufferKind::destroy( s.name );
+    for( const auto &s : spare[ TextureKind::INDEX ] )     TextureKind::destroy( s.name );
+    for( const auto &s : spare[ VertexArrayKind::INDEX ] ) VertexArrayKind::destroy( s.name );
+    for( const auto &s : spare[ FramebufferKind::INDEX ] ) FramebufferKind::destroy( s.name );
+    for( auto &list : spare )
+        list.clear();
+    shared_programs.clear();
+    shared_variants.clear();
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
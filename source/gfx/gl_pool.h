@@ -0,0 +1,162 @@
+#ifndef GL_POOL_H
+#define GL_POOL_H
+
+#include "gl_objects.h"
+#include "shader_variants.h"
+#include "utils.h"
+
+#include <glad/glad.h>
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//========================================================================
+namespace gfx {
+
+//========================================================================
+// What a pooled object was made for: a buffer of "size" bytes, a texture
+// of "target", internal format and size. Zero for objects without
+// storage (vertex arrays, framebuffers).
+struct PoolKey
+{
+    GLenum target {0};
+    GLint format {0};
+    GLsizeiptr width {0};   // Or the bytes of a buffer.
+    GLsizei height {0};
+    bool operator==( const PoolKey &other ) const
+    {
+        return target == other.target && format == other.format &&
+               width == other.width && height == other.height;
+    }
+};
+
+//========================================================================
+// The GL objects of renderers that were destroyed, for the next ones:
+// a session that is torn down leaves its buffers, textures, vertex
+// arrays and framebuffers here, and the next one with the same formats
+// and sizes takes them, storage and all. The shader programs of the
+// renderers are built once and shared by all instances.
+//
+// There is one pool (gl_pool()), for the one GL context of the program.
+// Everything in it is deleted by clear() or at the exit.
+class GLPool
+{
+public:
+    //========================================================================
+    GLPool() = default;
+    NO_COPY( GLPool );
+    NO_MOVE( GLPool );
+    virtual ~GLPool() { clear(); }
+    //========================================================================
+    // An object made for "key", "fresh" if it was made now: then its
+    // storage is up to the caller.
+    template<typename Kind> GLObject<Kind> take( const PoolKey &key, bool &fresh )
+    {
+        auto &list = spare[ Kind::INDEX ];
+        for( size_t i = list.size(); i-- > 0; )
+        {
+            if( list[i].key == key )
+            {
+                GLuint name = list[i].name;
+                list[i] = list.back();
+                list.pop_back();
+                fresh = false;
+                m_Reused++;
+                return GLObject<Kind>( name );
+            }
+        }
+        fresh = true;
+        m_Created++;
+        return GLObject<Kind>::create();
+    }
+    template<typename Kind> void give( GLObject<Kind> &&object, const PoolKey &key )
+    {
+        Kind::clean( object );
+        spare[ Kind::INDEX ].push_back( { key, object.release() } );
+    }
+    //========================================================================
+    // The program "name" of the given stages (see link_program()), built
+    // the first time it is asked for. Its uniforms are shared as well:
+    // renderers set theirs when they draw.
+    GLuint program( const std::string &name, const char *vxs, const char *fts, const char *gms = nullptr );
+    // Shader variants (see ShaderVariants) shared in the same way, "init"
+    // is called to set them up the first time.
+    ShaderVariants &variants( const std::string &name, const std::function<void(ShaderVariants&)> &init );
+    //========================================================================
+    // Objects made and taken from the pool so far, programs built.
+    size_t created() const { return m_Created; }
+    size_t reused() const { return m_Reused; }
+    size_t programs() const;
+    // Delete everything in the pool and all shared programs.
+    void clear();
+
+private:
+    struct Spare { PoolKey key; GLuint name; };
+    std::array<std::vector<Spare>, POOLED_KINDS> spare;
+    std::unordered_map<std::string, GLProgram> shared_programs;
+    std::unordered_map<std::string, std::unique_ptr<ShaderVariants>> shared_variants;
+    size_t m_Created {0};
+    size_t m_Reused {0};
+};
+
+//========================================================================
+GLPool &gl_pool();
+
+//========================================================================
+// A GL object from the pool that goes back to it when the handle is
+// destroyed (or reset(), or acquire() is called again). Movable, so the
+// renderers that hold them are.
+template<typename Kind>
+class Pooled
+{
+public:
+    //========================================================================
+    Pooled() = default;
+    NO_COPY( Pooled );
+    Pooled( Pooled &&other ) noexcept : object( std::move( other.object ) ), m_Key( other.m_Key ) {}
+    Pooled &operator=( Pooled &&other ) noexcept
+    {
+        if( this != &other )
+        {
+            reset();
+            object = std::move( other.object );
+            m_Key = other.m_Key;
+        }
+        return *this;
+    }
+    ~Pooled() { reset(); }
+    //========================================================================
+    // Take an object made for "key". Returns true if it is new and needs
+    // its storage.
+    bool acquire( const PoolKey &key = {} )
+    {
+        reset();
+        bool fresh;
+        object = gl_pool().take<Kind>( key, fresh );
+        m_Key = key;
+        return fresh;
+    }
+    void reset()
+    {
+        if( object != 0 )
+            gl_pool().give( std::move( object ), m_Key );
+    }
+    operator GLuint() const { return object; }
+    const PoolKey &key() const { return m_Key; }
+
+private:
+    GLObject<Kind> object;
+    PoolKey m_Key;
+};
+
+using PooledBuffer      = Pooled<BufferKind>;
+using PooledVertexArray = Pooled<VertexArrayKind>;
+using PooledFramebuffer = Pooled<FramebufferKind>;
+
+//========================================================================
+} // End of namespace gfx
+
+#endif // GL_POOL_H
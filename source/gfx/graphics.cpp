@@ -7,71 +7,51 @@
 #include <glm/glm.hpp>
 
 #include <iostream>
+#include <vector>
 namespace gfx {
 
-//========================================================================
-// C64 color table. Taken from the screenshot of the C64-wiki.com
-// https://www.c64-wiki.com/wiki/color
-// Note: The values in the table on the same site are different!
-std::array<glm::ivec3, 16> color_table { {
-    {    0,    0,    0 }, //  0  Black
-    {  255,  255,  255 }, //  1  White
-    {  146,   74,   64 }, //  2  Red
-    {  132,  197,  204 }, //  3  Cyan
-    {  147,   81,  182 }, //  4  Violet
-    {  114,  177,   75 }, //  5  Green
-    {   72,   58,  170 }, //  6  Blue
-    {  213,  223,  124 }, //  7  Yellow
-    {  103,   82,    0 }, //  8  Orange
-    {   87,   66,    0 }, //  9  Brown
-    {  193,  129,  120 }, // 10  Light Red
-    {   96,   96,   96 }, // 11  Dark Grey
-    {  138,  138,  138 }, // 12  Grey
-    {  179,  236,  145 }, // 13  Light Green
-    {  134,  122,  222 }, // 14  Light Blue
-    {  179,  179,  179 }  // 15  Light Grey
-} };
-
-
 //========================================================================
 void Graphics::init()
 {
     constexpr int cols=40, rows=25;
     //------------------------------------------------------------------
     // Initialize the framebuffer.
-    frame.init(384, 272);
+    frame.init( FRAME_WIDTH, FRAME_HEIGHT );
     //------------------------------------------------------------------
     // Load the character generator ROM.
     auto chargen { utils::RM.load("roms/chargen") };
     //------------------------------------------------------------------
-    // Initialize the border and text screen.
-    screen.init( chargen, cols, rows, glm::vec2 { 32, 36 } );
-    border.init( chargen,   48,   35, glm::vec2 {  0, -4 } );
+    // Initialize the text screen.
+    screen.init( chargen, cols, rows, glm::vec2 { FRAME_TEXT_X, FRAME_TEXT_Y } );
     //------------------------------------------------------------------
     // Everything that renders to the framebuffer, must be 
     // adjusted to the framebuffer size.
-    border.resize_screen ( frame.Rect.tex.width(), frame.Rect.tex.height() );
     screen.resize_screen ( frame.Rect.tex.width(), frame.Rect.tex.height() );
     //------------------------------------------------------------------
-#if 1 // Put something on the screen - just for testing.
-    int max_chars = rows*cols;
-    uint8_t chars[max_chars*2];    // A buffer representing the text screen.
-    uint8_t colrs[max_chars*2];    // A buffer representing the color memory.    
-    for( int i=0; i<max_chars*2; i++ )
-    {
-        chars[i]=i; // 32 = Space character
-        colrs[i]=14; // 14 = light blue color
-    }
-    border.set_bg_color( 14 );
+    // The sprites read the text screen's memory and are shown by it and
+    // in opened borders.
+    sprites.init( screen.memory_buffer_id(), frame.Rect.tex.width(), frame.Rect.tex.height() );
+    screen.show_sprites( &sprites.layer );
+    border.init( screen, frame.Rect.tex.width(), frame.Rect.tex.height() );
+    //------------------------------------------------------------------
+    // Clear the screen, it is updated from the emulation by set_screen().
+    // 32 = Space character, 14 = light blue color.
+    std::vector<uint8_t> chars( rows*cols, 32 );
+    std::vector<uint8_t> colrs( rows*cols, 14 );
     screen.set_bg_color( 6 );
-    border.set_memories( chars, colrs );
-    screen.set_memories ( chars, colrs );
-#endif
+    screen.set_memories ( chars.data(), colrs.data() );
 }
 
 //========================================================================
 void Graphics::render()
 {
+    //------------------------------------------------------------------
+    // The shaders output linear colors, converted to sRGB when written
+    // to the sprite layer and the framebuffer.
+    glEnable( GL_FRAMEBUFFER_SRGB );
+    //------------------------------------------------------------------
+    // The sprite layer first, the text screen puts it on top.
+    sprites.render();
     //------------------------------------------------------------------
     // RENDERING TO THE FRAMEBUFFER
     //------------------------------------------------------------------
@@ -90,6 +70,7 @@ void Graphics::render()
     //------------------------------------------------------------------
     // Deactivate the framebuffer to enable rendering to the screen.
     frame.deactivate();
+    glDisable( GL_FRAMEBUFFER_SRGB );   // The framebuffer's shader encodes itself.
     glViewport(0,0, m_Width, m_Height);
     //------------------------------------------------------------------
     //glClearColor( 0,0,0, 0.0f);
@@ -99,6 +80,18 @@ void Graphics::render()
     frame.render(); // Render the frame buffer on the screen.
 }
 
+//========================================================================
+void Graphics::set_screen( const VideoMemory &vic )
+{
+    m_Uploaded += screen.set_vic( vic );
+}
+
+//========================================================================
+void Graphics::set_sprites( const SpriteSlice *slices, int count )
+{
+    m_Uploaded += sprites.set_slices( slices, count );
+}
+
 //========================================================================
 void Graphics::resize_screen(int width, int height)
 {
@@ -6,6 +6,8 @@
 #include "framebuffer.h"
 #include "text_screen.h"
 #include "rectangle.h"
+#include "sprites.h"
+#include "border.h"
 
 #include "gfx_utils.h"
 
@@ -19,12 +21,21 @@ public:
     void init();
     void render();
     void resize_screen(int width, int height);
+    //------------------------------------------------------------------
+    // Show the emulated memory as the VIC sees it, border included.
+    void set_screen( const VideoMemory &vic );
+    // The sprite slices of the frame, see Sprites.
+    void set_sprites( const SpriteSlice *slices, int count );
+    // Bytes uploaded by set_screen() and set_sprites() since the last call.
+    size_t take_uploaded_bytes() { size_t n = m_Uploaded; m_Uploaded = 0; return n; }
 
 private:
     int m_Width, m_Height;
+    size_t m_Uploaded {0};
 
     text_screen screen;
-    text_screen border;
+    Border border;
+    Sprites sprites;
     Framebuffer frame;
 };
 
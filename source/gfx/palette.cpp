@@ -0,0 +1,162 @@
+//========================================================================
+#include "palette.h"
+#include "utils.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace gfx {
+
+//========================================================================
+// The built-in palettes.
+struct BuiltinPalette
+{
+    const char *name;
+    std::array<glm::ivec3, Palette::COLORS> colors;
+};
+
+static const BuiltinPalette builtin_palettes[] {
+    //--------------------------------------------------------------------
+    // Taken from the screenshot of the C64-wiki.com
+    // https://www.c64-wiki.com/wiki/color
+    // Note: The values in the table on the same site are different!
+    { "c64-wiki", { {
+        {    0,    0,    0 }, //  0  Black
+        {  255,  255,  255 }, //  1  White
+        {  146,   74,   64 }, //  2  Red
+        {  132,  197,  204 }, //  3  Cyan
+        {  147,   81,  182 }, //  4  Violet
+        {  114,  177,   75 }, //  5  Green
+        {   72,   58,  170 }, //  6  Blue
+        {  213,  223,  124 }, //  7  Yellow
+        {  103,   82,    0 }, //  8  Orange
+        {   87,   66,    0 }, //  9  Brown
+        {  193,  129,  120 }, // 10  Light Red
+        {   96,   96,   96 }, // 11  Dark Grey
+        {  138,  138,  138 }, // 12  Grey
+        {  179,  236,  145 }, // 13  Light Green
+        {  134,  122,  222 }, // 14  Light Blue
+        {  179,  179,  179 }  // 15  Light Grey
+    } } },
+    //--------------------------------------------------------------------
+    // Philip "Pepto" Timmermann's measurement of a PAL C64.
+    { "pepto", { {
+        { 0x00, 0x00, 0x00 }, { 0xFF, 0xFF, 0xFF }, { 0x68, 0x37, 0x2B }, { 0x70, 0xA4, 0xB2 },
+        { 0x6F, 0x3D, 0x86 }, { 0x58, 0x8D, 0x43 }, { 0x35, 0x28, 0x79 }, { 0xB8, 0xC7, 0x6F },
+        { 0x6F, 0x4F, 0x25 }, { 0x43, 0x39, 0x00 }, { 0x9A, 0x67, 0x59 }, { 0x44, 0x44, 0x44 },
+        { 0x6C, 0x6C, 0x6C }, { 0x9A, 0xD2, 0x84 }, { 0x6C, 0x5E, 0xB5 }, { 0x95, 0x95, 0x95 }
+    } } },
+    //--------------------------------------------------------------------
+    // Colodore, Pepto's later model of the VIC-II's colors.
+    { "colodore", { {
+        { 0x00, 0x00, 0x00 }, { 0xFF, 0xFF, 0xFF }, { 0x81, 0x33, 0x38 }, { 0x75, 0xCE, 0xC8 },
+        { 0x8E, 0x3C, 0x97 }, { 0x56, 0xAC, 0x4D }, { 0x2E, 0x2C, 0x9B }, { 0xED, 0xF1, 0x71 },
+        { 0x8E, 0x50, 0x29 }, { 0x55, 0x38, 0x00 }, { 0xC4, 0x6C, 0x71 }, { 0x4A, 0x4A, 0x4A },
+        { 0x7B, 0x7B, 0x7B }, { 0xA9, 0xFF, 0x9F }, { 0x70, 0x6D, 0xEB }, { 0xB2, 0xB2, 0xB2 }
+    } } },
+};
+
+//========================================================================
+static float srgb_to_linear( int value )
+{
+    float c = float(value) / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow( (c + 0.055f) / 1.055f, 2.4f );
+}
+
+//========================================================================
+Palette::Palette()
+    : Palette( builtin_palettes[0].name, builtin_palettes[0].colors )
+{
+}
+
+//========================================================================
+Palette::Palette( const std::string &name, const std::array<glm::ivec3, COLORS> &colors )
+    : m_Name( name ), m_Srgb( colors )
+{
+    for( int i = 0; i < COLORS; i++ )
+    {
+        const glm::ivec3 &c = colors[i];
+        m_Linear[i] = glm::vec4( srgb_to_linear( c[0] ), srgb_to_linear( c[1] ), srgb_to_linear( c[2] ), 1.0f );
+    }
+    for( int i = 0; i < 256; i++ )
+    {
+        const glm::ivec3 &c = colors[i & 15];
+        uint8_t bytes[4] { uint8_t(c[0]), uint8_t(c[1]), uint8_t(c[2]), 255 };
+        std::memcpy( &m_Pixels[i], bytes, 4 );
+    }
+}
+
+//========================================================================
+const std::vector<std::string> &Palette::builtin_names()
+{
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> list;
+        for( const auto &p : builtin_palettes )
+            list.push_back( p.name );
+        return list;
+    }();
+    return names;
+}
+
+//========================================================================
+Palette Palette::parse_vpl( const char *text, size_t size, const std::string &name )
+{
+    std::array<glm::ivec3, COLORS> colors;
+    int count = 0;
+    std::istringstream in( std::string( text, size ) );
+    std::string line;
+    while( std::getline( in, line ) )
+    {
+        auto hash = line.find( '#' );
+        if( hash != std::string::npos )
+            line.erase( hash );
+        std::istringstream fields( line );
+        int r, g, b;
+        if( !(fields >> std::hex >> r) )
+            continue;   // Empty line
+        if( !(fields >> g >> b) || r > 255 || g > 255 || b > 255 || r < 0 || g < 0 || b < 0 )
+            throw std::runtime_error( "Palette " + name + ": bad line \"" + line + "\"" );
+        if( count == COLORS )
+            throw std::runtime_error( "Palette " + name + ": more than 16 colors" );
+        colors[count++] = glm::ivec3( r, g, b );
+    }
+    if( count != COLORS )
+        throw std::runtime_error( "Palette " + name + ": only " + std::to_string( count ) + " colors" );
+    return Palette( name, colors );
+}
+
+//========================================================================
+Palette Palette::load( const std::string &name )
+{
+    for( const auto &p : builtin_palettes )
+        if( name == p.name )
+            return Palette( p.name, p.colors );
+    //------------------------------------------------------------------
+    std::filesystem::path file { name };
+    try
+    {
+        if( std::filesystem::exists( file ) )
+        {
+            utils::Buffer text( name );
+            return parse_vpl( text.data(), text.size(), file.stem().string() );
+        }
+        if( !file.has_extension() )
+            file += ".vpl";
+        auto text { utils::RM.load( (std::filesystem::path( "palettes" ) / file).string() ) };
+        return parse_vpl( text.data(), text.size(), file.stem().string() );
+    }
+    catch( int )
+    {
+        throw std::runtime_error( "Can't load palette " + name );
+    }
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,66 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+// The 16 colors of the VIC, with the lookup tables derived from them:
+// linear RGB for the shaders (which render into sRGB framebuffers) and
+// packed 32 bit pixels for rendering on the CPU.
+//
+// A palette is one of the built-in ones, or a VICE palette file (.vpl):
+// lines of "red green blue [dither]" in hex, '#' starts a comment.
+class Palette
+{
+public:
+    static constexpr int COLORS = 16;
+    //======================================================================
+    // The "c64-wiki" palette.
+    Palette();
+    //======================================================================
+    // A built-in palette ("pepto", "colodore", "c64-wiki"), a .vpl file,
+    // or a .vpl file in the "palettes" folder of the resources (the
+    // extension may be left out there). Throws std::runtime_error.
+    static Palette load( const std::string &name );
+    static const std::vector<std::string> &builtin_names();
+    // Parse the text of a .vpl file. Throws std::runtime_error.
+    static Palette parse_vpl( const char *text, size_t size, const std::string &name );
+    //======================================================================
+    const std::string &name() const { return m_Name; }
+    // The colors as 8 bit sRGB.
+    const std::array<glm::ivec3, COLORS> &srgb() const { return m_Srgb; }
+    // The colors as linear RGB, alpha 1. (The layout of a std140 vec4 array.)
+    const std::array<glm::vec4, COLORS> &linear() const { return m_Linear; }
+    // The pixel for each byte, of which the low nibble is the color:
+    // 8 bit sRGB, bytes R, G, B, A (255) in memory.
+    const std::array<uint32_t, 256> &pixels() const { return m_Pixels; }
+    //======================================================================
+    // Convert "count" color indices to pixels, one lookup per pixel.
+    void to_pixels( const uint8_t *indices, uint32_t *out, size_t count ) const
+    {
+        for( size_t i = 0; i < count; i++ )
+            out[i] = m_Pixels[ indices[i] ];
+    }
+
+private:
+    std::string m_Name;
+    std::array<glm::ivec3, COLORS> m_Srgb;
+    std::array<glm::vec4, COLORS> m_Linear;
+    std::array<uint32_t, 256> m_Pixels;
+    //======================================================================
+    Palette( const std::string &name, const std::array<glm::ivec3, COLORS> &colors );
+};
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // PALETTE_H
@@ -1,6 +1,7 @@
 
 #include "rectangle.h"
 #include "gfx_utils.h"
+#include "gl_pool.h"
 #include <glad/glad.h>
 
 //========================================================================
@@ -25,11 +26,17 @@ static const char *vxs =
 static const char *fts =
     "#version 330 core\n"
     "uniform sampler2D TEX;" // Defines which texture to use.
+    "uniform bool to_srgb;"  // Encode the (linear) texture color as sRGB.
     "in vec2 texcoord;"     // Input: The texture coordinates of the pixel.
     "out vec4 FragColor;"   // Output: The calculated color of the pixel.
     "void main()" // Shader: Look up the color of the pixel in the
     "{"           // texture bitmap.
     "    FragColor = vec4( texture( TEX, texcoord ) );"
+    "    if( to_srgb )"
+    "    {"
+    "        vec3 c = FragColor.rgb;"
+    "        FragColor.rgb = mix( c * 12.92, 1.055 * pow( c, vec3(1.0/2.4) ) - 0.055, step( 0.0031308, c ) );"
+    "    }"
     "}";
 
 //========================================================================
@@ -44,13 +51,8 @@ typedef struct
 void Rectangle::init(GLfloat x, GLfloat y, GLfloat w, GLfloat h )
 {
     //------------------------------------------------------------------
-    // Create a new vertex shader object.
-    GLuint shader_id_vxs = compile_shader( GL_VERTEX_SHADER, vxs );
-    //------------------------------------------------------------------
-    // Create a new fragment shader object.
-    GLuint shader_id_fts = compile_shader( GL_FRAGMENT_SHADER, fts );
-    //------------------------------------------------------------------
-    program_id = link_program( shader_id_vxs, shader_id_fts );
+    // The program of all rectangles, built by the first one.
+    program_id = gl_pool().program( "rectangle", vxs, fts );
 
     //======================================================================
     // Geometry relevant init.
@@ -60,23 +62,12 @@ void Rectangle::init(GLfloat x, GLfloat y, GLfloat w, GLfloat h )
     GLint loc_tPos = glGetAttribLocation( program_id, "tPos" );
     loc_TEX = glGetUniformLocation( program_id, "TEX"  );
     loc_MVP = glGetUniformLocation( program_id, "MVP"  );
+    loc_to_srgb = glGetUniformLocation( program_id, "to_srgb"  );
     //------------------------------------------------------------------
     // Create a vertex attribute array and bind it.
-    glGenVertexArrays(1, &vertex_array_id);
+    vertex_array_id.acquire();
     glBindVertexArray(vertex_array_id);
     //------------------------------------------------------------------
-    // Create a new buffer and bind it for the vertex attribute array.
-    GLuint vertex_buffer_id;
-    glGenBuffers(1, &vertex_buffer_id);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id);
-    //------------------------------------------------------------------
-    // Enable shader input "vPos" and describe its layout in the vertex buffer.
-    glEnableVertexAttribArray(loc_vPos);
-    glVertexAttribPointer( loc_vPos, 3, GL_FLOAT, GL_FALSE, sizeof(TexRectVertex), (void*)(0*sizeof(float)) /* <- 0 = offset of x in TexRectVertex */ );
-    //------------------------------------------------------------------
-    glEnableVertexAttribArray( loc_tPos);
-    glVertexAttribPointer( loc_tPos, 2, GL_FLOAT, GL_FALSE, sizeof(TexRectVertex), (void*)(3*sizeof(float)) /* <- 3 = offset of u in TexRectVertex */ );
-    //------------------------------------------------------------------
     // Define 4 vertices that make up a rectangle.
     float z=0;
     TexRectVertex vertices[4] =
@@ -87,25 +78,37 @@ void Rectangle::init(GLfloat x, GLfloat y, GLfloat w, GLfloat h )
         { x+w, y+h, z,    1, 1 },
     };
     //------------------------------------------------------------------
-    // Upload the vertices to the vertex buffer.
-    glBufferData( GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_DYNAMIC_DRAW );
+    // A buffer for the vertices, bound for the vertex attribute array,
+    // and the vertices uploaded into it.
+    bool fresh = vertex_buffer_id.acquire( { GL_ARRAY_BUFFER, 0, sizeof(vertices) } );
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id);
+    if( fresh )
+        glBufferData( GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_DYNAMIC_DRAW );
+    else
+        glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(vertices), &vertices[0] );
+    //------------------------------------------------------------------
+    // Enable shader input "vPos" and describe its layout in the vertex buffer.
+    glEnableVertexAttribArray(loc_vPos);
+    glVertexAttribPointer( loc_vPos, 3, GL_FLOAT, GL_FALSE, sizeof(TexRectVertex), (void*)(0*sizeof(float)) /* <- 0 = offset of x in TexRectVertex */ );
+    //------------------------------------------------------------------
+    glEnableVertexAttribArray( loc_tPos);
+    glVertexAttribPointer( loc_tPos, 2, GL_FLOAT, GL_FALSE, sizeof(TexRectVertex), (void*)(3*sizeof(float)) /* <- 3 = offset of u in TexRectVertex */ );
     //------------------------------------------------------------------
     // Unbind the vertex attribute array and the vertex buffer.
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     //------------------------------------------------------------------
-    // Shaders can be marked for deletion already.
-    glDeleteShader( shader_id_vxs );
-    glDeleteShader( shader_id_fts );
-    //------------------------------------------------------------------
 }
 
 //========================================================================
 void Rectangle::render()
 {
     //------------------------------------------------------------------
-    // Activate the drawing shader program.
+    // Activate the drawing shader program, with the uniforms of this
+    // rectangle.
     glUseProgram(program_id);
+    glUniformMatrix4fv( loc_MVP, 1, false, &m_MVP[0][0]);
+    glUniform1i( loc_to_srgb, m_ToSrgb );
 
     //------------------------------------------------------------------
     // Activate and bind the texture.
@@ -117,14 +120,17 @@ void Rectangle::render()
     glDrawArrays( GL_TRIANGLE_STRIP, 0, 4); // 4 = number of the vertices array in init()...
 }
 
+//========================================================================
+void Rectangle::encode_srgb( bool encode )
+{
+    m_ToSrgb = encode;
+}
+
 //========================================================================
 void Rectangle::resize_screen(int width, int height)
 {
     //------------------------------------------------------------------
-    auto MVP { glm::ortho<float>( 0, width, height, 0, 1, -1 ) };
-    //------------------------------------------------------------------
-    glUseProgram( program_id );
-    glUniformMatrix4fv( loc_MVP, 1, false, &MVP[0][0]);
+    m_MVP = glm::ortho<float>( 0, width, height, 0, 1, -1 );
 }
 
 //========================================================================
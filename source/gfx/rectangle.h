@@ -16,6 +16,9 @@ public:
     void init( GLfloat x, GLfloat y, GLfloat w, GLfloat h );
     void render();
     void resize_screen(int width, int height);
+    // The texture holds sRGB (decoded when sampled): encode the output
+    // again, for a target that is not sRGB itself.
+    void encode_srgb( bool encode );
 
 #if 0
     void SetMVP( mat4x4 &MVP)
@@ -24,19 +27,21 @@ public:
         glUniformMatrix4fv( loc_MVP, 1, false, &MVP[0][0]);
     }
 #else
-    void SetMVP( const glm::mat4 &MVP)
-    {
-        glUseProgram( program_id );
-        glUniformMatrix4fv( loc_MVP, 1, false, &MVP[0][0]);
-    }
+    void SetMVP( const glm::mat4 &MVP) { m_MVP = MVP; }
 #endif
 
     Texture tex;
 public:
+    // The program is shared by all rectangles (see GLPool), the uniforms
+    // are set when drawing.
     GLuint program_id {0};
     GLint loc_TEX;
     GLint loc_MVP;
-    GLuint vertex_array_id;
+    GLint loc_to_srgb;
+    PooledVertexArray vertex_array_id;
+    PooledBuffer vertex_buffer_id;
+    glm::mat4 m_MVP {1.0f};
+    bool m_ToSrgb {false};
 };
 
 //========================================================================
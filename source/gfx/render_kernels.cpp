@@ -0,0 +1,55 @@
+#include "render_kernels.h"
+
+#include <array>
+#include <utility>
+
+namespace gfx {
+
+//========================================================================
+// A kernel for each value of the mode bits, built at compile time.
+template<uint32_t... MODES>
+static constexpr std::array<LineKernel, sizeof...(MODES)> make_kernels( std::integer_sequence<uint32_t, MODES...> )
+{
+    return { { &render_line<MODES>... } };
+}
+static constexpr auto kernels = make_kernels( std::make_integer_sequence<uint32_t, MODE_COUNT>() );
+
+//========================================================================
+LineKernel line_kernel( uint32_t mode )
+{
+    return kernels[ mode & (MODE_COUNT - 1) ];
+}
+
+//========================================================================
+void render_text_area( const VideoMemory &vic, const uint8_t *char_rom,
+                       int first_line, int rows, int columns,
+                       uint8_t *out, int pitch )
+{
+    LineSource src { vic.ram, char_rom, vic.color_ram, nullptr, nullptr, columns };
+    for( int y = 0; y < rows * 8; y++ )
+    {
+        int line = (first_line + y) % RASTER_LINES;
+        src.regs  = vic.lines + line * 64;
+        src.state = vic.display + line * DISPLAY_BYTES;
+        kernels[ line_mode( src.regs ) ]( src, out + y * pitch );
+    }
+}
+
+//========================================================================
+void render_frame( const VideoMemory &vic, const uint8_t *char_rom, uint8_t *out )
+{
+    for( int y = 0; y < FRAME_HEIGHT; y++ )
+    {
+        const uint8_t *regs = vic.lines + ((FRAME_FIRST_LINE + y) % RASTER_LINES) * 64;
+        std::memset( out + y * FRAME_WIDTH, regs[0x20] & 15, FRAME_WIDTH );
+    }
+    render_text_area( vic, char_rom, FRAME_FIRST_LINE + FRAME_TEXT_Y, 25, 40,
+                      out + FRAME_TEXT_Y * FRAME_WIDTH + FRAME_TEXT_X, FRAME_WIDTH );
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
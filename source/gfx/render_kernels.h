@@ -0,0 +1,188 @@
+#ifndef RENDER_KERNELS_H
+#define RENDER_KERNELS_H
+
+#include "video_memory.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+// The mode of a raster line, from its registers. The bits make up the
+// keys of the text screen's shader variants and the template argument
+// of the CPU kernels below, so both see the same modes.
+enum : uint32_t
+{
+    MODE_MCM         = 1,   // $D016 bit 4: multicolor
+    MODE_BMM         = 2,   // $D011 bit 5: bitmap
+    MODE_ECM         = 4,   // $D011 bit 6: extended background color
+    MODE_CHARSET_ROM = 8,   // Text modes: the character set is in the ROM.
+    MODE_INVALID     = MODE_MCM | MODE_BMM | MODE_ECM,  // All invalid modes.
+    MODE_COUNT       = 16
+};
+
+//======================================================================
+// The mode of a line with the VIC registers "regs" (64 bytes, the bank
+// in place of $D03F). The invalid modes are all MODE_INVALID, and
+// MODE_CHARSET_ROM is only set for text.
+constexpr uint32_t line_mode( const uint8_t *regs )
+{
+    uint32_t mode = ((regs[0x16] >> 4) & 1) | ((regs[0x11] >> 4) & 6);
+    if( (mode & MODE_ECM) && (mode & (MODE_MCM | MODE_BMM)) )
+        return MODE_INVALID;
+    if( mode & MODE_BMM )
+        return mode;
+    // The character ROM shows up at $1000-$1FFF of banks 0 and 2.
+    int bank  = regs[0x3F] & 3;
+    int chars = (regs[0x18] & 0x0E) << 10;
+    if( (bank & 1) == 0 && (chars & 0x3000) == 0x1000 )
+        mode |= MODE_CHARSET_ROM;
+    return mode;
+}
+
+//======================================================================
+// A raster line for the CPU kernels.
+struct LineSource
+{
+    const uint8_t *ram;         // 64K
+    const uint8_t *char_rom;    // 4K
+    const uint8_t *color_ram;   // 1K
+    const uint8_t *regs;        // The 64 registers of the line.
+    const uint8_t *state;       // The DISPLAY_BYTES of the line.
+    int columns;                // Characters per row.
+};
+
+//======================================================================
+// A byte as the VIC sees it: a 14 bit address in its 16K bank.
+inline uint8_t vic_read( const LineSource &src, int bank, int addr )
+{
+    if( (bank & 1) == 0 && (addr & 0x3000) == 0x1000 )
+        return src.char_rom[ addr & 0x0FFF ];
+    return src.ram[ bank * 0x4000 + addr ];
+}
+
+//======================================================================
+// Render the text area of a raster line (columns * 8 pixels) in mode
+// MODE into palette indices, like the text screen's shader variant of
+// the mode does (without sprites). Only the code of the mode is
+// compiled into each kernel.
+template<uint32_t MODE>
+void render_line( const LineSource &src, uint8_t *out )
+{
+    constexpr bool mcm = (MODE & MODE_MCM) != 0;
+    constexpr bool bmm = (MODE & MODE_BMM) != 0;
+    constexpr bool ecm = (MODE & MODE_ECM) != 0;
+    constexpr bool rom = (MODE & MODE_CHARSET_ROM) != 0;
+    //------------------------------------------------------------------
+    const uint8_t *regs = src.regs;
+    int width = src.columns * 8;
+    int flags = src.state[3];
+    uint8_t border = regs[0x20] & 15;
+    if( flags & DISPLAY_BORDER )
+    {
+        std::memset( out, border, size_t(width) );
+        return;
+    }
+    //------------------------------------------------------------------
+    if constexpr( ecm && (mcm || bmm) )
+        std::memset( out, 0, size_t(width) );   // The invalid modes show black.
+    else
+    {
+        bool display = (flags & DISPLAY_ACTIVE) != 0;
+        int row  = src.state[0];
+        int rc   = src.state[1];
+        int xscroll = src.state[2];
+        int d018 = regs[0x18];
+        int bank = regs[0x3F] & 3;
+        const uint8_t bg[4] = { uint8_t(regs[0x21] & 15), uint8_t(regs[0x22] & 15),
+                                uint8_t(regs[0x23] & 15), uint8_t(regs[0x24] & 15) };
+        // Left of the scrolled text is background.
+        std::memset( out, bg[0], size_t( std::min( xscroll, width ) ) );
+        //--------------------------------------------------------------
+        // Video matrix, color RAM and the character or bitmap data of
+        // each cell, in idle state the last byte of the bank.
+        for( int cx = 0; cx < src.columns; cx++ )
+        {
+            int cell = (row * src.columns + cx) & 0x3FF;
+            int c    = 0;
+            int col  = 0;
+            int data;
+            if( !display )
+                data = vic_read( src, bank, ecm ? 0x39FF : 0x3FFF );
+            else
+            {
+                c   = vic_read( src, bank, ((d018 & 0xF0) << 6) + cell );
+                col = src.color_ram[ cell ] & 15;
+                int code = ecm ? c & 0x3F : c;
+                if constexpr( bmm )
+                    data = vic_read( src, bank, ((d018 & 0x08) << 10) + cell * 8 + rc );
+                else if constexpr( rom )
+                    data = src.char_rom[ ((d018 & 0x02) << 10) + code * 8 + rc ];
+                else
+                    data = vic_read( src, bank, ((d018 & 0x0E) << 10) + code * 8 + rc );
+            }
+            //----------------------------------------------------------
+            uint8_t pixels[8];
+            if( mcm && (bmm || (col & 8) != 0) )
+            {
+                // Multicolor: 2 bits per (double wide) pixel.
+                for( int p = 0; p < 4; p++ )
+                {
+                    int bits = (data >> (6 - p * 2)) & 3;
+                    uint8_t index;
+                    if constexpr( bmm )
+                        index = bits == 0 ? bg[0] : uint8_t( bits == 1 ? (c >> 4) : bits == 2 ? (c & 15) : col );
+                    else
+                        index = bits == 3 ? uint8_t( col & 7 ) : bg[bits];
+                    pixels[p * 2] = pixels[p * 2 + 1] = index;
+                }
+            }
+            else
+            {
+                uint8_t fg = uint8_t( bmm ? c >> 4 : col );
+                uint8_t back = bmm ? uint8_t( c & 15 ) : ecm ? bg[c >> 6] : bg[0];
+                for( int p = 0; p < 8; p++ )
+                    pixels[p] = (data >> (7 - p)) & 1 ? fg : back;
+            }
+            //----------------------------------------------------------
+            int x = xscroll + cx * 8;
+            if( x < width )
+                std::memcpy( out + x, pixels, size_t( std::min( 8, width - x ) ) );
+        }
+    }
+    //------------------------------------------------------------------
+    // 38 columns: 7 pixels left and 9 right are border.
+    if( (flags & (DISPLAY_40COLS | DISPLAY_SIDES_OPEN)) == 0 )
+    {
+        std::memset( out, border, size_t( std::min( 7, width ) ) );
+        if( width > 311 )
+            std::memset( out + 311, border, size_t( width - 311 ) );
+    }
+}
+
+//======================================================================
+// The kernel of a mode (MODE_COUNT of them), picked once per line.
+using LineKernel = void (*)( const LineSource &src, uint8_t *out );
+LineKernel line_kernel( uint32_t mode );
+
+//======================================================================
+// Render "rows" text rows (rows * 8 pixel rows, columns * 8 pixels
+// wide) from raster line "first_line" into palette indices, "pitch"
+// bytes from one pixel row to the next.
+void render_text_area( const VideoMemory &vic, const uint8_t *char_rom,
+                       int first_line, int rows, int columns,
+                       uint8_t *out, int pitch );
+
+//======================================================================
+// Render the FRAME_WIDTH x FRAME_HEIGHT framebuffer into palette
+// indices: the border color of each line and the 40x25 text area,
+// without sprites.
+void render_frame( const VideoMemory &vic, const uint8_t *char_rom, uint8_t *out );
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // RENDER_KERNELS_H
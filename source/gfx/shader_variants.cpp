@@ -0,0 +1,76 @@
+#include "shader_variants.h"
+#include "gfx_utils.h"
+
+#include <stdexcept>
+
+namespace gfx {
+
+//========================================================================
+void ShaderVariants::init( const char *vxs, const char *gms, const char *fts,
+                           std::vector<std::string> defines,
+                           std::function<void(GLuint)> setup )
+{
+    clear();
+    m_Vxs = vxs;
+    m_Gms = gms;
+    m_Fts = fts;
+    m_Defines = std::move( defines );
+    m_Setup = std::move( setup );
+}
+
+//========================================================================
+std::string ShaderVariants::code( const char *stage, uint32_t key ) const
+{
+    //------------------------------------------------------------------
+    // GLSL wants the #version first, the defines go right after it.
+    std::string text( stage );
+    size_t version = text.find( "#version" );
+    if( version == std::string::npos )
+        throw std::runtime_error( "Shader variants: no #version line" );
+    size_t pos = text.find( '\n', version );
+    pos = pos == std::string::npos ? text.size() : pos + 1;
+    //------------------------------------------------------------------
+    std::string defines;
+    for( size_t bit = 0; bit < m_Defines.size(); bit++ )
+        if( key & (uint32_t(1) << bit) )
+            defines += "#define " + m_Defines[bit] + " 1\n";
+    text.insert( pos, defines );
+    return text;
+}
+
+//========================================================================
+GLuint ShaderVariants::program( uint32_t key )
+{
+    auto found = programs.find( key );
+    if( found != programs.end() )
+        return found->second;
+    //------------------------------------------------------------------
+    GLuint vxs_id = compile_shader( GL_VERTEX_SHADER, code( m_Vxs, key ).c_str() );
+    GLuint gms_id = m_Gms ? compile_shader( GL_GEOMETRY_SHADER, code( m_Gms, key ).c_str() ) : 0;
+    GLuint fts_id = compile_shader( GL_FRAGMENT_SHADER, code( m_Fts, key ).c_str() );
+    GLProgram program( link_program( vxs_id, fts_id, gms_id ) );
+    GLuint id = program;
+    glDeleteShader( vxs_id );
+    if( gms_id )
+        glDeleteShader( gms_id );
+    glDeleteShader( fts_id );
+    //------------------------------------------------------------------
+    glUseProgram( id );
+    if( m_Setup )
+        m_Setup( id );
+    programs.emplace( key, std::move( program ) );
+    return id;
+}
+
+//========================================================================
+void ShaderVariants::clear()
+{
+    programs.clear();
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,68 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "gl_objects.h"
+#include "utils.h"
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//========================================================================
+namespace gfx {
+
+//========================================================================
+// Variants of one shader program, specialized with #defines instead of
+// branching on uniforms at run time: each bit of a key switches on one
+// of the defines given to init(). A variant is compiled (with
+// compile_shader()) and linked the first time it is asked for, and kept
+// until clear() or the destructor.
+//
+// So only the code of a variant's own mode ends up in its shaders, and
+// the cost of a fragment does not depend on how many modes there are.
+class ShaderVariants
+{
+public:
+    //========================================================================
+    ShaderVariants() = default;
+    NO_COPY( ShaderVariants );
+    NO_MOVE( ShaderVariants );
+    virtual ~ShaderVariants() { clear(); }
+    //========================================================================
+    // The code of the stages (gms may be null), each starting with its
+    // #version line, and the names of the defines, bit 0 first. "setup"
+    // is called for each new program, in use, to set its uniforms.
+    void init( const char *vxs, const char *gms, const char *fts,
+               std::vector<std::string> defines,
+               std::function<void(GLuint)> setup );
+    //========================================================================
+    // The program of the variant "key", built on first use.
+    GLuint program( uint32_t key );
+    // The code of a stage with the defines of "key" after its #version.
+    std::string code( const char *stage, uint32_t key ) const;
+    // Call f( program ) for each variant built so far.
+    template<typename F> void for_each( F f ) const
+    {
+        for( const auto &variant : programs )
+            f( variant.second );
+    }
+    size_t size() const { return programs.size(); }
+    // Delete all programs.
+    void clear();
+
+private:
+    const char *m_Vxs {nullptr};
+    const char *m_Gms {nullptr};
+    const char *m_Fts {nullptr};
+    std::vector<std::string> m_Defines;
+    std::function<void(GLuint)> m_Setup;
+    std::unordered_map<uint32_t, GLProgram> programs;
+};
+
+//========================================================================
+} // End of namespace gfx
+
+#endif // SHADER_VARIANTS_H
@@ -0,0 +1,218 @@
+
+#include "sprites.h"
+#include "text_screen.h"
+#include "gfx_utils.h"
+#include "gl_pool.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gfx {
+
+//========================================================================
+// Vertex shader: a quad per instance, 24 or 48 pixels wide, one pixel
+// row per raster line.
+static const char *vxs =
+R"(
+#version 460 core
+
+uniform mat4 MVP;           // Model-View-Projection Matrix (Camera)
+uniform int first_line;     // Raster line of the first framebuffer row.
+uniform int first_x;        // Sprite X coordinate of the first framebuffer column.
+
+in ivec4 slice;             // Instance: x, first line, lines, first row (half rows)
+in uint  data;              // Instance: address of the sprite data
+in uvec4 colors;            // Instance: color, multicolor 0 and 1, flags
+
+out vec2 local;             // Output: position in the slice, in sprite pixels/lines
+out flat ivec4 slice_fs;
+out flat int   data_fs;
+out flat ivec4 colors_fs;
+
+void main()
+{
+    int flags    = int(colors.w);
+    vec2 corner  = vec2( gl_VertexID & 1, gl_VertexID >> 1 );
+    vec2 size    = vec2( (flags & 1) != 0 ? 48 : 24, slice.z );
+    // X coordinates from $1F8 on are left of 0.
+    int x        = slice.x >= 0x1F8 ? slice.x - 0x1F8 : slice.x;
+    vec2 origin  = vec2( x - first_x, slice.y - first_line );
+    local        = corner * size;
+    gl_Position  = MVP * vec4( origin + local, 0, 1 );
+    slice_fs     = slice;
+    data_fs      = int(data);
+    colors_fs    = ivec4(colors);
+}
+)";
+
+//========================================================================
+static const char *fts =
+R"(
+#version 460 core
+
+uniform usamplerBuffer MEMORY; // 64K RAM, character ROM at $10000.
+layout( std140, binding = 0 ) uniform Palette { vec4 palette[16]; };  // Linear RGB
+
+in vec2 local;
+in flat ivec4 slice_fs;
+in flat int   data_fs;
+in flat ivec4 colors_fs;
+
+out vec4 FragColor;
+
+const int CHAR_ROM = 0x10000;
+
+int vic_read( int bank, int addr )
+{
+   if( (bank & 1) == 0 && (addr & 0x3000) == 0x1000 )
+      return int( texelFetch( MEMORY, CHAR_ROM + (addr & 0x0FFF) ).r );
+   return int( texelFetch( MEMORY, bank * 0x4000 + addr ).r );
+}
+
+void main()
+{
+   int flags = colors_fs.w;
+   int px    = int(local.x);
+   int dl    = int(local.y);
+   int sx    = (flags & 1) != 0 ? px >> 1 : px;
+   int row   = (flags & 2) != 0 ? (slice_fs.w + dl) >> 1 : (slice_fs.w >> 1) + dl;
+   int byte  = vic_read( data_fs >> 14, ((data_fs & 0x3FFF) + row * 3 + (sx >> 3)) & 0x3FFF );
+   int c;
+   if( (flags & 4) != 0 )
+   {
+      int bits = (byte >> (6 - (sx & 6))) & 3;
+      if( bits == 0 )
+         discard;
+      c = bits == 1 ? colors_fs.y : bits == 2 ? colors_fs.x : colors_fs.z;
+   }
+   else
+   {
+      if( ((byte >> (7 - (sx & 7))) & 1) == 0 )
+         discard;
+      c = colors_fs.x;
+   }
+   FragColor = vec4( palette[c & 15].rgb, (flags & 8) != 0 ? 0.5 : 1.0 );
+}
+)";
+
+//========================================================================
+void Sprites::init( GLuint memory_buffer, int width, int height )
+{
+    m_Width  = width;
+    m_Height = height;
+    //------------------------------------------------------------------
+    // The sprite layer and a framebuffer to render into it.
+    framebuffer_name.acquire();
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_name );
+    layer.activate(SPRITE_LAYER_UNIT)
+        .iformat(GL_SRGB8_ALPHA8).size(width,height).format(GL_RGBA).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
+        .Pi(GL_TEXTURE_MIN_FILTER, GL_NEAREST).Pi(GL_TEXTURE_MAG_FILTER, GL_NEAREST)
+        .unbind();
+    glFramebufferTexture( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layer, 0 );
+    if( GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER) )
+    {
+        throw std::runtime_error("Sprite framebuffer could not be completed!");
+    }
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    //------------------------------------------------------------------
+    memory.activate(3).iformat(GL_R8UI).storage(GL_TEXTURE_BUFFER)
+        .Buffer( memory_buffer )
+        .unbind();
+    //------------------------------------------------------------------
+    // The shader program of all sprite renderers, built by the first.
+    program_id = gl_pool().program( "sprites", vxs, fts );
+    //------------------------------------------------------------------
+    loc_slice      = glGetAttribLocation( program_id, "slice" );
+    loc_data       = glGetAttribLocation( program_id, "data" );
+    loc_colors     = glGetAttribLocation( program_id, "colors" );
+    loc_MVP        = glGetUniformLocation( program_id, "MVP" );
+    loc_MEMORY     = glGetUniformLocation( program_id, "MEMORY" );
+    loc_first_line = glGetUniformLocation( program_id, "first_line" );
+    loc_first_x    = glGetUniformLocation( program_id, "first_x" );
+    //------------------------------------------------------------------
+    // The uniforms are set by render(), the program is shared.
+    m_MVP = glm::ortho<float>( 0, width, height, 0, 1, -1 );
+    bind_palette();
+    //------------------------------------------------------------------
+    // The slices are per instance attributes, the quad corners come
+    // from gl_VertexID.
+    vertex_array_id.acquire();
+    grow_instance_buffer( GLsizeiptr( 64 * sizeof(SpriteSlice) ) );
+}
+
+//========================================================================
+// A buffer (from the pool) for "bytes" of slices, and the attributes
+// of the vertex array in it.
+void Sprites::grow_instance_buffer( GLsizeiptr bytes )
+{
+    bool fresh = instance_buffer_id.acquire( { GL_ARRAY_BUFFER, 0, bytes } );
+    glBindVertexArray( vertex_array_id );
+    glBindBuffer( GL_ARRAY_BUFFER, instance_buffer_id );
+    if( fresh )
+        glBufferData( GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+    glEnableVertexAttribArray( loc_slice );
+    glVertexAttribIPointer( loc_slice, 4, GL_SHORT, sizeof(SpriteSlice),
+                            reinterpret_cast<void*>( offsetof(SpriteSlice, x) ) );
+    glVertexAttribDivisor( loc_slice, 1 );
+    glEnableVertexAttribArray( loc_data );
+    glVertexAttribIPointer( loc_data, 1, GL_UNSIGNED_SHORT, sizeof(SpriteSlice),
+                            reinterpret_cast<void*>( offsetof(SpriteSlice, data) ) );
+    glVertexAttribDivisor( loc_data, 1 );
+    glEnableVertexAttribArray( loc_colors );
+    glVertexAttribIPointer( loc_colors, 4, GL_UNSIGNED_BYTE, sizeof(SpriteSlice),
+                            reinterpret_cast<void*>( offsetof(SpriteSlice, color) ) );
+    glVertexAttribDivisor( loc_colors, 1 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindVertexArray( 0 );
+}
+
+//========================================================================
+size_t Sprites::set_slices( const SpriteSlice *slices, int count )
+{
+    m_Count = count;
+    if( count == 0 )
+        return 0;
+    GLsizeiptr bytes = GLsizeiptr( count * sizeof(SpriteSlice) );
+    if( bytes > instance_buffer_id.key().width )
+    {
+        // Grow in steps, multiplexers change the count every frame.
+        grow_instance_buffer( bytes * 2 );
+    }
+    glBindBuffer( GL_ARRAY_BUFFER, instance_buffer_id );
+    glBufferSubData( GL_ARRAY_BUFFER, 0, bytes, slices );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    return size_t( bytes );
+}
+
+//========================================================================
+void Sprites::render()
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer_name );
+    glViewport( 0, 0, m_Width, m_Height );
+    glClearColor( 0, 0, 0, 0 );
+    glClear( GL_COLOR_BUFFER_BIT );
+    if( m_Count > 0 )
+    {
+        memory.activate().bind();
+        glUseProgram( program_id );
+        glUniformMatrix4fv( loc_MVP, 1, false, &m_MVP[0][0] );
+        glUniform1i( loc_first_line, FRAME_FIRST_LINE );
+        glUniform1i( loc_first_x, FRAME_FIRST_X );
+        memory.gl_Uniform( loc_MEMORY );
+        glBindVertexArray( vertex_array_id );
+        glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, m_Count );
+        glBindVertexArray( 0 );
+    }
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+//========================================================================
+} // End of namespace gfx
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,80 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include "texture.h"
+#include "gfx_utils.h"
+#include "gl_pool.h"
+#include "utils.h"
+
+#include <cstdint>
+
+//======================================================================
+namespace gfx {
+
+//======================================================================
+// A sprite shown with the same settings on consecutive raster lines.
+// This is the instance data of the draw call.
+struct SpriteSlice
+{
+    enum : uint8_t { X_EXPAND = 1, Y_EXPAND = 2, MULTICOLOR = 4, BEHIND = 8 };
+    int16_t  x;         // Sprite X coordinate.
+    int16_t  line;      // First raster line.
+    int16_t  lines;     // Number of raster lines.
+    int16_t  row;       // Sprite data row on the first line, in half rows.
+    uint16_t data;      // Sprite data: bank * $4000 + pointer * 64.
+    uint8_t  color, mc0, mc1, flags;
+};
+
+//======================================================================
+// Renders all sprite slices of a frame with one instanced draw into the
+// sprite layer, a texture of the framebuffer's size. The text screen
+// puts the layer over (or behind) its foreground pixels.
+//
+// The sprite data is read from the memory buffer of the text screen.
+class Sprites
+{
+public:
+    //========================================================================
+    Sprites() = default;
+    NO_COPY( Sprites );
+    NO_MOVE( Sprites );
+    virtual ~Sprites() = default;
+    //======================================================================
+    // "memory_buffer": a buffer with the 64K RAM and the character ROM
+    // at $10000, see text_screen.
+    void init( GLuint memory_buffer, int width, int height );
+    // Drawn in order: later slices cover earlier ones.
+    // Returns the number of bytes uploaded.
+    size_t set_slices( const SpriteSlice *slices, int count );
+    void render();
+    //======================================================================
+    // RGB: the sprite color. A: 1 in front of the background,
+    // 0.5 behind the background's foreground pixels, 0 for no sprite.
+    Texture layer;
+
+private:
+    int m_Width, m_Height;
+    int m_Count {0};
+    //======================================================================
+    Texture memory;     // Texture buffer view of the memory buffer.
+    PooledFramebuffer framebuffer_name;
+    GLuint program_id;  // Shared, see GLPool.
+    PooledVertexArray vertex_array_id;
+    PooledBuffer instance_buffer_id;    // Its key has the capacity.
+    glm::mat4 m_MVP {1.0f};
+    //======================================================================
+    GLint loc_slice;        // Location of the instance attributes
+    GLint loc_data;
+    GLint loc_colors;
+    GLint loc_MVP;
+    GLint loc_MEMORY;
+    GLint loc_first_line;
+    GLint loc_first_x;
+    //======================================================================
+    void grow_instance_buffer( GLsizeiptr bytes );
+};
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // SPRITES_H
@@ -2,8 +2,11 @@
 #include "text_screen.h"
 #include "texture.h"
 #include "gfx_utils.h"
+#include "render_kernels.h"
 #include "utils.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace gfx {
@@ -16,25 +19,21 @@ static const char *vxs =
 R"(
 #version 460 core
 
-uniform isampler2D CHARS;   // Screen characters: 1000 bytes
-uniform isampler2D COLOR;   // Screen color ram: 1000 nibbles
+// The locations are fixed, the programs are shared by all text screens
+// and each sets its uniforms when it draws (see text_screen::use_variant()).
+layout( location = 0 ) uniform mat4 MVP;        // Model-View-Projection Matrix (Camera)
+layout( location = 4 ) uniform vec2 TextOffset; // Offset on the screen, added to all coordinates.
+layout( location = 5 ) uniform float scaling;
+layout( location = 6 ) uniform int columns;     // Characters per row.
 
-uniform mat4 MVP;           // Model-View-Projection Matrix (Camera)
-uniform vec2 TextOffset;    // Offset on the screen, added to all coordinates.
-uniform float scaling;      
-
-in vec3 screen_coord;       // Input: The xy-coordinates of the character to display, 
-                            //             z is the index in screen and color RAM.
-
-out int character_vs;       // output: the character to display (0-255)
-out flat int fg_col_vs;     // output: the foreground color to display (0-15)
+out vec2 cell_vs;           // output: the column and row of the character.
 
 void main()                 // Shader: Calculate screen coordinates of the
-{                           // vertex from the 3D position.
-    gl_Position  = vec4( TextOffset + (screen_coord.xy)*scaling, 0, 1);
-    ivec2 coord  = ivec2( int(screen_coord.z),0);
-    character_vs = (texelFetch(CHARS, coord, 0 ).r) & 0xFF;
-    fg_col_vs    = (texelFetch(COLOR, coord, 0 ).r) & 0x0F;
+{                           // vertex from the index of the character.
+    // There is no vertex buffer, a point per character is drawn.
+    vec2 cell    = vec2( gl_VertexID % columns, gl_VertexID / columns );
+    gl_Position  = vec4( TextOffset + cell*scaling, 0, 1);
+    cell_vs      = cell;
 }
 
 )"
@@ -47,17 +46,14 @@ static const char *gms =
 R"(
 #version 460 core
 
-uniform mat4 MVP;           // Model-View-Projection Matrix (Camera)
-uniform float scaling;
-    
+layout( location = 0 ) uniform mat4 MVP;    // Model-View-Projection Matrix (Camera)
+layout( location = 5 ) uniform float scaling;
+
 layout ( points ) in;       // Input: Each vertex is a point.
-in int character_vs[];      // Input: the character to display.
-in int fg_col_vs[];         // Input: the foreground color to use
+in vec2 cell_vs[];          // Input: the column and row of the character.
 
 layout ( triangle_strip, max_vertices = 4 ) out; // Output: a triangle strip of 4 vertices as output.
-out vec2 texcoord;          // Output: The texture coordinate.
-out flat int fg_col_gs;     // Output: The foreground color to use
-out flat int char_gs;       // Output: The character to display.
+out vec2 pixel;             // Output: The position in the text area in C64 pixels.
 
 // Emit a single vertex.
 // x and y designate the corner of the character. Must be 0 or 1.
@@ -69,15 +65,9 @@ void emit_vertex(float x, float y)
     // The absolute output position: Input + relative position
     gl_Position = MVP * ( gl_in[0].gl_Position + vec4(rel,0,0) );
     
-    // The texture coordinates: select one of the 256 characters
-    // Multiply by 8: The x-position reflects the bit in the byte from the
-    // Character generator.
-    // The y-position reflects the row in the character generator.
-    char_gs = character_vs[0];
-    texcoord = vec2(x,y) * 8.0f;
-    
-    // Just push the foreground color through to the fragment shader.
-    fg_col_gs = fg_col_vs[0];
+    // The fragment shader works out everything from the pixel position,
+    // a character is 8x8 pixels.
+    pixel = (cell_vs[0] + vec2(x,y)) * 8.0f;
     
     EmitVertex();   // emit the outputs.
 }
@@ -104,40 +94,211 @@ static const char *fts =
 R"(
 #version 460 core
 
-uniform isampler2D TEX;        // character generator ROM.
-uniform int background_color;  // global screen background color.
-uniform ivec3 palette[16];      // The 16 colors.
-uniform int charset;           // Selects which character set to use (0 or 1)
-
-in vec2 texcoord;           // The interpolated texture coordinate.
-in flat int fg_col_gs;      // The foreground color.
-in flat int char_gs;        // The chaaracter to display.
+// A variant of the shader for each mode of the raster lines (see
+// ShaderVariants and text_screen::render()), with the defines:
+//   MCM, BMM, ECM  The mode bits of $D016 and $D011, all three for
+//                  the invalid modes.
+//   CHARSET_ROM    Text modes: the character set is in the ROM.
+//   GLYPH_ATLAS    ... and hires characters come from the atlas.
+//   SHOW_SPRITES   The sprite layer is drawn over the screen.
+//   CONSOLE        A text console of any size (see text_screen::init()),
+//                  only GLYPH_ATLAS goes with it.
+
+uniform usamplerBuffer MEMORY; // 64K RAM, character ROM at $10000, color RAM at $11000.
+uniform usampler2D LINES;      // VIC registers of each raster line, 4 per texel.
+uniform usampler2D DISPLAY;    // Display state of each raster line: row, RC, X scroll, flags.
+layout( std140, binding = 0 ) uniform Palette { vec4 palette[16]; };  // Linear RGB
+layout( location = 7 ) uniform int first_line; // Raster line of the first pixel row.
+layout( location = 6 ) uniform int columns;    // Characters per row.
+#if defined(SHOW_SPRITES)
+uniform sampler2D SPRITES;     // The sprite layer, alpha: 1 = in front, 0.5 = behind.
+#endif
+#if defined(GLYPH_ATLAS)
+uniform usampler2D GLYPHS;     // Both ROM character sets, a byte per pixel, 16x32 characters.
+#endif
+#if defined(CONSOLE)
+uniform usampler2D GRID;       // Character and color of each cell, 256 cells per row.
+#endif
+
+in vec2 pixel;              // The position in the text area.
 
 out vec4 FragColor;         // The pixel output color.
 
-void main()
+const int CHAR_ROM  = 0x10000;
+const int COLOR_RAM = 0x11000;
+
+const int DISPLAY_ACTIVE = 1;
+const int DISPLAY_BORDER = 2;
+const int DISPLAY_40COLS = 4;
+const int DISPLAY_SIDES_OPEN = 8;
+
+#if defined(ECM)
+#define CHAR(c) ((c) & 0x3F)
+#define IDLE_ADDR 0x39FF
+#else
+#define CHAR(c) (c)
+#define IDLE_ADDR 0x3FFF
+#endif
+
+// A byte as the VIC sees it: a 14 bit address in its 16K bank. The
+// character ROM shows up at $1000-$1FFF in banks 0 and 2.
+int vic_read( int bank, int addr )
 {
+   if( (bank & 1) == 0 && (addr & 0x3000) == 0x1000 )
+      return int( texelFetch( MEMORY, CHAR_ROM + (addr & 0x0FFF) ).r );
+   return int( texelFetch( MEMORY, bank * 0x4000 + addr ).r );
+}
 
-   int bit  = int(texcoord.x) & 0x7;
-   int col  = int(texcoord.y) & 0x7;
-   int row  = char_gs + 256*charset;
-
-   ivec2 tx = ivec2( col, row );
-   int byte = texelFetch( TEX, tx, 0 ).r;
-
-   float f  = float(((byte>>(7-bit))&1)) * 1.0f;
-
-   vec4 fg_col = vec4( float(palette[fg_col_gs       ].r)/255, float(palette[fg_col_gs       ].g)/255, float(palette[fg_col_gs       ].b)/255, 1);
-   vec4 bg_col = vec4( float(palette[background_color].r)/255, float(palette[background_color].g)/255, float(palette[background_color].b)/255, 1);
-
-   FragColor = mix( bg_col, fg_col, f);
+vec4 color( int c )
+{
+   return vec4( palette[c & 15].rgb, 1 );
+}
 
+#if defined(CONSOLE)
+// Text rows from the top, no VIC: characters from the ROM, the colors
+// of the first line.
+void main()
+{
+   int x    = int(pixel.x);
+   int y    = int(pixel.y);
+   int cell = (y >> 3) * columns + (x >> 3);
+   uvec4 grid = texelFetch( GRID, ivec2( cell & 0xFF, cell >> 8 ), 0 );
+   uvec4 r18  = texelFetch( LINES, ivec2( 0x18 >> 2, first_line ), 0 );  // $D018 in x
+   uvec4 r20  = texelFetch( LINES, ivec2( 0x20 >> 2, first_line ), 0 );  // $D021 in y
+   int glyph  = ((int(r18.x) & 0x02) << 7) + int(grid.r);
+#if defined(GLYPH_ATLAS)
+   bool set = texelFetch( GLYPHS, ivec2( (glyph & 15) * 8 + (x & 7), (glyph >> 4) * 8 + (y & 7) ), 0 ).r != 0u;
+#else
+   int data = int( texelFetch( MEMORY, CHAR_ROM + glyph * 8 + (y & 7) ).r );
+   bool set = ((data >> (7 - (x & 7))) & 1) != 0;
+#endif
+   FragColor = color( set ? int(grid.g) : int(r20.y) );
+}
+#else
+void main()
+{
+   int x    = int(pixel.x);
+   int y    = int(pixel.y);
+   int line = (first_line + y) % 312;
+   //---------------------------------------------------------------
+   // The display state of this raster line: the border covers it, or
+   // the text row, the row in the character and the X scroll. The
+   // border is in front of the sprites.
+   uvec4 r20 = texelFetch( LINES, ivec2( 0x20 >> 2, line ), 0 );  // $D020-$D023 in xyzw
+   uvec4 state = texelFetch( DISPLAY, ivec2( 0, line ), 0 );
+   int flags = int(state.w);
+   if( (flags & DISPLAY_BORDER) != 0 ||
+       ((flags & (DISPLAY_40COLS | DISPLAY_SIDES_OPEN)) == 0 && (x < 7 || x >= 311)) )
+   {
+      FragColor = color( int(r20.x) );
+      return;
+   }
+#if defined(ECM) && (defined(BMM) || defined(MCM))
+   FragColor = vec4( 0, 0, 0, 1 );   // The invalid modes show black.
+#else
+   //---------------------------------------------------------------
+   // The registers of this raster line.
+   uvec4 r18 = texelFetch( LINES, ivec2( 0x18 >> 2, line ), 0 );  // $D018 in x
+   uvec4 r3C = texelFetch( LINES, ivec2( 0x3C >> 2, line ), 0 );  // Bank in w
+   bool display = (flags & DISPLAY_ACTIVE) != 0;
+   int sx = x - int(state.z);       // Pixel in the scrolled text.
+   int rc = int(state.y);
+   int d018 = int(r18.x);
+   int bank = int(r3C.w) & 3;
+   //---------------------------------------------------------------
+   // Video matrix, color RAM and the character or bitmap data. In idle
+   // state the VIC reads the last byte of the bank and no video matrix,
+   // left of the scrolled text it shows the background.
+   int cell = (int(state.x) * columns + (sx >> 3)) & 0x3FF;
+   int c    = 0;
+   int col  = 0;
+   int data = 0;
+   if( sx >= 0 && !display )
+      data = vic_read( bank, IDLE_ADDR );
+   else if( sx >= 0 )
+   {
+      c   = vic_read( bank, ((d018 & 0xF0) << 6) + cell );
+      col = int( texelFetch( MEMORY, COLOR_RAM + cell ).r ) & 15;
+#if defined(BMM)
+      data = vic_read( bank, ((d018 & 0x08) << 10) + cell * 8 + rc );
+#elif defined(GLYPH_ATLAS)
+      // Read from the atlas below.
+#elif defined(CHARSET_ROM)
+      data = int( texelFetch( MEMORY, CHAR_ROM + ((d018 & 0x02) << 10) + CHAR(c) * 8 + rc ).r );
+#else
+      data = vic_read( bank, ((d018 & 0x0E) << 10) + CHAR(c) * 8 + rc );
+#endif
+   }
+   //---------------------------------------------------------------
+   int index;
+   bool foreground;         // Sprites with priority go behind these pixels.
+   if( sx < 0 )
+   {
+      index = int(r20.y);
+      foreground = false;
+   }
+#if defined(MCM)
+#if defined(BMM)
+   else
+#else
+   else if( (col & 8) != 0 )
+#endif
+   {
+      // Multicolor: 2 bits per (double wide) pixel.
+      int bits = (data >> (6 - (sx & 6))) & 3;
+      foreground = bits >= 2;
+#if defined(BMM)
+      index = bits == 0 ? int(r20.y) : bits == 1 ? (c >> 4) : bits == 2 ? (c & 15) : col;
+#else
+      index = bits == 0 ? int(r20.y) : bits == 1 ? int(r20.z) : bits == 2 ? int(r20.w) : (col & 7);
+#endif
+   }
+#endif
+#if !(defined(MCM) && defined(BMM))
+   else
+   {
+#if defined(GLYPH_ATLAS)
+      int glyph = ((d018 & 0x02) << 7) + CHAR(c);
+      bool set = display
+         ? texelFetch( GLYPHS, ivec2( (glyph & 15) * 8 + (sx & 7), (glyph >> 4) * 8 + rc ), 0 ).r != 0u
+         : ((data >> (7 - (sx & 7))) & 1) != 0;
+#else
+      bool set = ((data >> (7 - (sx & 7))) & 1) != 0;
+#endif
+      foreground = set;
+#if defined(BMM)
+      index = set ? (c >> 4) : (c & 15);
+#elif defined(ECM)
+      uvec4 r24 = texelFetch( LINES, ivec2( 0x24 >> 2, line ), 0 );  // $D024 in x
+      int bg = c >> 6;
+      index = set ? col : bg == 0 ? int(r20.y) : bg == 1 ? int(r20.z) : bg == 2 ? int(r20.w) : int(r24.x);
+#else
+      index = set ? col : int(r20.y);
+#endif
+   }
+#endif
+   FragColor = color( index );
+   //---------------------------------------------------------------
+#if defined(SHOW_SPRITES)
+   vec4 sprite = texelFetch( SPRITES, ivec2( gl_FragCoord.xy ), 0 );
+   if( sprite.a > 0.75 || (sprite.a > 0.25 && !foreground) )
+      FragColor = vec4( sprite.rgb, 1 );
+#endif
+#endif
 };
+#endif
 
 )"
 
 ;
 
+//========================================================================
+// The defines of the shader variants, bit 0 first: the mode bits (see
+// render_kernels.h), then the ones of the GPU only.
+static const std::vector<std::string> variant_defines {
+    "MCM", "BMM", "ECM", "CHARSET_ROM", "GLYPH_ATLAS", "SHOW_SPRITES", "CONSOLE"
+};
+
 //========================================================================
 // Setup the text screen objects;
 void text_screen::init( utils::Buffer &CG, int cols, int rows, const glm::vec2 &pos )
@@ -145,100 +306,117 @@ void text_screen::init( utils::Buffer &CG, int cols, int rows, const glm::vec2 &
     m_Rows = rows;
     m_Cols = cols;
     int max_chars = rows*cols;
+    int first_line = FRAME_FIRST_LINE + int(pos[1]);
+    m_Console = max_chars > VIDEO_MATRIX_CELLS || first_line + rows * 8 > RASTER_LINES;
 
     //------------------------------------------------------------------
-    // Create a buffer holding the screen coordinates (0-39,0-24) of each character.
-    glm::vec3 coords[max_chars]; 
-    for( int i=0; i<max_chars; i++ )
-    {
-        coords[i][0]   = float(i % cols);
-        coords[i][1]   = float(i / cols);
-        coords[i][2]   = float(i);
-    }
+    // Set up the memory buffer, with the character generator ROM in
+    // place, and a texture buffer to read it in the shader.
+    bool fresh = memory_buffer.acquire( { GL_TEXTURE_BUFFER, 0, MEMORY_SIZE } );
+    glBindBuffer( GL_TEXTURE_BUFFER, memory_buffer );
+    if( fresh )
+        glBufferData( GL_TEXTURE_BUFFER, MEMORY_SIZE, nullptr, GL_DYNAMIC_DRAW );
+    glBufferSubData( GL_TEXTURE_BUFFER, CHAR_ROM, std::min( CG.size(), size_t(0x1000) ), CG.data() );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+    memory.activate(MEMORY_UNIT).iformat(GL_R8UI).storage(GL_TEXTURE_BUFFER)
+        .Buffer( memory_buffer )
+        .unbind();
 
     //------------------------------------------------------------------
-    // Set up the "texture" to hold the screen RAM.
-    screen.gen().activate(0).bind(GL_TEXTURE_2D).size(max_chars,1)
-        .iformat(GL_R8UI).format(GL_RED_INTEGER).type(GL_UNSIGNED_BYTE)
+    // Set up the texture to hold the VIC registers of each raster line.
+    // Until set_vic() is called, all lines show standard text mode with
+    // the video matrix at $0400 and the upper case ROM character set,
+    // in the colors the C64 starts with.
+    for( int line = 0; line < RASTER_LINES; line++ )
+    {
+        uint8_t *regs = &fixed_lines[ line * LINE_BYTES ];
+        regs[0x11] = 0x1B;
+        regs[0x16] = 0xC8;
+        regs[0x18] = 0x14;
+        regs[0x20] = 14;
+        regs[0x21] = 6;
+    }
+    lines.activate(LINES_UNIT).size(LINE_BYTES/4, RASTER_LINES)
+        .iformat(GL_RGBA8UI).format(GL_RGBA_INTEGER).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
         .Pi(GL_TEXTURE_WRAP_S, GL_CLAMP).Pi(GL_TEXTURE_WRAP_T, GL_CLAMP)
         .Pi(GL_TEXTURE_MIN_FILTER, GL_NEAREST).Pi(GL_TEXTURE_MAG_FILTER, GL_NEAREST)
-        .Image2D(nullptr)
+        .SubImage2D( fixed_lines.data() )
         .unbind();
 
     //------------------------------------------------------------------
-    // Set up the "texture" to hold the color RAM.
-    colram.gen().activate(1).bind(GL_TEXTURE_2D).size(max_chars,1)
-        .iformat(GL_R8UI).format(GL_RED_INTEGER).type(GL_UNSIGNED_BYTE)
-        .Pi(GL_TEXTURE_WRAP_S, GL_CLAMP).Pi(GL_TEXTURE_WRAP_T, GL_CLAMP)
+    // And one with the display state of each raster line. Without VIC,
+    // the rows of this screen start at its top line, unscrolled, and
+    // the lines above and below are border.
+    for( int line = 0; line < RASTER_LINES; line++ )
+    {
+        int y = line - first_line;
+        bool inside = y >= 0 && y < rows * 8;
+        uint8_t *state = &fixed_display[ line * DISPLAY_BYTES ];
+        state[0] = uint8_t( std::max( y, 0 ) >> 3 );
+        state[1] = uint8_t( std::max( y, 0 ) & 7 );
+        state[3] = inside ? DISPLAY_ACTIVE | DISPLAY_40COLS : DISPLAY_BORDER | DISPLAY_40COLS;
+    }
+    display.activate(DISPLAY_UNIT).size(1, RASTER_LINES)
+        .iformat(GL_RGBA8UI).format(GL_RGBA_INTEGER).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
         .Pi(GL_TEXTURE_MIN_FILTER, GL_NEAREST).Pi(GL_TEXTURE_MAG_FILTER, GL_NEAREST)
-        .Image2D(nullptr)
+        .SubImage2D( fixed_display.data() )
         .unbind();
 
     //------------------------------------------------------------------
-    // Set up the texture to hold the character generator ROM.
-    //auto CG { utils::RM.load("roms/chargen") };
-    chrgen.gen().activate(2).bind(GL_TEXTURE_2D).size(8,512)
-        .iformat(GL_R8UI).format(GL_RED_INTEGER).type(GL_UNSIGNED_BYTE)
-        .Pi(GL_TEXTURE_WRAP_S, GL_CLAMP).Pi(GL_TEXTURE_WRAP_T, GL_CLAMP)
+    // The glyph atlas: both ROM character sets, a byte per pixel.
+    std::vector<uint8_t> rom( 0x1000 );
+    std::copy_n( CG.data(), std::min( CG.size(), rom.size() ), rom.begin() );
+    std::vector<GLchar> atlas( 256 * 128 );
+    auto *atlas_rows = reinterpret_cast<GLchar(*)[128]>( atlas.data() );
+    prepare_charset( &rom[0x000], atlas_rows );
+    prepare_charset( &rom[0x800], atlas_rows + 128 );
+    glyphs.activate(GLYPH_ATLAS_UNIT).size(128, 256)
+        .iformat(GL_R8UI).format(GL_RED_INTEGER).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
         .Pi(GL_TEXTURE_MIN_FILTER, GL_NEAREST).Pi(GL_TEXTURE_MAG_FILTER, GL_NEAREST)
-        .Image2D( CG.data() )
+        .SubImage2D( atlas.data() )
         .unbind();
+    update_line_modes( fixed_lines.data() );
+    update_line_borders( fixed_display.data() );
 
     //------------------------------------------------------------------
-    // Compile and link the shader program.
-    auto vxs_id = compile_shader( GL_VERTEX_SHADER, vxs );
-    auto gms_id = compile_shader( GL_GEOMETRY_SHADER, gms );
-    auto fts_id = compile_shader( GL_FRAGMENT_SHADER, fts );
-    program_id = link_program( vxs_id, fts_id, gms_id);
-
-    //------------------------------------------------------------------
-    // Get the locations of the shader inputs and uniforms.
-    loc_coord =    glGetAttribLocation( program_id, "screen_coord" );
-
-    loc_MVP =      glGetUniformLocation( program_id, "MVP"  );
-    loc_TEX =      glGetUniformLocation( program_id, "TEX"  );
-    loc_CHARS =    glGetUniformLocation( program_id, "CHARS"  );
-    loc_COLOR =    glGetUniformLocation( program_id, "COLOR"  );
-    loc_palette =  glGetUniformLocation( program_id, "palette"  );
-    loc_bg_color = glGetUniformLocation( program_id, "background_color"  );
-    loc_Offset =   glGetUniformLocation( program_id, "TextOffset");
-    loc_scaling =  glGetUniformLocation( program_id, "scaling"  );
-    loc_charset =  glGetUniformLocation( program_id, "charset");
+    // The characters and colors of a console, in rows of GRID_WIDTH
+    // cells, so the size of a texture doesn't limit the grid.
+    if( m_Console )
+    {
+        grid_cells.assign( size_t( (max_chars + GRID_WIDTH - 1) / GRID_WIDTH * GRID_WIDTH * 2 ), 0 );
+        grid.activate(GRID_UNIT).size(GRID_WIDTH, (max_chars + GRID_WIDTH - 1) / GRID_WIDTH)
+            .iformat(GL_RG8UI).format(GL_RG_INTEGER).type(GL_UNSIGNED_BYTE).storage(GL_TEXTURE_2D)
+            .Pi(GL_TEXTURE_MIN_FILTER, GL_NEAREST).Pi(GL_TEXTURE_MAG_FILTER, GL_NEAREST)
+            .SubImage2D( grid_cells.data() )
+            .unbind();
+    }
 
     //------------------------------------------------------------------
-    // Set some defaults of the shader uniforms
-    glUseProgram( program_id );
-
-    glUniform2f( loc_Offset, pos[0], pos[1] );
-    glUniform1f( loc_scaling, 8); // 8 = "real life pixel size" 
-    glUniform1i( loc_charset, 0);
-    glUniform1i( loc_bg_color, 0);
-
-    screen.gl_Uniform( loc_CHARS );
-    colram.gl_Uniform( loc_COLOR );
-    chrgen.gl_Uniform( loc_TEX );
+    // The shader variants of all text screens, built when a mode shows
+    // up first. They get the uniforms that are the same for all screens
+    // then, the others are set by use_variant().
+    m_Offset = pos;
+    m_FirstLine = first_line;
+    variants = &gl_pool().variants( "text_screen", []( ShaderVariants &shared ) {
+        shared.init( vxs, gms, fts, variant_defines, []( GLuint program ) {
+            glUniform1f( LOC_SCALING, 8 ); // 8 = "real life pixel size"
+            glUniform1i( glGetUniformLocation( program, "MEMORY" ), MEMORY_UNIT );
+            glUniform1i( glGetUniformLocation( program, "LINES" ), LINES_UNIT );
+            glUniform1i( glGetUniformLocation( program, "DISPLAY" ), DISPLAY_UNIT );
+            glUniform1i( glGetUniformLocation( program, "SPRITES" ), SPRITE_LAYER_UNIT );
+            glUniform1i( glGetUniformLocation( program, "GLYPHS" ), GLYPH_ATLAS_UNIT );
+            glUniform1i( glGetUniformLocation( program, "GRID" ), GRID_UNIT );
+        } );
+    } );
+    bands.reserve( RASTER_LINES );
 
     //------------------------------------------------------------------
-    // Set the palette
-    glUniform3iv( loc_palette, sizeof(color_table), &color_table.data()[0][0] );
+    // The palette is a uniform buffer shared with the other renderers.
+    bind_palette();
     //------------------------------------------------------------------
-    // Create a vertex attribute array and bind it.
-    glGenVertexArrays(1, &vertex_array_id);
-    glBindVertexArray(vertex_array_id);
-    GLuint vertex_buffer_id;
-    glGenBuffers(1, &vertex_buffer_id);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_id);
-    //------------------------------------------------------------------
-    // Enable shader input "vPos" and describe its layout in the vertex buffer.
-    glEnableVertexAttribArray(loc_coord);
-    glVertexAttribPointer( loc_coord, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0 );
-    //------------------------------------------------------------------
-    // Upload the vertices to the vertex buffer.
-    glBufferData( GL_ARRAY_BUFFER, sizeof(coords), &coords[0], GL_DYNAMIC_DRAW );
-    //------------------------------------------------------------------
-    // Unbind the vertex attribute array and the vertex buffer.
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // The shaders work out the characters from gl_VertexID, but GL
+    // wants a vertex array object bound to draw.
+    vertex_array_id.acquire();
     //------------------------------------------------------------------
 }
 
@@ -255,49 +433,196 @@ void text_screen::render()
     //------------------------------------------------------------------
     // Activate the texture units and bind the texture buffers
     // as defined at initialization.
-    screen.activate().bind();
-    colram.activate().bind();
-    chrgen.activate().bind();
-    //------------------------------------------------------------------
-    // Draw the vertices of the texture screen.
-    glUseProgram( program_id );
+    bind_textures();
     glBindVertexArray(vertex_array_id);
-    glDrawArrays( GL_POINTS, 0, m_Rows * m_Cols);
+    //------------------------------------------------------------------
+    // Draw the vertices of the texture screen, with the shader variant
+    // of each band of lines in the same mode. Most frames have one.
+    if( m_Console )
+    {
+        use_variant( VARIANT_CONSOLE | (m_GlyphAtlas ? VARIANT_GLYPH_ATLAS : 0) );
+        glDrawArrays( GL_POINTS, 0, m_Rows * m_Cols );
+        return;
+    }
+    update_bands();
+    if( bands.size() == 1 )
+    {
+        use_variant( bands[0].key );
+        glDrawArrays( GL_POINTS, 0, m_Rows * m_Cols );
+        return;
+    }
+    //------------------------------------------------------------------
+    // Otherwise only the text rows of each band are drawn, cut to its
+    // lines. Pixel rows go down, window rows up.
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    float scale = m_Height > 0 ? float(viewport[3]) / float(m_Height) : 1.0f;
+    glEnable( GL_SCISSOR_TEST );
+    for( const Band &band : bands )
+    {
+        int top    = int( std::lround( (float(m_Height) - m_Offset[1] - float(band.first)) * scale ) );
+        int bottom = int( std::lround( (float(m_Height) - m_Offset[1] - float(band.end)) * scale ) );
+        glScissor( viewport[0], viewport[1] + bottom, viewport[2], top - bottom );
+        int first_row = band.first / 8;
+        int end_row   = (band.end + 7) / 8;
+        use_variant( band.key );
+        glDrawArrays( GL_POINTS, first_row * m_Cols, (end_row - first_row) * m_Cols );
+    }
+    glDisable( GL_SCISSOR_TEST );
     //------------------------------------------------------------------
 }
 
 //======================================================================
-void text_screen::set_memories( uint8_t *new_chars, uint8_t *new_colrs )
+// Split the pixel rows of the screen into bands of lines with the same
+// shader variant. Border lines look the same in all variants and go
+// with the band above them (or below, at the top).
+void text_screen::update_bands()
+{
+    uint32_t extra = sprite_layer ? VARIANT_SHOW_SPRITES : 0;
+    bands.clear();
+    for( int y = 0; y < m_Rows * 8; y++ )
+    {
+        int line = (m_FirstLine + y) % RASTER_LINES;
+        if( line_borders[line] )
+        {
+            if( !bands.empty() )
+                bands.back().end = y + 1;
+            continue;
+        }
+        uint32_t key = line_modes[line] | extra;
+        if( m_GlyphAtlas && (key & (MODE_CHARSET_ROM | MODE_MCM | MODE_BMM)) == MODE_CHARSET_ROM )
+            key |= VARIANT_GLYPH_ATLAS;
+        if( !bands.empty() && bands.back().key == key )
+            bands.back().end = y + 1;
+        else
+            bands.push_back( { bands.empty() ? 0 : y, y + 1, key } );
+    }
+    if( bands.empty() )
+        bands.push_back( { 0, m_Rows * 8, extra } );
+}
+
+//======================================================================
+void text_screen::update_line_modes( const uint8_t *line_regs )
+{
+    for( int line = 0; line < RASTER_LINES; line++ )
+        line_modes[line] = uint8_t( line_mode( line_regs + line * LINE_BYTES ) );
+}
+
+//======================================================================
+void text_screen::update_line_borders( const uint8_t *display_lines )
 {
-    screen.bind().Image2D( new_chars );
-    colram.bind().Image2D( new_colrs );
+    for( int line = 0; line < RASTER_LINES; line++ )
+        line_borders[line] = (display_lines[ line * DISPLAY_BYTES + 3 ] & DISPLAY_BORDER) != 0;
+}
+
+//======================================================================
+void text_screen::bind_textures()
+{
+    memory.activate().bind();
+    lines.activate().bind();
+    display.activate().bind();
+    glyphs.activate().bind();
+    if( m_Console )
+        grid.activate().bind();
+    if( sprite_layer )
+        sprite_layer->activate().bind();
+}
 
-    /*
-    glUseProgram( program_id );
-    glUniform1i( loc_bg_color, new_colrs[1] & 0x0f );
-    */
+//======================================================================
+void text_screen::set_memories( uint8_t *new_chars, uint8_t *new_colrs )
+{
+    int cells = m_Rows * m_Cols;
+    if( m_Console )
+    {
+        for( int i = 0; i < cells; i++ )
+        {
+            grid_cells[ size_t(i) * 2 ]     = new_chars[i];
+            grid_cells[ size_t(i) * 2 + 1 ] = new_colrs[i];
+        }
+        grid.bind().SubImage2D( grid_cells.data() );
+        return;
+    }
+    glBindBuffer( GL_TEXTURE_BUFFER, memory_buffer );
+    glBufferSubData( GL_TEXTURE_BUFFER, 0x0400, cells, new_chars );
+    glBufferSubData( GL_TEXTURE_BUFFER, COLOR_RAM, cells, new_colrs );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
 }
 
 //======================================================================
 // Set the background color
 void text_screen::set_bg_color( int bg_color )
 {
-    glUseProgram( program_id );
-    glUniform1i( loc_bg_color, bg_color );
+    set_fixed_lines( 0x21, uint8_t( bg_color ) );
+}
+
+//======================================================================
+// Select one of the two character sets of the character generator ROM.
+void text_screen::set_charset( int charset )
+{
+    set_fixed_lines( 0x18, charset ? 0x16 : 0x14 );
+}
+
+//======================================================================
+void text_screen::set_fixed_lines( int reg, uint8_t value )
+{
+    for( int line = 0; line < RASTER_LINES; line++ )
+        fixed_lines[ line * LINE_BYTES + reg ] = value;
+    lines.bind().SubImage2D( fixed_lines.data() );
+    update_line_modes( fixed_lines.data() );
 }
 
+//======================================================================
+size_t text_screen::set_vic( const VideoMemory &vic )
+{
+    glBindBuffer( GL_TEXTURE_BUFFER, memory_buffer );
+    glBufferSubData( GL_TEXTURE_BUFFER, 0, 0x10000, vic.ram );
+    glBufferSubData( GL_TEXTURE_BUFFER, COLOR_RAM, 0x400, vic.color_ram );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+    lines.bind().SubImage2D( vic.lines );
+    update_line_modes( vic.lines );
+    set_display( vic.display );
+    return 0x10000 + 0x400 + fixed_lines.size() + fixed_display.size();
+}
+
+//======================================================================
+void text_screen::set_display( const uint8_t *display_lines )
+{
+    display.bind().SubImage2D( display_lines );
+    update_line_borders( display_lines );
+}
 
 //======================================================================
 void text_screen::resize_screen(int width, int height)
 {
     //------------------------------------------------------------------
-    auto MVP { glm::ortho<float>( 0, width, height, 0, 1, -1 ) };
-    //------------------------------------------------------------------
-    glUseProgram( program_id );
-    glUniformMatrix4fv( loc_MVP, 1, false, &MVP[0][0]);
+    m_MVP = glm::ortho<float>( 0, width, height, 0, 1, -1 );
+    m_Height = height;
     //------------------------------------------------------------------
 }
 
+//======================================================================
+// Draw with the variant "key", and the uniforms of this screen.
+void text_screen::use_variant( uint32_t key )
+{
+    glUseProgram( variants->program( key ) );
+    glUniformMatrix4fv( LOC_MVP, 1, false, &m_MVP[0][0] );
+    glUniform2f( LOC_OFFSET, m_Offset[0], m_Offset[1] );
+    glUniform1i( LOC_COLUMNS, m_Cols );
+    glUniform1i( LOC_FIRST_LINE, m_FirstLine );
+}
+
+//======================================================================
+const char *text_screen::shader_code( GLenum type )
+{
+    switch( type )
+    {
+    case GL_VERTEX_SHADER:   return vxs;
+    case GL_GEOMETRY_SHADER: return gms;
+    case GL_FRAGMENT_SHADER: return fts;
+    }
+    return nullptr;
+}
+
 //======================================================================
 } // End of namespace gfx
 //======================================================================
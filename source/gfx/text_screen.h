@@ -2,12 +2,32 @@
 #define TEXT_SCREEN_H
 
 #include "texture.h"
+#include "gl_pool.h"
+#include "video_memory.h"
+#include "shader_variants.h"
 #include "gfx_utils.h"
+#include "render_kernels.h"
 #include "utils.h"
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 //======================================================================
 namespace gfx {
 
+//======================================================================
+// The texture units of the text screen's textures and the sprite layer,
+// also used by the renderers that share them (see bind_textures()).
+// All samplers of a program must have a unit, even unused ones, and
+// units can't be shared between sampler types.
+constexpr GLenum MEMORY_UNIT = 0;
+constexpr GLenum LINES_UNIT = 1;
+constexpr GLenum SPRITE_LAYER_UNIT = 2;
+constexpr GLenum DISPLAY_UNIT = 4;
+constexpr GLenum GLYPH_ATLAS_UNIT = 5;
+constexpr GLenum GRID_UNIT = 6;
+
 //======================================================================
 class text_screen
 {
@@ -18,34 +38,113 @@ public:
     NO_MOVE( text_screen );
     virtual ~text_screen() = default;
     //======================================================================
-    void init( utils::Buffer &CG, int rows, int cols, const glm::vec2 &pos );
+    // A grid of cols x rows characters at "pos" of the render target.
+    // Grids that don't fit the VIC's video matrix (1000 cells) or raster
+    // lines are consoles of any size: set_memories(), set_bg_color() and
+    // set_charset() only, no sprites.
+    void init( utils::Buffer &CG, int cols, int rows, const glm::vec2 &pos );
+    //======================================================================
+    // Show a fixed screen: characters and colors, one background color
+    // and a ROM character set for all lines.
     void set_memories( uint8_t *new_chars, uint8_t *new_colrs );
     void set_bg_color( int bg_color );
+    void set_charset( int charset );    // 0 = upper case, 1 = lower case ROM charset
+    //======================================================================
+    // Show emulated memory as the VIC would: text, multicolor text,
+    // extended background color, hires and multicolor bitmap, with
+    // mode, colors and memory pointers taken from each raster line.
+    // Returns the number of bytes uploaded.
+    size_t set_vic( const VideoMemory &vic );
+    // Only the display state, RASTER_LINES * DISPLAY_BYTES. Fine scroll,
+    // 38 columns, 24 rows and scroll splits are shown from it; the text
+    // area is the 40x25 window from raster line $33, pixels in the
+    // border show the border color of the line.
+    void set_display( const uint8_t *display_lines );
+    // Put the sprite layer (see Sprites) over the screen. It must have
+    // the size of the render target.
+    void show_sprites( Texture *layer ) { sprite_layer = layer; }
+    // The buffer with RAM and character ROM, for other renderers.
+    GLuint memory_buffer_id() const { return memory_buffer; }
+    // Bind the memory, the line registers, the display state and the
+    // sprite layer to their units, for this or other renderers.
+    void bind_textures();
+    // Draw each band of lines in the same mode with the shader variant
+    // of the mode (see ShaderVariants), built when it shows up first.
     void render();
     void resize_screen( int width, int height );
-
+    // Read hires ROM characters from a texture with a byte per pixel,
+    // instead of picking the bits out of the memory buffer.
+    void use_glyph_atlas( bool on ) { m_GlyphAtlas = on; }
+    // The shader variants built so far (by all text screens).
+    size_t variant_count() const { return variants->size(); }
+    //======================================================================
+    // The GLSL code of the text screen shaders: GL_VERTEX_SHADER,
+    // GL_GEOMETRY_SHADER or GL_FRAGMENT_SHADER, without the defines of
+    // a variant, which is standard text mode. (For benchmarks.)
+    static const char *shader_code( GLenum type );
 
 private:
     int m_Rows, m_Cols; // Number of rows and columns of the text screen.
     //======================================================================
-    Texture chrgen;     // A Texture to hold the character generator ROM
-    Texture screen;     // A Texture to hold the 1000 bytes of screen RAM
-    Texture colram;     // A Texture to hold the 1000 nibbles of color RAM.
+    // The memory buffer: 64K RAM, the character generator ROM, then the
+    // color RAM (room for 2K cells).
+    static constexpr int CHAR_ROM  = 0x10000;
+    static constexpr int COLOR_RAM = 0x11000;
+    static constexpr int MEMORY_SIZE = 0x11800;
+    static constexpr int LINE_BYTES = 64;
+    //======================================================================
+    PooledBuffer memory_buffer;
+    Texture memory;     // Texture buffer view of the memory buffer.
+    Texture lines;      // The VIC registers per raster line (16 x RGBA per line).
+    Texture display;    // The display state per raster line (1 x RGBA per line).
+    Texture *sprite_layer {nullptr};
+    // The registers for set_bg_color() and set_charset(), same on all lines.
+    std::array<uint8_t, RASTER_LINES * LINE_BYTES> fixed_lines {};
+    // The display state without VIC: the rows of this screen from its top.
+    std::array<uint8_t, RASTER_LINES * DISPLAY_BYTES> fixed_display {};
+    //======================================================================
+    // Variant keys: the mode bits of the lines (see line_mode()), then
+    // the bits of the GPU only.
+    static constexpr uint32_t VARIANT_GLYPH_ATLAS  = MODE_COUNT;
+    static constexpr uint32_t VARIANT_SHOW_SPRITES = MODE_COUNT << 1;
+    static constexpr uint32_t VARIANT_CONSOLE      = MODE_COUNT << 2;
+    // The locations of the uniforms in the shaders.
+    static constexpr GLint LOC_MVP = 0;
+    static constexpr GLint LOC_OFFSET = 4;
+    static constexpr GLint LOC_SCALING = 5;
+    static constexpr GLint LOC_COLUMNS = 6;
+    static constexpr GLint LOC_FIRST_LINE = 7;
+    ShaderVariants *variants {nullptr};     // Shared, see GLPool.
+    PooledVertexArray vertex_array_id;      // Empty, the shaders use gl_VertexID.
+    Texture glyphs;         // The glyph atlas of the ROM character sets.
+    bool m_GlyphAtlas {false};
+    //======================================================================
+    // A console: the cells in a 2D texture, GRID_WIDTH per row, both
+    // bytes of a cell in a texel (character, color).
+    static constexpr int VIDEO_MATRIX_CELLS = 1000;
+    static constexpr int GRID_WIDTH = 256;
+    bool m_Console {false};
+    Texture grid;
+    std::vector<uint8_t> grid_cells;
     //======================================================================
-    GLuint program_id;
-    GLuint vertex_array_id;
-    GLint loc_coord;        // Location of shader input "screen_coord"
+    // The uniforms, for the variants built later.
+    glm::mat4 m_MVP {1.0f};
+    glm::vec2 m_Offset {0.0f};
+    int m_FirstLine {0};    // The raster line of the first pixel row.
+    int m_Height {0};       // Of the render target.
     //======================================================================
-    GLint loc_MVP;          // Location of uniform MVP
-    GLint loc_TEX;          // Location of texture for character generator
-    GLint loc_CHARS;        // Location of texture for screen memory
-    GLint loc_COLOR;        // Location of texture for color memory
-    GLint loc_palette;      // Location of color table (16 x vec3)
-    GLint loc_bg_color;     // Location of background color (0-15)
-    GLint loc_Offset;       // Location of Offset coordinate (ivec2)
-    GLint loc_scaling;
-    GLint loc_charset;
+    // The mode and the border of each raster line, and the bands of
+    // pixel rows drawn with the same variant.
+    std::array<uint8_t, RASTER_LINES> line_modes {};
+    std::array<bool, RASTER_LINES> line_borders {};
+    struct Band { int first, end; uint32_t key; };
+    std::vector<Band> bands;
     //======================================================================
+    void update_line_modes( const uint8_t *line_regs );
+    void update_line_borders( const uint8_t *display_lines );
+    void update_bands();
+    void set_fixed_lines( int reg, uint8_t value );
+    void use_variant( uint32_t key );
 };
 
 //======================================================================
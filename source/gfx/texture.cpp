@@ -10,7 +10,16 @@ namespace gfx {
     }
     Texture &Texture::gen()
     {
-        glGenTextures(1, &texture_name);
+        texture_name.acquire();
+        return *this;
+    }
+    Texture &Texture::storage( GLenum target )
+    {
+        tex_target = target;
+        bool fresh = texture_name.acquire( { target, tex_internalFormat, tex_width, tex_height } );
+        bind();
+        if( fresh && target != GL_TEXTURE_BUFFER )
+            Image2D( nullptr );
         return *this;
     }
     Texture &Texture::activate()
@@ -67,6 +76,23 @@ namespace gfx {
                       data);
         return *this;
     }
+    Texture &Texture::SubImage2D(const GLvoid * data)
+    {
+        glTexSubImage2D( tex_target,
+                         tex_level,
+                         0, 0,
+                         tex_width,
+                         tex_height,
+                         tex_format,
+                         tex_type,
+                         data);
+        return *this;
+    }
+    Texture &Texture::Buffer( GLuint buffer )
+    {
+        glTexBuffer( tex_target, tex_internalFormat, buffer );
+        return *this;
+    }
     Texture &Texture::Pi( GLenum pname, GLint param )
     {
         glTexParameteri( tex_target, pname, param );
@@ -1,6 +1,7 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "gl_pool.h"
 #include "utils.h"
 
 #include <glad/glad.h>
@@ -11,23 +12,31 @@ namespace gfx {
 //========================================================================
 // Simple abstaction layer over OpenGL Textures.
 // Provides a fluent interface.
+// The texture name comes from the GLPool and goes back to it with the
+// Texture (or del()). Textures can be moved, e.g. into containers.
 class Texture
 {
 public:
     //========================================================================
     Texture() = default;
     NO_COPY( Texture );
-    NO_MOVE( Texture );
-    virtual ~Texture() { del(); }
+    Texture( Texture && ) = default;
+    Texture &operator=( Texture && ) = default;
+    virtual ~Texture() = default;
 
-    operator GLuint() { return texture_name; }
+    operator GLuint() const { return texture_name; }
 
     // glUniform1i() - provides the texture unit defined in activate() 
     // to the uniform sampler2D location given here. 
     void gl_Uniform( GLint location );          
     
-    Texture &gen();                             // glGenTextures()
-    void del() { glDeleteTextures(1, &texture_name); }
+    Texture &gen();                             // glGenTextures(), or one from the pool
+    void del() { texture_name.reset(); }        // Back to the pool.
+    // A texture with storage for target, iformat() and size() (set before,
+    // with format() and type() for new storage), bound: from the pool if
+    // there is one of that format, else glTexImage2D() without data.
+    // Buffer textures get no storage, see Buffer().
+    Texture &storage( GLenum target );
     
     Texture &activate( GLenum textureUnit );    // glActiveTexture - set given value
     Texture &activate();                        // glActiveTexture - reuse last set value
@@ -40,6 +49,8 @@ public:
     Texture &format( GLint format = GL_RGB );           // set format for Image2D()
     Texture &type( GLint type = GL_UNSIGNED_BYTE );     // set type for Image2D()
     Texture &Image2D(const GLvoid * data);              // glTexImage2D()
+    Texture &SubImage2D(const GLvoid * data);           // glTexSubImage2D() - the whole image
+    Texture &Buffer( GLuint buffer );                   // glTexBuffer()     - for GL_TEXTURE_BUFFER
 
     Texture &Pi( GLenum pname, GLint param );   // glTexParameteri()
     Texture &GenerateMipMap();
@@ -50,7 +61,7 @@ public:
     GLsizei height() { return tex_height; }
 
 private:
-    GLuint texture_name { 0 };
+    Pooled<TextureKind> texture_name;
 
     GLenum tex_unit {  0 /*GL_TEXTURE0*/ };
     
@@ -0,0 +1,52 @@
+#ifndef VIDEO_MEMORY_H
+#define VIDEO_MEMORY_H
+
+#include <cstdint>
+
+//======================================================================
+// What the renderers get from the emulated VIC. Without GL, so the CPU
+// render kernels (see render_kernels.h) can use it, too.
+namespace gfx {
+
+//======================================================================
+// Raster lines of a PAL frame, and the raster line and sprite X
+// coordinate shown at the top left of the 384x272 framebuffer.
+constexpr int RASTER_LINES = 312;
+constexpr int FRAME_FIRST_LINE = 15;
+constexpr int FRAME_FIRST_X = -8;
+constexpr int FRAME_WIDTH = 384;
+constexpr int FRAME_HEIGHT = 272;
+// Where the 40x25 text area is in the framebuffer.
+constexpr int FRAME_TEXT_X = 32;
+constexpr int FRAME_TEXT_Y = 36;
+
+//======================================================================
+// The display state of a raster line: text row, row in the character,
+// X scroll (0-7) and flags. The emulator works it out from the VIC
+// registers of the frame, see VideoMemory.
+constexpr int DISPLAY_BYTES = 4;
+enum : uint8_t
+{
+    DISPLAY_ACTIVE = 1,     // Display state, else idle: the last byte of the bank is shown.
+    DISPLAY_BORDER = 2,     // The line is covered by the top or bottom border.
+    DISPLAY_40COLS = 4,     // 40 columns, else 38: 7 pixels left and 9 right are border.
+    DISPLAY_SIDES_OPEN = 8  // No side border on this line.
+};
+
+//======================================================================
+// What the VIC sees, for rendering the text screen from emulated memory.
+struct VideoMemory
+{
+    const uint8_t *ram;         // 64K
+    const uint8_t *color_ram;   // 1K, the low nibbles count.
+    // The VIC registers $D000-$D03F of each of the RASTER_LINES lines,
+    // with the VIC bank (0-3) in place of $D03F.
+    const uint8_t *lines;
+    // The display state of each line, DISPLAY_BYTES per line.
+    const uint8_t *display;
+};
+
+//======================================================================
+} // End of namespace gfx
+
+#endif // VIDEO_MEMORY_H
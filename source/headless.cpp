@@ -0,0 +1,1013 @@
+//======================================================================
+// glMurks64-headless: runs the emulation without window, GL or audio
+// device. Used for batch jobs and for measurements.
+//======================================================================
+#include "c64.h"
+#include "alloc_count.h"
+#include "autostart.h"
+#include "run_ahead.h"
+#include "rollback.h"
+#include "profiler.h"
+#include "monitor.h"
+#include "screen_text.h"
+#include "frame_diff.h"
+#include "palette.h"
+#include "render_kernels.h"
+#include "frame_stream.h"
+#include "stream_server.h"
+#include "link_socket.h"
+#include "utils.h"
+//======================================================================
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+//======================================================================
+#include <poll.h>
+#include <unistd.h>
+
+//======================================================================
+static void usage()
+{
+    std::cerr <<
+        "Usage: glMurks64-headless [options]\n"
+        "  --wav <file>       Render the audio output to a WAV file.\n"
+        "  --seconds <n>      Emulated time to run (default: 10).\n"
+        "  --sid <6581|8580>  SID model (default: 6581).\n"
+        "  --bench-mhz        Measure the emulation speed, event driven\n"
+        "                     scheduler vs. lockstep stepping, and with the\n"
+        "                     profiler.\n"
+        "  --disk <file>      Attach a D64/G64 image as device 8.\n"
+        "  --cart <file>      Plug in a CRT cartridge. Changes to an EasyFlash\n"
+        "                     are written back to the file.\n"
+        "  --drive <mode>     fast (KERNAL trap, default) or true (emulated 1541).\n"
+        "  --bench-load       Time LOAD\"*\",8,1 from the disk in both drive modes.\n"
+        "  --autostart <file> Run a PRG/T64 program (without LOAD) for --seconds.\n"
+        "                     May be given several times, the machine is booted\n"
+        "                     only once.\n"
+        "  --wait-text <re>   Run only until the pattern shows up on the screen\n"
+        "                     (at most --seconds), see emu::TextPattern. The exit\n"
+        "                     code is 1 and the screen is printed if it doesn't.\n"
+        "  --capture <dir>    At the end of each run, save the frame (without\n"
+        "                     sprites) as <dir>/<program>.frm (boot.frm without\n"
+        "                     --autostart), see glMurks64-framediff.\n"
+        "  --golden <dir>     Compare that frame with the one in <dir>. The exit\n"
+        "                     code is 1 if it differs, <program>.diff.ppm shows how.\n"
+        "  --stream <path>    Run in real time for --seconds (after --autostart of\n"
+        "                     the first program) and stream the frames to the\n"
+        "                     viewers on a Unix socket, see glMurks64-streamview.\n"
+        "  --bench-stream     Size and encoding time of the stream of a text\n"
+        "                     screen, for --seconds.\n"
+        "  --bench-screen-text  Time a pattern check on the screens of 10000\n"
+        "                     machines, changed and unchanged.\n"
+        "  --monitor          Machine code monitor on the console, stopped at\n"
+        "                     the start (after --autostart of the first program).\n"
+        "                     Type \"help\" for the commands, \"quit\" to exit. A\n"
+        "                     line typed while the machine runs stops it.\n"
+        "  --bench-monitor    Measure the emulation speed with the monitor.\n"
+        "  --link-host <path> Host a two player session on a Unix socket for\n"
+        "                     --seconds (after --autostart of the first program),\n"
+        "                     the joystick moves by itself. The exit code is 1\n"
+        "                     if the two machines went apart.\n"
+        "  --link-join <path> Join that session, with the host's machine.\n"
+        "  --bench-rollback   Two players in one process with 2 to 7 frames of\n"
+        "                     latency for --seconds, and the worst case of a\n"
+        "                     rollback (restore + 8 frames).\n"
+        "  --bench-run-ahead  CPU time of run-ahead per frame, 1 to 4 frames\n"
+        "                     ahead, for --seconds (of --autostart's program).\n"
+        "  --profile <file>   Count the cycles of the guest code per address\n"
+        "                     (after --autostart of the first program), print\n"
+        "                     the hottest routines at the end and save the\n"
+        "                     profile in callgrind format, for KCachegrind.\n"
+        "  --decode-trace <f> Print a trace saved by the monitor's \"trace save\".\n";
+}
+
+//======================================================================
+// Type text of any length, 10 characters whenever the keyboard
+// buffer is empty.
+static void type_text( emu::C64 &c64, const std::string &text )
+{
+    for( size_t pos = 0; pos < text.size(); c64.run_frame() )
+    {
+        if( c64.ram[0xC6] == 0 )
+        {
+            emu::type_keys( c64, text.substr( pos, 10 ) );
+            pos += 10;
+        }
+    }
+}
+
+//======================================================================
+// Boot, attach the disk and time LOAD"*",8,1 until the next READY.
+static void bench_load( const std::string &disk, sound::SIDModel model )
+{
+    if( disk.empty() )
+    {
+        std::cerr << "***ERROR: --bench-load needs --disk.\n";
+        return;
+    }
+    const emu::DriveMode modes[2] = { emu::DriveMode::TRUE_DRIVE, emu::DriveMode::FAST_LOAD };
+    double emulated[2] = { 0, 0 };
+    for( int m = 0; m < 2; m++ )
+    {
+        const char *label = m ? "Fast load:  " : "True drive: ";
+        auto c64 = std::make_unique<emu::C64>();
+        c64->init( model );
+        try
+        {
+            c64->attach_disk( disk );
+            c64->set_drive_mode( modes[m] );
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cout << label << "skipped (" << e.what() << ")\n";
+            continue;
+        }
+        if( !emu::wait_ready( *c64, 1, 10.0 ) )
+        {
+            std::cout << label << "the C64 didn't boot.\n";
+            continue;
+        }
+        //--------------------------------------------------------------
+        uint64_t start_cycles = c64->cycles_now();
+        uint64_t start_idle = c64->drive.idle_cycles();
+        uint64_t start_drive = c64->drive.total_cycles();
+        auto start = std::chrono::steady_clock::now();
+        type_text( *c64, "LOAD\"*\",8,1\n" );
+        bool done = emu::wait_ready( *c64, 2, 600.0 );
+        double wall = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        emulated[m] = double( c64->cycles_now() - start_cycles ) / sound::PAL_CLOCK;
+        //--------------------------------------------------------------
+        std::cout << label << (done ? "" : "(timed out) ") << emulated[m] << " s emulated, "
+                  << wall << " s wall clock";
+        uint64_t drive_cycles = c64->drive.total_cycles() - start_drive;
+        if( modes[m] == emu::DriveMode::TRUE_DRIVE && drive_cycles )
+            std::cout << ", drive slept "
+                      << (100.0 * double( c64->drive.idle_cycles() - start_idle ) / double( drive_cycles ))
+                      << "% of the time";
+        std::cout << "\n";
+    }
+    if( emulated[0] > 0 && emulated[1] > 0 )
+        std::cout << "Speedup:    " << (emulated[0] / emulated[1]) << "x (emulated time)\n";
+}
+
+//======================================================================
+// Run a freshly powered on machine for the given emulated time.
+// Returns the wall clock time it took.
+static double run_machine( emu::C64 &c64, double seconds )
+{
+    uint64_t end = c64.cycles_now() + uint64_t( seconds * sound::PAL_CLOCK );
+    alloc_count::FrameCheck check( "glMurks64-headless" );
+    auto start = std::chrono::steady_clock::now();
+    while( c64.cycles_now() < end )
+    {
+        c64.run_until( std::min( end, c64.cycles_now() + emu::CYCLES_PER_FRAME ) );
+        check.end_frame();
+    }
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+//======================================================================
+// Run until "pattern" is on the screen, for at most "seconds". Returns
+// the emulated time that took, or -1.
+static double run_until_text( emu::C64 &c64, const emu::TextPattern &pattern, double seconds )
+{
+    emu::ScreenWatch watch( pattern );
+    alloc_count::FrameCheck check( "glMurks64-headless" );
+    uint64_t start = c64.cycles_now();
+    uint64_t limit = start + uint64_t( seconds * sound::PAL_CLOCK );
+    while( !watch.check( c64 ) )
+    {
+        if( c64.cycles_now() >= limit )
+        {
+            std::cout << "\"" << pattern.pattern() << "\" not found within " << seconds
+                      << " s, the screen:\n" << watch.screen().to_string();
+            return -1.0;
+        }
+        c64.run_frame();
+        check.end_frame();
+    }
+    return double( c64.cycles_now() - start ) / sound::PAL_CLOCK;
+}
+
+//======================================================================
+// The frame (without sprites) as FRAME_WIDTH x FRAME_HEIGHT palette
+// indices.
+static void render_indices( emu::C64 &c64, uint8_t *out )
+{
+    gfx::render_frame( { c64.ram.data(), c64.color_ram.data(), c64.vic.raster_lines(), c64.vic.display_lines() },
+                       c64.char_rom.data(), out );
+}
+
+//======================================================================
+// The frame at the end of a run: saved to the "capture" folder, compared
+// with the golden image in the "golden" folder. Returns false if it
+// differs. Throws std::runtime_error.
+static bool check_frame( emu::C64 &c64, const std::string &name,
+                         const std::string &capture, const std::string &golden )
+{
+    c64.run_frame();    // All lines from the same frame.
+    std::vector<uint8_t> indices( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    render_indices( c64, indices.data() );
+    auto frame = gfx::PackedFrame::pack( indices.data(), gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    if( !capture.empty() )
+        frame.save( capture + "/" + name + ".frm" );
+    if( golden.empty() )
+        return true;
+    //------------------------------------------------------------------
+    auto expected = gfx::PackedFrame::load( golden + "/" + name + ".frm" );
+    auto diff = gfx::compare_frames( expected, frame );
+    if( diff.same() )
+    {
+        std::cout << name << ": same as the golden image.\n";
+        return true;
+    }
+    std::string image = name + ".diff.ppm";
+    gfx::write_diff_image( image, expected, frame, diff, gfx::Palette() );
+    std::cout << name << ": " << diff.pixels << " pixels differ from the golden image in "
+              << diff.boxes.size() << " places, see " << image << "\n";
+    return false;
+}
+
+//======================================================================
+// The screen codes of the start screen of BASIC. (The benchmarks don't
+// rely on the ROMs to boot.)
+static void basic_screen( uint8_t *cells )
+{
+    static const char *lines[] = { "", "    **** COMMODORE 64 BASIC V2 ****", "",
+                                   " 64K RAM SYSTEM  38911 BASIC BYTES FREE", "", "READY." };
+    std::memset( cells, ' ', emu::ScreenText::CELLS );
+    for( int y = 0; y < 6; y++ )
+        for( int x = 0; lines[y][x]; x++ )
+        {
+            char c = lines[y][x];
+            cells[ y * 40 + x ] = uint8_t( c >= 'A' && c <= 'Z' ? c - 'A' + 1 : c );
+        }
+}
+
+//======================================================================
+// A pattern check per frame on the screens of many sessions: most of the
+// screens don't change from one frame to the next, those cost a compare.
+// The screens are copies of the start screen of BASIC, each one typed on.
+static void bench_screen_text()
+{
+    constexpr int SESSIONS = 10000;
+    constexpr int ROUNDS = 20;
+    uint8_t booted[emu::ScreenText::CELLS];
+    basic_screen( booted );
+    std::vector<uint8_t> screens( size_t(SESSIONS) * emu::ScreenText::CELLS );
+    for( int i = 0; i < SESSIONS; i++ )
+        std::memcpy( &screens[ size_t(i) * emu::ScreenText::CELLS ], booted, emu::ScreenText::CELLS );
+    //------------------------------------------------------------------
+    for( const char *text : { "READY.", "^READY\\. *$", "[0-9]+ BYTES" } )
+    {
+        emu::TextPattern pattern( text );
+        std::vector<emu::ScreenWatch> watches( SESSIONS, emu::ScreenWatch( pattern ) );
+        auto check_all = [&]() {
+            auto start = std::chrono::steady_clock::now();
+            int found = 0;
+            for( int i = 0; i < SESSIONS; i++ )
+                found += watches[i].check( &screens[ size_t(i) * emu::ScreenText::CELLS ], emu::Charset::UPPER_CASE );
+            double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+            return std::make_pair( ms, found );
+        };
+        auto first = check_all();
+        double unchanged = 1e9, changed = 1e9;
+        for( int round = 0; round < ROUNDS; round++ )
+        {
+            unchanged = std::min( unchanged, check_all().first );
+            // A key typed on every screen, in the row below READY.
+            for( int i = 0; i < SESSIONS; i++ )
+                screens[ size_t(i) * emu::ScreenText::CELLS + 7 * 40 + round ] = uint8_t( 1 + (i + round) % 26 );
+            changed = std::min( changed, check_all().first );
+        }
+        std::cout << "\"" << text << "\" on " << SESSIONS << " screens (" << first.second << " match): first "
+                  << first.first << " ms, unchanged " << unchanged << " ms, changed " << changed << " ms\n";
+        // Back to the booted screens for the next pattern.
+        for( int i = 0; i < SESSIONS; i++ )
+            std::memcpy( &screens[ size_t(i) * emu::ScreenText::CELLS ], booted, emu::ScreenText::CELLS );
+    }
+}
+
+//======================================================================
+// Run in real time for "seconds", streaming the frames to the viewers on
+// "path". Frames are only rendered while someone watches.
+static void stream_session( emu::C64 &c64, const std::string &path, double seconds )
+{
+    StreamServer server;
+    server.open( path, gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    std::cout << "Streaming on " << path << ".\n";
+    std::vector<uint8_t> indices( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    auto frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>( double( emu::CYCLES_PER_FRAME ) / sound::PAL_CLOCK ) );
+    auto next = std::chrono::steady_clock::now();
+    uint64_t end = c64.cycles_now() + uint64_t( seconds * sound::PAL_CLOCK );
+    alloc_count::FrameCheck check( "glMurks64-headless" );
+    while( c64.cycles_now() < end )
+    {
+        c64.run_frame();
+        server.poll();
+        if( server.has_viewers() )
+        {
+            render_indices( c64, indices.data() );
+            server.send_frame( indices.data() );
+        }
+        check.end_frame();
+        next += frame_time;
+        std::this_thread::sleep_until( next );
+    }
+    if( server.frames_sent() )
+        std::cout << server.frames_sent() << " frames streamed, "
+                  << (double( server.bytes_sent() ) / double( server.frames_sent() ))
+                  << " bytes per frame (all viewers).\n";
+}
+
+//======================================================================
+// The joystick of a player who doesn't need a keyboard: a new direction
+// (or fire) every 13 frames on port 2, every 17 on port 1.
+static uint8_t scripted_input( uint32_t frame, int port )
+{
+    uint32_t h = (frame / (port == 2 ? 13 : 17) + uint32_t( port ) * 7919u) * 2654435761u;
+    return uint8_t( (h >> 13) & 0x1F );
+}
+
+//======================================================================
+// One side of a two player session in real time, see LinkSocket. The
+// local joystick is scripted_input(). Returns false if the machines went
+// apart. Throws std::runtime_error.
+static bool link_session( emu::C64 &c64, const std::string &path, bool host, double seconds )
+{
+    LinkSocket link;
+    if( host )
+        link.host( path );
+    else
+        link.join( path );
+    std::cout << (host ? "Waiting for the other player on " : "Joining on ") << path << ".\n";
+    auto frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>( double( emu::CYCLES_PER_FRAME ) / sound::PAL_CLOCK ) );
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds( 30 );
+    while( !link.start( c64 ) )
+    {
+        if( std::chrono::steady_clock::now() > give_up )
+            throw std::runtime_error( "Link: nobody came." );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+    }
+    //------------------------------------------------------------------
+    int port = host ? 2 : 1;
+    emu::Rollback rollback;
+    rollback.start( c64, port );
+    uint32_t frames = uint32_t( std::max( 1.0, seconds * sound::PAL_CLOCK / emu::CYCLES_PER_FRAME ) );
+    uint64_t stalls = 0, skipped = 0;
+    auto next = std::chrono::steady_clock::now();
+    give_up = next + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>( seconds + 10.0 ) );
+    alloc_count::FrameCheck check( "glMurks64-headless" );
+    // Until our frames are done and the other side has sent all of its.
+    while( rollback.frame() < frames || rollback.remote_frames() < frames )
+    {
+        if( !link.poll( rollback ) )
+            throw std::runtime_error( "Link: the other player hung up." );
+        if( std::chrono::steady_clock::now() > give_up )
+            throw std::runtime_error( "Link: the other player stopped sending." );
+        uint32_t frame = rollback.frame();
+        uint8_t input = scripted_input( frame, port );
+        if( frame < frames )
+        {
+            if( rollback.frames_ahead() > 1 )
+                skipped++;  // Let the other side catch up.
+            else if( rollback.advance( input ) )
+                link.send_input( frame, input, rollback.remote_frames() );
+            else
+                stalls++;
+        }
+        uint32_t check_frame;
+        uint64_t hash;
+        if( rollback.take_check( check_frame, hash ) )
+            link.send_check( check_frame, hash );
+        check.end_frame();
+        next += frame_time;
+        std::this_thread::sleep_until( next );
+    }
+    //------------------------------------------------------------------
+    std::cout << rollback.frame() << " frames, " << rollback.rollbacks() << " rollbacks ("
+              << rollback.frames_rerun() << " frames run again, at most " << rollback.max_rollback_ms()
+              << " ms), " << skipped << " frames waited to let the other side catch up, "
+              << stalls << " stalls, " << rollback.checks_passed() << " checks passed.\n";
+    if( rollback.desynced() )
+    {
+        std::cerr << "***ERROR: The machines differ since frame " << rollback.desync_frame() << ".\n";
+        return false;
+    }
+    return true;
+}
+
+//======================================================================
+// Both players in this process, their inputs delivered "latency" frames
+// late. A third machine runs with the real inputs: its checksums must be
+// the ones the two sides agree on. Then the worst case that must fit
+// into a 60 Hz display frame: restore a snapshot, run 8 frames again.
+static void bench_rollback( double seconds, sound::SIDModel model, const std::vector<std::string> &programs )
+{
+    auto reference = std::make_unique<emu::C64>();
+    reference->init( model );
+    if( programs.empty() )
+        emu::wait_ready( *reference, 1, 5.0 );
+    else
+        emu::Autostart().start( *reference, emu::load_program( programs.front() ) );
+    auto start = std::make_unique<emu::C64::Snapshot>();
+    auto snap = std::make_unique<emu::C64::Snapshot>();
+    reference->save_state( *start );
+    uint32_t frames = uint32_t( std::max( 1.0, seconds * sound::PAL_CLOCK / emu::CYCLES_PER_FRAME ) );
+    //------------------------------------------------------------------
+    std::vector<uint64_t> expected;
+    for( uint32_t frame = 0; frame < frames; frame++ )
+    {
+        if( frame % emu::Rollback::CHECK_INTERVAL == 0 )
+        {
+            reference->save_state( *snap );
+            expected.push_back( emu::Rollback::hash( *snap ) );
+        }
+        reference->joystick( 2, scripted_input( frame, 2 ) );
+        reference->joystick( 1, scripted_input( frame, 1 ) );
+        reference->run_frame();
+    }
+    //------------------------------------------------------------------
+    struct Message { uint32_t due, frame; uint8_t input; uint32_t ack; bool check; uint64_t hash; };
+    for( uint32_t latency : { 2u, 4u, 7u } )
+    {
+        std::unique_ptr<emu::C64> machines[2] = { std::make_unique<emu::C64>(), std::make_unique<emu::C64>() };
+        emu::Rollback sides[2];
+        std::deque<Message> wire[2];     // To side i.
+        bool match = true;
+        for( int i = 0; i < 2; i++ )
+        {
+            machines[i]->init( model );
+            machines[i]->load_state( *start );
+        }
+        for( int i = 0; i < 2; i++ )
+            sides[i].start( *machines[i], 2 - i );
+        for( uint32_t tick = 0; sides[0].remote_frames() < frames || sides[1].remote_frames() < frames; tick++ )
+        {
+            for( int i = 0; i < 2; i++ )
+            {
+                while( !wire[i].empty() && wire[i].front().due <= tick )
+                {
+                    const Message &m = wire[i].front();
+                    if( m.check )
+                        sides[i].remote_check( m.frame, m.hash );
+                    else
+                        sides[i].remote_input( m.frame, m.input, m.ack );
+                    wire[i].pop_front();
+                }
+                uint32_t frame = sides[i].frame();
+                uint8_t input = scripted_input( frame, 2 - i );
+                if( frame < frames && sides[i].advance( input ) )
+                    wire[1 - i].push_back( { tick + latency, frame, input, sides[i].remote_frames(), false, 0 } );
+                uint32_t check_frame;
+                uint64_t hash;
+                if( sides[i].take_check( check_frame, hash ) )
+                {
+                    wire[1 - i].push_back( { tick + latency, check_frame, 0, 0, true, hash } );
+                    match = match && hash == expected[ check_frame / emu::Rollback::CHECK_INTERVAL ];
+                }
+            }
+        }
+        std::cout << "Latency " << latency << " frames: " << sides[0].rollbacks() << " rollbacks, "
+                  << (double( sides[0].frames_rerun() ) / double( std::max<uint64_t>( 1, sides[0].rollbacks() ) ))
+                  << " frames run again each, at most " << sides[0].max_rollback_ms() << " ms; "
+                  << sides[0].checks_passed() << " checks passed"
+                  << (sides[0].desynced() || sides[1].desynced() ? ", THE SIDES WENT APART" : "")
+                  << (match ? "" : ", NOT THE REFERENCE") << ".\n";
+    }
+    //------------------------------------------------------------------
+    double worst = 0, total = 0;
+    const int runs = 50;
+    for( int run = 0; run < runs; run++ )
+    {
+        reference->save_state( *snap );
+        reference->run_cycles( 8 * emu::CYCLES_PER_FRAME );
+        auto t0 = std::chrono::steady_clock::now();
+        reference->load_state( *snap );
+        reference->audio.set_output( false );
+        for( int frame = 0; frame < 8; frame++ )
+        {
+            reference->joystick( 2, scripted_input( uint32_t( run * 8 + frame ), 2 ) );
+            reference->run_frame();
+        }
+        reference->audio.set_output( true );
+        double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - t0 ).count();
+        worst = std::max( worst, ms );
+        total += ms;
+    }
+    std::cout << "Restore + 8 frames: " << (total / runs) << " ms on average, " << worst
+              << " ms at worst (budget: 16 ms).\n";
+}
+
+//======================================================================
+// The stream of a text screen: the start screen of BASIC with a blinking
+// cursor and a line typed at 6 characters per second, a keyframe every
+// 5 seconds. The screen is set up directly, not by the ROMs.
+static void bench_stream( double seconds )
+{
+    auto c64 = std::make_unique<emu::C64>();
+    c64->init();
+    const uint8_t regs[][2] = { { 0x11, 0x1B }, { 0x16, 0xC8 }, { 0x18, 0x14 }, { 0x20, 14 }, { 0x21, 6 } };
+    for( const auto &reg : regs )
+        c64->vic.write( reg[0], reg[1] );
+    uint8_t *screen = c64->ram.data() + 0x0400;
+    basic_screen( screen );
+    std::fill( c64->color_ram.begin(), c64->color_ram.end(), uint8_t( 14 ) );
+    const char *typed = "10 PRINT \"HELLO WORLD\" : GOTO 10";
+    //------------------------------------------------------------------
+    gfx::FrameEncoder encoder;
+    encoder.init( gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    std::vector<uint8_t> indices( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    int frames = std::max( 1, int( seconds * sound::PAL_CLOCK / emu::CYCLES_PER_FRAME ) );
+    size_t total = 0, keyframes = 0, keyframe_bytes = 0, largest = 0, smallest = SIZE_MAX;
+    double render_us = 0, encode_us = 0;
+    for( int frame = 0, column = 0; frame < frames; frame++ )
+    {
+        uint8_t &cursor = screen[ 6 * 40 + column ];
+        if( frame % 8 == 0 && typed[column] )
+        {
+            char c = typed[column++];
+            cursor = uint8_t( c >= 'A' && c <= 'Z' ? c - 'A' + 1 : c );
+        }
+        else if( frame % 16 == 0 )
+            cursor ^= 0x80;
+        c64->run_frame();
+        auto t0 = std::chrono::steady_clock::now();
+        render_indices( *c64, indices.data() );
+        auto t1 = std::chrono::steady_clock::now();
+        size_t bytes = encoder.encode( indices.data() ).size();
+        auto t2 = std::chrono::steady_clock::now();
+        render_us += std::chrono::duration<double, std::micro>( t1 - t0 ).count();
+        encode_us += std::chrono::duration<double, std::micro>( t2 - t1 ).count();
+        total += bytes;
+        if( encoder.last_was_keyframe() )
+        {
+            keyframes++;
+            keyframe_bytes += bytes;
+            continue;
+        }
+        largest = std::max( largest, bytes );
+        smallest = std::min( smallest, bytes );
+    }
+    std::cout << frames << " frames: " << (double( total ) / frames) << " bytes per frame on average (raw RGB: "
+              << (gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT * 3) << ").\n"
+              << "Keyframes: " << (keyframes ? keyframe_bytes / keyframes : 0) << " bytes, deltas: "
+              << (largest ? smallest : 0) << " to " << largest << " bytes.\n"
+              << "Render " << (render_us / frames) << " us, encode " << (encode_us / frames) << " us per frame.\n";
+}
+
+//======================================================================
+static void bench_mhz( double seconds, sound::SIDModel model )
+{
+    const char *labels[] = { "Scheduler: ", "Lockstep:  ", "Profiled:  " };
+    double mhz[3];
+    for( int mode = 0; mode < 3; mode++ )
+    {
+        auto c64 = std::make_unique<emu::C64>();
+        c64->init( model );
+        c64->set_lockstep( mode == 1 );
+        emu::Profiler profiler;
+        if( mode == 2 )
+            c64->cpu.set_profiler( &profiler );
+        double elapsed = run_machine( *c64, seconds );
+        mhz[mode] = seconds * sound::PAL_CLOCK / elapsed / 1e6;
+        std::cout << labels[mode] << mhz[mode] << " emulated MHz ("
+                  << (mhz[mode] * 1e6 / sound::PAL_CLOCK) << "x real time)\n";
+    }
+    std::cout << "Speedup:   " << (mhz[0] / mhz[1]) << "x\n";
+}
+
+//======================================================================
+// The end of a --profile session.
+static void finish_profile( const emu::Profiler &profiler, const std::string &file, const std::string &command )
+{
+    profiler.report( std::cout );
+    profiler.write_callgrind( file, command );
+    std::cout << "Profile saved as " << file << ".\n";
+}
+
+//======================================================================
+// Emulation speed without a monitor, with a monitor but nothing to watch,
+// and with breakpoints and watchpoints on pages that the KERNAL and BASIC
+// don't use: those must not cost anything either. Tracing for comparison.
+// The modes take turns, 5 runs each, and the fastest run counts.
+static void bench_monitor( double seconds, sound::SIDModel model )
+{
+    const char *labels[] = { "No monitor:         ", "Monitor, no points: ",
+                             "Unused pages:       ", "Trace:              " };
+    double best[4] = { 0, 0, 0, 0 };
+    bool stopped = false;
+    for( int run = 0; run < 5; run++ )
+    {
+        for( int mode = 0; mode < 4; mode++ )
+        {
+            auto c64 = std::make_unique<emu::C64>();
+            c64->init( model );
+            emu::Monitor monitor;
+            if( mode > 0 )
+                monitor.attach( *c64 );
+            if( mode == 2 )
+            {
+                monitor.add_breakpoint( 0xC000 );
+                monitor.add_watchpoint( 0xC100, 0xC1FF, emu::Monitor::WATCH_READ | emu::Monitor::WATCH_WRITE );
+            }
+            if( mode == 3 )
+                monitor.set_trace( true );
+            double mhz = seconds * sound::PAL_CLOCK / run_machine( *c64, seconds ) / 1e6;
+            best[mode] = std::max( best[mode], mhz );
+            stopped = stopped || monitor.stopped();
+        }
+    }
+    for( int mode = 0; mode < 4; mode++ )
+        std::cout << labels[mode] << best[mode] << " emulated MHz ("
+                  << (100.0 * (best[mode] / best[0] - 1.0)) << "%)\n";
+    if( stopped )
+        std::cout << "(A breakpoint was hit, the results are wrong.)\n";
+}
+
+//======================================================================
+// What run-ahead costs per displayed frame, on top of the frame itself.
+// A second machine runs the same frames without run-ahead: both must end
+// up the same, the hidden frames must leave no trace.
+static void bench_run_ahead( double seconds, sound::SIDModel model, const std::vector<std::string> &programs )
+{
+    emu::Program program;
+    if( !programs.empty() )
+        program = emu::load_program( programs.front() );
+    int frames = std::max( 1, int( seconds * sound::PAL_CLOCK / emu::CYCLES_PER_FRAME ) );
+    std::vector<uint8_t> indices( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    double frame_ms = 1000.0 * emu::CYCLES_PER_FRAME / sound::PAL_CLOCK;
+    for( int ahead = 1; ahead <= 4; ahead++ )
+    {
+        auto c64 = std::make_unique<emu::C64>();
+        auto plain = std::make_unique<emu::C64>();
+        emu::Autostart starter;
+        for( emu::C64 *m : { c64.get(), plain.get() } )
+        {
+            m->init( model );
+            if( programs.empty() )
+                emu::wait_ready( *m, 1, 5.0 );
+            else
+                starter.start( *m, program );
+        }
+        emu::RunAhead run_ahead;
+        run_ahead.set_frames( ahead );
+        double plain_seconds = 0;
+        bool same = true;
+        for( int frame = 0; frame < frames; frame++ )
+        {
+            c64->run_frame();
+            run_ahead.begin( *c64 );
+            render_indices( *c64, indices.data() );
+            run_ahead.end( *c64 );
+            //--------------------------------------------------------------
+            auto start = std::chrono::steady_clock::now();
+            plain->run_frame();
+            plain_seconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            same = same && c64->cycles_now() == plain->cycles_now() && c64->ram == plain->ram &&
+                   c64->cpu.s.pc == plain->cpu.s.pc;
+        }
+        double plain_ms = plain_seconds * 1000.0 / frames;
+        std::cout << ahead << " frame" << (ahead > 1 ? "s" : " ") << " ahead: "
+                  << run_ahead.average_ms() << " ms per frame, "
+                  << (100.0 * run_ahead.average_ms() / frame_ms) << "% of a PAL frame, "
+                  << (run_ahead.average_ms() / plain_ms) << "x the frame itself ("
+                  << plain_ms << " ms)" << (same ? "\n" : " - the machines differ!\n");
+    }
+}
+
+//======================================================================
+// True if a line was typed on the terminal. (Commands piped in wait
+// until the machine stops by itself.)
+static bool console_input()
+{
+    if( !isatty( 0 ) )
+        return false;
+    if( std::cin.rdbuf()->in_avail() > 0 )
+        return true;
+    pollfd pfd { 0, POLLIN, 0 };
+    return poll( &pfd, 1, 0 ) > 0;
+}
+
+//======================================================================
+// The monitor console. The machine runs a frame at a time while it
+// isn't stopped.
+static void monitor_console( emu::C64 &c64 )
+{
+    emu::Monitor monitor;
+    monitor.attach( c64 );
+    monitor.stop( "Monitor" );
+    std::string line;
+    while( true )
+    {
+        if( !monitor.stopped() )
+        {
+            c64.run_frame();
+            if( console_input() )
+                monitor.stop( "Stopped" );
+            continue;
+        }
+        std::string event = monitor.take_event();
+        if( !event.empty() )
+            std::cout << event << "\n" << monitor.command( "r" );
+        std::cout << "> " << std::flush;
+        if( !std::getline( std::cin, line ) || line == "quit" || line == "q" )
+            break;
+        std::cout << monitor.command( line );
+    }
+}
+
+//======================================================================
+int main(int argc, char** argv)
+{
+    std::string wav_file;
+    std::string disk;
+    std::string cartridge;
+    double seconds = 10.0;
+    bool bench = false;
+    bool bench_disk = false;
+    bool bench_mon = false;
+    bool bench_text = false;
+    bool monitor = false;
+    bool bench_frames = false;
+    bool bench_ahead = false;
+    bool bench_link = false;
+    std::string link;
+    bool link_host = false;
+    std::string stream;
+    std::string wait_text;
+    std::string capture, golden;
+    std::string profile;
+    emu::DriveMode drive_mode = emu::DriveMode::FAST_LOAD;
+    std::vector<std::string> programs;
+    sound::SIDModel model = sound::SIDModel::MOS6581;
+    //------------------------------------------------------------------
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if( arg == "--wav" && has_value )             wav_file = argv[++i];
+        else if( arg == "--seconds" && has_value )    seconds = std::atof( argv[++i] );
+        else if( arg == "--sid" && has_value )        model = (std::strcmp(argv[++i], "8580") == 0)
+                                                              ? sound::SIDModel::MOS8580
+                                                              : sound::SIDModel::MOS6581;
+        else if( arg == "--bench-mhz" )               bench = true;
+        else if( arg == "--disk" && has_value )       disk = argv[++i];
+        else if( arg == "--cart" && has_value )       cartridge = argv[++i];
+        else if( arg == "--drive" && has_value )      drive_mode = (std::strcmp(argv[++i], "true") == 0)
+                                                              ? emu::DriveMode::TRUE_DRIVE
+                                                              : emu::DriveMode::FAST_LOAD;
+        else if( arg == "--bench-load" )              bench_disk = true;
+        else if( arg == "--autostart" && has_value )  programs.push_back( argv[++i] );
+        else if( arg == "--monitor" )                 monitor = true;
+        else if( arg == "--bench-monitor" )           bench_mon = true;
+        else if( arg == "--wait-text" && has_value )  wait_text = argv[++i];
+        else if( arg == "--bench-screen-text" )       bench_text = true;
+        else if( arg == "--capture" && has_value )    capture = argv[++i];
+        else if( arg == "--golden" && has_value )     golden = argv[++i];
+        else if( arg == "--stream" && has_value )     stream = argv[++i];
+        else if( arg == "--bench-stream" )            bench_frames = true;
+        else if( arg == "--bench-run-ahead" )         bench_ahead = true;
+        else if( arg == "--bench-rollback" )          bench_link = true;
+        else if( arg == "--profile" && has_value )    profile = argv[++i];
+        else if( arg == "--link-host" && has_value )  { link = argv[++i]; link_host = true; }
+        else if( arg == "--link-join" && has_value )  { link = argv[++i]; link_host = false; }
+        else if( arg == "--decode-trace" && has_value )
+        {
+            try
+            {
+                emu::TraceRing::decode( emu::TraceRing::load( argv[++i] ), std::cout );
+                return 0;
+            }
+            catch( const std::runtime_error &e )
+            {
+                std::cerr << "***ERROR: " << e.what() << "\n";
+                return -1;
+            }
+        }
+        else { usage(); return -1; }
+    }
+    //------------------------------------------------------------------
+    if( utils::RM.get_path().empty() )
+    {
+        std::cerr << "***ERROR: Can't find resource folder!\n";
+        return -1;
+    }
+    if( bench )
+    {
+        bench_mhz( seconds, model );
+        return 0;
+    }
+    if( bench_disk )
+    {
+        bench_load( disk, model );
+        return 0;
+    }
+    if( bench_mon )
+    {
+        bench_monitor( seconds, model );
+        return 0;
+    }
+    if( bench_text )
+    {
+        bench_screen_text();
+        return 0;
+    }
+    if( bench_frames )
+    {
+        bench_stream( seconds );
+        return 0;
+    }
+    if( bench_link )
+    {
+        try
+        {
+            bench_rollback( seconds, model, programs );
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+        return 0;
+    }
+    if( bench_ahead )
+    {
+        try
+        {
+            bench_run_ahead( seconds, model, programs );
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+        return 0;
+    }
+    std::unique_ptr<emu::TextPattern> pattern;
+    try
+    {
+        if( !wait_text.empty() )
+            pattern = std::make_unique<emu::TextPattern>( wait_text );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << "\n";
+        return -1;
+    }
+    //------------------------------------------------------------------
+    auto c64 = std::make_unique<emu::C64>();
+    c64->init( model );
+    if( !disk.empty() || !cartridge.empty() )
+    {
+        try
+        {
+            if( !cartridge.empty() )
+                c64->attach_cartridge( cartridge, true );
+            if( !disk.empty() )
+            {
+                c64->attach_disk( disk );
+                c64->set_drive_mode( drive_mode );
+            }
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+    }
+    if( !wav_file.empty() )
+        c64->audio.open_wav( wav_file );
+    // Without programs the boot is profiled, else the programs' runs.
+    std::unique_ptr<emu::Profiler> profiler;
+    std::string command;
+    for( int i = 0; i < argc; i++ )
+        command += (i ? " " : "") + std::string( argv[i] );
+    if( !profile.empty() )
+        profiler = std::make_unique<emu::Profiler>();
+    //------------------------------------------------------------------
+    if( monitor || !stream.empty() || !link.empty() )
+    {
+        emu::Autostart autostart;
+        int result = 0;
+        try
+        {
+            if( !programs.empty() && (link.empty() || link_host) )
+                autostart.start( *c64, emu::load_program( programs[0] ) );
+            if( profiler )
+                c64->cpu.set_profiler( profiler.get() );
+            if( monitor )
+                monitor_console( *c64 );
+            else if( !link.empty() )
+                result = link_session( *c64, link, link_host, seconds ) ? 0 : 1;
+            else
+                stream_session( *c64, stream, seconds );
+            if( profiler )
+                finish_profile( *profiler, profile, command );
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+        c64->audio.close_wav();
+        return result;
+    }
+    //------------------------------------------------------------------
+    int result = 0;
+    if( profiler && programs.empty() )
+        c64->cpu.set_profiler( profiler.get() );
+    if( programs.empty() && pattern )
+    {
+        double found = run_until_text( *c64, *pattern, seconds );
+        if( found < 0 )
+            result = 1;
+        else
+            std::cout << "\"" << wait_text << "\" after " << found << " s emulated.\n";
+    }
+    else if( programs.empty() )
+    {
+        double elapsed = run_machine( *c64, seconds );
+        std::cout << seconds << " s emulated in " << elapsed << " s ("
+                  << (seconds / elapsed) << "x real time).\n";
+    }
+    bool frames = !capture.empty() || !golden.empty();
+    if( programs.empty() && frames )
+    {
+        try
+        {
+            if( !check_frame( *c64, "boot", capture, golden ) )
+                result = 1;
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+    }
+    //------------------------------------------------------------------
+    // Each program starts from the same freshly booted machine.
+    emu::Autostart autostart;
+    for( const auto &file : programs )
+    {
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            autostart.start( *c64, emu::load_program( file ) );
+            double setup = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+            if( profiler )
+                c64->cpu.set_profiler( profiler.get() );
+            if( pattern )
+            {
+                std::cout << file << ": ";
+                double found = run_until_text( *c64, *pattern, seconds );
+                if( found < 0 )
+                    result = 1;
+                else
+                    std::cout << "\"" << wait_text << "\" after " << found << " s emulated.\n";
+            }
+            else
+            {
+                double elapsed = run_machine( *c64, seconds );
+                std::cout << file << ": started in " << setup << " s, "
+                          << seconds << " s emulated in " << elapsed << " s.\n";
+            }
+            if( frames && !check_frame( *c64, std::filesystem::path( file ).stem().string(), capture, golden ) )
+                result = 1;
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << "\n";
+            return -1;
+        }
+    }
+    if( !programs.empty() )
+        std::cout << "Booted once, " << autostart.boot_seconds() << " s emulated.\n";
+    c64->audio.close_wav();
+    try
+    {
+        if( profiler )
+            finish_profile( *profiler, profile, command );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << "\n";
+        return -1;
+    }
+    return result;
+}
+
+//======================================================================
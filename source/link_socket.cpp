@@ -0,0 +1,241 @@
+//======================================================================
+#include "link_socket.h"
+#include "alloc_count.h"
+//======================================================================
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+//======================================================================
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//======================================================================
+namespace {
+    constexpr uint32_t MAGIC = 0x4C4D3634;  // "LM64"
+    enum : uint8_t { MSG_INPUT = 1, MSG_CHECK = 2 };
+    //------------------------------------------------------------------
+    void put32( uint8_t *p, uint32_t v )
+    {
+        for( int i = 0; i < 4; i++ )
+            p[i] = uint8_t( v >> (8 * i) );
+    }
+    uint32_t get32( const uint8_t *p )
+    {
+        return uint32_t( p[0] ) | uint32_t( p[1] ) << 8 | uint32_t( p[2] ) << 16 | uint32_t( p[3] ) << 24;
+    }
+} // End of namespace
+
+//======================================================================
+LinkSocket::~LinkSocket()
+{
+    close();
+}
+
+//======================================================================
+void LinkSocket::close()
+{
+    disconnect();
+    if( m_Listen >= 0 )
+    {
+        ::close( m_Listen );
+        unlink( m_Path.c_str() );
+    }
+    m_Listen = -1;
+    m_Path.clear();
+    m_Started = false;
+}
+
+//======================================================================
+void LinkSocket::host( const std::string &path )
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(addr.sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( std::string( "Can't create socket: " ) + std::strerror( errno ) );
+    unlink( path.c_str() );
+    if( bind( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 || listen( fd, 1 ) != 0 )
+    {
+        std::string text = "Can't listen on " + path + ": " + std::strerror( errno );
+        ::close( fd );
+        throw std::runtime_error( text );
+    }
+    m_Listen = fd;
+    m_Path = path;
+}
+
+//======================================================================
+void LinkSocket::join( const std::string &path )
+{
+    if( path.size() >= sizeof(sockaddr_un::sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    m_Path = path;
+    machine = std::make_unique<emu::C64::Snapshot>();
+}
+
+//======================================================================
+bool LinkSocket::start( emu::C64 &c64 )
+{
+    if( m_Started || m_Path.empty() )
+        return m_Started;
+    if( m_Peer < 0 )
+    {
+        if( m_Listen >= 0 )
+            m_Peer = accept4( m_Listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        else
+        {
+            sockaddr_un addr {};
+            addr.sun_family = AF_UNIX;
+            std::strcpy( addr.sun_path, m_Path.c_str() );
+            m_Peer = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+            if( m_Peer >= 0 && connect( m_Peer, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 )
+                disconnect();   // Not there yet, try again next time.
+        }
+        if( m_Peer < 0 )
+            return false;
+        //--------------------------------------------------------------
+        alloc_count::excuse_frame();
+        if( m_Listen >= 0 )
+        {
+            auto snap = std::make_unique<emu::C64::Snapshot>();
+            c64.save_state( *snap );
+            uint8_t head[8];
+            put32( head, MAGIC );
+            put32( head + 4, uint32_t( sizeof(emu::C64::Snapshot) ) );
+            out.reserve( sizeof(head) + sizeof(emu::C64::Snapshot) );
+            out.append( reinterpret_cast<const char*>( head ), sizeof(head) );
+            out.append( reinterpret_cast<const char*>( snap.get() ), sizeof(emu::C64::Snapshot) );
+            m_Started = flush();
+            return m_Started;
+        }
+    }
+    if( m_Listen < 0 )
+        m_Started = receive_machine( c64 );
+    return m_Started;
+}
+
+//======================================================================
+// The 8 byte header, then the snapshot.
+bool LinkSocket::receive_machine( emu::C64 &c64 )
+{
+    const size_t total = sizeof(header) + sizeof(emu::C64::Snapshot);
+    while( m_Peer >= 0 && received < total )
+    {
+        uint8_t *dest = received < sizeof(header) ? header + received
+                      : reinterpret_cast<uint8_t*>( machine.get() ) + (received - sizeof(header));
+        size_t want = received < sizeof(header) ? sizeof(header) - received : total - received;
+        ssize_t n = recv( m_Peer, dest, want, 0 );
+        if( n > 0 )
+        {
+            received += size_t(n);
+            if( received == sizeof(header) &&
+                (get32( header ) != MAGIC || get32( header + 4 ) != sizeof(emu::C64::Snapshot)) )
+            {
+                disconnect();
+                throw std::runtime_error( "Link: the host runs a different build." );
+            }
+            continue;
+        }
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            return false;
+        disconnect();
+        received = 0;
+    }
+    if( received < total )
+        return false;
+    c64.load_state( *machine );
+    out.reserve( 64 * MESSAGE );
+    return true;
+}
+
+//======================================================================
+bool LinkSocket::poll( emu::Rollback &rollback )
+{
+    if( !m_Started )
+        return true;
+    while( m_Peer >= 0 )
+    {
+        ssize_t n = recv( m_Peer, in + in_size, MESSAGE - in_size, 0 );
+        if( n > 0 )
+        {
+            in_size += size_t(n);
+            if( in_size < MESSAGE )
+                continue;
+            in_size = 0;
+            uint32_t frame = get32( in + 4 );
+            uint64_t value = get32( in + 8 ) | uint64_t( get32( in + 12 ) ) << 32;
+            if( in[0] == MSG_INPUT )
+                rollback.remote_input( frame, in[1], uint32_t( value ) );
+            else if( in[0] == MSG_CHECK )
+                rollback.remote_check( frame, value );
+            continue;
+        }
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            break;
+        disconnect();
+    }
+    return flush();
+}
+
+//======================================================================
+void LinkSocket::send_input( uint32_t frame, uint8_t input, uint32_t ack )
+{
+    send_message( MSG_INPUT, input, frame, ack );
+}
+
+//======================================================================
+void LinkSocket::send_check( uint32_t frame, uint64_t hash )
+{
+    send_message( MSG_CHECK, 0, frame, hash );
+}
+
+//======================================================================
+void LinkSocket::send_message( uint8_t type, uint8_t input, uint32_t frame, uint64_t value )
+{
+    if( m_Peer < 0 )
+        return;
+    uint8_t message[MESSAGE] { type, input };
+    put32( message + 4, frame );
+    put32( message + 8, uint32_t( value ) );
+    put32( message + 12, uint32_t( value >> 32 ) );
+    out.append( reinterpret_cast<const char*>( message ), MESSAGE );
+    flush();
+}
+
+//======================================================================
+// Send as much as the socket takes. Returns false (and disconnects) on
+// an error.
+bool LinkSocket::flush()
+{
+    size_t sent = 0;
+    while( m_Peer >= 0 && sent < out.size() )
+    {
+        ssize_t n = ::send( m_Peer, out.data() + sent, out.size() - sent, MSG_NOSIGNAL );
+        if( n > 0 )
+        {
+            sent += size_t(n);
+            continue;
+        }
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            break;
+        disconnect();
+    }
+    out.erase( 0, sent );
+    return m_Peer >= 0;
+}
+
+//======================================================================
+void LinkSocket::disconnect()
+{
+    if( m_Peer >= 0 )
+        ::close( m_Peer );
+    m_Peer = -1;
+}
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,75 @@
+#ifndef LINK_SOCKET_H
+#define LINK_SOCKET_H
+//======================================================================
+#include "c64.h"
+#include "rollback.h"
+#include "utils.h"
+//======================================================================
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//======================================================================
+// The connection of a two player session (see emu::Rollback) on a Unix
+// domain socket. One side hosts, the other one joins:
+//     glMurks64 --link-host /tmp/glMurks64-link
+//     glMurks64 --link-join /tmp/glMurks64-link
+// The host sends its machine to the joiner, so both start the same, with
+// whatever the host loaded. The snapshot is sent as it is in memory: both
+// sides must run the same build. After that, only the joystick input of
+// each frame and now and then a checksum go over the socket, in messages
+// of MESSAGE bytes. Everything is non-blocking and done once per frame.
+class LinkSocket
+{
+public:
+    //========================================================================
+    static constexpr size_t MESSAGE = 16;
+    //========================================================================
+    LinkSocket() = default;
+    NO_COPY( LinkSocket );
+    NO_MOVE( LinkSocket );
+    virtual ~LinkSocket();
+    //========================================================================
+    // Listen on "path" (replaced if it exists). Throws std::runtime_error.
+    void host( const std::string &path );
+    // Connect to the host on "path", as soon as it is there.
+    void join( const std::string &path );
+    bool is_open() const { return !m_Path.empty(); }
+    // End the session (or stop waiting for it).
+    void close();
+    bool is_host() const { return m_Listen >= 0; }
+    //========================================================================
+    // Until the session starts: the host waits for the other side and
+    // sends it "c64", the joiner waits for that machine and loads it into
+    // "c64". Returns true once both have it, then start the Rollback.
+    // Throws std::runtime_error if the host's machine doesn't fit.
+    bool start( emu::C64 &c64 );
+    bool started() const { return m_Started; }
+    // Hand what the other side sent to "rollback" (which may throw, see
+    // emu::Rollback::remote_input()). Returns false once it hung up.
+    bool poll( emu::Rollback &rollback );
+    void send_input( uint32_t frame, uint8_t input, uint32_t ack );
+    void send_check( uint32_t frame, uint64_t hash );
+
+private:
+    std::string m_Path;
+    int m_Listen {-1};
+    int m_Peer {-1};
+    bool m_Started {false};
+    std::string out;        // Not sent yet.
+    //------------------------------------------------------------------
+    // The joiner receives the header and then the host's machine.
+    std::unique_ptr<emu::C64::Snapshot> machine;
+    size_t received {0};
+    uint8_t header[8] {};
+    uint8_t in[MESSAGE] {};
+    size_t in_size {0};
+    //========================================================================
+    bool receive_machine( emu::C64 &c64 );
+    void send_message( uint8_t type, uint8_t input, uint32_t frame, uint64_t value );
+    bool flush();
+    void disconnect();
+};
+
+#endif // LINK_SOCKET_H
+//======================================================================
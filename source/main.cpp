@@ -1,83 +1,110 @@
 //======================================================================
 #include "mainwindow.h"
+#include "metrics.h"
 #include "utils.h"
 //======================================================================
 #include <SDL2/SDL.h>
 //======================================================================
-#include <iostream>
-#include <filesystem>
-#include <fstream>
-#include <string>
-#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
 
-//========================================================================
-#if defined(__linux__)
-    #include <unistd.h> // For "readlink()" on GNU/linux.
-#endif
-#if defined(_WIN32)
-    #include <libloaderapi.h> // For GetModuleFileName() on Windows
-#endif
+//======================================================================
+static void usage()
+{
+    std::cerr <<
+        "Usage: glMurks64 [options]\n"
+        "  --autostart <file>      Run a PRG/T64 program.\n"
+        "  --cart <file>           Plug in a CRT cartridge (8K, 16K, Ultimax,\n"
+        "                          Ocean, Magic Desk, EasyFlash). Changes to\n"
+        "                          the EasyFlash are written back to the file.\n"
+        "  --palette <name|file>   pepto, colodore, c64-wiki (default), or a\n"
+        "                          VICE .vpl file.\n"
+        "  --metrics-shm <name>    Publish performance counters in the shared\n"
+        "                          memory segment /dev/shm/<name>.\n"
+        "  --metrics-socket <path> Serve performance counters (Prometheus text\n"
+        "                          format over HTTP) on a Unix socket.\n"
+        "  --print-metrics <name>  Print the counters of a running emulator\n"
+        "                          started with --metrics-shm, and exit.\n"
+        "  --monitor <path>        Machine code monitor on a Unix socket, e.g.\n"
+        "                          socat - UNIX-CONNECT:<path>\n"
+        "  --stream <path>         Stream the frames to viewers on a Unix socket,\n"
+        "                          see glMurks64-streamview.\n"
+        "  --run-ahead <frames>    Show each frame as it will be that many\n"
+        "                          frames later (1-8), to hide input lag.\n"
+        "  --link-host <path>      Host a two player session on a Unix socket,\n"
+        "                          joystick 2 on the cursor keys and SPACE.\n"
+        "  --link-join <path>      Join it with joystick 1. The host's machine\n"
+        "                          (e.g. after --autostart) is the session's.\n"
+        "  --profile <file>        Count the cycles of the guest code per address\n"
+        "                          (after --autostart), print the hottest\n"
+        "                          routines at the end and save the profile in\n"
+        "                          callgrind format, for KCachegrind.\n";
+}
 
 //======================================================================
-namespace utils {
-    //======================================================================
-    Resource RM; // Singleton resource manager for the whole program
-    //======================================================================
-    Resource::Resource()
+int main(int argc, char** argv)
+{
+    //------------------------------------------------------------------
+    std::string program, cartridge, palette, metrics_shm, metrics_socket, monitor, stream;
+    std::string link, profile;
+    bool link_host = false;
+    int run_ahead = 0;
+    for( int i = 1; i < argc; i++ )
     {
-        path exe = Resource::get_exe_path();
-        resource_folder = find_resource_path( exe );
-        if( get_path() == "" )
+        std::string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if( arg == "--autostart" && has_value )           program = argv[++i];
+        else if( arg == "--cart" && has_value )           cartridge = argv[++i];
+        else if( arg == "--palette" && has_value )        palette = argv[++i];
+        else if( arg == "--metrics-shm" && has_value )    metrics_shm = argv[++i];
+        else if( arg == "--metrics-socket" && has_value ) metrics_socket = argv[++i];
+        else if( arg == "--monitor" && has_value )        monitor = argv[++i];
+        else if( arg == "--stream" && has_value )         stream = argv[++i];
+        else if( arg == "--run-ahead" && has_value )      run_ahead = std::atoi( argv[++i] );
+        else if( arg == "--link-host" && has_value )      { link = argv[++i]; link_host = true; }
+        else if( arg == "--link-join" && has_value )      { link = argv[++i]; link_host = false; }
+        else if( arg == "--profile" && has_value )        profile = argv[++i];
+        else if( arg == "--print-metrics" && has_value )
         {
-            std::cerr << "***ERROR: Can't find resource folder!\n";
-            exit(-1);
+            try
+            {
+                metrics::print_shared( argv[++i], std::cout );
+                return 0;
+            }
+            catch( const std::runtime_error &e )
+            {
+                std::cerr << "***ERROR: " << e.what() << std::endl;
+                return -1;
+            }
         }
+        else { usage(); return -1; }
     }
-    //======================================================================
-    Buffer Resource::load( const std::string & filename )
-    {
-        path full_path = resource_folder / filename;
-        return Buffer( full_path.string() );
-    }
-    //======================================================================
-    path Resource::get_exe_path()
-    {
-        char exe_path[65536];
-        memset(exe_path, 0, 65536);
-    #if defined(__linux__)
-        auto exe_size = readlink("/proc/self/exe", exe_path, 65535);
-    #elif defined(_WIN32)
-        (void)::GetModuleFileName(nullptr, exe_path, 65535);
-    #else
-    #error Operating system is not supported! Must be either Linux or Windows!
-    #endif
-        std::filesystem::path exe {exe_path};
-        return exe.parent_path();
-    }
-    //======================================================================
-    path Resource::find_resource_path(const path &check_dir)
+    //------------------------------------------------------------------
+    if( utils::RM.get_path().empty() )
     {
-        if( !std::filesystem::exists( check_dir) ) return "";
-        if( check_dir == "/" ) return "";
-        if( !std::filesystem::is_directory(check_dir) ) return "";
-
-        path test_dir = check_dir / "resource";
-        if( std::filesystem::is_directory(test_dir) )
-        {
-            return test_dir;
-        }
-
-        return find_resource_path( check_dir.parent_path() );
+        std::cerr << "***ERROR: Can't find resource folder!\n";
+        return -1;
     }
-}
-
-//======================================================================
-int main(int, char**)
-{
-    if(SDL_Init(SDL_INIT_VIDEO) >= 0)
+    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) >= 0)
     {
         atexit( SDL_Quit );
         auto win { MainWindow() };
+        if( !palette.empty() )
+            win.set_palette( palette );
+        win.publish_metrics( metrics_shm, metrics_socket );
+        if( !monitor.empty() )
+            win.open_monitor( monitor );
+        if( !stream.empty() )
+            win.open_stream( stream );
+        win.set_run_ahead( run_ahead );
+        if( !link.empty() )
+            win.open_link( link, link_host );
+        if( !cartridge.empty() )
+            win.attach_cartridge( cartridge );
+        if( !program.empty() )
+            win.autostart( program );
+        if( !profile.empty() )
+            win.profile( profile );
         win.loop();
     }
     return 0;
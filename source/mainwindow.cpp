@@ -1,6 +1,9 @@
 #include "mainwindow.h"
+#include "alloc_count.h"
+#include "render_kernels.h"
 #include "utils.h"
 #include <iostream>
+#include <algorithm>
 
 //======================================================================
 void GLAPIENTRY MessageCallback(
@@ -67,19 +70,69 @@ MainWindow::MainWindow()
     SDL_GetWindowSize(pWin, &width, &height);
     graphics.resize_screen(width, height);
     //------------------------------------------------------------------
+    // Power on the C64 and start the audio.
+    // Running without sound is fine, if there is no device.
+    c64.init();
+    audio_open = audio_out.open( c64.audio.ring, sound::OUTPUT_RATE );
+    c64.audio.enable_ring( audio_open );
+    last_counter = SDL_GetPerformanceCounter();
+    pacer.init( pWin );
+    //------------------------------------------------------------------
+    // Room for the steady state, see alloc_count.h: a slice per sprite
+    // and line at most, more keys than anyone types in a frame.
+    vic_slices.reserve( 8 * emu::LINES_PER_FRAME );
+    sprite_slices.reserve( 8 * emu::LINES_PER_FRAME );
+    key_queue.reserve( 64 );
 }
 
 //======================================================================
 MainWindow::~MainWindow()
 {
+    pacer.report( std::cout );
+    if( rollback.started() )
+        std::cout << "Two player session: " << rollback.frame() << " frames, " << rollback.rollbacks()
+                  << " rollbacks, at most " << rollback.max_rollback_ms() << " ms." << std::endl;
+    if( run_ahead.runs() )
+        std::cout << "Run-ahead of " << run_ahead.frames() << " frames: "
+                  << run_ahead.average_ms() << " ms CPU time per frame" << std::endl;
+    if( profiler )
+    {
+        c64.cpu.set_profiler( nullptr );
+        profiler->report( std::cout );
+        try
+        {
+            profiler->write_callgrind( profile_file, "glMurks64" );
+            std::cout << "Profile saved as " << profile_file << "." << std::endl;
+        }
+        catch( const std::runtime_error &e )
+        {
+            std::cerr << "***ERROR: " << e.what() << std::endl;
+        }
+    }
     SDL_DestroyWindow( pWin );
 }
 
+//======================================================================
+void MainWindow::profile( const std::string &filename )
+{
+    profiler = std::make_unique<emu::Profiler>();
+    profile_file = filename;
+    c64.cpu.set_profiler( profiler.get() );
+}
+
 //======================================================================
 void MainWindow::loop()
 {
+    // The start of each stage, and the end of the last one.
+    Uint64 stamps[metrics::STAGES + 1];
+    alloc_count::FrameCheck check( "glMurks64" );
     while( run )
     {
+        //------------------------------------------------------------------
+        // Sleep until the frame has to be started to make the next
+        // vblank, then poll the input as late as possible.
+        stamps[metrics::STAGE_WAIT] = SDL_GetPerformanceCounter();
+        pacer.wait();
         //------------------------------------------------------------------
         // Process SDL events.
         SDL_Event event;
@@ -87,22 +140,256 @@ void MainWindow::loop()
         {
             on_event( event );
         }
+        monitor_server.poll();
         //------------------------------------------------------------------
         int w, h;
         SDL_GetWindowSize( pWin, &w, &h );
         graphics.resize_screen(w,h); //event.window.data1, event.window.data2 );
         //------------------------------------------------------------------
-        // TODO: Render here
+        stamps[metrics::STAGE_EMULATE] = SDL_GetPerformanceCounter();
+        if( link.is_open() )
+            run_link();
+        else
+            run_emulation();
+        // The picture is taken from the hidden frames, then the machine
+        // goes back to where the real time is.
+        run_ahead.begin( c64 );
+        stamps[metrics::STAGE_UPLOAD] = SDL_GetPerformanceCounter();
+        gfx::VideoMemory vm { c64.ram.data(), c64.color_ram.data(), c64.vic.raster_lines(), c64.vic.display_lines() };
+        graphics.set_screen( vm );
+        update_sprites();
+        stream_frame( vm );
+        run_ahead.end( c64 );
+        //------------------------------------------------------------------
+        stamps[metrics::STAGE_RENDER] = SDL_GetPerformanceCounter();
         glClear( GL_COLOR_BUFFER_BIT );
         //------------------------------------------------------------------
         graphics.render();
+        glFinish();
+        pacer.rendered();
         //------------------------------------------------------------------
-        // Make rendered frame visible.
+        // Make rendered frame visible. With vsync, glFinish() returns
+        // when the swap has happened.
+        stamps[metrics::STAGE_PRESENT] = SDL_GetPerformanceCounter();
         SDL_GL_SwapWindow(pWin);
+        glFinish();
+        pacer.presented();
+        stamps[metrics::STAGES] = SDL_GetPerformanceCounter();
+        update_metrics( stamps );
+        check.end_frame();
         //------------------------------------------------------------------
     }
 }
 
+//======================================================================
+// Emulate the time that passed since the last frame.
+// Queued key events are applied at the emulated cycle (and so the
+// raster line) that corresponds to the wall clock time they arrived at.
+void MainWindow::run_emulation()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = double(now - last_counter) / double(SDL_GetPerformanceFrequency());
+    //------------------------------------------------------------------
+    // Don't try to catch up after a stall (e.g. window dragging),
+    // at most 3 PAL frames are emulated at once.
+    uint64_t cycles = uint64_t( std::min( elapsed, 0.06 ) * sound::PAL_CLOCK );
+    uint64_t start = c64.cycles_now();
+    for( auto &k : key_queue )
+    {
+        double f = 0.0;
+        if( k.arrival > last_counter && now > last_counter )
+            f = std::min( 1.0, double(k.arrival - last_counter) / double(now - last_counter) );
+        c64.run_until( start + uint64_t( f * double(cycles) ) );
+        on_key( k.event, k.down );
+        pacer.input( k.arrival );
+    }
+    key_queue.clear();
+    c64.run_until( start + cycles );
+    metrics::add( metrics.counters().cycles, c64.cycles_now() - start );
+    last_counter = now;
+}
+
+//======================================================================
+// The two player session: a frame per PAL frame of wall time, each with
+// the joystick as it is then, see emu::Rollback. While waiting for the
+// other side to connect, the machine stands still.
+void MainWindow::run_link()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = double(now - last_counter) / double(SDL_GetPerformanceFrequency());
+    last_counter = now;
+    for( auto &k : key_queue )
+    {
+        link_key( k.event.key.keysym.sym, k.down );
+        pacer.input( k.arrival );
+    }
+    key_queue.clear();
+    //------------------------------------------------------------------
+    const double frame_time = double( emu::CYCLES_PER_FRAME ) / sound::PAL_CLOCK;
+    try
+    {
+        if( !link.start( c64 ) )
+            return;
+        if( !rollback.started() )
+            rollback.start( c64, link.is_host() ? 2 : 1 );
+        if( !link.poll( rollback ) )
+            throw std::runtime_error( "Link: the other player hung up." );
+        uint64_t start = c64.cycles_now();
+        link_time = std::min( link_time + elapsed, 3 * frame_time );
+        // A frame less now and then lets the other side catch up.
+        if( rollback.frames_ahead() > 1 && link_time >= frame_time )
+            link_time -= frame_time;
+        while( link_time >= frame_time )
+        {
+            uint32_t frame = rollback.frame();
+            if( !rollback.advance( link_joystick ) )
+                break;  // The other side is too far behind.
+            link.send_input( frame, link_joystick, rollback.remote_frames() );
+            link_time -= frame_time;
+        }
+        uint32_t check_frame;
+        uint64_t hash;
+        if( rollback.take_check( check_frame, hash ) )
+            link.send_check( check_frame, hash );
+        metrics::add( metrics.counters().cycles, c64.cycles_now() - start );
+        if( rollback.desynced() && !link_reported )
+        {
+            std::cerr << "***ERROR: The machines of the session differ since frame "
+                      << rollback.desync_frame() << "." << std::endl;
+            link_reported = true;
+        }
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+        link.close();
+    }
+}
+
+//======================================================================
+// The cursor keys and SPACE (fire) are the joystick.
+void MainWindow::link_key( SDL_Keycode sym, bool down )
+{
+    uint8_t bit = 0;
+    switch( sym )
+    {
+    case SDLK_UP:    bit = 0x01; break;
+    case SDLK_DOWN:  bit = 0x02; break;
+    case SDLK_LEFT:  bit = 0x04; break;
+    case SDLK_RIGHT: bit = 0x08; break;
+    case SDLK_SPACE: bit = 0x10; break;
+    }
+    link_joystick = uint8_t( down ? (link_joystick | bit) : (link_joystick & ~bit) );
+}
+
+//======================================================================
+// Hand the sprite slices of the frame from the VIC to the renderer.
+void MainWindow::update_sprites()
+{
+    c64.vic.sprite_slices( vic_slices );
+    sprite_slices.resize( vic_slices.size() );
+    for( size_t i = 0; i < vic_slices.size(); i++ )
+    {
+        const auto &v = vic_slices[i];
+        sprite_slices[i] = { v.x, v.line, v.lines, v.row, v.data, v.color, v.mc0, v.mc1, v.flags };
+    }
+    graphics.set_sprites( sprite_slices.data(), int( sprite_slices.size() ) );
+}
+
+//======================================================================
+// The frame is rendered on the CPU, and only while someone watches.
+void MainWindow::stream_frame( const gfx::VideoMemory &vm )
+{
+    stream_server.poll();
+    if( !stream_server.has_viewers() )
+        return;
+    stream_indices.resize( gfx::FRAME_WIDTH * gfx::FRAME_HEIGHT );
+    gfx::render_frame( vm, c64.char_rom.data(), stream_indices.data() );
+    stream_server.send_frame( stream_indices.data() );
+}
+
+//======================================================================
+// Once per frame: a few relaxed stores, nothing that waits for readers.
+void MainWindow::update_metrics( const Uint64 (&stamps)[metrics::STAGES + 1] )
+{
+    auto &c = metrics.counters();
+    double frequency = double( SDL_GetPerformanceFrequency() );
+    for( int s = 0; s < metrics::STAGES; s++ )
+    {
+        uint64_t ns = uint64_t( double( stamps[s + 1] - stamps[s] ) * 1e9 / frequency );
+        metrics::set( c.stage_ns[s], ns );
+        metrics::add( c.stage_ns_total[s], ns );
+    }
+    uint64_t uploaded = graphics.take_uploaded_bytes();
+    metrics::set( c.upload_bytes, uploaded );
+    metrics::add( c.upload_bytes_total, uploaded );
+    metrics::set( c.frames_emulated, c.cycles.load( std::memory_order_relaxed ) / emu::CYCLES_PER_FRAME );
+    metrics::add( c.frames_presented, 1 );
+    metrics::set( c.frames_dropped, pacer.dropped() );
+    metrics::set( c.audio_fill, audio_open ? c64.audio.ring.size() : 0 );
+    metrics::set( c.audio_capacity, audio_open ? c64.audio.ring.capacity() : 0 );
+    metrics.end_frame( double( stamps[metrics::STAGES] ) / frequency );
+}
+
+//======================================================================
+void MainWindow::publish_metrics( const std::string &shm_name, const std::string &socket_path )
+{
+    try
+    {
+        if( !shm_name.empty() )
+            metrics.open_shared( shm_name );
+        if( !socket_path.empty() )
+            metrics.serve( socket_path );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+}
+
+//======================================================================
+void MainWindow::open_monitor( const std::string &socket_path )
+{
+    try
+    {
+        monitor_server.open( socket_path, monitor );
+        monitor.attach( c64 );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+}
+
+//======================================================================
+void MainWindow::open_stream( const std::string &socket_path )
+{
+    try
+    {
+        stream_server.open( socket_path, gfx::FRAME_WIDTH, gfx::FRAME_HEIGHT );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+}
+
+//======================================================================
+void MainWindow::open_link( const std::string &socket_path, bool host )
+{
+    try
+    {
+        if( host )
+            link.host( socket_path );
+        else
+            link.join( socket_path );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+}
+
 //======================================================================
 void MainWindow::load_open_gl( GLADloadproc proc_address )
 {
@@ -132,11 +419,89 @@ bool MainWindow::on_event( SDL_Event & event )
         run = false;
         return true;
     case SDL_KEYDOWN: return on_keydown( event );
+    case SDL_KEYUP:   return queue_key( event, false );
     case SDL_WINDOWEVENT: return on_window_event( event) ;
+    case SDL_DROPFILE:
+    {
+        std::string filename = event.drop.file;
+        SDL_free( event.drop.file );
+        if( link.started() )
+        {
+            std::cerr << "***ERROR: Not during a two player session." << std::endl;
+            return true;
+        }
+        bool crt = filename.size() > 4 &&
+                   SDL_strcasecmp( filename.c_str() + filename.size() - 4, ".crt" ) == 0;
+        if( crt )
+            attach_cartridge( filename );
+        else
+            autostart( filename );
+        return true;
+    }
     }
     return false;
 }
 
+//======================================================================
+void MainWindow::autostart( const std::string &filename )
+{
+    alloc_count::excuse_frame();
+    // The first start boots the C64 as fast as possible,
+    // that audio is not worth hearing.
+    c64.audio.enable_ring( false );
+    try
+    {
+        starter.start( c64, emu::load_program( filename ) );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+    c64.audio.enable_ring( audio_open );
+    last_counter = SDL_GetPerformanceCounter();
+}
+
+//======================================================================
+void MainWindow::attach_cartridge( const std::string &filename )
+{
+    alloc_count::excuse_frame();
+    try
+    {
+        c64.attach_cartridge( filename, true );
+        // The booted machine of the autostart had no cartridge.
+        starter = emu::Autostart();
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+    last_counter = SDL_GetPerformanceCounter();
+}
+
+//======================================================================
+void MainWindow::set_palette( const std::string &name )
+{
+    alloc_count::excuse_frame();
+    try
+    {
+        gfx::set_palette( gfx::Palette::load( name ) );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << std::endl;
+    }
+}
+
+//======================================================================
+// Switch to the next built-in palette.
+void MainWindow::next_palette()
+{
+    const auto &names = gfx::Palette::builtin_names();
+    auto it = std::find( names.begin(), names.end(), gfx::current_palette().name() );
+    set_palette( (it == names.end() || it + 1 == names.end()) ? names.front() : *(it + 1) );
+    std::cout << "Palette: " << gfx::current_palette().name() << std::endl;
+}
+
 //======================================================================
 bool MainWindow::on_keydown( SDL_Event & event )
 {
@@ -145,11 +510,82 @@ bool MainWindow::on_keydown( SDL_Event & event )
     case SDLK_ESCAPE:
         close();
         break;
+    case SDLK_p:
+        if( (event.key.keysym.mod & KMOD_ALT) )
+        {
+            if( !event.key.repeat )
+                next_palette();
+            return true;
+        }
+        break;
     case SDLK_RETURN:
         if( (event.key.keysym.mod & KMOD_ALT) )
+        {
             toggle_fullscreen();
+            return true;
+        }
         break;
     }
+    return queue_key( event, true );
+}
+
+//======================================================================
+bool MainWindow::queue_key( SDL_Event & event, bool down )
+{
+    if( event.key.repeat )
+        return true;    // The C64 KERNAL does its own key repeat.
+    key_queue.push_back( { event, down, FramePacer::event_time( event.key.timestamp ) } );
+    return true;
+}
+
+//======================================================================
+// Position of a PC key in the C64 keyboard matrix
+// (column = CIA1 port A bit, row = CIA1 port B bit).
+struct KeyMapping { SDL_Keycode key; int col, row; };
+static const KeyMapping keymap[] = {
+    { SDLK_BACKSPACE, 0, 0 }, { SDLK_RETURN, 0, 1 }, { SDLK_RIGHT, 0, 2 }, { SDLK_F7, 0, 3 },
+    { SDLK_F1, 0, 4 },        { SDLK_F3, 0, 5 },     { SDLK_F5, 0, 6 },    { SDLK_DOWN, 0, 7 },
+    { '3', 1, 0 }, { 'w', 1, 1 }, { 'a', 1, 2 }, { '4', 1, 3 },
+    { 'z', 1, 4 }, { 's', 1, 5 }, { 'e', 1, 6 }, { SDLK_LSHIFT, 1, 7 },
+    { '5', 2, 0 }, { 'r', 2, 1 }, { 'd', 2, 2 }, { '6', 2, 3 },
+    { 'c', 2, 4 }, { 'f', 2, 5 }, { 't', 2, 6 }, { 'x', 2, 7 },
+    { '7', 3, 0 }, { 'y', 3, 1 }, { 'g', 3, 2 }, { '8', 3, 3 },
+    { 'b', 3, 4 }, { 'h', 3, 5 }, { 'u', 3, 6 }, { 'v', 3, 7 },
+    { '9', 4, 0 }, { 'i', 4, 1 }, { 'j', 4, 2 }, { '0', 4, 3 },
+    { 'm', 4, 4 }, { 'k', 4, 5 }, { 'o', 4, 6 }, { 'n', 4, 7 },
+    { '-', 5, 0 }, { 'p', 5, 1 }, { 'l', 5, 2 }, { '=', 5, 3 },
+    { '.', 5, 4 }, { ';', 5, 5 }, { '[', 5, 6 }, { ',', 5, 7 },
+    { SDLK_INSERT, 6, 0 }, { ']', 6, 1 }, { '\'', 6, 2 }, { SDLK_HOME, 6, 3 },
+    { SDLK_RSHIFT, 6, 4 }, { '\\', 6, 5 }, { SDLK_DELETE, 6, 6 }, { '/', 6, 7 },
+    { '1', 7, 0 }, { '`', 7, 1 }, { SDLK_TAB, 7, 2 }, { '2', 7, 3 },
+    { SDLK_SPACE, 7, 4 }, { SDLK_LCTRL, 7, 5 }, { 'q', 7, 6 }, { SDLK_END, 7, 7 },
+};
+
+//======================================================================
+// Forward key presses and releases to the C64 keyboard matrix.
+// LEFT and UP are SHIFT + RIGHT and SHIFT + DOWN on the C64.
+// PAGE UP is the RESTORE key.
+bool MainWindow::on_key( SDL_Event & event, bool down )
+{
+    SDL_Keycode sym = event.key.keysym.sym;
+    if( sym == SDLK_PAGEUP )
+    {
+        c64.restore( down );
+        return true;
+    }
+    if( sym == SDLK_LEFT || sym == SDLK_UP )
+    {
+        c64.key( 1, 7, down ); // Left shift
+        sym = (sym == SDLK_LEFT) ? SDLK_RIGHT : SDLK_DOWN;
+    }
+    for( const auto &k : keymap )
+    {
+        if( k.key == sym )
+        {
+            c64.key( k.col, k.row, down );
+            return true;
+        }
+    }
     return false;
 }
 
@@ -172,6 +608,7 @@ bool MainWindow::on_window_event( SDL_Event & event)
     switch( event.window.type )
     {
     case SDL_WINDOWEVENT_SIZE_CHANGED:
+        alloc_count::excuse_frame();
         graphics.resize_screen(event.window.data1, event.window.data2 );
         return true;
         break;
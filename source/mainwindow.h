@@ -2,10 +2,25 @@
 #define MAINWINDOW_H
 //======================================================================
 #include "graphics.h"
+#include "c64.h"
+#include "autostart.h"
+#include "run_ahead.h"
+#include "rollback.h"
+#include "profiler.h"
+#include "audio_output.h"
+#include "frame_pacer.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "monitor_server.h"
+#include "stream_server.h"
+#include "link_socket.h"
 //======================================================================
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 //======================================================================
+#include <memory>
+#include <vector>
+//======================================================================
 // Note: A SCALING of 8 means characters are 8x8 pixels in size.
 #define SCALING (8)
 #define SCREEN_WIDTH  (384*2)
@@ -17,6 +32,36 @@ public:
     MainWindow();
     ~MainWindow();
     void loop();
+    // Run a PRG/T64 file without LOAD. Errors are reported on stderr.
+    void autostart( const std::string &filename );
+    // Plug in a CRT cartridge and reset. EasyFlash changes are written
+    // back to the file. Errors are reported on stderr.
+    void attach_cartridge( const std::string &filename );
+    // A built-in palette or a .vpl file, see gfx::Palette::load().
+    // Alt+P cycles through the built-in palettes.
+    void set_palette( const std::string &name );
+    // Publish the performance counters in the shared memory segment
+    // "shm_name" and/or on the Unix socket "socket_path" (empty: not).
+    // Errors are reported on stderr.
+    void publish_metrics( const std::string &shm_name, const std::string &socket_path );
+    // The machine code monitor on the Unix socket "socket_path", see
+    // MonitorServer. Errors are reported on stderr.
+    void open_monitor( const std::string &socket_path );
+    // Stream the frames (without sprites) to viewers on the Unix socket
+    // "socket_path", see StreamServer. Errors are reported on stderr.
+    void open_stream( const std::string &socket_path );
+    // Show each frame as it will be "frames" frames later, see
+    // emu::RunAhead. 0 is off.
+    void set_run_ahead( int frames ) { run_ahead.set_frames( frames ); }
+    // A two player session with another glMurks64, see LinkSocket: the
+    // host plays with joystick 2, the other side with joystick 1, both
+    // with the cursor keys and SPACE. The C64 keyboard is off meanwhile.
+    // Errors are reported on stderr.
+    void open_link( const std::string &socket_path, bool host );
+    // Profile the guest code from now on, see emu::Profiler. At the end,
+    // the hottest routines are printed and the profile is saved to
+    // "filename" in callgrind format.
+    void profile( const std::string &filename );
     void close()
     {
         SDL_Event ev { SDL_QUIT };
@@ -29,12 +74,48 @@ private:
     bool run { true };
 
     gfx::Graphics graphics;
+    emu::C64 c64;
+    emu::Autostart starter;     // Keeps the booted machine.
+    emu::RunAhead run_ahead;
+    emu::Monitor monitor;       // Attached by open_monitor().
+    MonitorServer monitor_server;
+    StreamServer stream_server;
+    std::vector<uint8_t> stream_indices;    // The frame for the viewers.
+    LinkSocket link;
+    emu::Rollback rollback;
+    std::unique_ptr<emu::Profiler> profiler;
+    std::string profile_file;
+    uint8_t link_joystick {0};  // The local player's joystick bits.
+    double link_time {0.0};     // Wall time not emulated yet, in seconds.
+    bool link_reported {false};
+    sound::AudioOutput audio_out;
+    bool audio_open {false};
+    Uint64 last_counter {0};    // Performance counter at the last frame.
+    FramePacer pacer;
+    metrics::Metrics metrics;
+    //------------------------------------------------------------------
+    // C64 key events wait here until the emulation reaches the time
+    // they arrived at.
+    struct QueuedKey { SDL_Event event; bool down; Uint64 arrival; };
+    std::vector<QueuedKey> key_queue;
+    //------------------------------------------------------------------
+    std::vector<emu::VIC::SpriteSlice> vic_slices;
+    std::vector<gfx::SpriteSlice> sprite_slices;
 
     void load_open_gl(GLADloadproc proc_address);
     bool on_event( SDL_Event &event );
     bool on_keydown( SDL_Event & event );
+    bool on_key( SDL_Event & event, bool down );
+    bool queue_key( SDL_Event & event, bool down );
     void toggle_fullscreen();
+    void next_palette();
     bool on_window_event( SDL_Event & event);
+    void run_emulation();
+    void run_link();
+    void link_key( SDL_Keycode sym, bool down );
+    void update_sprites();
+    void stream_frame( const gfx::VideoMemory &vm );
+    void update_metrics( const Uint64 (&stamps)[metrics::STAGES + 1] );
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,223 @@
+//======================================================================
+#include "metrics.h"
+//======================================================================
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+//======================================================================
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace metrics {
+
+//======================================================================
+const char *const stage_names[STAGES] = { "wait", "emulate", "upload", "render", "present" };
+
+//======================================================================
+static std::string error_text( const std::string &what )
+{
+    return what + ": " + std::strerror( errno );
+}
+
+//======================================================================
+void write_prometheus( const Counters &c, std::ostream &out )
+{
+    auto get = []( const std::atomic<uint64_t> &a ) { return a.load( std::memory_order_relaxed ); };
+    auto metric = [&out]( const char *name, const char *type, const char *help ) {
+        out << "# HELP glmurks64_" << name << ' ' << help << "\n"
+            << "# TYPE glmurks64_" << name << ' ' << type << "\n";
+    };
+    //------------------------------------------------------------------
+    metric( "cycles_total", "counter", "Emulated CPU cycles." );
+    out << "glmurks64_cycles_total " << get( c.cycles ) << "\n";
+    metric( "cycles_per_second", "gauge", "Emulated CPU cycles per wall clock second." );
+    out << "glmurks64_cycles_per_second " << get( c.cycles_per_second ) << "\n";
+    metric( "frames_emulated_total", "counter", "Emulated VIC frames." );
+    out << "glmurks64_frames_emulated_total " << get( c.frames_emulated ) << "\n";
+    metric( "frames_presented_total", "counter", "Frames shown on the display." );
+    out << "glmurks64_frames_presented_total " << get( c.frames_presented ) << "\n";
+    metric( "frames_dropped_total", "counter", "Display refreshes without a new frame." );
+    out << "glmurks64_frames_dropped_total " << get( c.frames_dropped ) << "\n";
+    //------------------------------------------------------------------
+    metric( "stage_seconds", "gauge", "Time of each stage of the last frame." );
+    for( int s = 0; s < STAGES; s++ )
+        out << "glmurks64_stage_seconds{stage=\"" << stage_names[s] << "\"} "
+            << double( get( c.stage_ns[s] ) ) * 1e-9 << "\n";
+    metric( "stage_seconds_total", "counter", "Time spent in each stage." );
+    for( int s = 0; s < STAGES; s++ )
+        out << "glmurks64_stage_seconds_total{stage=\"" << stage_names[s] << "\"} "
+            << double( get( c.stage_ns_total[s] ) ) * 1e-9 << "\n";
+    //------------------------------------------------------------------
+    metric( "upload_bytes", "gauge", "Bytes uploaded to the GPU for the last frame." );
+    out << "glmurks64_upload_bytes " << get( c.upload_bytes ) << "\n";
+    metric( "upload_bytes_total", "counter", "Bytes uploaded to the GPU." );
+    out << "glmurks64_upload_bytes_total " << get( c.upload_bytes_total ) << "\n";
+    metric( "audio_buffer_samples", "gauge", "Samples waiting in the audio ring buffer." );
+    out << "glmurks64_audio_buffer_samples " << get( c.audio_fill ) << "\n";
+    metric( "audio_buffer_capacity", "gauge", "Size of the audio ring buffer in samples." );
+    out << "glmurks64_audio_buffer_capacity " << get( c.audio_capacity ) << "\n";
+}
+
+//======================================================================
+void print_shared( const std::string &name, std::ostream &out )
+{
+    int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( error_text( "Can't open metrics " + name ) );
+    void *p = mmap( nullptr, sizeof(Counters), PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED )
+        throw std::runtime_error( error_text( "Can't map metrics " + name ) );
+    const Counters *c = static_cast<const Counters*>( p );
+    if( c->magic != Counters::MAGIC || c->version != Counters::VERSION )
+    {
+        munmap( p, sizeof(Counters) );
+        throw std::runtime_error( "Metrics " + name + ": unknown format" );
+    }
+    write_prometheus( *c, out );
+    munmap( p, sizeof(Counters) );
+}
+
+//======================================================================
+Metrics::~Metrics()
+{
+    if( m_Server.joinable() )
+    {
+        m_Stop = true;
+        m_Server.join();
+    }
+    if( m_Listen >= 0 )
+    {
+        close( m_Listen );
+        unlink( m_SocketPath.c_str() );
+    }
+    if( m_Counters != &m_Local )
+    {
+        m_Counters->~Counters();
+        munmap( m_Counters, sizeof(Counters) );
+        shm_unlink( m_ShmName.c_str() );
+    }
+}
+
+//======================================================================
+void Metrics::open_shared( const std::string &name )
+{
+    if( m_Counters != &m_Local )
+        throw std::runtime_error( "Metrics are shared already" );
+    int fd = shm_open( name.c_str(), O_CREAT | O_RDWR, 0644 );
+    if( fd < 0 )
+        throw std::runtime_error( error_text( "Can't create metrics " + name ) );
+    if( ftruncate( fd, sizeof(Counters) ) != 0 )
+    {
+        close( fd );
+        throw std::runtime_error( error_text( "Can't size metrics " + name ) );
+    }
+    void *p = mmap( nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED )
+        throw std::runtime_error( error_text( "Can't map metrics " + name ) );
+    m_ShmName = name;
+    m_Counters = new( p ) Counters;
+}
+
+//======================================================================
+void Metrics::serve( const std::string &path )
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if( m_Listen >= 0 )
+        throw std::runtime_error( "Metrics are served already" );
+    if( path.size() >= sizeof(addr.sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    std::strcpy( addr.sun_path, path.c_str() );
+    //------------------------------------------------------------------
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( error_text( "Can't create socket" ) );
+    unlink( path.c_str() );
+    if( bind( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 || listen( fd, 4 ) != 0 )
+    {
+        std::string text = error_text( "Can't listen on " + path );
+        close( fd );
+        throw std::runtime_error( text );
+    }
+    m_Listen = fd;
+    m_SocketPath = path;
+    m_Server = std::thread( &Metrics::server_loop, this );
+}
+
+//======================================================================
+// Answer every connection with the counters, whatever was requested.
+// Polling with a timeout lets the destructor stop the thread.
+void Metrics::server_loop()
+{
+    while( !m_Stop )
+    {
+        pollfd pfd { m_Listen, POLLIN, 0 };
+        if( poll( &pfd, 1, 200 ) <= 0 )
+            continue;
+        int client = accept4( m_Listen, nullptr, nullptr, SOCK_CLOEXEC );
+        if( client < 0 )
+            continue;
+        //--------------------------------------------------------------
+        // Read the request (up to the empty line), but don't wait long
+        // for clients that send nothing.
+        timeval timeout { 0, 200000 };
+        setsockopt( client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+        char request[1024];
+        std::string head;
+        ssize_t n;
+        while( head.find( "\r\n\r\n" ) == std::string::npos && head.size() < 8192
+               && (n = recv( client, request, sizeof(request), 0 )) > 0 )
+            head.append( request, size_t(n) );
+        //--------------------------------------------------------------
+        std::ostringstream body;
+        write_prometheus( *m_Counters, body );
+        std::string text = body.str();
+        std::string response = "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string( text.size() ) + "\r\n"
+                               "Connection: close\r\n\r\n" + text;
+        for( size_t sent = 0; sent < response.size(); )
+        {
+            n = send( client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL );
+            if( n <= 0 )
+                break;
+            sent += size_t(n);
+        }
+        close( client );
+    }
+}
+
+//======================================================================
+void Metrics::end_frame( double seconds )
+{
+    uint64_t cycles = m_Counters->cycles.load( std::memory_order_relaxed );
+    if( m_RateStart < 0 )
+    {
+        m_RateStart = seconds;
+        m_RateCycles = cycles;
+    }
+    else if( seconds - m_RateStart >= 1.0 )
+    {
+        set( m_Counters->cycles_per_second,
+             uint64_t( double( cycles - m_RateCycles ) / (seconds - m_RateStart) ) );
+        m_RateStart = seconds;
+        m_RateCycles = cycles;
+    }
+}
+
+//======================================================================
+} // End of namespace metrics
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,121 @@
+#ifndef METRICS_H
+#define METRICS_H
+//======================================================================
+#include "utils.h"
+//======================================================================
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+//======================================================================
+// Live performance counters, for scraping without a debugger.
+//
+// The counters are written by the main loop only, once per frame, with
+// relaxed loads and stores (no locked instructions, no fences). Readers
+// may see a frame's counters half updated, which is fine for monitoring.
+// They can be published in two ways, both optional:
+//
+//  - A POSIX shared memory segment (/dev/shm/<name>) holding the
+//    Counters struct. Readers map it read-only, see print_shared().
+//  - A Unix domain socket serving the Prometheus text format over HTTP
+//    from its own thread, e.g.:
+//        curl --unix-socket /tmp/glMurks64.sock http://localhost/metrics
+//
+// Without either, the counters are a plain static struct.
+namespace metrics {
+
+//======================================================================
+// Stages of a host frame, timed by the main loop.
+enum Stage { STAGE_WAIT, STAGE_EMULATE, STAGE_UPLOAD, STAGE_RENDER, STAGE_PRESENT, STAGES };
+extern const char *const stage_names[STAGES];
+
+//======================================================================
+// The layout of the shared memory segment. Only std::atomic<uint64_t>
+// after the header, which is lock-free (and so address-free) on every
+// platform the emulator runs on.
+struct Counters
+{
+    static constexpr uint32_t MAGIC   = 0x4D363443;   // "C64M"
+    static constexpr uint32_t VERSION = 1;
+    uint32_t magic   {MAGIC};
+    uint32_t version {VERSION};
+    //------------------------------------------------------------------
+    std::atomic<uint64_t> cycles {0};               // Emulated cycles.
+    std::atomic<uint64_t> cycles_per_second {0};    // Over the last second.
+    std::atomic<uint64_t> frames_emulated {0};      // Complete VIC frames.
+    std::atomic<uint64_t> frames_presented {0};     // Buffer swaps.
+    std::atomic<uint64_t> frames_dropped {0};       // Missed vblanks.
+    std::atomic<uint64_t> stage_ns[STAGES] {};      // Of the last frame.
+    std::atomic<uint64_t> stage_ns_total[STAGES] {};
+    std::atomic<uint64_t> upload_bytes {0};         // Of the last frame.
+    std::atomic<uint64_t> upload_bytes_total {0};
+    std::atomic<uint64_t> audio_fill {0};           // Samples in the ring.
+    std::atomic<uint64_t> audio_capacity {0};
+};
+static_assert( std::atomic<uint64_t>::is_always_lock_free,
+               "The counters must be lock-free to be shared between processes." );
+
+//======================================================================
+// Single writer updates: a load and a store, no read-modify-write.
+inline void set( std::atomic<uint64_t> &counter, uint64_t value )
+{
+    counter.store( value, std::memory_order_relaxed );
+}
+inline void add( std::atomic<uint64_t> &counter, uint64_t value )
+{
+    counter.store( counter.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+}
+
+//======================================================================
+// Write the counters in the Prometheus text format.
+void write_prometheus( const Counters &c, std::ostream &out );
+// Map the segment "name" read-only and write its counters to "out".
+// Throws std::runtime_error.
+void print_shared( const std::string &name, std::ostream &out );
+
+//======================================================================
+class Metrics
+{
+public:
+    //========================================================================
+    Metrics() = default;
+    NO_COPY( Metrics );
+    NO_MOVE( Metrics );
+    virtual ~Metrics();
+    //========================================================================
+    // Move the counters to the shared memory segment "name" (created,
+    // removed again by the destructor). Throws std::runtime_error.
+    void open_shared( const std::string &name );
+    // Serve the counters on the Unix socket at "path" (replaced if it
+    // exists). Throws std::runtime_error.
+    void serve( const std::string &path );
+    //========================================================================
+    Counters &counters() { return *m_Counters; }
+    //========================================================================
+    // End of a host frame: "seconds" is the wall clock time. Updates
+    // the cycles per second once a second.
+    void end_frame( double seconds );
+
+private:
+    Counters m_Local;
+    Counters *m_Counters { &m_Local };
+    std::string m_ShmName;
+    //------------------------------------------------------------------
+    std::string m_SocketPath;
+    int m_Listen {-1};
+    std::atomic<bool> m_Stop {false};
+    std::thread m_Server;
+    //------------------------------------------------------------------
+    double m_RateStart {-1.0};
+    uint64_t m_RateCycles {0};
+    //========================================================================
+    void server_loop();
+};
+
+//======================================================================
+} // End of namespace metrics
+
+#endif // METRICS_H
+//======================================================================
@@ -0,0 +1,130 @@
+//======================================================================
+#include "monitor_server.h"
+#include "alloc_count.h"
+//======================================================================
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+//======================================================================
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//======================================================================
+MonitorServer::~MonitorServer()
+{
+    disconnect();
+    if( m_Listen >= 0 )
+    {
+        close( m_Listen );
+        unlink( m_Path.c_str() );
+    }
+}
+
+//======================================================================
+void MonitorServer::open( const std::string &path, emu::Monitor &monitor )
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(addr.sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( std::string( "Can't create socket: " ) + std::strerror( errno ) );
+    unlink( path.c_str() );
+    if( bind( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 || listen( fd, 1 ) != 0 )
+    {
+        std::string text = "Can't listen on " + path + ": " + std::strerror( errno );
+        close( fd );
+        throw std::runtime_error( text );
+    }
+    m_Listen = fd;
+    m_Path = path;
+    m_Monitor = &monitor;
+}
+
+//======================================================================
+void MonitorServer::poll()
+{
+    if( m_Listen < 0 )
+        return;
+    //------------------------------------------------------------------
+    if( m_Client < 0 )
+    {
+        m_Client = accept4( m_Listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if( m_Client < 0 )
+            return;
+        m_Input.clear();
+        alloc_count::excuse_frame();
+        send( "glMurks64 monitor, type \"help\".\n" + std::string( m_Monitor->stopped() ? "> " : "" ) );
+    }
+    //------------------------------------------------------------------
+    char buffer[1024];
+    ssize_t n;
+    while( (n = recv( m_Client, buffer, sizeof(buffer), 0 )) > 0 )
+    {
+        m_Input.append( buffer, size_t(n) );
+        alloc_count::excuse_frame();    // Commands may allocate.
+    }
+    if( n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) )
+    {
+        disconnect();
+        return;
+    }
+    //------------------------------------------------------------------
+    size_t end;
+    while( (end = m_Input.find( '\n' )) != std::string::npos )
+    {
+        std::string line = m_Input.substr( 0, end );
+        m_Input.erase( 0, end + 1 );
+        if( !line.empty() && line.back() == '\r' )
+            line.pop_back();
+        send( m_Monitor->command( line ) );
+        if( !report() && m_Monitor->stopped() )
+            send( "> " );
+    }
+    report();
+}
+
+//======================================================================
+// Tell the client why the machine stopped (a breakpoint, a step, "stop").
+bool MonitorServer::report()
+{
+    std::string event = m_Monitor->take_event();
+    if( event.empty() )
+        return false;
+    alloc_count::excuse_frame();
+    send( event + "\n" + m_Monitor->command( "r" ) + "> " );
+    return true;
+}
+
+//======================================================================
+void MonitorServer::send( const std::string &text )
+{
+    int waits = 0;
+    for( size_t sent = 0; m_Client >= 0 && sent < text.size(); )
+    {
+        ssize_t n = ::send( m_Client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL );
+        if( n > 0 )
+        {
+            sent += size_t(n);
+            continue;
+        }
+        // A client that doesn't read for a second loses its connection.
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && ++waits < 1000 )
+            usleep( 1000 );
+        else
+            disconnect();
+    }
+}
+
+//======================================================================
+void MonitorServer::disconnect()
+{
+    if( m_Client >= 0 )
+        close( m_Client );
+    m_Client = -1;
+}
+
+//======================================================================
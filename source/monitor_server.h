@@ -0,0 +1,45 @@
+#ifndef MONITOR_SERVER_H
+#define MONITOR_SERVER_H
+//======================================================================
+#include "monitor.h"
+#include "utils.h"
+//======================================================================
+#include <string>
+
+//======================================================================
+// The monitor on a Unix domain socket, for the main window:
+//     socat - UNIX-CONNECT:/tmp/glMurks64-monitor
+// One client at a time. Everything is non-blocking and done by poll(),
+// once per frame in the main loop, so the emulation needs no locks.
+// A command line sent while the machine runs is executed at once, e.g.
+// "stop", "m" or "break"; "g" and "step" let it run on.
+class MonitorServer
+{
+public:
+    //========================================================================
+    MonitorServer() = default;
+    NO_COPY( MonitorServer );
+    NO_MOVE( MonitorServer );
+    virtual ~MonitorServer();
+    //========================================================================
+    // Listen on "path" (replaced if it exists). Throws std::runtime_error.
+    void open( const std::string &path, emu::Monitor &monitor );
+    bool is_open() const { return m_Listen >= 0; }
+    //========================================================================
+    // Accept a client, execute its complete lines, report stops.
+    void poll();
+
+private:
+    emu::Monitor *m_Monitor {nullptr};
+    std::string m_Path;
+    int m_Listen {-1};
+    int m_Client {-1};
+    std::string m_Input;
+    //========================================================================
+    bool report();
+    void send( const std::string &text );
+    void disconnect();
+};
+
+#endif // MONITOR_SERVER_H
+//======================================================================
@@ -0,0 +1,48 @@
+//========================================================================
+#include "audio.h"
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+void Audio::init( SIDModel model, double clock )
+{
+    sid.init( model );
+    resampler.init( clock, OUTPUT_RATE );
+    //------------------------------------------------------------------
+    // About 170 ms of audio. Enough to ride out a late frame, small
+    // enough to keep the latency acceptable. The device callback keeps
+    // the actual fill level much lower.
+    ring.init( 8192 );
+}
+
+//========================================================================
+void Audio::run( int cycles )
+{
+    if( !output )
+    {
+        sid.clock_silent( cycles );
+        return;
+    }
+    while( cycles > 0 )
+    {
+        int n = std::min( cycles, CHUNK );
+        sid.clock( n, cycle_samples.data() );
+        size_t produced = resampler.process( cycle_samples.data(), size_t(n),
+                                             out_samples.data(), out_samples.size() );
+        //--------------------------------------------------------------
+        // If the ring is full (device not draining), the samples are
+        // dropped. The emulation must never block on audio.
+        if( ring_enabled )
+            ring.push( out_samples.data(), produced );
+        wav.write( out_samples.data(), produced );
+        cycles -= n;
+    }
+}
+
+//========================================================================
+} // End of namespace sound
+
+//========================================================================
+// End of file.
+//========================================================================
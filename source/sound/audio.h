@@ -0,0 +1,65 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "sid.h"
+#include "resampler.h"
+#include "audio_ring.h"
+#include "wav_writer.h"
+
+#include <cstdint>
+#include <array>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Sample rate of the audio output (device and WAV file).
+constexpr int OUTPUT_RATE = 48000;
+
+//========================================================================
+// The audio pipeline: SID -> resampler -> ring buffer and/or WAV file.
+//
+// The emulation calls run() with the number of cycles that passed since
+// the last call (typically once per register write and once per frame).
+// The SID is synthesized for the whole batch, resampled to OUTPUT_RATE
+// and the result is pushed to the ring (drained by the audio device)
+// and written to the WAV file, if one is open.
+class Audio
+{
+public:
+    //========================================================================
+    void init( SIDModel model = SIDModel::MOS6581, double clock = PAL_CLOCK );
+    //========================================================================
+    // Synthesize and resample the given number of cycles.
+    void run( int cycles );
+    //========================================================================
+    // Output sinks.
+    void enable_ring( bool enable ) { ring_enabled = enable; }
+    void open_wav( const std::string &filename ) { wav.open( filename, OUTPUT_RATE ); }
+    void close_wav() { wav.close(); }
+    // With the output off, run() only keeps the SID's voices going (see
+    // SID::clock_silent()): no filter, no resampling, nothing reaches the
+    // ring or the WAV file.
+    void set_output( bool enable ) { output = enable; }
+    bool output_enabled() const { return output; }
+    //========================================================================
+    SID sid;
+    SpscRing<int16_t> ring;     // Drained by the audio device callback.
+    WavWriter wav;
+
+private:
+    //========================================================================
+    // The SID output is processed in chunks of this many cycles.
+    static constexpr int CHUNK = 2048;
+    //========================================================================
+    Resampler resampler;
+    bool ring_enabled {false};
+    bool output {true};
+    std::array<float,   CHUNK>   cycle_samples;
+    std::array<int16_t, CHUNK/8> out_samples;
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // AUDIO_H
@@ -0,0 +1,67 @@
+//========================================================================
+#include "audio_output.h"
+
+#include <iostream>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+bool AudioOutput::open( SpscRing<int16_t> &source, int rate )
+{
+    close();
+    ring = &source;
+    //------------------------------------------------------------------
+    SDL_AudioSpec want {}, have {};
+    want.freq     = rate;
+    want.format   = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples  = 512;    // ~10 ms at 48 kHz.
+    want.callback = &AudioOutput::callback;
+    want.userdata = this;
+    //------------------------------------------------------------------
+    device = SDL_OpenAudioDevice( nullptr, 0, &want, &have, 0 );
+    if( device == 0 )
+    {
+        std::cerr << "***WARNING: Could not open audio device: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_PauseAudioDevice( device, 0 ); // Start playing.
+    return true;
+}
+
+//========================================================================
+void AudioOutput::close()
+{
+    if( device != 0 )
+    {
+        SDL_CloseAudioDevice( device );
+        device = 0;
+    }
+}
+
+//========================================================================
+// Runs on the SDL audio thread.
+void AudioOutput::callback( void *userdata, Uint8 *stream, int len )
+{
+    auto self = static_cast<AudioOutput*>(userdata);
+    auto out  = reinterpret_cast<int16_t*>(stream);
+    size_t count = size_t(len) / sizeof(int16_t);
+    //------------------------------------------------------------------
+    size_t got = self->ring->pop( out, count );
+    if( got > 0 )
+        self->last_sample = out[got-1];
+    if( got < count )
+    {
+        self->m_Underruns++;
+        for( size_t i = got; i < count; i++ )
+            out[i] = self->last_sample;
+    }
+}
+
+//========================================================================
+} // End of namespace sound
+
+//========================================================================
+// End of file.
+//========================================================================
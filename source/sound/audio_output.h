@@ -0,0 +1,45 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include "audio_ring.h"
+#include "utils.h"
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Plays the samples of a ring buffer on an SDL audio device.
+// The SDL audio thread calls the callback, which drains the ring.
+// On an underrun, the last sample is held to avoid clicks.
+class AudioOutput
+{
+public:
+    //========================================================================
+    AudioOutput() = default;
+    NO_COPY( AudioOutput );
+    NO_MOVE( AudioOutput );
+    virtual ~AudioOutput() { close(); }
+    //========================================================================
+    // Returns false if no audio device could be opened. (Not fatal.)
+    bool open( SpscRing<int16_t> &source, int rate );
+    void close();
+    //========================================================================
+    // Number of underruns (callbacks that didn't get enough samples).
+    uint32_t underruns() const { return m_Underruns; }
+
+private:
+    SDL_AudioDeviceID device {0};
+    SpscRing<int16_t> *ring {nullptr};
+    int16_t last_sample {0};
+    uint32_t m_Underruns {0};
+    //========================================================================
+    static void callback( void *userdata, Uint8 *stream, int len );
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // AUDIO_OUTPUT_H
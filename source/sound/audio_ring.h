@@ -0,0 +1,96 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Lock-free single-producer / single-consumer ring buffer.
+//
+// The emulation thread pushes resampled audio, the audio device callback
+// pops it. Neither side ever blocks or takes a lock. The capacity is
+// rounded up to a power of two, so the indices can run freely and are
+// only masked on access.
+template<typename T>
+class SpscRing
+{
+public:
+    //========================================================================
+    SpscRing() = default;
+    explicit SpscRing( size_t capacity ) { init(capacity); }
+    //========================================================================
+    void init( size_t capacity )
+    {
+        size_t cap = 1;
+        while( cap < capacity ) cap <<= 1;
+        buffer.assign( cap, T{} );
+        mask = cap - 1;
+        head.store( 0, std::memory_order_relaxed );
+        tail.store( 0, std::memory_order_relaxed );
+    }
+    //========================================================================
+    size_t capacity() const { return mask + 1; }
+    // Number of elements ready to pop. (Exact only from the consumer side.)
+    size_t size() const
+    {
+        return head.load( std::memory_order_acquire ) - tail.load( std::memory_order_acquire );
+    }
+    //========================================================================
+    // Producer: write up to "count" elements, returns the number written.
+    size_t push( const T *data, size_t count )
+    {
+        size_t h = head.load( std::memory_order_relaxed );
+        size_t t = tail.load( std::memory_order_acquire );
+        size_t n = std::min( count, capacity() - (h - t) );
+        copy_in( h, data, n );
+        head.store( h + n, std::memory_order_release );
+        return n;
+    }
+    //========================================================================
+    // Consumer: read up to "count" elements, returns the number read.
+    size_t pop( T *data, size_t count )
+    {
+        size_t t = tail.load( std::memory_order_relaxed );
+        size_t h = head.load( std::memory_order_acquire );
+        size_t n = std::min( count, h - t );
+        copy_out( t, data, n );
+        tail.store( t + n, std::memory_order_release );
+        return n;
+    }
+
+private:
+    //========================================================================
+    // Copy in at most two parts, the second one after wrapping around.
+    void copy_in( size_t index, const T *data, size_t n )
+    {
+        size_t i = index & mask;
+        size_t first = std::min( n, capacity() - i );
+        std::memcpy( &buffer[i], data, first * sizeof(T) );
+        std::memcpy( &buffer[0], data + first, (n - first) * sizeof(T) );
+    }
+    void copy_out( size_t index, T *data, size_t n )
+    {
+        size_t i = index & mask;
+        size_t first = std::min( n, capacity() - i );
+        std::memcpy( data, &buffer[i], first * sizeof(T) );
+        std::memcpy( data + first, &buffer[0], (n - first) * sizeof(T) );
+    }
+    //========================================================================
+    std::vector<T> buffer;
+    size_t mask {0};
+    //------------------------------------------------------------------
+    // Producer and consumer indices live on separate cache lines.
+    alignas(64) std::atomic<size_t> head {0};
+    alignas(64) std::atomic<size_t> tail {0};
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // AUDIO_RING_H
@@ -0,0 +1,150 @@
+//========================================================================
+#include "resampler.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Zeroth order modified Bessel function, for the Kaiser window.
+static double bessel_i0( double x )
+{
+    double sum = 1.0, term = 1.0;
+    for( int k = 1; k < 32; k++ )
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+//========================================================================
+void Resampler::init( double in_rate, double out_rate, double passband )
+{
+    ratio = in_rate / out_rate;
+    step  = uint64_t( ratio * 4294967296.0 );
+    //------------------------------------------------------------------
+    // Aliases of frequencies between out_rate/2 and (out_rate - passband)
+    // fold back above the pass band, so the stop band may start there.
+    double stopband   = out_rate - passband;
+    double cutoff     = (passband + stopband) / 2.0 / in_rate;  // Normalized.
+    double transition = (stopband - passband) / in_rate;        // Normalized.
+    //------------------------------------------------------------------
+    // Kaiser window design for ~90 dB stop band attenuation.
+    const double atten = 90.0;
+    const double beta  = 0.1102 * (atten - 8.7);
+    size_t n = size_t( std::ceil( (atten - 8.0) / (2.285 * 2.0 * M_PI * transition) ) );
+    m_Taps = (n + 7) & ~size_t(7); // Multiple of 8 for the vectorized dot product.
+    //------------------------------------------------------------------
+    // Build the sub-filters. Phase p is used for an output sample that
+    // lies p/PHASES of an input sample after the first tap.
+    coeffs.assign( size_t(PHASES) * m_Taps, 0.0f );
+    const double half = double(m_Taps) / 2.0;
+    const double i0_beta = bessel_i0( beta );
+    for( int p = 0; p < PHASES; p++ )
+    {
+        double frac = double(p) / PHASES;
+        double sum = 0;
+        float *c = &coeffs[ size_t(p) * m_Taps ];
+        for( size_t k = 0; k < m_Taps; k++ )
+        {
+            double x = double(k) - frac - half;     // Distance from the center.
+            double r = x / half;                    // -1 .. +1 over the window.
+            double w = (std::fabs(r) <= 1.0) ? bessel_i0( beta * std::sqrt(1.0 - r*r) ) / i0_beta : 0.0;
+            double s = (x == 0.0) ? 1.0 : std::sin( 2.0 * M_PI * cutoff * x ) / (2.0 * M_PI * cutoff * x);
+            c[k] = float( w * s );
+            sum += w * s;
+        }
+        // Normalize every phase to unity gain, so DC passes unchanged.
+        for( size_t k = 0; k < m_Taps; k++ )
+            c[k] = float( c[k] / sum );
+    }
+    //------------------------------------------------------------------
+    reset();
+}
+
+//========================================================================
+void Resampler::reset()
+{
+    pos = 0;
+    history.assign( m_Taps * 4, 0.0f );
+    hist_len = m_Taps; // Start with a history of silence.
+}
+
+//========================================================================
+float Resampler::dot( const float *a, const float *b, size_t n )
+{
+#if defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps();
+    for( size_t i = 0; i < n; i += 8 )
+        acc0 = _mm256_add_ps( acc0, _mm256_mul_ps( _mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i) ) );
+    __m128 acc = _mm_add_ps( _mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1) );
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for( size_t i = 0; i < n; i += 8 )
+    {
+        acc0 = _mm_add_ps( acc0, _mm_mul_ps( _mm_loadu_ps(a+i),   _mm_loadu_ps(b+i)   ) );
+        acc1 = _mm_add_ps( acc1, _mm_mul_ps( _mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4) ) );
+    }
+    __m128 acc = _mm_add_ps( acc0, acc1 );
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+    // Horizontal sum of the 4 lanes.
+    acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+    acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+    return _mm_cvtss_f32( acc );
+#else
+    float sum = 0;
+    for( size_t i = 0; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+#endif
+}
+
+//========================================================================
+size_t Resampler::process( const float *in, size_t count, int16_t *out, size_t max_out )
+{
+    //------------------------------------------------------------------
+    // Append the new input to the history.
+    if( hist_len + count > history.size() )
+        history.resize( hist_len + count );
+    std::memcpy( &history[hist_len], in, count * sizeof(float) );
+    hist_len += count;
+    //------------------------------------------------------------------
+    // Produce all output samples whose filter window is complete.
+    size_t produced = 0;
+    while( produced < max_out )
+    {
+        size_t idx = size_t( pos >> 32 );
+        if( idx + m_Taps > hist_len ) break;
+        size_t phase = size_t( (pos >> (32 - PHASE_BITS)) & (PHASES - 1) );
+        float v = dot( &history[idx], &coeffs[ phase * m_Taps ], m_Taps );
+        //--------------------------------------------------------------
+        v = std::clamp( v * 32767.0f, -32768.0f, 32767.0f );
+        out[produced++] = int16_t( std::lrintf( v ) );
+        pos += step;
+    }
+    //------------------------------------------------------------------
+    // Drop the input samples that are no longer needed.
+    size_t consumed = std::min( size_t( pos >> 32 ), hist_len );
+    std::memmove( &history[0], &history[consumed], (hist_len - consumed) * sizeof(float) );
+    hist_len -= consumed;
+    pos -= uint64_t(consumed) << 32;
+    //------------------------------------------------------------------
+    return produced;
+}
+
+//========================================================================
+} // End of namespace sound
+
+//========================================================================
+// End of file.
+//========================================================================
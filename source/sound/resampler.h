@@ -0,0 +1,61 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Polyphase FIR resampler, used to bring the SID output (one sample per
+// system cycle, ~985 kHz) down to the audio device rate (48 kHz).
+//
+// The windowed-sinc prototype filter is split into "phases" sub-filters,
+// one for each fractional position between two input samples. Each output
+// sample is a single dot product of the input history with one phase.
+// The dot product is vectorized (SSE / AVX when available).
+class Resampler
+{
+public:
+    //========================================================================
+    // in_rate, out_rate: sample rates in Hz.
+    // passband: upper edge of the pass band in Hz (below out_rate/2).
+    void init( double in_rate, double out_rate, double passband = 20000.0 );
+    void reset();
+    //========================================================================
+    // Feed "count" input samples and write the resulting output samples
+    // to "out" (at most "max_out"). Returns the number of output samples.
+    // Input that can't be consumed because "out" is full is dropped, so
+    // size "out" with max_output(count).
+    size_t process( const float *in, size_t count, int16_t *out, size_t max_out );
+    //========================================================================
+    // Upper bound of output samples produced for "count" input samples.
+    size_t max_output( size_t count ) const { return size_t( double(count) / ratio ) + 2; }
+    //========================================================================
+    size_t taps() const { return m_Taps; }
+
+private:
+    //========================================================================
+    static constexpr int PHASE_BITS = 8;
+    static constexpr int PHASES = 1 << PHASE_BITS;
+    //========================================================================
+    double ratio {1};           // in_rate / out_rate
+    size_t m_Taps {0};          // Taps per phase (multiple of 8).
+    //------------------------------------------------------------------
+    // Step and position in input samples, 32.32 fixed point.
+    uint64_t step {0};
+    uint64_t pos {0};
+    //------------------------------------------------------------------
+    std::vector<float> coeffs;  // PHASES x m_Taps coefficients.
+    std::vector<float> history; // Input history, at least m_Taps samples.
+    size_t hist_len {0};        // Valid samples in history.
+    //========================================================================
+    static float dot( const float *a, const float *b, size_t n );
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // RESAMPLER_H
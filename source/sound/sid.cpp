@@ -0,0 +1,378 @@
+//========================================================================
+#include "sid.h"
+
+#include <cmath>
+#include <algorithm>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Number of cycles between two envelope steps, for the 16 rate settings.
+// (Values as measured on real chips, see reSID.)
+static const uint16_t rate_periods[16] = {
+        9,    32,    63,    95,   149,   220,   267,   313,
+      392,   977,  1954,  3126,  3907, 11720, 19532, 31251
+};
+
+//========================================================================
+// The exponential decay: the envelope counter is only stepped every
+// "n"th rate period, depending on the current envelope level.
+static uint8_t exp_period_for( uint8_t level )
+{
+    if( level > 0x5D ) return 1;
+    if( level > 0x36 ) return 2;
+    if( level > 0x1A ) return 4;
+    if( level > 0x0E ) return 8;
+    if( level > 0x06 ) return 16;
+    if( level > 0x00 ) return 30;
+    return 1;
+}
+
+//========================================================================
+void SID::init( SIDModel model )
+{
+    m_Model = model;
+    //------------------------------------------------------------------
+    // The 6581 has a large DC offset in the voice outputs (the zero level
+    // of the waveform is not centered) and in the mixer. The latter is
+    // what makes "volume register samples" (digis) audible.
+    if( m_Model == SIDModel::MOS6581 )
+    {
+        voice_dc = float(0x800 - 0x380);
+        mixer_dc = -0.06f;
+    }
+    else
+    {
+        voice_dc = 0.0f;
+        mixer_dc = 0.0f;
+    }
+    reset();
+}
+
+//========================================================================
+void SID::reset()
+{
+    for( auto &v : voice )
+    {
+        v = Voice {};
+    }
+    fc = 0;
+    res_filt = 0;
+    mode_vol = 0;
+    bus_value = 0;
+    f_lp = f_bp = 0;
+    dc_block = 0;
+    update_filter();
+}
+
+//========================================================================
+void SID::set_rate( Voice &v, uint8_t rate )
+{
+    v.rate_period = rate_periods[rate & 0x0F];
+}
+
+//========================================================================
+void SID::write( uint8_t reg, uint8_t value )
+{
+    bus_value = value;
+    //------------------------------------------------------------------
+    // Voice registers: 7 per voice.
+    if( reg < 0x15 )
+    {
+        Voice &v = voice[reg / 7];
+        switch( reg % 7 )
+        {
+        case 0: v.freq = (v.freq & 0xFF00) | value; break;
+        case 1: v.freq = (v.freq & 0x00FF) | (value << 8); break;
+        case 2: v.pw   = (v.pw & 0x0F00) | value; break;
+        case 3: v.pw   = (v.pw & 0x00FF) | ((value & 0x0F) << 8); break;
+        case 4:
+        {
+            bool gate_was = v.control & 0x01;
+            bool gate_now = value & 0x01;
+            //----------------------------------------------------------
+            // Gate on: start the attack. Gate off: start the release.
+            if( !gate_was && gate_now )
+            {
+                v.env_state = Voice::ATTACK;
+                set_rate( v, v.attack );
+                v.hold_zero = false;
+            }
+            else if( gate_was && !gate_now )
+            {
+                v.env_state = Voice::RELEASE;
+                set_rate( v, v.release );
+            }
+            //----------------------------------------------------------
+            // The test bit stops the oscillator and resets the noise.
+            if( value & 0x08 )
+            {
+                v.accumulator = 0;
+                v.shift_reg = 0x7FFFF8;
+            }
+            v.control = value;
+            break;
+        }
+        case 5:
+            v.attack = value >> 4;
+            v.decay  = value & 0x0F;
+            if( v.env_state == Voice::ATTACK )             set_rate( v, v.attack );
+            else if( v.env_state == Voice::DECAY_SUSTAIN ) set_rate( v, v.decay );
+            break;
+        case 6:
+            v.sustain = value >> 4;
+            v.release = value & 0x0F;
+            if( v.env_state == Voice::RELEASE ) set_rate( v, v.release );
+            break;
+        }
+        return;
+    }
+    //------------------------------------------------------------------
+    // Filter and volume registers.
+    switch( reg )
+    {
+    case 0x15: fc = (fc & 0x7F8) | (value & 0x07); update_filter(); break;
+    case 0x16: fc = (fc & 0x007) | (value << 3);   update_filter(); break;
+    case 0x17: res_filt = value;                   update_filter(); break;
+    case 0x18: mode_vol = value; break;
+    }
+}
+
+//========================================================================
+uint8_t SID::read( uint8_t reg )
+{
+    switch( reg )
+    {
+    case 0x19: // POTX
+    case 0x1A: // POTY
+        return 0xFF;
+    case 0x1B: // OSC3
+        return uint8_t( waveform( voice[2], voice[1] ) >> 4 );
+    case 0x1C: // ENV3
+        return voice[2].envelope;
+    }
+    return bus_value;
+}
+
+//========================================================================
+// Map the register values to the coefficients of the state variable filter.
+void SID::update_filter()
+{
+    //------------------------------------------------------------------
+    // Cutoff frequency in Hz.
+    // The 8580 is (nearly) linear from ~30 Hz to ~12 kHz.
+    // The 6581 curve differs from chip to chip. This is an approximation
+    // of a typical chip: flat around 200 Hz for low values, then rising
+    // exponentially up to about 18 kHz.
+    float x = float(fc) / 2047.0f;
+    float cutoff;
+    if( m_Model == SIDModel::MOS8580 )
+        cutoff = 30.0f + x * 12000.0f;
+    else
+        cutoff = 220.0f + 18000.0f * (std::exp(3.5f * x) - 1.0f) / (std::exp(3.5f) - 1.0f);
+    //------------------------------------------------------------------
+    f_w0 = 2.0f * std::sin( float(M_PI) * cutoff / float(PAL_CLOCK) );
+    //------------------------------------------------------------------
+    // Resonance: Q from 0.707 to about 1.7 (8580) or 2.0 (6581).
+    float q_max = (m_Model == SIDModel::MOS8580) ? 1.7f : 2.0f;
+    float q = 0.707f + (q_max - 0.707f) * float(res_filt >> 4) / 15.0f;
+    f_q = 1.0f / q;
+}
+
+//========================================================================
+// Calculate the 12 bit output of the waveform generator.
+uint16_t SID::waveform( const Voice &v, const Voice &ring_src ) const
+{
+    uint8_t  wave = v.control >> 4;
+    uint32_t acc  = v.accumulator;
+    //------------------------------------------------------------------
+    uint16_t out = 0xFFF; // Combined waveforms are approximated by AND.
+    if( wave == 0 ) return 0;
+    //------------------------------------------------------------------
+    if( wave & 0x1 ) // Triangle
+    {
+        uint32_t msb = (v.control & 0x04) ? ((acc ^ ring_src.accumulator) & 0x800000)
+                                          : (acc & 0x800000);
+        out &= uint16_t( ((msb ? ~acc : acc) >> 11) & 0xFFF );
+    }
+    if( wave & 0x2 ) // Sawtooth
+    {
+        out &= uint16_t( acc >> 12 );
+    }
+    if( wave & 0x4 ) // Pulse
+    {
+        out &= ( (v.control & 0x08) || (acc >> 12) >= v.pw ) ? 0xFFF : 0x000;
+    }
+    if( wave & 0x8 ) // Noise
+    {
+        uint32_t r = v.shift_reg;
+        out &= uint16_t( ((r & 0x100000) >> 9) | ((r & 0x040000) >> 8) |
+                         ((r & 0x004000) >> 5) | ((r & 0x000800) >> 3) |
+                         ((r & 0x000200) >> 2) | ((r & 0x000020) << 1) |
+                         ((r & 0x000004) << 3) | ((r & 0x000001) << 4) );
+    }
+    return out;
+}
+
+//========================================================================
+void SID::clock_envelope( Voice &v )
+{
+    if( ++v.rate_counter < v.rate_period ) return;
+    v.rate_counter = 0;
+    //------------------------------------------------------------------
+    if( v.env_state == Voice::ATTACK )
+    {
+        // The attack is linear, it doesn't use the exponential counter.
+        v.exp_counter = 0;
+        if( ++v.envelope == 0xFF )
+        {
+            v.env_state = Voice::DECAY_SUSTAIN;
+            set_rate( v, v.decay );
+        }
+        v.exp_period = exp_period_for( v.envelope );
+        return;
+    }
+    //------------------------------------------------------------------
+    if( ++v.exp_counter < v.exp_period ) return;
+    v.exp_counter = 0;
+    if( v.hold_zero ) return;
+    //------------------------------------------------------------------
+    if( v.env_state == Voice::DECAY_SUSTAIN && v.envelope == v.sustain * 0x11 )
+        return;
+    //------------------------------------------------------------------
+    if( --v.envelope == 0 )
+        v.hold_zero = true;
+    v.exp_period = exp_period_for( v.envelope );
+}
+
+//========================================================================
+// Step the oscillator of a voice by one cycle.
+static inline void clock_oscillator( uint32_t &acc, uint32_t &shift_reg, bool &msb_rising,
+                                     uint16_t freq, uint8_t control )
+{
+    if( control & 0x08 ) { msb_rising = false; return; }
+    uint32_t prev = acc;
+    acc = (prev + freq) & 0xFFFFFF;
+    msb_rising = !(prev & 0x800000) && (acc & 0x800000);
+    //------------------------------------------------------------------
+    // The noise LFSR is clocked by bit 19 of the accumulator.
+    if( !(prev & 0x080000) && (acc & 0x080000) )
+    {
+        uint32_t bit0 = ((shift_reg >> 22) ^ (shift_reg >> 17)) & 1;
+        shift_reg = ((shift_reg << 1) & 0x7FFFFF) | bit0;
+    }
+}
+
+//========================================================================
+// Voice-major batch: each voice runs through the whole batch on its own.
+// Only possible if no voice is coupled to another one by sync or ring
+// modulation, which is the common case.
+void SID::clock_voices( int cycles, float (*vout)[BATCH] )
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        Voice &v = voice[i];
+        float *o = vout[i];
+        for( int c = 0; c < cycles; c++ )
+        {
+            clock_oscillator( v.accumulator, v.shift_reg, v.msb_rising, v.freq, v.control );
+            clock_envelope( v );
+            o[c] = (float( waveform( v, v ) ) - 2048.0f + voice_dc) * float( v.envelope );
+        }
+    }
+}
+
+//========================================================================
+// Cycle-major batch: all voices are stepped together every cycle, so that
+// hard sync and ring modulation see the other voice of the same cycle.
+void SID::clock_coupled( int cycles, float (*vout)[BATCH] )
+{
+    for( int c = 0; c < cycles; c++ )
+    {
+        for( auto &v : voice )
+            clock_oscillator( v.accumulator, v.shift_reg, v.msb_rising, v.freq, v.control );
+        //--------------------------------------------------------------
+        // Hard sync: voice N is synced by voice N-1 (voice 1 by voice 3).
+        for( int i = 0; i < 3; i++ )
+        {
+            const Voice &src = voice[(i+2) % 3];
+            if( (voice[i].control & 0x02) && src.msb_rising )
+                voice[i].accumulator = 0;
+        }
+        //--------------------------------------------------------------
+        for( int i = 0; i < 3; i++ )
+        {
+            Voice &v = voice[i];
+            clock_envelope( v );
+            vout[i][c] = (float( waveform( v, voice[(i+2) % 3] ) ) - 2048.0f + voice_dc) * float( v.envelope );
+        }
+    }
+}
+
+//========================================================================
+void SID::clock( int cycles, float *out )
+{
+    //------------------------------------------------------------------
+    // Values that don't change during a batch are read only once.
+    const float filt_mask[3] = {
+        (res_filt & 0x01) ? 1.0f : 0.0f,
+        (res_filt & 0x02) ? 1.0f : 0.0f,
+        (res_filt & 0x04) ? 1.0f : 0.0f };
+    // Voice 3 can be disconnected from the output, unless filtered.
+    const float v3_on = ( (mode_vol & 0x80) && !(res_filt & 0x04) ) ? 0.0f : 1.0f;
+    const float lp = (mode_vol & 0x10) ? 1.0f : 0.0f;
+    const float bp = (mode_vol & 0x20) ? 1.0f : 0.0f;
+    const float hp = (mode_vol & 0x40) ? 1.0f : 0.0f;
+    const float volume = float(mode_vol & 0x0F) / 15.0f;
+    const bool coupled = ( (voice[0].control | voice[1].control | voice[2].control) & 0x06 ) != 0;
+    //------------------------------------------------------------------
+    float vout[3][BATCH];
+    while( cycles > 0 )
+    {
+        int n = std::min( cycles, BATCH );
+        if( coupled ) clock_coupled( n, vout );
+        else          clock_voices ( n, vout );
+        //--------------------------------------------------------------
+        for( int c = 0; c < n; c++ )
+        {
+            float v3 = vout[2][c] * v3_on;
+            float filt_in = vout[0][c] * filt_mask[0] + vout[1][c] * filt_mask[1] + v3 * filt_mask[2];
+            float direct  = vout[0][c] + vout[1][c] + v3 - filt_in;
+            //----------------------------------------------------------
+            // State variable filter.
+            float f_hp = filt_in * OUTPUT_SCALE - f_lp - f_q * f_bp;
+            f_bp += f_w0 * f_hp;
+            f_lp += f_w0 * f_bp;
+            float filtered = lp * f_lp + bp * f_bp + hp * f_hp;
+            //----------------------------------------------------------
+            // Mixer, master volume and the output capacitor (DC blocker).
+            float mix = (direct * OUTPUT_SCALE + filtered + mixer_dc) * volume;
+            dc_block += (mix - dc_block) * (1.0f / 8192.0f);
+            out[c] = mix - dc_block;
+        }
+        out += n;
+        cycles -= n;
+    }
+}
+
+//========================================================================
+void SID::clock_silent( int cycles )
+{
+    const bool coupled = ( (voice[0].control | voice[1].control | voice[2].control) & 0x06 ) != 0;
+    float vout[3][BATCH];
+    while( cycles > 0 )
+    {
+        int n = std::min( cycles, BATCH );
+        if( coupled ) clock_coupled( n, vout );
+        else          clock_voices ( n, vout );
+        cycles -= n;
+    }
+}
+
+//========================================================================
+} // End of namespace sound
+
+//========================================================================
+// End of file.
+//========================================================================
@@ -0,0 +1,106 @@
+#ifndef SID_H
+#define SID_H
+
+#include <cstdint>
+#include <array>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// PAL system clock of the C64 (Hz). The SID runs at this rate.
+constexpr double PAL_CLOCK = 985248.0;
+
+//========================================================================
+// The two SID chip revisions. They differ mainly in the filter curve,
+// the combined waveforms and the DC offsets of voices and mixer.
+enum class SIDModel { MOS6581, MOS8580 };
+
+//========================================================================
+// Emulation of the SID sound chip (6581/8580).
+//
+// The chip is not stepped every cycle by the caller. Instead it is
+// clocked in batches: clock() synthesizes a whole run of cycles in one
+// tight loop and writes one output sample per cycle. Register writes
+// are expected to be applied between two batches, i.e. the owner first
+// catches the SID up to the current cycle, then writes the register.
+class SID
+{
+public:
+    //========================================================================
+    void init( SIDModel model = SIDModel::MOS6581 );
+    void reset();
+    //========================================================================
+    // Register access, reg is 0x00 - 0x1F.
+    void    write( uint8_t reg, uint8_t value );
+    uint8_t read ( uint8_t reg );
+    //========================================================================
+    // Synthesize the given number of cycles, one float sample per cycle
+    // (range about -1.0 .. +1.0) is written to "out".
+    void clock( int cycles, float *out );
+    // Advance the voices (oscillators, envelopes, noise) without making
+    // any output: the filter and the mixer are left as they are. For
+    // cycles nobody listens to, e.g. the hidden frames of run-ahead. Only
+    // what the CPU can read back (OSC3, ENV3) is kept exact.
+    void clock_silent( int cycles );
+    //========================================================================
+    SIDModel model() const { return m_Model; }
+
+private:
+    //========================================================================
+    struct Voice
+    {
+        uint32_t accumulator {0};   // 24 bit phase accumulator.
+        uint32_t shift_reg {0x7FFFF8}; // 23 bit noise LFSR.
+        uint16_t freq {0};
+        uint16_t pw {0};            // 12 bit pulse width.
+        uint8_t  control {0};
+        //----------------------------------------------------------------
+        // Envelope generator.
+        uint8_t  attack {0}, decay {0}, sustain {0}, release {0};
+        uint8_t  env_state {RELEASE};
+        uint8_t  envelope {0};      // 8 bit envelope output.
+        uint16_t rate_counter {0};
+        uint16_t rate_period {9};
+        uint8_t  exp_counter {0};
+        uint8_t  exp_period {1};
+        bool     hold_zero {true};
+        //----------------------------------------------------------------
+        bool     msb_rising {false}; // Set when the accumulator MSB went 0->1 this cycle.
+        //----------------------------------------------------------------
+        enum { ATTACK, DECAY_SUSTAIN, RELEASE };
+    };
+    //========================================================================
+    SIDModel m_Model { SIDModel::MOS6581 };
+    std::array<Voice,3> voice;
+    //========================================================================
+    // Filter and mixer registers.
+    uint16_t fc {0};            // 11 bit cutoff.
+    uint8_t  res_filt {0};      // Resonance (bits 4-7) and routing (bits 0-3).
+    uint8_t  mode_vol {0};      // Filter mode (bits 4-7) and volume (bits 0-3).
+    uint8_t  bus_value {0};     // Last value written (read back from write-only registers).
+    //========================================================================
+    // Filter state (state variable filter) and derived coefficients.
+    float f_lp {0}, f_bp {0};
+    float f_w0 {0}, f_q {1};
+    float voice_dc {0}, mixer_dc {0};
+    float dc_block {0};         // State of the output DC blocker.
+    //========================================================================
+    // Cycles synthesized per inner batch.
+    static constexpr int BATCH = 256;
+    // Scales the sum of the voices, with some headroom for the filter
+    // resonance and the 6581 DC offsets.
+    static constexpr float OUTPUT_SCALE = 1.0f / (6.0f * 2048.0f * 255.0f);
+    //========================================================================
+    void clock_voices ( int cycles, float (*vout)[BATCH] );
+    void clock_coupled( int cycles, float (*vout)[BATCH] );
+    void update_filter();
+    void set_rate( Voice &v, uint8_t rate );
+    void clock_envelope( Voice &v );
+    uint16_t waveform( const Voice &v, const Voice &ring_src ) const;
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // SID_H
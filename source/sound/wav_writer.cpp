@@ -0,0 +1,72 @@
+//========================================================================
+#include "wav_writer.h"
+
+#include <stdexcept>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Write a little endian integer of the given size.
+static void put( std::ofstream &out, uint32_t value, int bytes )
+{
+    for( int i = 0; i < bytes; i++ )
+        out.put( char( (value >> (8*i)) & 0xFF ) );
+}
+
+//========================================================================
+void WavWriter::open( const std::string &filename, int rate, int channels )
+{
+    close();
+    out.open( filename, std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !out )
+    {
+        throw std::runtime_error( "Can't open WAV file for writing: " + filename );
+    }
+    m_Rate = rate;
+    m_Channels = channels;
+    data_bytes = 0;
+    write_header(); // With zero sizes for now.
+}
+
+//========================================================================
+void WavWriter::write_header()
+{
+    const uint32_t block_align = uint32_t(m_Channels) * sizeof(int16_t);
+    out.seekp( 0 );
+    out.write( "RIFF", 4 );  put( out, 36 + data_bytes, 4 );
+    out.write( "WAVE", 4 );
+    out.write( "fmt ", 4 );  put( out, 16, 4 );
+    put( out, 1, 2 );                       // PCM
+    put( out, uint32_t(m_Channels), 2 );
+    put( out, uint32_t(m_Rate), 4 );
+    put( out, uint32_t(m_Rate) * block_align, 4 );
+    put( out, block_align, 2 );
+    put( out, 16, 2 );                      // Bits per sample.
+    out.write( "data", 4 );  put( out, data_bytes, 4 );
+}
+
+//========================================================================
+void WavWriter::write( const int16_t *samples, size_t count )
+{
+    if( !out.is_open() ) return;
+    //------------------------------------------------------------------
+    // WAV is little endian, like the platforms we run on.
+    out.write( reinterpret_cast<const char*>(samples), std::streamsize(count * sizeof(int16_t)) );
+    data_bytes += uint32_t( count * sizeof(int16_t) );
+}
+
+//========================================================================
+void WavWriter::close()
+{
+    if( !out.is_open() ) return;
+    write_header(); // Now with the real sizes.
+    out.close();
+}
+
+//========================================================================
+} // End of namespace sound
+
+//========================================================================
+// End of file.
+//========================================================================
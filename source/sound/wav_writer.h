@@ -0,0 +1,44 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include "utils.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+//========================================================================
+namespace sound {
+
+//========================================================================
+// Writes 16 bit signed PCM samples to a RIFF/WAVE file.
+// The header sizes are patched when the file is closed.
+class WavWriter
+{
+public:
+    //========================================================================
+    WavWriter() = default;
+    NO_COPY( WavWriter );
+    NO_MOVE( WavWriter );
+    virtual ~WavWriter() { close(); }
+    //========================================================================
+    void open( const std::string &filename, int rate, int channels = 1 );
+    void write( const int16_t *samples, size_t count );
+    void close();
+    bool is_open() const { return out.is_open(); }
+    //========================================================================
+    size_t samples_written() const { return data_bytes / sizeof(int16_t); }
+
+private:
+    std::ofstream out;
+    uint32_t data_bytes {0};
+    int m_Rate {0};
+    int m_Channels {1};
+    //========================================================================
+    void write_header();
+};
+
+//========================================================================
+} // End of namespace sound
+
+#endif // WAV_WRITER_H
@@ -0,0 +1,139 @@
+//======================================================================
+#include "stream_server.h"
+#include "alloc_count.h"
+//======================================================================
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+//======================================================================
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//======================================================================
+StreamServer::~StreamServer()
+{
+    for( auto &viewer : viewers )
+        close( viewer.fd );
+    if( m_Listen >= 0 )
+    {
+        close( m_Listen );
+        unlink( m_Path.c_str() );
+    }
+}
+
+//======================================================================
+void StreamServer::open( const std::string &path, int width, int height, int keyframe_interval )
+{
+    encoder.init( width, height, keyframe_interval );
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(addr.sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( std::string( "Can't create socket: " ) + std::strerror( errno ) );
+    unlink( path.c_str() );
+    if( bind( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 || listen( fd, 8 ) != 0 )
+    {
+        std::string text = "Can't listen on " + path + ": " + std::strerror( errno );
+        close( fd );
+        throw std::runtime_error( text );
+    }
+    m_Listen = fd;
+    m_Path = path;
+}
+
+//======================================================================
+void StreamServer::poll()
+{
+    if( m_Listen < 0 )
+        return;
+    int fd;
+    while( (fd = accept4( m_Listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC )) >= 0 )
+    {
+        std::string *queue = queues.acquire();
+        queue->reserve( 2 * encoder.max_message() );
+        viewers.push_back( Viewer { fd, queue } );
+        encoder.request_keyframe();
+        alloc_count::excuse_frame();
+    }
+    drop_closed();
+    for( auto &viewer : viewers )
+        flush( viewer );
+    drop_closed();
+}
+
+//======================================================================
+void StreamServer::send_frame( const uint8_t *indices )
+{
+    if( viewers.empty() )
+        return;
+    const std::string &message = encoder.encode( indices );
+    for( auto &viewer : viewers )
+    {
+        viewer.queue->append( message );
+        if( flush( viewer ) && viewer.queue->size() > MAX_QUEUE )
+        {
+            close( viewer.fd );
+            viewer.fd = -1;
+        }
+    }
+    drop_closed();
+    m_FramesSent++;
+}
+
+//======================================================================
+// Send as much of the queue as the socket takes. Returns false (and
+// closes the viewer) on an error.
+bool StreamServer::flush( Viewer &viewer )
+{
+    size_t sent = 0;
+    while( viewer.fd >= 0 && sent < viewer.queue->size() )
+    {
+        ssize_t n = ::send( viewer.fd, viewer.queue->data() + sent, viewer.queue->size() - sent, MSG_NOSIGNAL );
+        if( n > 0 )
+        {
+            sent += size_t(n);
+            continue;
+        }
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            break;
+        close( viewer.fd );
+        viewer.fd = -1;
+    }
+    viewer.queue->erase( 0, sent );
+    m_BytesSent += sent;
+    return viewer.fd >= 0;
+}
+
+//======================================================================
+// Viewers don't send anything, a readable socket means they hung up.
+void StreamServer::drop_closed()
+{
+    for( auto &viewer : viewers )
+    {
+        char buffer[256];
+        while( viewer.fd >= 0 )
+        {
+            ssize_t n = recv( viewer.fd, buffer, sizeof(buffer), 0 );
+            if( n > 0 )
+                continue;
+            if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+                break;
+            close( viewer.fd );
+            viewer.fd = -1;
+        }
+        if( viewer.fd < 0 )
+        {
+            viewer.queue->clear();
+            queues.release( viewer.queue );
+        }
+    }
+    viewers.erase( std::remove_if( viewers.begin(), viewers.end(), []( const Viewer &v ) { return v.fd < 0; } ),
+                   viewers.end() );
+}
+
+//======================================================================
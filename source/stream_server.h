@@ -0,0 +1,62 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+//======================================================================
+#include "frame_arena.h"
+#include "frame_stream.h"
+#include "utils.h"
+//======================================================================
+#include <string>
+#include <vector>
+
+//======================================================================
+// The frames of a session on a Unix domain socket, for viewers in other
+// processes (glMurks64-streamview), see gfx::FrameEncoder. Any number of
+// viewers; a new one gets a keyframe at once (and so do the others).
+// Everything is non-blocking: a viewer that falls behind by more than
+// MAX_QUEUE bytes loses its connection instead of stalling the emulation.
+class StreamServer
+{
+public:
+    //========================================================================
+    static constexpr size_t MAX_QUEUE = 1 << 20;
+    //========================================================================
+    StreamServer() = default;
+    NO_COPY( StreamServer );
+    NO_MOVE( StreamServer );
+    virtual ~StreamServer();
+    //========================================================================
+    // Listen on "path" (replaced if it exists) for frames of width x
+    // height. Throws std::runtime_error.
+    void open( const std::string &path, int width, int height, int keyframe_interval = 250 );
+    bool is_open() const { return m_Listen >= 0; }
+    // Only then is a frame worth rendering.
+    bool has_viewers() const { return !viewers.empty(); }
+    //========================================================================
+    // Accept viewers, drop the ones that hung up, send what is queued.
+    void poll();
+    // Send a frame of palette indices to all viewers.
+    void send_frame( const uint8_t *indices );
+    //========================================================================
+    uint64_t bytes_sent() const { return m_BytesSent; }
+    uint64_t frames_sent() const { return m_FramesSent; }
+
+private:
+    struct Viewer
+    {
+        int fd;
+        std::string *queue;  // From "queues", with room for two keyframes.
+    };
+    std::string m_Path;
+    int m_Listen {-1};
+    std::vector<Viewer> viewers;
+    utils::ObjectPool<std::string> queues;
+    gfx::FrameEncoder encoder;
+    uint64_t m_BytesSent {0};
+    uint64_t m_FramesSent {0};
+    //========================================================================
+    bool flush( Viewer &viewer );
+    void drop_closed();
+};
+
+#endif // STREAM_SERVER_H
+//======================================================================
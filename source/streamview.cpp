@@ -0,0 +1,241 @@
+//======================================================================
+// glMurks64-streamview: shows the frames that a session streams on a
+// Unix socket (glMurks64 --stream, glMurks64-headless --stream), see
+// gfx::FrameEncoder. A reference for other viewers: it needs SDL2 and
+// the frame decoder, nothing of the emulation.
+//======================================================================
+#include "frame_diff.h"
+#include "frame_stream.h"
+#include "palette.h"
+#include "utils.h"
+//======================================================================
+#include <SDL2/SDL.h>
+//======================================================================
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+//======================================================================
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//======================================================================
+static void usage()
+{
+    std::cerr <<
+        "Usage: glMurks64-streamview [options] <socket>\n"
+        "  --scale <n>             Window size in pixels per C64 pixel (default: 2).\n"
+        "  --palette <name|file>   Colors, see glMurks64 --palette.\n"
+        "  --stats                 Print the bandwidth once a second.\n"
+        "  --no-window             Only decode, e.g. to measure the bandwidth.\n"
+        "  --frames <n>            Exit after n frames.\n"
+        "  --save <ppm>            Save the last frame as an image at the exit.\n";
+}
+
+//======================================================================
+static int connect_to( const std::string &path )
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(addr.sun_path) )
+        throw std::runtime_error( "Socket path too long: " + path );
+    std::strcpy( addr.sun_path, path.c_str() );
+    int fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+        throw std::runtime_error( std::string( "Can't create socket: " ) + std::strerror( errno ) );
+    if( connect( fd, reinterpret_cast<sockaddr*>( &addr ), sizeof(addr) ) != 0 )
+    {
+        std::string text = "Can't connect to " + path + ": " + std::strerror( errno );
+        close( fd );
+        throw std::runtime_error( text );
+    }
+    return fd;
+}
+
+//======================================================================
+// The window: the frame as a streaming texture, scaled by SDL.
+struct Window
+{
+    SDL_Window *window {nullptr};
+    SDL_Renderer *renderer {nullptr};
+    SDL_Texture *texture {nullptr};
+    int width {0}, height {0};
+    std::vector<uint32_t> pixels;
+
+    Window() = default;
+    NO_COPY( Window );
+    NO_MOVE( Window );
+    ~Window()
+    {
+        if( texture )  SDL_DestroyTexture( texture );
+        if( renderer ) SDL_DestroyRenderer( renderer );
+        if( window )   SDL_DestroyWindow( window );
+    }
+    //------------------------------------------------------------------
+    void show( const gfx::FrameDecoder &frame, const gfx::Palette &palette, int scale, const std::string &title )
+    {
+        if( frame.width() != width || frame.height() != height )
+        {
+            width = frame.width();
+            height = frame.height();
+            pixels.resize( size_t( width * height ) );
+            if( !window )
+            {
+                window = SDL_CreateWindow( title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                           width * scale, height * scale, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE );
+                renderer = window ? SDL_CreateRenderer( window, -1, SDL_RENDERER_PRESENTVSYNC ) : nullptr;
+                if( !renderer )
+                    throw std::runtime_error( std::string( "Can't create the window: " ) + SDL_GetError() );
+            }
+            if( texture )
+                SDL_DestroyTexture( texture );
+            texture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height );
+            if( !texture )
+                throw std::runtime_error( std::string( "Can't create the texture: " ) + SDL_GetError() );
+        }
+        palette.to_pixels( frame.indices(), pixels.data(), pixels.size() );
+        SDL_UpdateTexture( texture, nullptr, pixels.data(), width * 4 );
+        SDL_RenderClear( renderer );
+        SDL_RenderCopy( renderer, texture, nullptr, nullptr );
+        SDL_RenderPresent( renderer );
+    }
+};
+
+//======================================================================
+int main(int argc, char** argv)
+{
+    std::string path, save;
+    gfx::Palette palette;
+    int scale = 2;
+    bool stats = false, windowed = true;
+    long max_frames = -1;
+    try
+    {
+        for( int i = 1; i < argc; i++ )
+        {
+            std::string arg = argv[i];
+            bool has_value = (i + 1 < argc);
+            if( arg == "--scale" && has_value )         scale = std::max( 1, std::atoi( argv[++i] ) );
+            else if( arg == "--palette" && has_value )  palette = gfx::Palette::load( argv[++i] );
+            else if( arg == "--stats" )                 stats = true;
+            else if( arg == "--no-window" )             windowed = false;
+            else if( arg == "--frames" && has_value )   max_frames = std::atol( argv[++i] );
+            else if( arg == "--save" && has_value )     save = argv[++i];
+            else if( arg.size() > 1 && arg[0] == '-' )  { usage(); return -1; }
+            else                                        path = arg;
+        }
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << "\n";
+        return -1;
+    }
+    if( path.empty() )
+    {
+        usage();
+        return -1;
+    }
+    if( windowed && SDL_Init( SDL_INIT_VIDEO ) < 0 )
+    {
+        std::cerr << "***ERROR: Can't initialize SDL: " << SDL_GetError() << "\n";
+        return -1;
+    }
+    //------------------------------------------------------------------
+    gfx::FrameDecoder decoder;
+    long frames = 0;
+    uint64_t bytes = 0, second_bytes = 0;
+    long second_frames = 0;
+    try
+    {
+        int fd = connect_to( path );
+        Window window;
+        std::string input;
+        auto second = std::chrono::steady_clock::now();
+        bool run = true;
+        while( run && (max_frames < 0 || frames < max_frames) )
+        {
+            //----------------------------------------------------------
+            // Whatever arrived, then every complete message in it.
+            pollfd pfd { fd, POLLIN, 0 };
+            if( ::poll( &pfd, 1, 10 ) > 0 )
+            {
+                char buffer[65536];
+                ssize_t n = recv( fd, buffer, sizeof(buffer), 0 );
+                if( n <= 0 )
+                {
+                    std::cerr << "The stream ended.\n";
+                    break;
+                }
+                input.append( buffer, size_t(n) );
+                bytes += uint64_t(n);
+                second_bytes += uint64_t(n);
+            }
+            size_t pos = 0;
+            bool shown = false;
+            while( input.size() - pos >= gfx::stream::LENGTH_BYTES )
+            {
+                const auto *head = reinterpret_cast<const uint8_t*>( input.data() + pos );
+                size_t length = head[0] | (head[1] << 8) | (head[2] << 16) | (size_t( head[3] ) << 24);
+                if( input.size() - pos - gfx::stream::LENGTH_BYTES < length )
+                    break;
+                if( decoder.decode( head + gfx::stream::LENGTH_BYTES, length ) )
+                {
+                    frames++;
+                    second_frames++;
+                    shown = true;
+                }
+                pos += gfx::stream::LENGTH_BYTES + length;
+                if( max_frames >= 0 && frames >= max_frames )
+                    break;
+            }
+            input.erase( 0, pos );
+            //----------------------------------------------------------
+            if( windowed )
+            {
+                if( shown )
+                    window.show( decoder, palette, scale, "glMurks64-streamview: " + path );
+                SDL_Event event;
+                while( SDL_PollEvent( &event ) )
+                    if( event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) )
+                        run = false;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if( stats && now - second >= std::chrono::seconds( 1 ) )
+            {
+                std::cout << "Frame " << decoder.frame() << ": " << second_frames << " frames, " << second_bytes
+                          << " bytes per second (" << (second_frames ? second_bytes / uint64_t( second_frames ) : 0)
+                          << " per frame)" << std::endl;
+                second = now;
+                second_bytes = 0;
+                second_frames = 0;
+            }
+        }
+        close( fd );
+        if( !save.empty() && decoder.has_frame() )
+            gfx::write_frame_image( save, gfx::PackedFrame::pack( decoder.indices(), decoder.width(), decoder.height() ),
+                                    palette );
+    }
+    catch( const std::runtime_error &e )
+    {
+        std::cerr << "***ERROR: " << e.what() << "\n";
+        return -1;
+    }
+    std::cout << frames << " frames, " << bytes << " bytes received";
+    if( frames )
+        std::cout << " (" << (bytes / uint64_t( frames )) << " per frame)";
+    std::cout << ".\n";
+    if( windowed )
+        SDL_Quit();
+    return 0;
+}
+
+//======================================================================
+// End of file.
+//======================================================================
@@ -0,0 +1,134 @@
+//======================================================================
+#include "utils.h"
+//======================================================================
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+
+//========================================================================
+#if defined(__linux__)
+    #include <unistd.h> // For "readlink()" on GNU/linux.
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+#if defined(_WIN32)
+    #include <libloaderapi.h> // For GetModuleFileName() on Windows
+#endif
+
+//======================================================================
+namespace utils {
+    //======================================================================
+#if defined(__linux__)
+    void Buffer::map( const std::string &filename, Map mode )
+    {
+        int fd = open( filename.c_str(), mode == Map::SHARED ? O_RDWR : O_RDONLY );
+        struct stat st;
+        if( fd < 0 || fstat( fd, &st ) != 0 )
+        {
+            std::string text = "Can't open " + filename + ": " + std::strerror( errno );
+            if( fd >= 0 ) close( fd );
+            throw std::runtime_error( text );
+        }
+        if( st.st_size == 0 )
+        {
+            close( fd );
+            throw std::runtime_error( "Empty file: " + filename );
+        }
+        int prot  = mode == Map::READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+        int flags = mode == Map::SHARED ? MAP_SHARED : MAP_PRIVATE;
+        void *p = mmap( nullptr, size_t(st.st_size), prot, flags, fd, 0 );
+        close( fd );
+        if( p == MAP_FAILED )
+            throw std::runtime_error( "Can't map " + filename + ": " + std::strerror( errno ) );
+        destroy();
+        buffer  = static_cast<char*>( p );
+        _size   = size_t(st.st_size);
+        _mapped = true;
+    }
+    //======================================================================
+    void Buffer::sync( size_t offset, size_t length )
+    {
+        if( !_mapped || offset >= _size )
+            return;
+        // msync() wants a page aligned start.
+        size_t page  = size_t( sysconf( _SC_PAGESIZE ) );
+        size_t start = offset - offset % page;
+        msync( buffer + start, std::min( offset + length, _size ) - start, MS_SYNC );
+    }
+    //======================================================================
+    void Buffer::unmap()
+    {
+        munmap( buffer, _size );
+    }
+#else
+    //======================================================================
+    // No mapping: the file is read, and SHARED changes are lost.
+    void Buffer::map( const std::string &filename, Map )
+    {
+        try { load( filename ); }
+        catch( int ) { throw std::runtime_error( "Can't open " + filename ); }
+    }
+    void Buffer::sync( size_t, size_t ) {}
+    void Buffer::unmap() { delete[] buffer; }
+#endif
+    //======================================================================
+    Resource RM; // Singleton resource manager for the whole program
+    //======================================================================
+    // No exit() here: this runs before main(), also in programs that use
+    // the library (see api/glmurks64.h). Without a folder, load() throws.
+    Resource::Resource()
+    {
+        const char *env = std::getenv( "GLMURKS64_RESOURCES" );
+        if( env && std::filesystem::is_directory( env ) )
+            resource_folder = env;
+        else
+            resource_folder = find_resource_path( Resource::get_exe_path() );
+    }
+    //======================================================================
+    Buffer Resource::load( const std::string & filename )
+    {
+        if( resource_folder.empty() )
+            throw std::runtime_error( "Can't find resource folder!" );
+        path full_path = resource_folder / filename;
+        return Buffer( full_path.string() );
+    }
+    //======================================================================
+    path Resource::get_exe_path()
+    {
+        char exe_path[65536];
+        memset(exe_path, 0, 65536);
+    #if defined(__linux__)
+        auto exe_size = readlink("/proc/self/exe", exe_path, 65535);
+    #elif defined(_WIN32)
+        (void)::GetModuleFileName(nullptr, exe_path, 65535);
+    #else
+    #error Operating system is not supported! Must be either Linux or Windows!
+    #endif
+        std::filesystem::path exe {exe_path};
+        return exe.parent_path();
+    }
+    //======================================================================
+    path Resource::find_resource_path(const path &check_dir)
+    {
+        if( !std::filesystem::exists( check_dir) ) return "";
+        if( check_dir == "/" ) return "";
+        if( !std::filesystem::is_directory(check_dir) ) return "";
+
+        path test_dir = check_dir / "resource";
+        if( std::filesystem::is_directory(test_dir) )
+        {
+            return test_dir;
+        }
+
+        return find_resource_path( check_dir.parent_path() );
+    }
+}
+
+//======================================================================
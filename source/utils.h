@@ -29,6 +29,14 @@ public:
     Buffer(const Buffer& other) = delete;
     Buffer & operator=(const Buffer& other) = delete;
     //========================================================================
+    // How map() maps a file.
+    enum class Map
+    {
+        READ_ONLY,  // Writing to the buffer crashes.
+        PRIVATE,    // Writable, changes stay in memory (copy on write).
+        SHARED      // Writable, changes go to the file, see sync().
+    };
+    //========================================================================
     // Move semantics.
     Buffer(Buffer&& other) noexcept
     {
@@ -71,23 +79,38 @@ public:
         throw(errno);
     }
     //========================================================================
+    // Map the file instead of reading it: nothing is copied, the pages
+    // are read when they are used. Throws std::runtime_error.
+    void map( const std::string &filename, Map mode = Map::READ_ONLY );
+    bool mapped() const { return _mapped; }
+    // Write the changes to a SHARED mapping in [offset, offset+length)
+    // to the file. Blocks until they are on disk.
+    void sync( size_t offset, size_t length );
+    //========================================================================
 
 private:
     //========================================================================
     char * buffer { nullptr};
     size_t _size {0};
+    bool _mapped {false};
     //========================================================================
     void move_helper(Buffer && other) noexcept
     {
         _size = other._size;
+        _mapped = other._mapped;
         buffer = other.buffer;
         other.buffer = nullptr;
+        other._mapped = false;
     }
     //========================================================================
+    void unmap();
     void destroy()
     {
-        if(buffer) delete[] buffer;
+        if( _mapped ) unmap();
+        else if(buffer) delete[] buffer;
+        buffer = nullptr;
         _size = 0;
+        _mapped = false;
     }
     //========================================================================
 };
@@ -102,10 +125,14 @@ class Resource
     std::filesystem::path resource_folder;
 public:
     //======================================================================
+    // The folder in the environment variable GLMURKS64_RESOURCES, else the
+    // first "resource" folder from the executable's folder upwards.
     Resource();
     //======================================================================
+    // Throws std::runtime_error if there is no resource folder.
     Buffer load( const std::string & filename );
     //======================================================================
+    // Empty if there is no resource folder.
     const std::filesystem::path &get_path() { return resource_folder; }
     //======================================================================
 private: